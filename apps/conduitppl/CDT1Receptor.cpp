@@ -12,6 +12,7 @@
 #include <string>
 #include <vector>
 #include <sstream>
+#include <future>
 #include <unordered_set>
 
 #include <boost/scoped_ptr.hpp>
@@ -35,6 +36,9 @@
 #include "Parser/Mol2.h"
 #include "Parser/Sdf.h"
 #include "Parser/SanderOutput.h"
+#include "Parser/Prmtop.h"
+#include "Parser/AmberPdb.h"
+#include "MM/Amber.h"
 #include "Structure/Sstrm.hpp"
 #include "Structure/Coor3d.h"
 #include "Structure/Constants.h"
@@ -42,7 +46,9 @@
 #include "Structure/Atom.h"
 #include "Common/LBindException.h"
 #include "Common/Tokenize.hpp"
-#include "Common/Command.hpp"
+#include "Common/Process.h"
+#include "Common/FileOps.h"
+#include "Common/ScopedTimer.h"
 #include "BackBone/Surface.h"
 #include "BackBone/Grid.h"
 #include "Structure/ParmContainer.h"
@@ -51,6 +57,7 @@
 #include "Common/LBindException.h"
 #include "Common/Utils.h"
 #include "XML/XMLHeader.hpp"
+#include "Parallel/Dispatcher.h"
 
 #include "CDT1Receptor.h"
 #include "CDT1ReceptorPO.h"
@@ -122,6 +129,9 @@ void toConduit(JobOutData& jobOut, std::string& recCdtFile){
         n[recIDMeta + "/Site/Dimension/Y"] = jobOut.dimension.getY();
         n[recIDMeta + "/Site/Dimension/Z"] = jobOut.dimension.getZ();
         n[recIDMeta + "/Mesg"] = jobOut.message;
+        for(const auto& t : jobOut.timing.phases()){
+            n[recIDMeta + "/timing/" + t.first] = t.second;
+        }
         std::string recIDFile ="rec/"+jobOut.pdbid + "/file/";
 
         std::vector<std::string> filenames={"rec_min.pdbqt", "rec_min.rst", "rec.prmtop", "rec_min.pdb", "std4pdbqt.pdb",
@@ -218,16 +228,14 @@ bool isRun(JobInputData& jobInput){
 */
 void rmRecDir(JobOutData& jobOut)
 {
-    std::string cmd="rm -rf " + jobOut.recPath;
-    std::string errMesg="Remove fails for "+jobOut.recPath;
-    command(cmd, errMesg);
+    removeAll(jobOut.recPath);
 }
 
-bool getSiteFromLigand(JobInputData& jobInput, JobOutData& jobOut, Coor3d& centroid, Coor3d& boxDim){
+bool getSiteFromLigand(const JobInputData& jobInput, const std::string& subRes, Coor3d& centroid, Coor3d& boxDim){
     bool hasSubResCoor=false;
 
-    std::cout << "jobOut.subRes=" << jobOut.subRes << std::endl;
-    std::string subResFileName=jobOut.subRes;
+    std::cout << "jobOut.subRes=" << subRes << std::endl;
+    std::string subResFileName=subRes;
     std::string fileExtension=subResFileName.substr(subResFileName.find_last_of(".") + 1);
     std::cout << "fileExtension=" << fileExtension << std::endl;
     if( fileExtension == "mol2") {
@@ -249,22 +257,20 @@ bool getSiteFromLigand(JobInputData& jobInput, JobOutData& jobOut, Coor3d& centr
 }
 
 
-void minimization(JobInputData& jobInput, JobOutData& jobOut, std::string& checkFName, std::string& recType, std::string& libDir) {
-    std::string tleapFName = recType + "_leap.in";
-    std::string cmd = "";
-    std::string errMesg = "";
-
-    std::vector<std::vector<int> > ssList;
-    {
-        boost::scoped_ptr<Pdb> pPdb(new Pdb());
-        pPdb->getDisulfide(checkFName, ssList);
+//! recType_std.pdb from checkFName with the disulfide-bonded CYS renamed, and the SS bonds for tleap.
+void stdReceptor(std::string& checkFName, std::string& recType, std::vector<std::vector<int> >& ssList) {
+    boost::scoped_ptr<Pdb> pPdb(new Pdb());
+    pPdb->getDisulfide(checkFName, ssList);
 
-        std::string stdPdbFile = recType + "_std.pdb";
-
-        pPdb->standardlizeSS(checkFName, stdPdbFile, ssList);
+    std::string stdPdbFile = recType + "_std.pdb";
 
+    pPdb->standardlizeSS(checkFName, stdPdbFile, ssList);
+}
 
-    }
+//! GB minimization of recType_std.pdb, written by stdReceptor.
+void minimization(JobInputData& jobInput, JobOutData& jobOut, std::vector<std::vector<int> >& ssList, std::string& recType, std::string& libDir) {
+    std::string tleapFName = recType + "_leap.in";
+    std::string errMesg = "";
 
     {
         std::ofstream tleapFile;
@@ -316,10 +322,8 @@ void minimization(JobInputData& jobInput, JobOutData& jobOut, std::string& check
         tleapFile.close();
     }
 
-    cmd = "tleap -f " + tleapFName + " >& " + recType + "_leap.log";
-    //std::cout <<cmd <<std::endl;
     errMesg = "tleap creating receptor prmtop fails";
-    command(cmd, errMesg);
+    runProcess({"tleap", "-f", tleapFName}, errMesg, redirectOut(recType + "_leap.log", true));
 
     std::string minFName = recType + "_minGB.in";
     {
@@ -349,14 +353,10 @@ void minimization(JobInputData& jobInput, JobOutData& jobOut, std::string& check
                 << " /\n" << std::endl;
         minFile.close();
     }
-    if (jobInput.ambVersion == 13) {
-        cmd = "sander13 -O -i " + recType + "_minGB.in -o " + recType + "_minGB.out  -p " + recType + ".prmtop -c " + recType + ".inpcrd -ref " + recType + ".inpcrd -x " + recType + ".mdcrd -r " + recType + "_min.rst";
-    } else {
-        cmd = "sander -O -i " + recType + "_minGB.in -o " + recType + "_minGB.out  -p " + recType + ".prmtop -c " + recType + ".inpcrd -ref " + recType + ".inpcrd -x " + recType + ".mdcrd -r " + recType + "_min.rst";
-    }
-    //std::cout <<cmd <<std::endl;
+    std::string sander = (jobInput.ambVersion == 13) ? "sander13" : "sander";
     errMesg = "sander receptor minimization fails";
-    command(cmd, errMesg);
+    runProcess({sander, "-O", "-i", recType + "_minGB.in", "-o", recType + "_minGB.out", "-p", recType + ".prmtop",
+                "-c", recType + ".inpcrd", "-ref", recType + ".inpcrd", "-x", recType + ".mdcrd", "-r", recType + "_min.rst"}, errMesg);
 
     boost::scoped_ptr<SanderOutput> pSanderOutput(new SanderOutput());
     std::string sanderOut = recType + "_minGB.out";
@@ -369,44 +369,104 @@ void minimization(JobInputData& jobInput, JobOutData& jobOut, std::string& check
         throw LBindException(message);
     }
 
-    if (jobInput.ambVersion == 16) {
-        cmd = "ambpdb -p " + recType + ".prmtop -aatm -c " + recType + "_min.rst > " + recType + "_min_0.pdb";
-    } else {
-        cmd = "ambpdb -p " + recType + ".prmtop -aatm < " + recType + "_min.rst > " + recType + "_min_0.pdb";
+    {
+        Prmtop prmtop;
+        prmtop.read(recType + ".prmtop");
+        std::vector<double> xyz;
+        readAmberCoords(recType + "_min.rst", xyz);
+
+        AmberPdb amberPdb(prmtop);
+        amberPdb.write(recType + "_min_0.pdb", xyz, true);
+        amberPdb.write(recType + "_min_orig.pdb", xyz, true, AmberPdb::ALL, "", false);
+        amberPdb.write(recType + "_min_1.pdb", xyz, false);
     }
 
-    //std::cout <<cmd <<std::endl;
-    errMesg = "ambpdb converting rst to " + recType + "_min_0.pdb file fails";
-    command(cmd, errMesg);
+    symLink(recType + "_min_orig.pdb", "rec_min.pdb", true);
+}
 
-    checkFName = recType + "_min_0.pdb";
-    if (!fileExist(checkFName)) {
-        std::string message = checkFName + " does not exist.";
-        throw LBindException(message);
+//! Docking site found by siteSearch, copied into JobOutData once the search thread is joined.
+struct SiteResult{
+    int clust=0;
+    double volume=0;
+    Coor3d centroid;
+    Coor3d dimension;
+};
+
+//! Cavity search on stdPDBfile: SASA, the grid of cavity points and the docking site, picked from the
+//! substrate, the key residues or the largest cavity, into site and recDir/rec_geo.txt. It runs next to
+//! the receptor minimization, so it only takes absolute paths and writes nothing but site and times.
+void siteSearch(const JobInputData& jobInput, const std::string& subRes, const std::string& recDir,
+                const std::string& stdPDBfile, const std::string& pdbFile, Complex* pComplex,
+                ParmContainer* pParmContainer, Grid* pGrid, SiteResult& site, PhaseTimes& times){
+    boost::scoped_ptr<Pdb> pPdb(new Pdb());
+    pPdb->parse(stdPDBfile, pComplex);
+
+    ElementContainer* pElementContainer = pParmContainer->addElementContainer();
+    pComplex->assignElement(pElementContainer);
+
+    boost::scoped_ptr<Surface> pSurface(new Surface(pComplex));
+    std::cout << "Start Calculation " << std::endl;
+    {
+        ScopedTimer timer(times, "sasa");
+        pSurface->run(jobInput.radius, jobInput.surfSphNum);
     }
+    std::cout << " Total SASA is: " << pSurface->getTotalSASA() << std::endl << std::endl;
+
+    pGrid->setSpacing(jobInput.spacing);
+    pGrid->setCutoffCoef(jobInput.cutoffCoef);
+    pGrid->setBoxExtend(jobInput.boxExtend);
+    {
+        ScopedTimer timer(times, "grid");
+        pGrid->run(jobInput.radius, jobInput.gridSphNum, jobInput.minVol);
+    }
+
 
-    cmd = "grep -v END " + recType + "_min_0.pdb > " + recType + "_min_orig.pdb ";
-    //std::cout <<cmd <<std::endl;
-    errMesg = "grep " + recType + "_min_0.pdb fails";
-    command(cmd, errMesg);
+    // Calculate the average coordinates for identify active site cavity
+    // Priority 1. Crystal substrate 2. Key residues 3. Top volume
+    Coor3d aveKeyResCoor;
+    Coor3d boxDim;
 
-    if (jobInput.ambVersion == 16) {
-        cmd = "ambpdb -p " + recType + ".prmtop -c " + recType + "_min.rst > " + recType + "_min_1.pdb";
-    } else {
-        cmd = "ambpdb -p " + recType + ".prmtop < " + recType + "_min.rst > " + recType + "_min_1.pdb";
+    bool hasSubResCoor=false;
+    std::string subResFile=subRes;
+    if(fileExist(subResFile)){
+        hasSubResCoor=getSiteFromLigand(jobInput, subRes, aveKeyResCoor, boxDim);
+    }
+
+    bool hasKeyResCoor=false;
+    if(!hasSubResCoor){
+        std::vector<std::string> keyRes=jobInput.keyRes;
+        hasKeyResCoor=pPdb->aveKeyResCoor(pdbFile, keyRes, aveKeyResCoor);
+        if(hasKeyResCoor){
+            std::cout << "Average coordinates of key residues: " << aveKeyResCoor << std::endl;
+        }
     }
 
-    //std::cout <<cmd <<std::endl;
-    errMesg = "ambpdb converting rst to " + recType + "_min_1.pdb file fails";
-    command(cmd, errMesg);
+    Coor3d dockDim;
+    Coor3d centroid; 
+
+    bool hasKeyDockGeo=false;
+    if(hasKeyResCoor || hasSubResCoor){
+        hasKeyDockGeo=pGrid->getKeySiteGeo(aveKeyResCoor, dockDim, centroid, site.volume);
+    }
 
-    cmd="ln -sf "+recType + "_min_orig.pdb rec_min.pdb";
-    errMesg="ln rec_min.pdb fails for"+recType + "_min_orig.pdb";
-    command(cmd, errMesg);  
+    if(!hasKeyDockGeo){
+        pGrid->getTopSiteGeo(dockDim, centroid, site.volume);
+    }
+
+    site.clust=pGrid->getSiteIndex()+1; // Cluster print out index start with 1
+    site.centroid=centroid;
+    site.dimension=dockDim;
+
+    std::ofstream outFile;
+    outFile.open((recDir+"/rec_geo.txt").c_str());
+    outFile << centroid.getX() << " " << centroid.getY() << " " << centroid.getZ() << " " 
+             << dockDim.getX() << " " << dockDim.getY() << " "  << dockDim.getZ() << "\n";
+    outFile.close();
 }
 
 void preReceptor(JobInputData& jobInput, JobOutData& jobOut, std::string& workDir, std::string& inputDir, std::string& dataPath){
 
+    JobTiming timing(jobOut.timing);
     try{
         chdir(workDir.c_str());
 
@@ -437,13 +497,9 @@ void preReceptor(JobInputData& jobInput, JobOutData& jobOut, std::string& workDi
         }
     
         std::string libDir=inputDir+"/lib/";
-        std::string cmd="mkdir -p "+recDir;
-        std::string errMesg="mkdir recDir fails";
-        command(cmd, errMesg);
-
-        cmd="cp "+jobOut.pdbFilePath+" "+recDir;
-        errMesg="cp receptor pdb file fails";
-        command(cmd,errMesg); 
+        makeDir(recDir);
+        copyFile(jobOut.pdbFilePath, recDir);
+        std::string errMesg;
 
         // cd to the rec directory to perform calculation
         chdir(recDir.c_str());
@@ -461,10 +517,8 @@ void preReceptor(JobInputData& jobInput, JobOutData& jobOut, std::string& workDi
             //command(cmd,errMesg);
             //! begin energy minimization of receptor
             //cmd="reduce -Quiet -Trim  rec_pdb4amber.pdb >& rec_noh.pdb ";
-            cmd="reduce -Quiet -Trim  rec_AForm.pdb >& rec_noh.pdb ";
-            //std::cout <<cmd <<std::endl;
             errMesg="reduce converting rec_AForm.pdb fails";
-            command(cmd,errMesg);
+            runProcess({"reduce", "-Quiet", "-Trim", "rec_AForm.pdb"}, errMesg, redirectOut("rec_noh.pdb", true));
 
             checkFName="rec_noh.pdb";
             if(!fileExist(checkFName)){
@@ -472,15 +526,15 @@ void preReceptor(JobInputData& jobInput, JobOutData& jobOut, std::string& workDi
                 throw LBindException(message);       
             }     
 
+            std::string hetDict;
             if(jobInput.ambVersion==16 || jobInput.ambVersion==13){
-                cmd="reduce -Quiet -BUILD rec_noh.pdb -DB \""+dataPath+"/amber16_reduce_wwPDB_het_dict.txt\" >& rec_rd.pdb";
+                hetDict=dataPath+"/amber16_reduce_wwPDB_het_dict.txt";
             }else{
-                cmd="reduce -Quiet -BUILD rec_noh.pdb -DB \""+dataPath+"/amber10_reduce_wwPDB_het_dict.txt\" >& rec_rd.pdb";
+                hetDict=dataPath+"/amber10_reduce_wwPDB_het_dict.txt";
             }
 
-            //std::cout <<cmd <<std::endl;
             errMesg="reduce converting rec_noh.pdb fails";
-            command(cmd,errMesg); 
+            runProcess({"reduce", "-Quiet", "-BUILD", "rec_noh.pdb", "-DB", hetDict}, errMesg, redirectOut("rec_rd.pdb", true));
 
 
             checkFName="rec_rd.pdb";
@@ -494,9 +548,36 @@ void preReceptor(JobInputData& jobInput, JobOutData& jobOut, std::string& workDi
 
         std::string b4pdbqt=checkFName;
 
+        std::vector<std::vector<int> > ssList;
         if(jobInput.minimizeFlg){
             std::string recType="rec";
-            minimization(jobInput, jobOut, checkFName, recType, libDir);
+            stdReceptor(checkFName, recType, ssList);
+        }
+
+        // The cavity search only needs the standardized PDB; it runs on its own thread while tleap,
+        // sander and obabel prepare the receptor for docking. Both work in recDir on different files.
+        bool siteCalc=jobInput.siteFlg && jobInput.dockBX.size()!=2 && !jobInput.sitebylig;
+        std::string stdPDBfile=jobInput.minimizeFlg ? "rec_std.pdb" : b4pdbqt;
+        boost::scoped_ptr<Complex> pComplex(new Complex());
+        boost::scoped_ptr<ParmContainer> pParmContainer(new ParmContainer());
+        boost::scoped_ptr<Grid> pGrid(new Grid(pComplex.get(), true));
+        PhaseTimes siteTimes;
+        SiteResult siteResult;
+        std::future<void> site;
+        if(siteCalc){
+            std::string subRes=jobOut.subRes;
+            std::string stdPDBpath=recDir+"/"+stdPDBfile;
+            std::string pdbPath=recDir+"/"+pdbFile;
+            site=std::async(std::launch::async, [&jobInput, subRes, recDir, stdPDBpath, pdbPath, &pComplex,
+                                                 &pParmContainer, &pGrid, &siteResult, &siteTimes](){
+                siteSearch(jobInput, subRes, recDir, stdPDBpath, pdbPath, pComplex.get(), pParmContainer.get(),
+                           pGrid.get(), siteResult, siteTimes);
+            });
+        }
+
+        if(jobInput.minimizeFlg){
+            std::string recType="rec";
+            minimization(jobInput, jobOut, ssList, recType, libDir);
             b4pdbqt="rec_min_0.pdb";
         }
 
@@ -513,12 +594,9 @@ void preReceptor(JobInputData& jobInput, JobOutData& jobOut, std::string& workDi
                 //command(cmd,errMesg);
             }
             //cmd="prepare_receptor4.py -r "+b4pdbqt+" -o "+jobOut.pdbid+".pdbqt";
-            cmd="obabel -ipdb std4pdbqt.pdb -opdbqt -xr -O temp.pdbqt >& pdbqt.log";
             errMesg="obabel converting std4pdbqt.pdb  temp.pdbqt to fails";
-            command(cmd,errMesg);  
-            cmd="grep -v REMARK temp.pdbqt > rec_min.pdbqt";
-            errMesg="grep to remove REMARK fails";
-            command(cmd,errMesg);  
+            runProcess({"obabel", "-ipdb", "std4pdbqt.pdb", "-opdbqt", "-xr", "-O", "temp.pdbqt"}, errMesg, redirectOut("pdbqt.log", true));
+            grepFile("temp.pdbqt", "rec_min.pdbqt", "REMARK", true);
 
         }
 
@@ -567,82 +645,33 @@ void preReceptor(JobInputData& jobInput, JobOutData& jobOut, std::string& workDi
         }
 
         if(jobInput.sitebylig) {
-            getSiteFromLigand(jobInput, jobOut, jobOut.centroid, jobOut.dimension);
+            getSiteFromLigand(jobInput, jobOut.subRes, jobOut.centroid, jobOut.dimension);
             jobOut.clust=0; // 0 indicate user define box
             jobOut.error=true;
             return;
         }
-        // Get geometry
-        std::string stdPDBfile="rec_std.pdb"; 
-        if(!jobInput.minimizeFlg){
-            stdPDBfile=b4pdbqt;
-        }
-        boost::scoped_ptr<Complex> pComplex(new Complex());
-        boost::scoped_ptr<Pdb> pPdb(new Pdb());
-        pPdb->parse(stdPDBfile, pComplex.get());
-
-        boost::scoped_ptr<ParmContainer> pParmContainer(new ParmContainer());
-        ElementContainer* pElementContainer = pParmContainer->addElementContainer();
-        pComplex->assignElement(pElementContainer);
-
-        boost::scoped_ptr<Surface> pSurface(new Surface(pComplex.get()));
-        std::cout << "Start Calculation " << std::endl;
-        pSurface->run(jobInput.radius, jobInput.surfSphNum);
-        std::cout << " Total SASA is: " << pSurface->getTotalSASA() << std::endl << std::endl;
-
-        boost::scoped_ptr<Grid> pGrid(new Grid(pComplex.get(), true));
-        pGrid->setSpacing(jobInput.spacing);
-        pGrid->setCutoffCoef(jobInput.cutoffCoef);
-        pGrid->setBoxExtend(jobInput.boxExtend);
-        pGrid->run(jobInput.radius, jobInput.gridSphNum, jobInput.minVol);
-
-
-        // Calculate the average coordinates for identify active site cavity
-        // Priority 1. Crystal substrate 2. Key residues 3. Top volume
-        Coor3d aveKeyResCoor;
-        Coor3d boxDim;
 
-        bool hasSubResCoor=false;
-        if(fileExist(jobOut.subRes)){
-            hasSubResCoor=getSiteFromLigand(jobInput, jobOut, aveKeyResCoor, boxDim);
-        }
-
-        bool hasKeyResCoor=false;
-        if(!hasSubResCoor){
-            hasKeyResCoor=pPdb->aveKeyResCoor(pdbFile, jobInput.keyRes, aveKeyResCoor);
-            if(hasKeyResCoor){
-                std::cout << "Average coordinates of key residues: " << aveKeyResCoor << std::endl;
-            }
-        }
-
-        Coor3d dockDim;
-        Coor3d centroid; 
-
-        bool hasKeyDockGeo=false;
-        if(hasKeyResCoor || hasSubResCoor){
-            hasKeyDockGeo=pGrid->getKeySiteGeo(aveKeyResCoor, dockDim, centroid, jobOut.volume);
+        // Get geometry
+        {
+            ScopedTimer timer("siteWait");
+            site.get();
         }
-
-        if(!hasKeyDockGeo){
-            pGrid->getTopSiteGeo(dockDim, centroid, jobOut.volume);
+        jobOut.clust=siteResult.clust;
+        jobOut.volume=siteResult.volume;
+        jobOut.centroid=siteResult.centroid;
+        jobOut.dimension=siteResult.dimension;
+        for(const auto& t : siteTimes.phases()){
+            jobOut.timing.add(t.first, t.second);
         }
-
-        jobOut.clust=pGrid->getSiteIndex()+1; // Cluster print out index start with 1
-        jobOut.centroid=centroid;
-        jobOut.dimension=dockDim;
-
-        std::ofstream outFile;
-        outFile.open("rec_geo.txt");
-        outFile << centroid.getX() << " " << centroid.getY() << " " << centroid.getZ() << " " 
-                 << dockDim.getX() << " " << dockDim.getY() << " "  << dockDim.getZ() << "\n";
-        outFile.close();
         
         if(jobInput.cutProt){
             jobOut.cutProt=jobInput.cutProt;
             std::string fileName="recCut.pdb";
             pGrid->writeCutRecPDB(fileName, pComplex.get(), jobInput.cutRadius);
             std::string recType="recCut";
-            minimization(jobInput, jobOut, fileName, recType, libDir);           
+            std::vector<std::vector<int> > cutSSList;
+            stdReceptor(fileName, recType, cutSSList);
+            minimization(jobInput, jobOut, cutSSList, recType, libDir);           
         }
 
         chdir(workDir.c_str());
@@ -754,14 +783,6 @@ void initInputData(JobInputData& jobInput, POdata& podata){
 int main(int argc, char** argv) {
 
     // ! start MPI parallel
-    
-    int jobFlag=1; // 1: doing job,  0: done job
-
-    int rankTag=1;
-    int jobTag=2;
-
-    int inpTag=3;
-    int outTag=4;
 
     mpi::environment env(argc, argv);
     mpi::communicator world;    
@@ -797,14 +818,14 @@ int main(int argc, char** argv) {
     JobInputData jobInput;
     JobOutData jobOut;
 
+    Dispatcher<JobInputData, JobOutData> dispatcher(world, DispatchOptions::fromEnv().statusTo(workDir+"/scratch/CDT1Receptor.status.json"));
+
     if (world.rank() == 0) {
 
         bool isNew=true;
         // if force re-do just delete the receptor.hdf5
         if (jobInput.forceRedoFlg) {
-            std::string cmd = "rm -f " + workDir + "/scratch/receptor.hdf5";
-            std::string errMesg = "Remove fails for " + workDir + "/scratch/receptor.hdf5";
-            command(cmd, errMesg);
+            removeAll(workDir + "/scratch/receptor.hdf5");
         }
 
         std::string recHDF5filename=workDir + "/scratch/receptor.hdf5";
@@ -812,9 +833,7 @@ int main(int argc, char** argv) {
             isNew=false;
         }
         //! Open a Conduit file to track the calculation
-        std::string cmd = "mkdir -p " + workDir + "/scratch";
-        std::string errMesg = "mkdir scratch directory fails";
-        LBIND::command(cmd, errMesg);
+        makeDir(workDir + "/scratch");
 
         Node n;
         std::string recCdtFile = workDir + "/scratch/receptor.hdf5:/";
@@ -840,82 +859,55 @@ int main(int argc, char** argv) {
             getCalcList(calcList, recHDF5filename, dirList);
         }
 
+        unsigned i=0;
         int count=0;
-           
-        for(unsigned i=0; i<dirList.size(); ++i){
-            jobInput.dirBuffer=dirList[i]->pdbFile;
-            //For restart
-            // If force re-do the calculation skip check the hdf5 file and continue calculation (by default not force re-do)
-            if(!isNew){
-                if(calcList[i]){
-                    continue;
-                }
-            }
-
-            ++count;
-            
-            if(count >world.size()-1){
-                world.recv(mpi::any_source, outTag, jobOut);
-
-                toConduit(jobOut, recCdtFile);
-                if(jobOut.error && !podata.keep) {
-                    rmRecDir(jobOut);
-                }
-            }   
-            
-            int freeProc;
-            world.recv(mpi::any_source, rankTag, freeProc);
-            std::cout << "At Process: " << freeProc << " working on: " << dirList[i]->pdbFile  << std::endl;
-            world.send(freeProc, jobTag, jobFlag);
-
-            jobInput.keyRes=dirList[i]->keyRes;
-            jobInput.nonRes=dirList[i]->nonRes;
-            jobInput.subRes=dirList[i]->subRes;
-            jobInput.dockBX=dirList[i]->dockBX;
-
-            world.send(freeProc, inpTag, jobInput);            
+        long total=0;
+        for(unsigned j=0; j<dirList.size(); ++j){
+            if(isNew || !calcList[j]) ++total;
         }
 
-        int nJobs=count;
-        int nWorkers=world.size()-1;
-        int ndata=(nJobs<nWorkers)? nJobs: nWorkers;
-
-        std::cout << "ndata=" << ndata << " nJobs=" << nJobs << std::endl;
-    
-        for(int i=0; i < ndata; ++i){
-            world.recv(mpi::any_source, outTag, jobOut);
+        auto nextJob=[&](JobInputData& job){
+            for(; i<dirList.size(); ++i){
+                //For restart
+                // If force re-do the calculation skip check the hdf5 file and continue calculation (by default not force re-do)
+                if(!isNew && calcList[i]){
+                    continue;
+                }
 
-            toConduit(jobOut, recCdtFile);
-            if(jobOut.error && !podata.keep) {
-                rmRecDir(jobOut);
+                jobInput.dirBuffer=dirList[i]->pdbFile;
+                jobInput.keyRes=dirList[i]->keyRes;
+                jobInput.nonRes=dirList[i]->nonRes;
+                jobInput.subRes=dirList[i]->subRes;
+                jobInput.dockBX=dirList[i]->dockBX;
+                job=jobInput;
+                ++i;
+                ++count;
+                return true;
             }
-        } 
+            return false;
+        };
 
-        for(int i=1; i < world.size(); ++i){
-            int freeProc;
-            world.recv(mpi::any_source, rankTag, freeProc);
-            jobFlag=0;;
-            world.send(freeProc, jobTag, jobFlag);
-        }        
-        
-    }else {
-        while (1) {
-            world.send(0, rankTag, world.rank());
-            world.recv(0, jobTag, jobFlag);
-            if (jobFlag==0) {
-                break;
+        auto saveJob=[&](JobOutData& out){
+            toConduit(out, recCdtFile);
+            if(out.error && !podata.keep) {
+                rmRecDir(out);
             }
-            // Receive parameters
+        };
 
-            world.recv(0, inpTag, jobInput);
-                                    
-            jobOut.message="Finished!";
+        dispatcher.setFailed([](const JobOutData& out){ return !out.error; });
+        dispatcher.serve(nextJob, saveJob, total);
 
-            preReceptor(jobInput, jobOut, workDir, inputDir, dataPath);
+        std::cout << "nJobs=" << count << std::endl;
 
-            world.send(0, outTag, jobOut);
-           
-        }
+    }else {
+        TimingSummary timing;
+        dispatcher.work([&](JobInputData& job, JobOutData& out){
+            if(dispatcher.logJob()) std::cout << "At Process: " << world.rank() << " working on: " << job.dirBuffer << std::endl;
+            out.message="Finished!";
+            preReceptor(job, out, workDir, inputDir, dataPath);
+            timing.add(out.timing);
+        });
+        timing.print(std::cout, world.rank());
     }
 
     std::cout << "Rank= " << world.rank() <<" MPI Wall Time= " << runingTime.elapsed() << " Sec."<< std::endl;
@@ -94,6 +94,7 @@ public:
         ar & recPath;
         ar & message;
         ar & nonRes;
+        ar & timing;
 
     }
 
@@ -110,6 +111,7 @@ public:
     std::string recPath;
     std::string message;
     std::vector<std::string> nonRes;
+    PhaseTimes timing; // written to meta/timing
 
 };
 
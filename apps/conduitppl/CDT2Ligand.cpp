@@ -11,6 +11,10 @@
 #include <fstream>
 #include <sstream>
 #include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <iterator>
+#include <sys/stat.h>
 
 #include <boost/scoped_ptr.hpp>
 
@@ -19,6 +23,9 @@
 #include <boost/mpi/communicator.hpp>
 #include <boost/serialization/string.hpp>
 #include <boost/serialization/vector.hpp>
+#include <boost/serialization/utility.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/range/iterator_range.hpp>
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
 
@@ -28,6 +35,8 @@
 #include <conduit_blueprint.hpp>
 
 #include "Parser/Sdf.h"
+#include "Parser/SdfIndex.h"
+#include "Parallel/Dispatcher.h"
 #include "Parser/Pdb.h"
 #include "MM/Amber.h"
 #include "Parser/SanderOutput.h" 
@@ -39,7 +48,9 @@
 #include "Common/Utils.h"
 #include "Common/Tokenize.hpp"
 #include "Common/LBindException.h"
-#include "Common/Command.hpp"
+#include "Common/Process.h"
+#include "Common/FileOps.h"
+#include "Common/ScopedTimer.h"
 #include "XML/XMLHeader.hpp"
 
 #include "CDT2Ligand.h"
@@ -49,6 +60,7 @@
 namespace mpi = boost::mpi;
 using namespace LBIND;
 using namespace conduit;
+using namespace CDT2;
 
 /*!
  * \breif preReceptors calculation receptor grid dimension from CSA sitemap output
@@ -76,50 +88,62 @@ using namespace conduit;
  */
 
 
-void toConduit(JobOutData& jobOut, std::string& ligCdtFile){
+//! Ligand IDs in the shards of scratch/ligHDF5, scanned with a stride over the workers
+void getShardKeys(std::string& workDir, mpi::communicator& world, std::vector<std::pair<std::string, std::string> >& keys){
+    using namespace boost::filesystem;
 
-    try {
+    if(world.rank()==0) return;
 
-        Node n;
+    path shardPath(workDir+"/scratch/ligHDF5");
+    if(!is_directory(shardPath)) return;
 
-        n["lig/"+jobOut.ligID + "/status"]=jobOut.error;
-
-        std::string ligIDMeta ="lig/"+jobOut.ligID + "/meta";
-        n[ligIDMeta] = jobOut.ligID;
-
-        n[ligIDMeta + "/name"] = jobOut.ligName;
-        n[ligIDMeta + "/LigPath"] = jobOut.ligPath;
-        n[ligIDMeta + "/GBEN"] = jobOut.gbEn;
-        n[ligIDMeta + "/Mesg"] = jobOut.message;
-        std::string ligIDFile ="lig/"+jobOut.ligID+ "/file/";
-
-        std::vector<std::string> filenames={"LIG.prmtop", "LIG.lib", "LIG.inpcrd", "LIG_min.pdbqt", "LIG_min.pdb", "ligand.mol2",
-                                  "LIG_min.rst", "LIG_minGB.out", "ligand.frcmod"};
-        std::cout << "CONDUIT: " << jobOut.ligPath << std::endl;
-
-        for(std::string& name : filenames)
-        {
-            std::string filename=jobOut.ligPath+"/"+name;
-            std::ifstream infile(filename);
-            if(infile.good())
-            {
-                std::string buffer((std::istreambuf_iterator<char>(infile)),
-                                   std::istreambuf_iterator<char>());
-                infile.close();
-                n[ligIDFile+name] = buffer;
-            }
-            else
-            {
-                std::cout << "File - " << filename << " is not there." << std::endl;
-            }
-        }
+    std::vector<std::string> shardFiles;
+    for(auto& entry : boost::make_iterator_range(directory_iterator(shardPath), {}))
+        shardFiles.push_back(entry.path().filename().string());
 
-        relay::io::hdf5_append(n, ligCdtFile);
+    int start = world.rank()-1;
+    int stride = world.size()-1;
 
-    }catch(conduit::Error &error){
-        jobOut.message= error.message();
+    for(int i=start; i<shardFiles.size(); i=i+stride){
+        std::string shardRel="ligHDF5/"+shardFiles[i];
+        std::vector<std::string> lig_names;
+        try {
+            hid_t lig_hid=relay::io::hdf5_open_file_for_read(workDir+"/scratch/"+shardRel);
+            relay::io::hdf5_group_list_child_names(lig_hid, "/lig/", lig_names);
+            relay::io::hdf5_close_file(lig_hid);
+        }catch (...){
+            std::cout << "Warning some error in " << shardRel << std::endl;
+        }
+        for(std::string& name : lig_names){
+            keys.push_back(std::make_pair(name, shardRel));
+        }
     }
+}
 
+//! Restart: index the ligands that reached a shard but not ligand.hdf5
+void recoverShards(std::string& workDir, std::string& ligCdtFile, std::vector<bool>& calcList,
+                   std::vector<std::vector<std::pair<std::string, std::string> > >& allKeys){
+    int count=0;
+    for(auto& keys : allKeys){
+        for(auto& key : keys){
+            int ligID=std::atoi(key.first.c_str());
+            if(ligID<=0 || ligID>=calcList.size() || calcList[ligID]) continue;
+
+            std::string ligPath=workDir+"/scratch/"+key.second+":lig/"+key.first;
+            try {
+                Node n;
+                relay::io::load(ligPath+"/status", n["lig/"+key.first+"/status"]);
+                relay::io::load(ligPath+"/meta", n["lig/"+key.first+"/meta"]);
+                n["lig/"+key.first+"/meta/shard"]=key.second;
+                relay::io::hdf5_append(n, ligCdtFile);
+                calcList[ligID]=true;
+                count++;
+            }catch(conduit::Error &error){
+                std::cout << "Recover ligand " << key.first << " fails: " << error.message() << std::endl;
+            }
+        }
+    }
+    std::cout << "Recovered ligands from shards " << count << std::endl;
 }
 
 /*
@@ -178,22 +202,6 @@ void getCalcHDF5(std::string& fileName, std::vector<bool>& calcList, std::vector
     relay::io::hdf5_close_file(lig_hid);
 }
 
-int getNumLigand(POdata& podata){
-    std::ifstream inFile;
-    inFile.open(podata.sdfFile);
-
-    int count =0;
-    std::string fileLine;
-    while (inFile) {
-        std::getline(inFile, fileLine);
-
-        if (fileLine[0]=='$') count++;
-
-    }
-    std::cout << "There are total " << count << " ligands in SDF file" << std::endl;
-    return count;
-}
-
 void getSkipList(POdata& podata, std::vector<int>& skipList){
     if(fileExist(podata.skipFile)){
         std::ifstream inFile;
@@ -210,288 +218,185 @@ void getSkipList(POdata& podata, std::vector<int>& skipList){
     }
 }
 
-void getCalcList(std::vector<bool>& calcList, std::string& fileName, POdata& podata){
-    int numLigand=getNumLigand(podata);
+void getCalcList(std::vector<bool>& calcList, std::string& fileName, POdata& podata, int numLigand){
     calcList.resize(numLigand+1, false);
     std::vector<int> skipList;
     getSkipList(podata, skipList);
     getCalcHDF5(fileName, calcList, skipList);
 }
 
-void rmLigDir(JobOutData& jobOut)
-{
-    std::cout << "rmLigDir: " << jobOut.ligPath << std::endl;
-    std::string cmd="rm -rf " + jobOut.ligPath;
-    std::string errMesg="Remove fails for "+jobOut.ligPath;
-    command(cmd, errMesg);
+/*!
+ * \brief Incremental checkpoint of ligand.hdf5
+ *
+ * The entries written to ligand.hdf5 since the last checkpoint are kept in
+ * memory and saved as a new segment scratch/ligCkpt/ckpt_<seq>.hdf5 every
+ * freq ligands. A segment is written to a temporary name and renamed, so a
+ * crash never leaves a partial segment behind. Replaying all segments in
+ * order rebuilds ligand.hdf5 up to the last checkpoint.
+ *
+ * The segments belong to one input: scratch/ligCkpt/manifest.txt records
+ * the SDF path, size and modification time. Segments of another input are
+ * moved aside to scratch/ligCkpt-stale instead of being replayed.
+ */
+struct LigCheckpoint{
+    std::string dir;
+    int seq=0;
+    int count=0;
+    int freq=1000;
+    Node node;
+};
+
+void getCkptSegments(std::string& ckptDir, std::vector<std::pair<int, std::string> >& segments){
+    using namespace boost::filesystem;
+
+    path ckptPath(ckptDir);
+    if(!is_directory(ckptPath)) return;
+
+    for(auto& entry : boost::make_iterator_range(directory_iterator(ckptPath), {})){
+        std::string name=entry.path().filename().string();
+        // ckpt_<seq>.hdf5
+        if(name.compare(0, 5, "ckpt_")!=0 || entry.path().extension().string()!=".hdf5") continue;
+        int seq=std::atoi(name.substr(5).c_str());
+        segments.push_back(std::make_pair(seq, entry.path().string()));
+    }
+    std::sort(segments.begin(), segments.end());
 }
 
-void backupHDF5File(std::string& hdf5file)
-{
-    std::string cmd="cp " + hdf5file + " " + hdf5file+"-backup";
-    std::string errMesg="Backup fails for "+hdf5file;
-    command(cmd, errMesg);
+//! SDF path, size and modification time the checkpoint segments are made from
+std::string ckptManifest(const std::string& sdfFile){
+    struct stat st;
+    std::stringstream manifest;
+    manifest << "sdf " << boost::filesystem::absolute(sdfFile).string() << "\n";
+    if(stat(sdfFile.c_str(), &st)==0){
+        manifest << "size " << static_cast<int64_t>(st.st_size) << "\n"
+                 << "mtime " << static_cast<int64_t>(st.st_mtime) << "\n";
+    }
+    return manifest.str();
 }
 
-void preLigands(JobInputData& jobInput, JobOutData& jobOut, std::string& workDir, std::string& targetDir, bool useLocalDir) {
-
-    try{
-        jobOut.ligID=jobInput.dirBuffer;
-        jobOut.message="Finished!";
-
-        std::string subDir=workDir+"/scratch/lig/"+jobOut.ligID;
-        std::string tgtDir=targetDir+"/scratch/lig/"+jobOut.ligID;
-        jobOut.ligPath=subDir;
-
-        jobOut.gbEn=0.0;        
-        std::string sdfPath=subDir+"/ligand.sdf";
-
-        std::string cmd="mkdir -p "+subDir;
-        std::string errMesg="mkdir ligDir fails";
-        command(cmd, errMesg);
-        
-        std::ofstream outFile;
-        try {
-            outFile.open(sdfPath.c_str());
-        }
-        catch(...){
-            std::cout << "preLigands >> Cannot open file" << sdfPath << std::endl;
-        }
-
-        outFile <<jobInput.sdfBuffer;
-        outFile.close();     
-
-        if(!fileExist(sdfPath)){
-            std::string message=sdfPath+" does not exist.";
-            throw LBindException(message);
-        }
-
-        chdir(subDir.c_str());
-
-        std::string sdfFile="ligand.sdf";
-        std::string pdb1File="ligand.pdb";
-
-        cmd="obabel -isdf " + sdfFile + " -opdb -O " +pdb1File +" >> log";
-        //std::cout << cmd << std::endl;
-        errMesg="obabel converting SDF to PDB fails";
-        command(cmd, errMesg);
+bool ckptMatches(const std::string& ckptDir, const std::string& manifest){
+    std::ifstream inFile((ckptDir+"/manifest.txt").c_str());
+    if(!inFile.good()) return false;
+    std::string buffer((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>());
+    return buffer==manifest;
+}
 
-        std::string pdbFile="ligrn.pdb";
-        std::string tmpFile="ligstrp.pdb";
+void initCheckpoint(LigCheckpoint& ckpt, std::string& ckptDir, const std::string& manifest){
+    ckpt.dir=ckptDir;
+    makeDir(ckptDir);
 
-        boost::scoped_ptr<Pdb> pPdb(new Pdb());   
+    // Leftovers of a crash or of a failed rename, never part of a finished segment
+    using namespace boost::filesystem;
+    for(auto& entry : boost::make_iterator_range(directory_iterator(path(ckptDir)), {})){
+        if(entry.path().extension().string()==".tmp") removeAll(entry.path().string());
+    }
+    {
+        std::ofstream outFile((ckptDir+"/manifest.txt").c_str());
+        outFile << manifest;
+    }
 
-        //! Rename the atom name.
-        pPdb->renameAtom(pdb1File, pdbFile);
+    std::vector<std::pair<int, std::string> > segments;
+    getCkptSegments(ckptDir, segments);
+    if(!segments.empty()) ckpt.seq=segments.back().first+1;
+}
 
-        pPdb->strip(pdbFile, tmpFile);
+void writeCheckpoint(LigCheckpoint& ckpt){
+    if(ckpt.count==0) return;
 
-        boost::scoped_ptr<Sdf> pSdf(new Sdf());
-        if(jobInput.cmpName=="NoName"){
-            jobOut.ligName=pSdf->getTitle(sdfFile);
-        }else{
-            jobOut.ligName=pSdf->getInfo(sdfFile, jobInput.cmpName);
+    std::string ckptFile=ckpt.dir+"/ckpt_"+std::to_string(ckpt.seq)+".hdf5";
+    std::string tmpFile=ckptFile+".tmp";
+    try {
+        removeAll(tmpFile);
+        relay::io::hdf5_append(ckpt.node, tmpFile+":/");
+        if(std::rename(tmpFile.c_str(), ckptFile.c_str())!=0){
+            std::cout << "Checkpoint rename fails for " << ckptFile << std::endl;
+            return;
         }
+    }catch(conduit::Error &error){
+        std::cout << "Checkpoint fails for " << ckptFile << ": " << error.message() << std::endl;
+        return;
+    }catch(LBindException& e){
+        std::cout << "Checkpoint fails for " << ckptFile << ": " << e.what() << std::endl;
+        return;
+    }
+    ckpt.seq++;
+    ckpt.count=0;
+    ckpt.node.reset();
+}
 
-        if(jobInput.minimizeFlg) {
-            //! Get ligand charge from SDF file.
-            std::string keyword="TOTAL_CHARGE";
-
-            std::string info=pSdf->getInfo(sdfFile, keyword);
-
-            std::cout << "Charge:" << info << std::endl;
-            int charge=Sstrm<int, std::string>(info);
-            std::string chargeStr=Sstrm<std::string,int>(charge);
-
-            //! Start antechamber calculation
-            std::string output="ligand.mol2";
-            std::string options=" -c bcc -nc "+ chargeStr;
-
-            boost::scoped_ptr<Amber> pAmber(new Amber(jobInput.ambVersion));
-            pAmber->antechamber(tmpFile, output, options);
-
-            {
-                if(!fileExist(output)){
-                    std::string message="ligand.mol2 does not exist.";
-                    throw LBindException(message);
-                }
-
-                if(fileEmpty(output)){
-                    std::string message="ligand.mol2 is empty.";
-                    throw LBindException(message);
-                }
-            }
-
-            if (jobInput.ambVersion == 16) {
-                pAmber->parmchk2(output);
-            }else {
-                pAmber->parmchk(output); // parmchk is deprecated from AMBER16
-            }
-
-            //! leap to obtain forcefield for ligand
-            std::string ligName="LIG";
-            std::string tleapFile="leap.in";
-
-            pAmber->tleapInput(output,ligName,tleapFile, subDir);
-            pAmber->tleap(tleapFile);
-
-            std::string checkFName="LIG.prmtop";
-            {
-                if(!fileExist(checkFName)){
-                    std::string message="LIG.prmtop does not exist.";
-                    throw LBindException(message);
-                }
-
-                if(fileEmpty(checkFName)){
-                    std::string message="LIG.prmtop is empty.";
-                    throw LBindException(message);
-                }
-            }
-
-            if(jobInput.score_only){
-                cmd = "ambpdb -p LIG.prmtop < LIG.inpcrd > LIG_minTmp.pdb ";
-            }else {
-                //! GB energy minimization
-                std::string minFName = "LIG_minGB.in";
-                {
-                    std::ofstream minFile;
-                    try {
-                        minFile.open(minFName.c_str());
-                    }
-                    catch (...) {
-                        std::string mesg = "mmpbsa::receptor()\n\t Cannot open min file: " + minFName;
-                        throw LBindException(mesg);
-                    }
-
-                    minFile << "title..\n"
-                            << "&cntrl\n"
-                            << "  imin   = 1,\n"
-                            << "  ntmin   = 1,\n"
-                            << "  maxcyc = 2000,\n"
-                            << "  ncyc   = 1000,\n"
-                            << "  ntpr   = 200,\n"
-                            << "  ntb    = 0,\n"
-                            << "  igb    = 5,\n"
-                            << "  gbsa   = 1,\n"
-                            << "  intdiel= " << jobInput.intDiel << ",\n"
-                            << "  cut    = 50,\n"
-                            << " /\n" << std::endl;
-
-                    minFile.close();
-                }
-
-                if (jobInput.ambVersion == 13) {
-                    cmd = "sander13  -O -i LIG_minGB.in -o LIG_minGB.out  -p LIG.prmtop -c LIG.inpcrd -ref LIG.inpcrd  -x LIG.mdcrd -r LIG_min.rst  >> log";
-                } else {
-                    cmd = "sander  -O -i LIG_minGB.in -o LIG_minGB.out  -p LIG.prmtop -c LIG.inpcrd -ref LIG.inpcrd  -x LIG.mdcrd -r LIG_min.rst  >> log";
-                }
-                //std::cout <<cmd <<std::endl;
-                errMesg = "sander ligand minimization fails";
-                command(cmd, errMesg);
-                boost::scoped_ptr<SanderOutput> pSanderOutput(new SanderOutput());
-                std::string sanderOut = "LIG_minGB.out";
-                double ligGBen = 0;
-                bool success = pSanderOutput->getEnergy(sanderOut, ligGBen);
-                jobOut.gbEn = ligGBen;
-
-                if (!success) {
-                    std::string message = "Ligand GB minimization fails.";
-                    throw LBindException(message);
-                }
-
-                //! Use ambpdb generated PDB file for PDBQT.
-                if (jobInput.ambVersion == 16) {
-                    cmd = "ambpdb -p LIG.prmtop -c LIG_min.rst > LIG_minTmp.pdb ";
-                } else {
-                    cmd = "ambpdb -p LIG.prmtop < LIG_min.rst > LIG_minTmp.pdb ";
-                }
-            }
-
-        }else{
-
-            //cmd="ambpdb -p LIG.prmtop < LIG.inpcrd > LIG_minTmp.pdb";
-            cmd="ln -s ligstrp.pdb LIG_minTmp.pdb";
-
-        }
+void addCheckpoint(LigCheckpoint& ckpt, Node& n){
+    ckpt.node.update(n);
+    ckpt.count++;
+    if(ckpt.count>=ckpt.freq){
+        writeCheckpoint(ckpt);
+    }
+}
 
-        //std::cout <<cmd <<std::endl;
-        errMesg = "ambpdb converting rst/inp to pdb fails";
-        command(cmd, errMesg);
+bool isHDF5Readable(std::string& hdf5file){
+    try {
+        hid_t hid=relay::io::hdf5_open_file_for_read(hdf5file);
+        std::vector<std::string> names;
+        relay::io::hdf5_group_list_child_names(hid, "/", names);
+        relay::io::hdf5_close_file(hid);
+    }catch(...){
+        return false;
+    }
+    return true;
+}
 
-        std::string checkFName = "LIG_minTmp.pdb";
-        if (!fileExist(checkFName)) {
-            std::string message = "LIG_min.pdb minimization PDB file does not exist.";
-            throw LBindException(message);
+//! Rebuild a missing or corrupted ligand.hdf5 from the checkpoint segments of the same input
+void recoverCheckpoint(std::string& ligOutfile, std::string& ckptDir, const std::string& manifest){
+    std::vector<std::pair<int, std::string> > segments;
+    getCkptSegments(ckptDir, segments);
+    if(!segments.empty() && !ckptMatches(ckptDir, manifest)){
+        std::string staleDir=ckptDir+"-stale";
+        std::cout << "Checkpoint segments in " << ckptDir << " are of another SDF input, moved to " << staleDir
+                  << std::endl;
+        removeAll(staleDir);
+        if(std::rename(ckptDir.c_str(), staleDir.c_str())!=0){
+            throw LBindException("Cannot move "+ckptDir+" to "+staleDir);
         }
+        segments.clear();
+    }
 
-        pPdb->fixElement("LIG_minTmp.pdb", "LIG_min.pdb");
-
-        //! Get DPBQT file for ligand from minimized structure.
-        //cmd="prepare_ligand4.py -l  LIG_min.pdb >> log";
-        cmd="obabel -ipdb LIG_min.pdb  -xn -opdbqt > LIG_min.pdbqt";
-        //std::cout << cmd << std::endl;   
-        //errMesg="prepare_ligand4.py fails";
-        errMesg="obabel LIG_min.pdbqt fails";
-        command(cmd, errMesg);
-
-        checkFName="LIG_min.pdbqt";
-        {
-            if(!fileExist(checkFName)){
-                std::string message="LIG_min.pdbqt PDBQT file does not exist.";
-                throw LBindException(message);        
-            }
+    if(fileExist(ligOutfile)){
+        if(isHDF5Readable(ligOutfile)) return;
+        std::string corrupted=ligOutfile+"-corrupted";
+        std::cout << ligOutfile << " is not readable, moved to " << corrupted << std::endl;
+        std::rename(ligOutfile.c_str(), corrupted.c_str());
+    }else if(!segments.empty()){
+        std::cout << ligOutfile << " is missing; it is rebuilt from the checkpoint segments of the same SDF"
+                  << " (remove " << ckptDir << " too to start over)" << std::endl;
+    }
+    if(segments.empty()) return;
 
-            if(fileEmpty(checkFName)){
-                std::string message="LIG_min.pdbqt is empty.";
-                throw LBindException(message);              
-            }
-        }
-        
-        //! fix the Br element type
-        cmd="sed -i '/Br.* LIG/{s! B ! Br!}' LIG_min.pdbqt";
-        //std::cout << cmd << std::endl;
-        errMesg="sed to fix Br fails";
-        command(cmd, errMesg);
-        if(useLocalDir) {
-            cmd = "mkdir -p " + tgtDir;
-            errMesg = "mkdir ligand target directory fails";
-            command(cmd, errMesg);
-
-            cmd = "cp LIG.prmtop LIG.lib LIG.inpcrd LIG_min.pdbqt LIG_min.pdb ligand.mol2 LIG_min.rst LIG_minGB.out ligand.frcmod " + tgtDir;
-            errMesg = "copying saved ligand files fails";
-            command(cmd, errMesg);
-            std::cout << "BEFORE: " << jobOut.ligPath << std::endl;
-            jobOut.ligPath=tgtDir;
-	    std::cout << "AFTER : " << jobOut.ligPath << std::endl;
-        }
-        chdir(workDir.c_str());
+    std::string ligCdtFile=ligOutfile+":/";
+    for(auto& seg : segments){
+        Node n;
+        relay::io::load(seg.second, n);
+        relay::io::hdf5_append(n, ligCdtFile);
+    }
+    std::cout << "Rebuild " << ligOutfile << " from " << segments.size() << " checkpoint segments" << std::endl;
+}
 
-        if(useLocalDir) {
-            std::string cmd="rm -rf " + subDir;
-            std::string errMesg="Remove fails for "+subDir;
-            command(cmd, errMesg);
+//! Master side: record a finished ligand in ligand.hdf5
+void saveLigand(JobOutData& jobOut, std::string& ligCdtFile, bool shard, bool keep, LigCheckpoint* ckpt){
+    Node n;
+    if(shard) {
+        toIndex(jobOut, ligCdtFile, n);
+    }else{
+        toConduit(jobOut, ligCdtFile, n);
+        if (jobOut.error && !keep) {
+            rmLigDir(jobOut);
         }
-
-    } catch (LBindException& e){
-        jobOut.message= e.what();
-        jobOut.error=false;
-        return;
     }
-
-    jobOut.error=true;
-    return;
+    if(ckpt!=NULL){
+        addCheckpoint(*ckpt, n);
+    }
 }
 
 int main(int argc, char** argv) {
 
-    int jobFlag=1; // 1: doing job,  0: done job
-
-    int rankTag=1;
-    int jobTag=2;
-
-    int inpTag=3;
-    int outTag=4;
-
     mpi::environment env(argc, argv);
     mpi::communicator world; 
     
@@ -525,28 +430,70 @@ int main(int argc, char** argv) {
     JobInputData jobInput;
     JobOutData jobOut;
 
+    //! Ligands already written to shards by a previous run
+    std::vector<std::pair<std::string, std::string> > shardKeys;
+    std::vector<std::vector<std::pair<std::string, std::string> > > allShardKeys;
+    getShardKeys(workDir, world, shardKeys);
+    gather(world, shardKeys, allShardKeys, 0);
+
+    Dispatcher<JobInputData, JobOutData> dispatcher(world, DispatchOptions::fromEnv().statusTo(workDir+"/scratch/CDT2Ligand.status.json"));
+
     if (world.rank() == 0) {
         // Check if these is ligand.hdf5
+        //! Byte offsets of the SDF records, cached in <sdf>.idx for restart
+        SdfIndex sdfIndex;
+        try {
+            sdfIndex.build(podata.sdfFile);
+        } catch (LBindException& e) {
+            std::cout << "CDT2Ligand >> " << e.what() << std::endl;
+            world.abort(1);
+        }
+        int numLigand=sdfIndex.size();
+        std::cout << "There are total " << numLigand << " ligands in SDF file" << std::endl;
+
         bool isNew=true;
         std::string ligOutfile=workDir+"/scratch/ligand.hdf5";
+        std::string ckptDir=workDir+"/scratch/ligCkpt";
+        std::string ckptInput=ckptManifest(podata.sdfFile);
+        try {
+            recoverCheckpoint(ligOutfile, ckptDir, ckptInput);
+        } catch (LBindException& e) {
+            std::cout << "CDT2Ligand >> " << e.what() << std::endl;
+            world.abort(1);
+        }
         std::vector<bool> calcList;
         if(fileExist(ligOutfile)){
             isNew=false;
-            getCalcList(calcList, ligOutfile, podata);
+            getCalcList(calcList, ligOutfile, podata, numLigand);
         }
 
         //! Open a Conduit file to track the calculation
-        std::string cmd = "mkdir -p " + workDir + "/scratch";
-        std::string errMesg = "mkdir scratch directory fails";
-        LBIND::command(cmd, errMesg);
+        makeDir(workDir + "/scratch");
+
+        jobInput.shard=(podata.shard=="on");
+        jobInput.keep=podata.keep;
+        if(jobInput.shard) {
+            makeDir(workDir + "/scratch/ligHDF5");
+        }
 
         //! Open a Conduit file to track the calculation
         Node n;
         std::string ligCdtFile=workDir+"/scratch/ligand.hdf5:/";
-        std::string ligHDF5Backup=workDir+"/scratch/ligand.hdf5";
         n["date"]="Create By CDT2Ligand at "+timeStamp();
         relay::io::hdf5_append(n, ligCdtFile);
 
+        bool hasShardKeys=false;
+        for(auto& keys : allShardKeys){
+            if(!keys.empty()) hasShardKeys=true;
+        }
+        if(hasShardKeys){
+            if(isNew){
+                isNew=false;
+                getCalcList(calcList, ligOutfile, podata, numLigand);
+            }
+            recoverShards(workDir, ligCdtFile, calcList, allShardKeys);
+        }
+
         if(podata.saveSDF=="on") {
             hid_t lig_hid = relay::io::hdf5_open_file_for_read_write(workDir + "/scratch/ligand.hdf5");
             //std::string ligSdfFile = ligCdtFile + "sdf/";
@@ -574,9 +521,11 @@ int main(int argc, char** argv) {
             jobInput.minimizeFlg=false;
         }
 
-        bool backupHDF5=false;
+        LigCheckpoint ligCkpt;
+        LigCheckpoint* pCkpt=NULL;
         if(podata.backup=="on"){
-            backupHDF5=true;
+            initCheckpoint(ligCkpt, ckptDir, ckptInput);
+            pCkpt=&ligCkpt;
         }
 
         jobInput.ligCdtFile=ligCdtFile;
@@ -586,117 +535,71 @@ int main(int argc, char** argv) {
         jobInput.ambVersion=podata.version;
         jobInput.score_only=podata.score_only;
         jobInput.intDiel=podata.intDiel;
+        jobInput.paramCache=podata.paramCache.empty() ? "" : boost::filesystem::absolute(podata.paramCache).string();
 
-        // Start to read in the SDF file
-        //std::string sdfFileName=inputDir+"/"+podata.sdfFile;
-        std::ifstream inFile;
-        try {
-            inFile.open(podata.sdfFile.c_str());
-        } catch (...) {
-            std::cout << "CDT2Ligand >> Cannot open file" << podata.sdfFile << std::endl;
-            world.abort(1);
-        }
-
-        const std::string delimter = "$$$$";
-        std::string fileLine = "";
-        std::string contents = "";
+        //! Workers read their own SDF records, only the offsets are sent.
+        jobInput.sdfFile=boost::filesystem::absolute(podata.sdfFile).string();
+        jobInput.sdfBuffer="";
 
+        int i = 0;
         int count = 0;
-        int dirCnt= 0;
+        long total = 0;
+        for(int j=0; j<numLigand; ++j) {
+            if(isNew || !calcList[j+1]) ++total;
+        }
 
-        while (inFile) {
-            std::getline(inFile, fileLine);
-            contents = contents + fileLine + "\n";
-            if (fileLine.size() >= 4 && fileLine.compare(0, 4, delimter) == 0) {
-                dirCnt++;
+        auto nextJob=[&](JobInputData& job){
+            for(; i<numLigand; ++i) {
+                int dirCnt=i+1;
                 //For restart
-                if(!isNew) {
-                    if (calcList[dirCnt]) {
-                        contents = ""; //! clean up the contents for the next structure.
-                        continue;
-                    }
+                if(!isNew && calcList[dirCnt]) {
+                    continue;
                 }
                 jobInput.dirBuffer=std::to_string(dirCnt);
+                jobInput.sdfOffset=sdfIndex.offset(i);
+                jobInput.sdfLength=sdfIndex.length(i);
+                job=jobInput;
+                ++i;
+                ++count;
+                return true;
+            }
+            return false;
+        };
 
-                count++;
-
-                if(count > world.size()-1){
-                    world.recv(mpi::any_source, outTag, jobOut);
-
-                    toConduit(jobOut, ligCdtFile);
-                    if(backupHDF5 && count%1000==0){
-                        backupHDF5File(ligHDF5Backup);
-                    }
-                    if(jobOut.error && !podata.keep) {
-                        rmLigDir(jobOut);
-                    }
-                }
-
-                int freeProc;
-                world.recv(mpi::any_source, rankTag, freeProc);
-                std::cout << "At Process: " << freeProc << " working on: " << jobInput.dirBuffer << std::endl;
-                world.send(freeProc, jobTag, jobFlag);
+        auto saveJob=[&](JobOutData& out){
+            saveLigand(out, ligCdtFile, jobInput.shard, podata.keep, pCkpt);
+        };
 
-                jobInput.sdfBuffer=contents;
+        dispatcher.setFailed([](const JobOutData& out){ return !out.error; });
+        dispatcher.serve(nextJob, saveJob, total);
 
-                world.send(freeProc, inpTag, jobInput);
-                
-                contents = ""; //! clean up the contents for the next structure.
+        std::cout << "nJobs=" << count << std::endl;
 
-            }
-                             
+        if(pCkpt!=NULL){
+            writeCheckpoint(ligCkpt);
         }
 
-        int nJobs=count;
-        int nWorkers=world.size()-1;
-        int ndata=(nJobs<nWorkers)? nJobs: nWorkers;
-        std::cout << "ndata=" << ndata << " nJobs=" << nJobs << std::endl;
-    
-        for(int i=0; i < ndata; ++i){
-            world.recv(mpi::any_source, outTag, jobOut);
-
-            toConduit(jobOut, ligCdtFile);
-            if(backupHDF5 && i%1000==0){
-                backupHDF5File(ligHDF5Backup);
-            }
-            if(jobOut.error  && !podata.keep) {
-            	rmLigDir(jobOut);
-            }
-        } 
-
-        
-        for(int i=1; i < world.size(); ++i){
-            int freeProc;
-            world.recv(mpi::any_source, rankTag, freeProc);
-            jobFlag=0;;
-            world.send(freeProc, jobTag, jobFlag);
-        }
-        
     }else {
         //if(useLocalDir){
         //    std::string cmd = "rm -rf " + localDir+"/scratch";
         //    std::string errMesg = "Clean up local disk fails before calculation";
         //    LBIND::command(cmd, errMesg);
         //}
-        while (1) {
-            world.send(0, rankTag, world.rank());
-            world.recv(0, jobTag, jobFlag);
-            if (jobFlag==0) {
-                break;
-            }
-
-            world.recv(0, inpTag, jobInput);
+        std::string shardRel="ligHDF5/lig_proc"+std::to_string(world.rank())+".hdf5";
+        std::string shardFile=workDir+"/scratch/"+shardRel+":/";
+        TimingSummary timing;
 
-            preLigands(jobInput, jobOut, localDir, workDir, useLocalDir);
+        dispatcher.work([&](JobInputData& job, JobOutData& out){
+            if(dispatcher.logJob()) std::cout << "At Process: " << world.rank() << " working on: " << job.dirBuffer << std::endl;
 
-            world.send(0, outTag, jobOut);
+            preLigands(job, out, localDir, workDir, useLocalDir);
 
-            //if(useLocalDir){
-            //    std::string cmd = "rm -rf " + localDir+"/scratch";
-            //    std::string errMesg = "Clean up local disk fails before calculation";
-            //    LBIND::command(cmd, errMesg);
-            //}
-        }
+            if(job.shard) {
+                toShard(job, out, shardRel, shardFile, localDir, useLocalDir);
+            }
+            timing.add(out.timing);
+        });
+        timing.print(std::cout, world.rank());
     }
 
     std::cout << "Rank= " << world.rank() <<" MPI Wall Time= " << runingTime.elapsed() << " Sec."<< std::endl;
@@ -5,8 +5,18 @@
 #ifndef CONVEYORLC_CDT2LIGAND_H
 #define CONVEYORLC_CDT2LIGAND_H
 
+#include <string>
+
+#include "Common/ScopedTimer.h"
+
 using namespace LBIND;
 
+namespace conduit {
+    class Node;
+}
+
+namespace CDT2 {
+
 class JobInputData{
 
 public:
@@ -21,8 +31,14 @@ public:
         ar & minimizeFlg;
         ar & score_only;
         ar & intDiel;
+        ar & paramCache;
+        ar & shard;
+        ar & keep;
         ar & dirBuffer;
         ar & sdfBuffer;
+        ar & sdfFile;
+        ar & sdfOffset;
+        ar & sdfLength;
         ar & cmpName;
         ar & ligCdtFile;
     }
@@ -31,8 +47,14 @@ public:
     bool minimizeFlg;
     bool score_only;
     double intDiel;
+    std::string paramCache; // parameterization cache directory, empty without cache
+    bool shard; // workers write their own ligand HDF5 shard
+    bool keep;
     std::string dirBuffer;
     std::string sdfBuffer;
+    std::string sdfFile; // workers read the record from sdfFile when sdfBuffer is empty
+    int64_t sdfOffset;
+    int64_t sdfLength;
     std::string cmpName;
     std::string ligCdtFile;
 };
@@ -49,21 +71,48 @@ public:
     {
         ar & error;
         ar & gbEn;
+        ar & numAtoms;
+        ar & numTors;
         ar & ligID;
         ar & ligName;
         ar & ligPath;
+        ar & ligShard;
         ar & message;
+        ar & timing;
 
     }
 
     bool error;
     double gbEn;
+    int numAtoms; // heavy atoms, for the docking cost estimate
+    int numTors;  // rotatable bonds
     std::string ligID;
     std::string ligName;
     std::string ligPath;
+    std::string ligShard; // shard file relative to scratch, empty if not sharded
     std::string message;
+    PhaseTimes timing; // written to meta/timing, without the HDF5 write itself
 
 };
 
+void setLigMeta(conduit::Node& n, JobOutData& jobOut);
+
+bool toConduit(JobOutData& jobOut, std::string& ligCdtFile, conduit::Node& n);
+
+bool toConduit(JobOutData& jobOut, std::string& ligCdtFile);
+
+//! Index entry in ligand.hdf5 for a ligand whose files are in a worker shard
+void toIndex(JobOutData& jobOut, std::string& ligCdtFile, conduit::Node& n);
+
+//! Worker side: write the ligand to its own shard and clean up the ligand directory
+void toShard(JobInputData& jobInput, JobOutData& jobOut, std::string& shardRel, std::string& shardFile,
+             std::string& localDir, bool useLocalDir);
+
+void rmLigDir(JobOutData& jobOut);
+
+//! Parameterize one ligand in workDir/scratch/lig/<ligID>, jobOut.error is true on success.
+void preLigands(JobInputData& jobInput, JobOutData& jobOut, std::string& workDir, std::string& targetDir, bool useLocalDir);
+
+}//namespace CDT2
 
 #endif //CONVEYORLC_CDT2LIGAND_H
@@ -39,7 +39,7 @@
 #include "Common/Utils.h"
 #include "Common/Tokenize.hpp"
 #include "Common/LBindException.h"
-#include "Common/Command.hpp"
+#include "Common/FileOps.h"
 
 #include "CDT2LigandNoMin.h"
 #include "CDT2LigandPO.h"
@@ -151,9 +151,11 @@ void getCalcList(std::vector<bool>& calcList, std::string& fileName, POdata& pod
 
 void backupHDF5File(std::string& hdf5file)
 {
-    std::string cmd="cp " + hdf5file + " " + hdf5file+"-backup";
-    std::string errMesg="Backup fails for "+hdf5file;
-    command(cmd, errMesg);
+    try {
+        copyFile(hdf5file, hdf5file+"-backup");
+    }catch (LBindException& e){
+        std::cout << "Backup fails for " << hdf5file << ": " << e.what() << std::endl;
+    }
 }
 
 void sdf2pdb(std::string& inputStr, std::string& outputStr)
@@ -294,9 +296,7 @@ int main(int argc, char** argv) {
         }
 
         //! Open a Conduit file to track the calculation
-        std::string cmd = "mkdir -p " + workDir + "/scratch";
-        std::string errMesg = "mkdir scratch directory fails";
-        LBIND::command(cmd, errMesg);
+        makeDir(workDir + "/scratch");
 
         //! Open a Conduit file to track the calculation
         Node n;
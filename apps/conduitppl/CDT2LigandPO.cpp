@@ -34,12 +34,14 @@ bool CDT2LigandPO(int argc, char** argv, POdata& podata) {
                 ("minimize", value<std::string> (&podata.minimizeFlg)->default_value("on"), "Run minimization by default")
                 ("restart", value<bool>(&podata.restart)->default_value(false), "To restart the calculation")
                 ("saveSDF", value<std::string> (&podata.saveSDF)->default_value("on"), "Save SDF to HDF5")
-                ("backup", value<std::string> (&podata.backup)->default_value("off"), "Backup HDF5 file every 1000 ligands")
+                ("backup", value<std::string> (&podata.backup)->default_value("off"), "Checkpoint ligand.hdf5 incrementally every 1000 ligands")
+                ("shard", value<std::string> (&podata.shard)->default_value("on"), "Workers write per-rank ligand HDF5 shards indexed by ligand.hdf5")
                 ("firstLigID", value<int> (&podata.firstLigID)->default_value(1), "First ligID default from 1")
                 ("skipList", value<std::string > (&podata.skipFile), "File name for a list of ligand IDs skipping calculations")
                 ("score_only", bool_switch(&podata.score_only)->default_value(false), "rescoring the score_only docking calculation")
                 ("intDiel", value<double>(&podata.intDiel)->default_value(4.0), "Solute dielectric constant")
                 ("keep", bool_switch(&podata.keep)->default_value(false), "Keep intermediate files")
+                ("paramCache", value<std::string>(&podata.paramCache)->default_value(""), "Shared directory caching the parameterized ligands by structure (default off)")
                 ;   
         options_description info("Optional:");
         info.add_options()
@@ -18,6 +18,7 @@ struct POdata{
     std::string minimizeFlg;
     std::string saveSDF;
     std::string backup;
+    std::string shard;
     std::string skipFile;
     int firstLigID;
     bool restart;
@@ -25,6 +26,7 @@ struct POdata{
     bool keep;
     int version;
     double intDiel;
+    std::string paramCache;
 };
 
 bool CDT2LigandPO(int argc, char** argv, POdata& podata);
@@ -14,8 +14,12 @@
 #include <vector> // ligand paths
 #include <cmath> // for ceila
 #include <unordered_set>
+#include <unordered_map>
+#include <algorithm>
+#include <cfloat>
 #include <chrono>
 #include <ctime>
+#include <functional>
 
 #include <boost/program_options.hpp>
 #include <boost/filesystem/fstream.hpp>
@@ -46,9 +50,13 @@
 #include "VinaLC/quasi_newton.h"
 #include "VinaLC/coords.h" // add_to_output_container
 #include "VinaLC/tokenize.h"
-#include "Common/Command.hpp"
+#include "Common/FileOps.h"
+#include "Common/LBindException.h"
+#include "Common/LigIndex.h"
+#include "Common/ScopedTimer.h"
 
 #include "dock.h"
+#include "Parallel/Dispatcher.h"
 #include "mpiparser.h"
 #include "InitEnv.h"
 
@@ -57,7 +65,17 @@ namespace mpi = boost::mpi;
 using namespace boost::filesystem;
 using namespace LBIND;
 
+//! What a worker reports back for a docked pair.
+struct DockStatus {
+    std::string key;
+    double score;   //!< best score, DBL_MAX if docking failed
 
+    template<class Archive>
+    void serialize(Archive & ar, const unsigned int version){
+        ar & key;
+        ar & score;
+    }
+};
 
 void getKeysHDF5(std::string& fileName, std::vector<std::string>& keysFinish)
 {
@@ -65,6 +83,11 @@ void getKeysHDF5(std::string& fileName, std::vector<std::string>& keysFinish)
     Node n;
 
     hid_t dock_hid=relay::io::hdf5_open_file_for_read(fileName);
+    if(!relay::io::hdf5_has_path(dock_hid, "dock")){
+        // only screening pass results so far
+        relay::io::hdf5_close_file(dock_hid);
+        return;
+    }
 
     std::vector<std::string> rec_names;
     relay::io::hdf5_group_list_child_names(dock_hid,"/dock/",rec_names);
@@ -86,6 +109,41 @@ void getKeysHDF5(std::string& fileName, std::vector<std::string>& keysFinish)
 
 }
 
+//! Screening pass results of an earlier run, DBL_MAX for the failed ones.
+void getPass1ScoresHDF5(std::string& fileName, std::vector<std::string>& keys, std::vector<double>& scores)
+{
+    hid_t dock_hid=relay::io::hdf5_open_file_for_read(fileName);
+    if(!relay::io::hdf5_has_path(dock_hid, "dockPass1")){
+        relay::io::hdf5_close_file(dock_hid);
+        return;
+    }
+
+    std::vector<std::string> rec_names;
+    relay::io::hdf5_group_list_child_names(dock_hid,"/dockPass1/",rec_names);
+
+    for(int i=0;i<rec_names.size();i++)
+    {
+        std::vector<std::string> lig_names;
+        relay::io::hdf5_group_list_child_names(dock_hid,"/dockPass1/"+rec_names[i]+"/",lig_names);
+
+        for(int j=0; j<lig_names.size(); j++)
+        {
+            std::string key=rec_names[i]+"/"+lig_names[j];
+            std::string scorePath="dockPass1/"+key+"/meta/scores/1";
+            double score=DBL_MAX;
+            if(relay::io::hdf5_has_path(dock_hid, scorePath)){
+                Node n;
+                relay::io::hdf5_read(dock_hid, scorePath, n);
+                score=n.to_double();
+            }
+            keys.push_back(key);
+            scores.push_back(score);
+        }
+    }
+
+    relay::io::hdf5_close_file(dock_hid);
+}
+
 void getKeysHDF5OLD(std::string& fileName, std::vector<std::string>& keysFinish)
 {
     Node n;
@@ -113,58 +171,60 @@ void getKeysHDF5OLD(std::string& fileName, std::vector<std::string>& keysFinish)
 
 }
 
-void toConduit(JobOutData& jobOut, std::string& dockHDF5File){
-    try {
-
-        Node n;
-
-        std::string keyPath="dock/"+jobOut.pdbID +"/"+jobOut.ligID;
-
-        n[keyPath+ "/status"]=jobOut.error;
-
-        std::string recIDMeta =keyPath+ "/meta/";
-        n[recIDMeta+"ligName"]=jobOut.ligName;
-        n[recIDMeta+"numPose"]=jobOut.numPose;
-        n[recIDMeta+"Mesg"]=jobOut.mesg;
-
-        for(int i=0; i< jobOut.scores.size(); ++i)
-        {
-            n[recIDMeta+"scores/"+std::to_string(i+1)]=jobOut.scores[i];
-        }
-
-        std::string recIDFile =keyPath + "/file/";
-
-        n[recIDFile+"scores.log"]=jobOut.scorelog;
-        n[recIDFile+"poses.pdbqt"]=jobOut.pdbqtfile;
-
-        relay::io::hdf5_append(n, dockHDF5File);
+std::string ligIDofKey(const std::string& key){
+    size_t found=key.find_last_of('/');
+    return (found==std::string::npos) ? key : key.substr(found+1);
+}
 
-    }catch(conduit::Error &error){
-        jobOut.mesg= error.message();
+//! Order the rec/lig keys longest-processing-time-first by the ligand size from CDT2Ligand.
+void orderKeys(const std::string& ligFile, std::vector<std::string>& keys){
+    std::unordered_set<std::string> ligSet;
+    for(const std::string& key : keys){
+        ligSet.insert(ligIDofKey(key));
     }
+    std::vector<std::string> ligIDs(ligSet.begin(), ligSet.end());
 
-
+    std::unordered_map<std::string, std::pair<int, int> > sizes;
+    try {
+        getLigSizes(ligFile, ligIDs, sizes);
+    }catch(conduit::Error& e){
+        std::cout << "CDT3Docking >> cannot read ligand sizes: " << e.message() << std::endl;
+    }
+    std::cout << "CDT3Docking ligand size known for " << sizes.size() << " of " << ligIDs.size() << " ligands" << std::endl;
+
+    std::function<double(const std::string&)> cost=[&](const std::string& key){
+        auto found=sizes.find(ligIDofKey(key));
+        if(found==sizes.end()) return -1.0;
+        return dockCost(found->second.first, found->second.second);
+    };
+    orderByCost(keys, cost);
 }
 
-void toHDF5File(JobInputData& jobInput, JobOutData& jobOut, std::string& dockHDF5File)
-{
-    if(jobInput.useScoreCF){
-        if(jobOut.scores.size()>0){
-            if(jobOut.scores[0]>jobInput.scoreCF){
-                //Mark the low score compound as "fail" so when restart program won't re-do it
-                jobOut.error=false;
-                //jobOut.numPose=0;
-                jobOut.mesg="Beyond score cutoff";
-                //jobOut.scorelog="";
-                //jobOut.pdbqtfile="";
-                //jobOut.scores.clear();
-            }
-        }else{
-            jobOut.error=false;
+//! Pass 2 keys: the pending pairs among the best pass2Top percent of the screened ones,
+//! or among those scoring below pass2Cutoff.
+std::vector<std::string> selectHits(const std::vector<std::string>& keys, const std::unordered_map<std::string, double>& pass1Scores, const JobInputData& jobInput){
+    double threshold=jobInput.pass2Cutoff;
+    if(!jobInput.usePass2Cutoff){
+        std::vector<double> scores;
+        for(auto& s : pass1Scores){
+            if(s.second<DBL_MAX) scores.push_back(s.second);
         }
+        if(scores.empty()) return std::vector<std::string>();
+        size_t num=std::max(size_t(1), size_t(std::ceil(jobInput.pass2Top*scores.size()/100.0)));
+        num=std::min(num, scores.size());
+        std::nth_element(scores.begin(), scores.begin()+num-1, scores.end());
+        threshold=scores[num-1];
     }
-    toConduit(jobOut, dockHDF5File);
 
+    std::vector<std::string> hits;
+    for(const std::string& key : keys){
+        auto found=pass1Scores.find(key);
+        if(found!=pass1Scores.end() && found->second<DBL_MAX && found->second<=threshold){
+            hits.push_back(key);
+        }
+    }
+    std::cout << "CDT3Docking pass 2 score threshold " << threshold << ", " << hits.size() << " pairs to re-dock" << std::endl;
+    return hits;
 }
 
 std::string timestamp(){
@@ -176,14 +236,6 @@ std::string timestamp(){
 int main(int argc, char* argv[]) {
 
     // ! MPI Parallel   
-    int jobFlag=1; // 1: doing job,  0: done job
-
-    int rankTag=1;
-    int jobTag=2;
-
-    int inpTag=3;
-    int outTag=4;
-
     mpi::environment env(argc, argv);
     mpi::communicator world;    
     mpi::timer runingTime;
@@ -204,21 +256,22 @@ int main(int argc, char* argv[]) {
 
     bool useLocalDir=(localDir!=workDir);
     if(useLocalDir){
-        std::string cmd = "rm -rf " + localDir+"/scratch";
-        std::string errMesg = "Clean up local disk fails before calculation";
-        LBIND::command(cmd, errMesg);
+        removeAll(localDir+"/scratch");
         world.barrier();
     }
 
     std::cout << "Number of tasks= " << world.size() << " My rank= " << world.rank() << std::endl;
 
     JobInputData jobInput;
-    JobOutData jobOut;
 
     std::unordered_set<std::string> keysCalc;
 
     std::vector<std::string> keysFinish;
 
+    std::vector<std::string> pass1Keys;
+    std::vector<double> pass1Values;
+    std::unordered_map<std::string, double> pass1Scores;
+
     if (world.rank() == 0) {
         std::cout << "Master Node: " << world.size() << " My rank= " << world.rank() << std::endl;
         std::string recFile;
@@ -240,9 +293,7 @@ int main(int argc, char* argv[]) {
         }
 
         //Create a HDF5 output directory for docking
-        std::string cmd = "mkdir -p " + workDir+"/scratch/dockHDF5";
-        std::string errMesg="mkdir dockHDF5 fails";
-        LBIND::command(cmd, errMesg);
+        makeDir(workDir+"/scratch/dockHDF5");
 
         // Generate the keys based on combination or no combination
         // reserve large chunk of memory to speed up the process
@@ -280,6 +331,18 @@ int main(int argc, char* argv[]) {
         std::vector<std::vector<std::string> > allKeysFinish;
         gather(world, keysFinish, allKeysFinish, 0);
 
+        std::vector<std::vector<std::string> > allPass1Keys;
+        std::vector<std::vector<double> > allPass1Values;
+        gather(world, pass1Keys, allPass1Keys, 0);
+        gather(world, pass1Values, allPass1Values, 0);
+        for(int i=0; i < allPass1Keys.size(); ++i)
+        {
+            for(int j=0; j < allPass1Keys[i].size(); ++j)
+            {
+                pass1Scores[allPass1Keys[i][j]]=allPass1Values[i][j];
+            }
+        }
+
         for(int i=0; i < allKeysFinish.size(); ++i)
         {
             std::vector<std::string> keysVec=allKeysFinish[i];
@@ -304,9 +367,12 @@ int main(int argc, char* argv[]) {
         for(int i=start; i<hdf5Files.size(); i=i+stride)
         {
             getKeysHDF5(hdf5Files[i], keysFinish);
+            getPass1ScoresHDF5(hdf5Files[i], pass1Keys, pass1Values);
         }
 
         gather(world, keysFinish, 0);
+        gather(world, pass1Keys, 0);
+        gather(world, pass1Values, 0);
     }
 
     if (world.rank() == 0) {
@@ -314,106 +380,126 @@ int main(int argc, char* argv[]) {
         std::cout << "CDT3Docking Number of Calculations : " << keysCalc.size() << std::endl;
     }
 
-    if (world.rank() == 0) {
-        unsigned num_cpus = boost::thread::hardware_concurrency();
-        if (num_cpus > 0)
-            jobInput.cpu = num_cpus;
-        else
-            jobInput.cpu = 1;    
+    //! Two-pass mode: screen every pair cheaply, then re-dock the best ones at full settings.
+    bool twoPass=(world.rank()==0 && jobInput.pass1Exhaustiveness>0);
+    broadcast(world, twoPass, 0);
+
+    int cacheHits=0;
+    int cacheMisses=0;
 
+    Dispatcher<JobInputData, DockStatus> dispatcher(world, DispatchOptions::fromEnv().allowSpeculation()
+            .statusTo(workDir+"/scratch/CDT3Docking.status.json"));
+
+    if (world.rank() == 0) {
+        //! jobInput.cpu==0 lets each worker use the CPUs it is bound to.
         jobInput.flexible=false;
         
         if(jobInput.randomize){
             srand(unsigned(std::time(NULL)));
         }
 
-        std::string delimiter = "/";
-        //int count=0;
-        std::unordered_set<std::string> :: iterator itr;
-        for (itr = keysCalc.begin(); itr != keysCalc.end(); itr++) {
-            //std::cout << (*itr) << std::endl;
-
-            /*
-            ++count;
-            if (count > world.size()-1) {
-                world.recv(mpi::any_source, outTag, jobOut);
-                toFile(jobInput, jobOut);
+        //! Workers write their own dock_proc<rank>.hdf5, only the best score comes back.
+        auto dockKeys=[&](std::vector<std::string>& keys, JobInputData& settings){
+            //! Largest ligands first, so no big one is left for the end of the run.
+            orderKeys(settings.ligFile, keys);
+
+            std::vector<std::string>::iterator itr = keys.begin();
+            auto nextJob=[&](JobInputData& job){
+                if(itr==keys.end()) return false;
+                job=settings;
+                job.key = (*itr);
+                ++itr;
+                return true;
+            };
+            dispatcher.serve(nextJob, [&](DockStatus& status){
+                if(settings.screening) pass1Scores[status.key]=status.score;
+            }, keys.size());
+        };
+
+        std::vector<std::string> keys(keysCalc.begin(), keysCalc.end());
+        keysCalc.clear();
+        dispatcher.setFailed([](const DockStatus& status){ return status.score==DBL_MAX; });
+
+        if(twoPass){
+            std::vector<std::string> screenKeys;
+            for(const std::string& key : keys){
+                if(pass1Scores.count(key)==0) screenKeys.push_back(key);
             }
-            */
-            int freeProc;
-            world.recv(mpi::any_source, rankTag, freeProc);
-            world.send(freeProc, jobTag, jobFlag);
-            // Start to send parameters
-            jobInput.key = (*itr);
-
-            std::cout << "At Process: " << freeProc << " working on  Key: " << jobInput.key << std::endl;
-
-            world.send(freeProc, inpTag, jobInput);
-
-        }
+            std::cout << "CDT3Docking pass 1 screens " << screenKeys.size() << " pairs: " << timestamp() << std::endl;
 
-        /*
-        int nJobs=count;
-        int nWorkers=world.size()-1;
-        int ndata=(nJobs<nWorkers)? nJobs: nWorkers;
+            JobInputData screen=jobInput;
+            screen.screening=true;
+            screen.exhaustiveness=jobInput.pass1Exhaustiveness;
+            screen.stepScale=jobInput.pass1Steps;
+            dockKeys(screenKeys, screen);
+            world.barrier();
 
-        std::cout << "ndata=" << ndata << " nJobs=" << nJobs << std::endl;
-    
-        for(unsigned i=0; i < ndata; ++i){
-            world.recv(mpi::any_source, outTag, jobOut);
-            toFile(jobInput, jobOut);
+            keys=selectHits(keys, pass1Scores, jobInput);
         }
-        */
 
-        for(unsigned i=1; i < world.size(); ++i){
-            int freeProc;
-            world.recv(mpi::any_source, rankTag, freeProc);
-            jobFlag=0;
-            world.send(freeProc, jobTag, jobFlag);
-        }
+        dockKeys(keys, jobInput);
 
     } else {
 
         std::string dockHDF5File=workDir+"/scratch/dockHDF5/dock_proc"+std::to_string(world.rank())+".hdf5:/";
         //hid_t dock_hid=relay::io::hdf5_open_file_for_read_write(dockHDF5File);
-        while (1) {
-
-            world.send(0, rankTag, world.rank());
-
-            world.recv(0, jobTag, jobFlag);
-            if (jobFlag==0) {
-                break;
+        //! A tail job may run on two ranks: copies dock in a directory of their own
+        //! and only the copy that wins the claim is written.
+        std::string specDir=localDir+"/scratch/spec"+std::to_string(world.rank());
+        JobOutData jobOut;
+        TimingSummary timing;
+        auto runJob=[&](JobInputData& job, DockStatus& status){
+            if(dispatcher.logJob()) std::cout << "At Process: " << world.rank() << " working on  Key: " << job.key << std::endl;
+
+            jobOut=JobOutData();
+            dockjob(job, jobOut, dispatcher.speculative() ? specDir : localDir);
+
+            status.key=job.key;
+            status.score=(jobOut.error && !jobOut.scores.empty()) ? jobOut.scores[0] : DBL_MAX;
+        };
+        auto commitJob=[&](JobInputData& job, DockStatus& status, bool won){
+            if(won){
+                toHDF5File(job, jobOut, dockHDF5File);
+                timing.add(jobOut.timing);
+                if(jobOut.cacheLookup==CACHE_HIT) ++cacheHits;
+                if(jobOut.cacheLookup==CACHE_MISS) ++cacheMisses;
             }
-            // Receive parameters
-
-            world.recv(0, inpTag, jobInput);
-
-            dockjob(jobInput, jobOut, localDir);
-
-            toHDF5File(jobInput, jobOut, dockHDF5File);
 
             // Go back the localDir to get rid of following error
             // shell-init: error retrieving current directory: getcwd: cannot access
             chdir(localDir.c_str());
 
             // Remove the working directory
-            std::string cmd = "rm -rf " + jobOut.dockDir;
-            std::string errMesg="remove dockDir fails";
-            LBIND::command(cmd, errMesg);
+            try {
+                removeAll(jobOut.dockDir);
+            }catch (LBindException& e){
+                std::cout << e.what() << std::endl;
+            }
+        };
 
+        if(twoPass){
+            dispatcher.work(runJob, commitJob);
+            world.barrier();
         }
+        dispatcher.work(runJob, commitJob);
 
         //relay::io::hdf5_close_file(dock_hid);
+        timing.print(std::cout, world.rank());
     }
 
+    //! Result cache hits and misses of all ranks, for the run summary
+    int totalHits=0, totalMisses=0;
+    reduce(world, cacheHits, totalHits, std::plus<int>(), 0);
+    reduce(world, cacheMisses, totalMisses, std::plus<int>(), 0);
+    if(world.rank()==0 && totalHits+totalMisses>0){
+        std::cout << "CDT3Docking docking result cache: " << totalHits << " hits, " << totalMisses << " misses" << std::endl;
+    }
 
     std::cout << "Rank= " << world.rank() <<" MPI Wall Time= " << runingTime.elapsed() << " Sec."<< std::endl;
 
     if(useLocalDir){
         world.barrier();
-        std::string cmd = "rm -rf " + localDir+"/scratch";
-        std::string errMesg = "Clean up local disk fails before calculation";
-        LBIND::command(cmd, errMesg);
+        removeAll(localDir+"/scratch");
 
     }
 
@@ -10,6 +10,8 @@
 #include <fstream>
 #include <sstream>
 #include <cstring>
+#include <algorithm>
+#include <map>
 #include <unordered_map>
 
 #include <boost/filesystem.hpp>
@@ -30,10 +32,13 @@
 #include "Structure/Constants.h"
 #include "Common/File.hpp"
 #include "Common/LBindException.h"
-#include "Common/Command.hpp"
+#include "Common/FileOps.h"
+#include "Common/ScopedTimer.h"
+#include "Parallel/Dispatcher.h"
 
 #include "InitEnv.h"
 #include "CDT4mmgbsa.h"
+#include "gbsa.h"
 #include "CDT4mmgbsaPO.h"
 
 using namespace conduit;
@@ -215,89 +220,8 @@ void getKeysHDF5pIO(std::string& fileName, std::vector<std::string>& keysFinish)
 
 }
 
-void toConduit(CDTmeta &cdtMeta, std::string& gbsaHDF5File){
-    try {
-
-        Node n;
-
-        std::string keyPath="gbsa/"+cdtMeta.key;
-
-        n[keyPath+ "/status"]=cdtMeta.error;
-
-        std::string recIDMeta =keyPath+ "/meta/";
-        n[recIDMeta+"ligName"]=cdtMeta.ligName;
-        n[recIDMeta+"comGB"]=cdtMeta.comGB;
-        n[recIDMeta+"ligGB"]=cdtMeta.ligGB;
-        n[recIDMeta+"recGB"]=cdtMeta.recGB;
-        n[recIDMeta+"bindGB"]=cdtMeta.gbbind;
-        n[recIDMeta+"dockScore"]=cdtMeta.dockscore;
-        n[recIDMeta+"Mesg"]=cdtMeta.message;
-
-        std::string recIDFile =keyPath + "/file/";
-
-        std::vector<std::string> filenames={"Com.prmtop", "Com.inpcrd", "Com_min.rst",
-                                            "Com_min.pdb", "Com_min_GB.out", "Rec_minGB.out",
-                                            "Rec_min.rst"};
-
-        for(std::string& name : filenames)
-        {
-            std::ifstream infile(name);
-            if(infile.good())
-            {
-                std::string buffer((std::istreambuf_iterator<char>(infile)),
-                                   std::istreambuf_iterator<char>());
-                infile.close();
-                n[recIDFile+name] = buffer;
-            }
-            else
-            {
-                std::cout << "File - " << name << " is not there." << std::endl;
-            }
-        }
-
-        relay::io::hdf5_append(n, gbsaHDF5File);
-
-    }catch(conduit::Error &error){
-        cdtMeta.message= error.message();
-    }
-
-
-}
-
-void mmgbsa(CDTmeta& cdtMeta) {
-
-    try{
-        if(cdtMeta.newapp) {
-            CDTgbsa::runNew(cdtMeta);
-        } else{
-            CDTgbsa::run(cdtMeta);
-        }
-        cdtMeta.message= "Finished!";
-        cdtMeta.error=true;
-
-    } catch (conduit::Error& e){
-        cdtMeta.message= e.what();
-        cdtMeta.error=false;
-    } catch (LBindException& e){
-        cdtMeta.message= e.what();
-        cdtMeta.error=false;
-    }catch (...){
-        cdtMeta.message= "Unknown error";
-        cdtMeta.error=false;
-    }
-
-}
-
 int main(int argc, char** argv) {
 
-    int jobFlag=1; // 1: doing job,  0: done job
-
-    int rankTag=1;
-    int jobTag=2;
-
-    int inpTag=3;
-    int outTag=4;
-
     mpi::environment env(argc, argv);
     mpi::communicator world;  
     mpi::timer runingTime;
@@ -321,9 +245,7 @@ int main(int argc, char** argv) {
     bool useLocalDir=(localDir!=workDir);
 
     if(useLocalDir){
-        std::string cmd = "rm -rf " + localDir+"/scratch";
-        std::string errMesg = "Clean up local disk fails before calculation";
-        LBIND::command(cmd, errMesg);
+        removeAll(localDir+"/scratch");
         world.barrier();
     }
 
@@ -332,8 +254,6 @@ int main(int argc, char** argv) {
         world.abort(1);
     }
 
-    JobInputData jobInput;
-
     std::vector<std::string> dockingKeys;
     std::vector<std::vector<std::string> > allDockingKeys;
 
@@ -341,9 +261,7 @@ int main(int argc, char** argv) {
     if (world.rank() == 0) {
 
         //Create a HDF5 output directory for docking
-        std::string cmd = "mkdir -p " + workDir + "/scratch/gbsaHDF5";
-        std::string errMesg = "mkdir gbsaHDF5 fails";
-        LBIND::command(cmd, errMesg);
+        makeDir(workDir + "/scratch/gbsaHDF5");
 
         gather(world, dockingKeys, allDockingKeys, 0);
     }else {
@@ -429,44 +347,58 @@ int main(int argc, char** argv) {
     }
 
 
+    //! One job per receptor-ligand pair: its poses share the receptor, ligand and docking data.
+    std::map<std::string, JobInputData> pairJobs;
     if (world.rank() == 0) {
+        for(auto& keyCalc : keysCalc)
+        {
+            size_t pos=keyCalc.first.rfind('/');
+            JobInputData& pairJob=pairJobs[keyCalc.first.substr(0, pos)];
+            pairJob.key=keyCalc.first.substr(0, pos);
+            pairJob.procID=keyCalc.second;
+            pairJob.poseIDs.push_back(keyCalc.first.substr(pos+1));
+        }
+        for(auto& pairJob : pairJobs)
+        {
+            std::vector<std::string>& poseIDs=pairJob.second.poseIDs;
+            std::sort(poseIDs.begin(), poseIDs.end(), [](const std::string& a, const std::string& b){
+                return std::stoi(a.substr(1)) < std::stoi(b.substr(1));
+            });
+        }
+    }
 
-        for (auto cKey : keysCalc) {
-
-            int freeProc;
-            world.recv(mpi::any_source, rankTag, freeProc);
-
-            world.send(freeProc, jobTag, jobFlag);
+    Dispatcher<JobInputData, int> dispatcher(world, DispatchOptions::fromEnv().allowSpeculation()
+            .statusTo(workDir+"/scratch/CDT4mmgbsa.status.json"));
 
-            jobInput.key = cKey.first;
-            jobInput.procID=cKey.second;
-            std::cout << "At Process: " << freeProc << " working on  Key: " << jobInput.key << std::endl;
+    if (world.rank() == 0) {
 
-            world.send(freeProc, inpTag, jobInput);
+        //! Workers write their own gbsa_proc<rank>.hdf5, only the number of failed poses comes back.
+        auto itr = pairJobs.begin();
+        auto nextJob=[&](JobInputData& job){
+            if(itr==pairJobs.end()) return false;
+            job=itr->second;
+            ++itr;
+            return true;
+        };
 
-        }
+        dispatcher.setFailed([](const int& status){ return status>0; });
+        dispatcher.serve(nextJob, [](int& status){}, pairJobs.size());
 
-        for(unsigned i=1; i < world.size(); ++i){
-            int freeProc;
-            world.recv(mpi::any_source, rankTag, freeProc);
-            jobFlag=0;;
-            world.send(freeProc, jobTag, jobFlag);
-        }        
-        
     }else {
 
         std::string gbsaHDF5File=workDir+"/scratch/gbsaHDF5/gbsa_proc"+std::to_string(world.rank())+".hdf5:/";
-        while (1) {
-            world.send(0, rankTag, world.rank());
-            world.recv(0, jobTag, jobFlag);
-            if (jobFlag==0) {
-                break;
-            }
-            // Receive parameters
-            world.recv(0, inpTag, jobInput);
+        //! A tail job may run on two ranks: copies work in a directory of their own
+        //! and only the copy that wins the claim is written.
+        std::string specDir=localDir+"/scratch/spec"+std::to_string(world.rank());
+        CDTmeta cdtMeta;
+        std::vector<CDTmeta> results;
+        TimingSummary timing;
+        auto runJob=[&](JobInputData& job, int& status){
+            if(dispatcher.logJob()) std::cout << "At Process: " << world.rank() << " working on  Key: " << job.key
+                                              << " poses: " << job.poseIDs.size() << std::endl;
 
             //initialize Meta data
-            CDTmeta cdtMeta;
+            cdtMeta=CDTmeta();
             cdtMeta.version=podata.version;
             cdtMeta.dockInDir=podata.dockInDir;
             cdtMeta.recFile=podata.recFile;
@@ -483,51 +415,61 @@ int main(int argc, char** argv) {
             }
 
             cdtMeta.intDiel = podata.intDiel;
+            cdtMeta.nativeGB = (podata.gbEngine=="native");
+            cdtMeta.mergeTop = podata.mergeTop;
 
             cdtMeta.workDir=workDir;
-            cdtMeta.localDir=localDir;
+            cdtMeta.localDir=dispatcher.speculative() ? specDir : localDir;
             cdtMeta.dataPath=dataPath;
             cdtMeta.inputDir=inputDir;
 
-            cdtMeta.key=jobInput.key;
-            cdtMeta.procID=jobInput.procID;
-
-            mmgbsa(cdtMeta);
-
-            toConduit(cdtMeta, gbsaHDF5File);
-
-            // Remove the working dire
-            if(cdtMeta.error && !podata.keep) {
-                chdir(cdtMeta.localDir.c_str());
-                std::string cmd = "rm -rf " + cdtMeta.poseDir;
-                std::string errMesg = "remove poseDir fails";
-                LBIND::command(cmd, errMesg);
-            } else if (useLocalDir && !cdtMeta.error && podata.keep){
-                std::string scrPoseDir = cdtMeta.workDir+"/scratch/gbsa/"+cdtMeta.key;
-                std::string cmd="mkdir -p "+scrPoseDir;
-                std::string errMesg="Run mkdir srcPoseDir fails";
-                LBIND::command(cmd, errMesg);
-
-                cmd="cp * "+scrPoseDir;
-                errMesg="copy file from local to file system fails";
-                LBIND::command(cmd, errMesg);
-
-                chdir(cdtMeta.localDir.c_str());
-                cmd = "rm -rf " + cdtMeta.poseDir;
-                errMesg = "remove poseDir fails";
-                LBIND::command(cmd, errMesg);
+            cdtMeta.key=job.key;
+            cdtMeta.procID=job.procID;
+
+            mmgbsaPair(cdtMeta, job.poseIDs, results);
+
+            status=0;
+            for(CDTmeta& poseMeta : results)
+            {
+                if(!poseMeta.error) ++status;
             }
+        };
+        auto commitJob=[&](JobInputData& job, int& status, bool won){
+            for(CDTmeta& poseMeta : results)
+            {
+                if(won){
+                    toConduit(poseMeta, gbsaHDF5File);
+                    timing.add(poseMeta.timing);
+                }
 
-            
-        }
+                // Remove the working dire
+                if(poseMeta.poseDir.empty()) continue;
+                try {
+                    if (!won || (poseMeta.error && !podata.keep)) {
+                        chdir(poseMeta.localDir.c_str());
+                        removeAll(poseMeta.poseDir);
+                    } else if ((useLocalDir || poseMeta.localDir!=localDir) && !poseMeta.error && podata.keep) {
+                        std::string scrPoseDir = poseMeta.workDir + "/scratch/gbsa/" + poseMeta.key;
+                        makeDir(scrPoseDir);
+                        copyDirFiles(poseMeta.poseDir, scrPoseDir);
+
+                        chdir(poseMeta.localDir.c_str());
+                        removeAll(poseMeta.poseDir);
+                    }
+                }catch (LBindException& e){
+                    std::cout << e.what() << std::endl;
+                }
+            }
+            results.clear();
+        };
+        dispatcher.work(runJob, commitJob);
+        timing.print(std::cout, world.rank());
 
     }
 
     if(useLocalDir){
         world.barrier();
-        std::string cmd = "rm -rf " + localDir+"/scratch";
-        std::string errMesg = "Clean up local disk fails before calculation";
-        LBIND::command(cmd, errMesg);
+        removeAll(localDir+"/scratch");
     }
     std::cout << "Rank= " << world.rank() <<" MPI Wall Time= " << runingTime.elapsed() << " Sec."<< std::endl;
     
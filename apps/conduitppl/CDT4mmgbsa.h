@@ -25,10 +25,12 @@ public:
 
         ar & procID;
         ar & key;
+        ar & poseIDs;
     }
 
     int procID;
-    std::string key;
+    std::string key;                    // rec/lig
+    std::vector<std::string> poseIDs;   // p1, p2, ... still to be rescored
 
 };
 
@@ -38,6 +38,8 @@ bool CDT4mmgbsaPO(int argc, char** argv, POdata& podata) {
                 ("minimize", value<std::string> (&podata.minimizeFlg)->default_value("on"), "Run minimization by default")
                 ("useScoreCF", bool_switch(&podata.useScoreCF)->default_value(false), "Use score cutoff to save ligand with top score higher than certain critical value")
                 ("scoreCF", value<double>(&podata.scoreCF)->default_value(-8.0), "Score cutoff to save ligand with top score higher than certain value (default -8.0)")
+                ("mergeTop", bool_switch(&podata.mergeTop)->default_value(false), "Merge the cached receptor topology and LIG.prmtop in-process instead of running tleap for the later poses of a receptor (check with gbCheck --merge first)")
+                ("gb", value<std::string>(&podata.gbEngine)->default_value("sander"), "GB minimizations and single-point energies by sander (native, in-process, is disabled until gbCheck validates it against sander)")
                 ;
         options_description info("Optional:");
         info.add_options()
@@ -65,6 +67,15 @@ bool CDT4mmgbsaPO(int argc, char** argv, POdata& podata) {
             return 0;
         }
 
+        if (podata.gbEngine=="native") {
+            std::cerr << "--gb native is disabled: the in-process GB engine has not been validated against sander (see gbCheck)\n";
+            return false;
+        }
+        if (podata.gbEngine!="sander") {
+            std::cerr << "--gb must be sander\n\nCorrect usage:\n" << desc << '\n';
+            return false;
+        }
+
         
     }catch (boost::filesystem::filesystem_error& e) {
         std::cerr << "\n\nFile system error: " << e.what() << '\n';
@@ -17,6 +17,7 @@ struct POdata{
     bool score_only;
     bool newapp;
     bool useScoreCF; //switch to turn on score cutoff
+    bool mergeTop;   // complex topologies merged in-process instead of tleap
     int version;
     double intDiel;
     double scoreCF;  // value for score cutoff
@@ -24,6 +25,7 @@ struct POdata{
     std::string recFile;
     std::string ligFile;
     std::string minimizeFlg;
+    std::string gbEngine;    // sander or native
 
 };
 
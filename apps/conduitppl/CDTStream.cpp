@@ -0,0 +1,516 @@
+//
+// CDTStream: ligand preparation, docking and MM/GBSA streamed in one MPI job.
+//
+// CDT2Ligand, CDT3Docking and CDT4mmgbsa run one after the other with the
+// HDF5 files in between, so docking waits for the last ligand and GBSA for
+// the last docking. Here the three stages run at once on pools of workers
+// (see Parallel/StagePool.h): a ligand goes to docking as soon as it is
+// parameterized, and its top poses go to GBSA as soon as it is docked. The
+// prepared ligand and the poses are passed on in memory; each stage still
+// writes the same HDF5 output as the stand-alone app, so CDT4mmgbsa and the
+// analysis scripts can read a streamed run.
+//
+// Receptors must be prepared by CDT1Receptor first. A streamed run does not
+// restart; rerun the stand-alone apps to finish an interrupted one.
+//
+
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/mpi.hpp>
+#include <boost/mpi/environment.hpp>
+#include <boost/mpi/communicator.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/map.hpp>
+#include <boost/timer.hpp>
+
+#include <conduit.hpp>
+#include <conduit_relay.hpp>
+#include <conduit_relay_io_hdf5.hpp>
+
+#include "VinaLC/random.h"
+#include "Parser/SdfIndex.h"
+#include "Parallel/StagePool.h"
+#include "Common/File.hpp"
+#include "Common/FileOps.h"
+#include "Common/Utils.h"
+#include "Common/ScopedTimer.h"
+#include "Common/LBindException.h"
+#include "MM/CDTgbsa.h"
+
+#include "CDT2Ligand.h"
+#include "dock.h"
+#include "gbsa.h"
+#include "mpiparser.h"
+#include "InitEnv.h"
+
+namespace mpi = boost::mpi;
+using namespace conduit;
+using namespace LBIND;
+
+enum Stage { PREP=0, DOCK=1, GBSA=2 };
+
+struct StreamTask {
+    int stage;
+    std::string key;        // ligID (PREP), rec/lig (DOCK), rec/lig/p<n> (GBSA)
+    int64_t sdfOffset=0;    // PREP: SDF record
+    int64_t sdfLength=0;
+    std::string ligName;
+    double ligGB=0;
+    double dockScore=0;
+    std::map<std::string, std::string> files;  // DOCK: LIG_min.pdbqt, GBSA: ligand files
+    std::string poses;      // GBSA: docked poses
+
+    template<class Archive>
+    void serialize(Archive & ar, const unsigned int version){
+        ar & stage;
+        ar & key;
+        ar & sdfOffset;
+        ar & sdfLength;
+        ar & ligName;
+        ar & ligGB;
+        ar & dockScore;
+        ar & files;
+        ar & poses;
+    }
+};
+
+struct StreamResult {
+    bool ok=false;
+    CDT2::JobOutData lig;                       // PREP: entry of the ligand index
+    std::map<std::string, std::string> files;   // PREP: ligand files for the later stages
+    std::vector<double> scores;                 // DOCK
+    std::string poses;                          // DOCK
+    double bindGB=0;                            // GBSA
+
+    template<class Archive>
+    void serialize(Archive & ar, const unsigned int version){
+        ar & ok;
+        ar & lig;
+        ar & files;
+        ar & scores;
+        ar & poses;
+        ar & bindGB;
+    }
+};
+
+struct StreamOptions {
+    std::string sdfFile;
+    std::string recFile;    // relative to WORKDIR as in CDT4mmgbsa
+    int gbsaPoses;          // top poses of each docking sent to GBSA
+    int backlog;
+    bool keep;
+    bool newapp;
+    bool nativeGB;
+    bool mergeTop;
+    CDT2::JobInputData prep;
+    JobInputData dock;
+
+    template<class Archive>
+    void serialize(Archive & ar, const unsigned int version){
+        ar & sdfFile;
+        ar & recFile;
+        ar & gbsaPoses;
+        ar & backlog;
+        ar & keep;
+        ar & newapp;
+        ar & nativeGB;
+        ar & mergeTop;
+        ar & prep;
+        ar & dock;
+    }
+};
+
+bool streamPO(int argc, char** argv, std::string& workDir, StreamOptions& opts){
+    using namespace boost::program_options;
+
+    std::string minimizeFlg;
+    std::string gbEngine;
+    bool explicitSeed=false;
+    bool help=false;
+
+    options_description inputs("Input");
+    inputs.add_options()
+            ("sdf", value<std::string>(&opts.sdfFile), "input SDF file name")
+            ("recFile", value<std::string>(&opts.recFile)->default_value("scratch/receptor.hdf5"), "receptor HDF5 file from CDT1Receptor, relative to WORKDIR")
+            ("cmpName", value<std::string>(&opts.prep.cmpName)->default_value("NoName"), "Use the SDF field property as ligand name (default no name)")
+            ("version", value<int>(&opts.prep.ambVersion)->default_value(16), "AMBER Version")
+            ("minimize", value<std::string>(&minimizeFlg)->default_value("on"), "Run minimization by default")
+            ("intDiel", value<double>(&opts.prep.intDiel)->default_value(4.0), "Solute dielectric constant")
+            ("paramCache", value<std::string>(&opts.prep.paramCache)->default_value(""), "Shared directory caching the parameterized ligands by structure (default off)")
+            ("resultCache", value<std::string>(&opts.dock.resultCache)->default_value(""), "Shared directory caching the docking results by their inputs (default off). Without --seed the seed is not part of the key: any cached result of the same inputs is reused, give --seed to sample new poses")
+            ("seed", value<int>(&opts.dock.seed), "explicit random seed")
+            ("exhaustiveness", value<int>(&opts.dock.exhaustiveness)->default_value(8), "exhaustiveness (default value 8) of the global search")
+            ("granularity", value<double>(&opts.dock.granularity)->default_value(0.375), "the granularity of grids (default value 0.375)")
+            ("num_modes", value<int>(&opts.dock.num_modes)->default_value(10), "maximum number (default value 10) of binding modes to generate")
+            ("energy_range", value<double>(&opts.dock.energy_range)->default_value(2.0), "maximum energy difference (default value 2.0) between the best binding mode and the worst one displayed (kcal/mol)")
+            ("min_rmsd", value<double>(&opts.dock.min_rmsd)->default_value(1.0), "minimum RMSD between binding modes (default value 1.0)")
+            ("useScoreCF", bool_switch(&opts.dock.useScoreCF)->default_value(false), "Skip GBSA for ligands with a top score higher than scoreCF")
+            ("scoreCF", value<double>(&opts.dock.scoreCF)->default_value(-8.0), "Score cutoff (default -8.0)")
+            ("threads-per-rank", value<int>(&opts.dock.cpu)->default_value(0), "docking threads per MPI rank (default 0: the number of CPUs the rank is bound to)")
+            ("gbsa-poses", value<int>(&opts.gbsaPoses)->default_value(1), "top poses of each docking rescored by GBSA (default 1)")
+            ("newapp", bool_switch(&opts.newapp)->default_value(false), "rescoring using new approach")
+            ("gb", value<std::string>(&gbEngine)->default_value("sander"), "GB minimizations and single-point energies by sander (native, in-process, is disabled until gbCheck validates it against sander)")
+            ("mergeTop", bool_switch(&opts.mergeTop)->default_value(false), "Merge the cached receptor topology and LIG.prmtop in-process instead of running tleap for the later poses of a receptor (check with gbCheck --merge first)")
+            ("backlog", value<int>(&opts.backlog)->default_value(2), "queued docking and GBSA tasks per worker before new ligands are started")
+            ("keep", bool_switch(&opts.keep)->default_value(false), "Keep intermediate files")
+            ;
+    options_description info("Information (optional)");
+    info.add_options()
+            ("help", bool_switch(&help), "display usage summary")
+            ;
+    options_description desc;
+    desc.add(inputs).add(info);
+
+    try {
+        variables_map vm;
+        store(command_line_parser(argc, argv)
+                .options(desc)
+                .style(command_line_style::default_style ^ command_line_style::allow_guessing)
+                .run(),
+              vm);
+        notify(vm);
+        explicitSeed=(vm.count("seed")>0);
+
+        if(help){
+            std::cout << desc << '\n';
+            return false;
+        }
+        if(vm.count("sdf")<=0){
+            std::cerr << "Missing SDF file.\n" << "\nCorrect usage:\n" << desc << '\n';
+            return false;
+        }
+    } catch (boost::program_options::error& e) {
+        std::cerr << "Command line parse error: " << e.what() << '\n' << "\nCorrect usage:\n" << desc << '\n';
+        return false;
+    }
+
+    if(gbEngine=="native"){
+        std::cerr << "--gb native is disabled: the in-process GB engine has not been validated against sander (see gbCheck)\n";
+        return false;
+    }
+    if(gbEngine!="sander"){
+        std::cerr << "--gb must be sander\n\nCorrect usage:\n" << desc << '\n';
+        return false;
+    }
+
+    if(opts.gbsaPoses<0) opts.gbsaPoses=0;
+    if(opts.backlog<1) opts.backlog=1;
+
+    opts.prep.minimizeFlg=(minimizeFlg=="on");
+    opts.nativeGB=(gbEngine=="native");
+    opts.prep.score_only=false;
+    opts.prep.shard=true;
+    opts.prep.keep=opts.keep;
+    opts.prep.sdfFile=boost::filesystem::absolute(opts.sdfFile).string();
+    opts.prep.sdfBuffer="";
+    if(!opts.prep.paramCache.empty()){
+        opts.prep.paramCache=boost::filesystem::absolute(opts.prep.paramCache).string();
+    }
+    opts.prep.ligCdtFile=workDir+"/scratch/ligand.hdf5:/";
+
+    opts.dock.flexible=false;
+    opts.dock.randomize=false;
+    opts.dock.score_only=false;
+    opts.dock.local_only=false;
+    opts.dock.randomize_only=false;
+    opts.dock.pinThreads=false;
+    opts.dock.screening=false;
+    opts.dock.stepScale=1.0;
+    opts.dock.explicitSeed=explicitSeed;
+    if(!explicitSeed){
+        opts.dock.seed=auto_seed();
+    }
+    if(!opts.dock.resultCache.empty()){
+        opts.dock.resultCache=boost::filesystem::absolute(opts.dock.resultCache).string();
+    }
+    opts.dock.recFile=workDir+"/"+opts.recFile;
+    opts.dock.ligFile=workDir+"/scratch/ligand.hdf5";
+    opts.dock.comFile="";
+    if(opts.dock.cpu<0) opts.dock.cpu=0;
+
+    return true;
+}
+
+//! Files of a prepared ligand that docking and GBSA need.
+void readLigFiles(const std::string& ligPath, std::map<std::string, std::string>& files){
+    std::vector<std::string> names={"LIG.lib", "LIG_min.pdbqt", "ligand.frcmod", "LIG_min.pdb", "ligand.mol2",
+                                    "LIG.prmtop"};
+    for(std::string& name : names){
+        std::ifstream infile(ligPath+"/"+name);
+        if(infile.good()){
+            files[name]=std::string((std::istreambuf_iterator<char>(infile)), std::istreambuf_iterator<char>());
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+
+    mpi::environment env(argc, argv);
+    mpi::communicator world;
+    mpi::timer runingTime;
+
+    std::string workDir;
+    std::string inputDir;
+    std::string dataPath;
+    std::string localDir;
+
+    if(!initConveyorlcEnv(workDir, localDir, inputDir, dataPath)){
+        world.abort(1);
+    }
+
+    bool useLocalDir=(localDir!=workDir);
+    if(useLocalDir){
+        removeAll(localDir+"/scratch");
+        world.barrier();
+    }
+
+    if (world.size() < 2) {
+        std::cerr << "Error: Total process less than 2" << std::endl;
+        world.abort(1);
+    }
+
+    StreamOptions opts;
+    if(world.rank()==0){
+        std::cout << "CDTStream Begin: " << timeStamp() << std::endl;
+        if(!streamPO(argc, argv, workDir, opts)){
+            world.abort(1);
+        }
+        makeDir(workDir+"/scratch/ligHDF5");
+        makeDir(workDir+"/scratch/dockHDF5");
+        makeDir(workDir+"/scratch/gbsaHDF5");
+    }
+    broadcast(world, opts, 0);
+
+    StagePool<StreamTask, StreamResult> pool(world, 3, opts.backlog);
+    int cacheHits=0;
+    int cacheMisses=0;
+
+    if(world.rank()==0){
+        SdfIndex sdfIndex;
+        try {
+            sdfIndex.build(opts.sdfFile);
+        } catch (LBindException& e) {
+            std::cout << "CDTStream >> " << e.what() << std::endl;
+            world.abort(1);
+        }
+        int numLigand=sdfIndex.size();
+
+        std::vector<std::string> recList;
+        saveRec(opts.dock.recFile, recList);
+        std::cout << "CDTStream " << numLigand << " ligands, " << recList.size() << " receptors" << std::endl;
+
+        Node n;
+        std::string ligCdtFile=opts.prep.ligCdtFile;
+        n["date"]="Create By CDTStream at "+timeStamp();
+        relay::io::hdf5_append(n, ligCdtFile);
+
+        //! Prepared ligands wait here until all their dockings are done.
+        struct Ligand {
+            std::map<std::string, std::string> files;
+            int pending;
+        };
+        std::unordered_map<std::string, Ligand> ligands;
+        long numGbsa=0;
+
+        int i=0;
+        auto nextLigand=[&](StreamTask& task){
+            if(i>=numLigand) return false;
+            task.stage=PREP;
+            task.key=std::to_string(i+1);
+            task.sdfOffset=sdfIndex.offset(i);
+            task.sdfLength=sdfIndex.length(i);
+            ++i;
+            return true;
+        };
+
+        auto route=[&](StreamTask& task, StreamResult& out, std::vector<StreamTask>& more){
+            if(task.stage==PREP){
+                Node nIndex;
+                toIndex(out.lig, ligCdtFile, nIndex);
+                if(!out.ok || recList.empty()) return;
+
+                Ligand& lig=ligands[task.key];
+                lig.files.swap(out.files);
+                lig.pending=recList.size();
+                for(std::string& rec : recList){
+                    StreamTask dock;
+                    dock.stage=DOCK;
+                    dock.key=rec+"/"+task.key;
+                    dock.ligName=out.lig.ligName;
+                    dock.ligGB=out.lig.gbEn;
+                    dock.files["LIG_min.pdbqt"]=lig.files["LIG_min.pdbqt"];
+                    more.push_back(dock);
+                }
+            }else if(task.stage==DOCK){
+                std::string ligID=task.key.substr(task.key.find('/')+1);
+                Ligand& lig=ligands[ligID];
+
+                bool pass=out.ok && !out.scores.empty()
+                          && !(opts.dock.useScoreCF && out.scores[0]>opts.dock.scoreCF);
+                if(pass){
+                    int numPose=std::min(static_cast<int>(out.scores.size()), opts.gbsaPoses);
+                    for(int k=1; k<=numPose; ++k){
+                        StreamTask gbsa;
+                        gbsa.stage=GBSA;
+                        gbsa.key=task.key+"/p"+std::to_string(k);
+                        gbsa.ligName=task.ligName;
+                        gbsa.ligGB=task.ligGB;
+                        gbsa.dockScore=out.scores[0];
+                        gbsa.files=lig.files;
+                        gbsa.poses=out.poses;
+                        more.push_back(gbsa);
+                    }
+                }
+
+                if(--lig.pending<=0){
+                    ligands.erase(ligID);
+                }
+            }else{
+                ++numGbsa;
+            }
+        };
+
+        pool.serve(nextLigand, route);
+        std::cout << "CDTStream " << numGbsa << " GBSA calculations" << std::endl;
+
+    }else{
+        std::string rank=std::to_string(world.rank());
+        std::string shardRel="ligHDF5/lig_proc"+rank+".hdf5";
+        std::string shardFile=workDir+"/scratch/"+shardRel+":/";
+        std::string dockHDF5File=workDir+"/scratch/dockHDF5/dock_proc"+rank+".hdf5:/";
+        std::string gbsaHDF5File=workDir+"/scratch/gbsaHDF5/gbsa_proc"+rank+".hdf5:/";
+        TimingSummary timing;
+
+        auto prepLigand=[&](StreamTask& task, StreamResult& out){
+            CDT2::JobInputData job=opts.prep;
+            job.dirBuffer=task.key;
+            job.sdfOffset=task.sdfOffset;
+            job.sdfLength=task.sdfLength;
+
+            CDT2::JobOutData& jobOut=out.lig;
+            CDT2::preLigands(job, jobOut, localDir, workDir, useLocalDir);
+            if(jobOut.error){
+                readLigFiles(jobOut.ligPath, out.files);
+            }
+            CDT2::toShard(job, jobOut, shardRel, shardFile, localDir, useLocalDir);
+            timing.add(jobOut.timing);
+            out.ok=jobOut.error && out.files.count("LIG_min.pdbqt")>0;
+        };
+
+        auto dockLigand=[&](StreamTask& task, StreamResult& out){
+            JobInputData job=opts.dock;
+            job.key=task.key;
+            job.ligPdbqt=task.files["LIG_min.pdbqt"];
+
+            JobOutData jobOut;
+            dockjob(job, jobOut, localDir);
+            jobOut.ligName=task.ligName;
+            toHDF5File(job, jobOut, dockHDF5File);
+            timing.add(jobOut.timing);
+            if(jobOut.cacheLookup==CACHE_HIT) ++cacheHits;
+            if(jobOut.cacheLookup==CACHE_MISS) ++cacheMisses;
+
+            chdir(localDir.c_str());
+            try {
+                removeAll(jobOut.dockDir);
+            }catch (LBindException& e){
+                std::cout << e.what() << std::endl;
+            }
+
+            out.ok=jobOut.error;
+            out.scores=jobOut.scores;
+            out.poses=jobOut.pdbqtfile;
+        };
+
+        auto gbsaPose=[&](StreamTask& task, StreamResult& out){
+            CDTmeta cdtMeta;
+            cdtMeta.version=opts.prep.ambVersion;
+            cdtMeta.recFile=opts.recFile;
+            cdtMeta.score_only=false;
+            cdtMeta.newapp=opts.newapp;
+            cdtMeta.useScoreCF=false;
+            cdtMeta.scoreCF=opts.dock.scoreCF;
+            cdtMeta.minimize=opts.prep.minimizeFlg;
+            cdtMeta.intDiel=opts.prep.intDiel;
+            cdtMeta.nativeGB=opts.nativeGB;
+            cdtMeta.mergeTop=opts.mergeTop;
+            cdtMeta.workDir=workDir;
+            cdtMeta.localDir=localDir;
+            cdtMeta.dataPath=dataPath;
+            cdtMeta.inputDir=inputDir;
+            cdtMeta.key=task.key;
+            cdtMeta.procID=world.rank();
+            cdtMeta.ligName=task.ligName;
+            cdtMeta.ligGB=task.ligGB;
+            cdtMeta.dockscore=task.dockScore;
+            cdtMeta.ligFiles.swap(task.files);
+            cdtMeta.poses.swap(task.poses);
+
+            mmgbsa(cdtMeta);
+            toConduit(cdtMeta, gbsaHDF5File);
+            timing.add(cdtMeta.timing);
+
+            try {
+                if (!cdtMeta.error && !opts.keep) {
+                    chdir(cdtMeta.localDir.c_str());
+                    removeAll(cdtMeta.poseDir);
+                } else if (useLocalDir && !cdtMeta.error && opts.keep) {
+                    std::string scrPoseDir = cdtMeta.workDir + "/scratch/gbsa/" + cdtMeta.key;
+                    makeDir(scrPoseDir);
+                    copyDirFiles(cdtMeta.poseDir, scrPoseDir);
+
+                    chdir(cdtMeta.localDir.c_str());
+                    removeAll(cdtMeta.poseDir);
+                }
+            }catch (LBindException& e){
+                std::cout << e.what() << std::endl;
+            }
+
+            out.ok=cdtMeta.error;
+            out.bindGB=cdtMeta.gbbind;
+        };
+
+        pool.work([&](StreamTask& task, StreamResult& out){
+            std::cout << "At Process: " << world.rank() << " stage " << task.stage << " working on: " << task.key << std::endl;
+            if(task.stage==PREP){
+                prepLigand(task, out);
+            }else if(task.stage==DOCK){
+                dockLigand(task, out);
+            }else{
+                gbsaPose(task, out);
+            }
+        });
+        timing.print(std::cout, world.rank());
+    }
+
+    //! Result cache hits and misses of all ranks, for the run summary
+    int totalHits=0, totalMisses=0;
+    reduce(world, cacheHits, totalHits, std::plus<int>(), 0);
+    reduce(world, cacheMisses, totalMisses, std::plus<int>(), 0);
+    if(world.rank()==0 && totalHits+totalMisses>0){
+        std::cout << "CDTStream docking result cache: " << totalHits << " hits, " << totalMisses << " misses" << std::endl;
+    }
+
+    std::cout << "Rank= " << world.rank() <<" MPI Wall Time= " << runingTime.elapsed() << " Sec."<< std::endl;
+
+    if(useLocalDir){
+        world.barrier();
+        removeAll(localDir+"/scratch");
+    }
+
+    if(world.rank()==0){
+        std::cout << "CDTStream End: " << timeStamp() << std::endl;
+    }
+
+    return 0;
+}
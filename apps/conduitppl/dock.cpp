@@ -28,6 +28,7 @@
 #include <stack>
 #include <vector> // ligand paths
 #include <cmath> // for ceila
+#include <cstdlib>
 #include <boost/program_options.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <boost/filesystem/exception.hpp>
@@ -50,8 +51,12 @@
 #include "VinaLC/weighted_terms.h"
 #include "VinaLC/current_weights.h"
 #include "VinaLC/quasi_newton.h"
-#include "Common/Command.hpp"
+#include "Common/FileOps.h"
+#include "Common/Affinity.h"
 #include "Common/LBindException.h"
+#include "Common/LigIndex.h"
+#include "Common/ScopedTimer.h"
+#include "DataBase/ContentCache.h"
 //#include "gzstream.h"
 //#include "tee.h"
 #include "VinaLC/coords.h" // add_to_output_container
@@ -64,45 +69,34 @@
 
 using namespace conduit;
 
-bool getScores(JobOutData& jobOut){
+bool getScores(const DockResult& result, JobOutData& jobOut){
 
-    std::vector<std::string> lines;
-    tokenize(jobOut.scorelog, lines, "\n");
-    if(lines.size()<5)  return false;
+    jobOut.scores.clear();
+    jobOut.rmsdLB.clear();
+    jobOut.rmsdUB.clear();
+    jobOut.intraEn.clear();
+    jobOut.interEn.clear();
 
-    for (unsigned i = 4; i < lines.size(); ++i) {
-        std::vector<std::string> values;
-        tokenize(lines[i], values);
-        if (values.size() > 2) {
-            double score = Sstrm<double, std::string>(values[1]);
-            jobOut.scores.push_back(score);
-        }
+    for(const DockMode& mode : result.modes){
+        jobOut.scores.push_back(mode.energy);
+        jobOut.rmsdLB.push_back(mode.rmsdLB);
+        jobOut.rmsdUB.push_back(mode.rmsdUB);
+        jobOut.intraEn.push_back(mode.intra);
+        jobOut.interEn.push_back(mode.inter);
     }
-    
-    if(jobOut.scores.size()==0) return false;
-    
-    return true;
-}
 
-bool getScoreOnlyScores(JobOutData& jobOut){
-
-    std::vector<std::string> lines;
-    tokenize(jobOut.scorelog, lines, " ");
-    //std::cout << jobOut.scorelog << std::endl;
-    if(lines.size()<2)  return false;
-
-    if(lines[0]=="Affinity:") {
-        double score = Sstrm<double, std::string>(lines[1]);
-        jobOut.scores.push_back(score);
-    }
+    return jobOut.scores.size()>0;
+}
 
-    if(jobOut.scores.size()==0) return false;
 
-    return true;
+double dockCost(int numAtoms, int numTors){
+    //! MC steps grow with atoms + 10*degrees of freedom, each step with the atoms.
+    double dof = numTors + 6;
+    double steps = 50 + numAtoms + 10 * dof;
+    return steps * std::max(numAtoms, 1);
 }
 
-
-void getRecData(JobInputData& jobInput, std::string& recKey, grid_dims& gd){
+void getRecData(JobInputData& jobInput, std::string& recKey, grid_dims& gd, std::string& recPdbqt){
     Node nRec;
 
     hid_t rec_hid = relay::io::hdf5_open_file_for_read(jobInput.recFile);
@@ -117,10 +111,10 @@ void getRecData(JobInputData& jobInput, std::string& recKey, grid_dims& gd){
     std::string pdbqtPath="file/rec_min.pdbqt";
     //std::cout << pdbqtPath << std::endl;
     if(nRec.has_path(pdbqtPath)){
-        std::string outLines=nRec[pdbqtPath].as_string();
+        recPdbqt=nRec[pdbqtPath].as_string();
 
         std::ofstream outFile("rec_min.pdbqt");
-        outFile << outLines;
+        outFile << recPdbqt;
     }else{
         throw LBIND::LBindException("Cannot retrieve pdbqt file for "+recKey);
     }
@@ -212,11 +206,10 @@ bool checkLigData(std::string& fileName, std::string& ligKey){
 
 void getLigData(std::string& fileName, std::string& ligKey, std::string& ligName, std::stringstream& ligSS){
 
-    hid_t lig_hid=relay::io::hdf5_open_file_for_read(fileName);
-
     Node nLig;
     try {
-        relay::io::hdf5_read(lig_hid, "lig/" + ligKey, nLig);
+        // ligand.hdf5 may only index the ligand and keep the files in a shard
+        LBIND::loadLigand(fileName, ligKey, nLig);
         if(nLig.has_path("meta/name")){
             ligName=nLig["meta/name"].as_string();
         }else{
@@ -228,14 +221,164 @@ void getLigData(std::string& fileName, std::string& ligKey, std::string& ligName
     }catch (...){
         throw LBIND::LBindException("Cannot retrieve pdbqt file for "+ligKey);
     }
+}
+
+//! Files of a docking result in the result cache, written in dockDir.
+const std::vector<std::string> resultFiles={"scores.log", "poses.pdbqt", "modes.txt"};
+
+//! SHA1 of every input main_procedure's result depends on. The thread count is left out, the Monte
+//! Carlo tasks are seeded from the seed alone. A seed the user did not give, or --randomize replaced,
+//! is left out as well ("any"): an unseeded run reuses a result docked with any seed.
+std::string resultKey(const JobInputData& jobInput, const std::string& recPdbqt, const std::string& ligPdbqt,
+                      const grid_dims& gd, const flv& weights){
+    std::stringstream ss;
+    ss.precision(17);
+    ss << "dock-1\n";
+    VINA_FOR_IN(i, gd) {
+        ss << gd[i].begin << " " << gd[i].end << " " << gd[i].n << "\n";
+    }
+    for(fl w : weights) ss << w << " ";
+    ss << "\nexhaustiveness " << jobInput.exhaustiveness << " stepScale " << jobInput.stepScale
+       << " num_modes " << jobInput.num_modes << " energy_range " << jobInput.energy_range
+       << " min_rmsd " << jobInput.min_rmsd << " score_only " << jobInput.score_only
+       << " local_only " << jobInput.local_only << " randomize_only " << jobInput.randomize_only
+       << " seed ";
+    if(jobInput.explicitSeed && !jobInput.randomize){
+        ss << jobInput.seed;
+    }else{
+        ss << "any";
+    }
+    ss << "\n" << recPdbqt << "\n" << ligPdbqt;
+    return LBIND::ContentCache::sha1(ss.str());
+}
+
+std::string readText(const std::string& fileName){
+    std::ifstream inFile(fileName.c_str());
+    std::stringstream buffer;
+    buffer << inFile.rdbuf();
+    return buffer.str();
+}
+
+//! The result docked before under key, copied into jobOut.dockDir; false on a miss.
+bool fetchResult(const std::string& cacheDir, const std::string& key, JobOutData& jobOut){
+    std::string info;
+    if(!LBIND::ContentCache(cacheDir).fetch(key, jobOut.dockDir, info)) return false;
+
+    jobOut.scorelog=readText(jobOut.dockDir+"/scores.log");
+    jobOut.pdbqtfile=readText(jobOut.dockDir+"/poses.pdbqt");
+
+    DockResult result;
+    std::ifstream modeFile((jobOut.dockDir+"/modes.txt").c_str());
+    DockMode mode;
+    while(modeFile >> mode.energy >> mode.rmsdLB >> mode.rmsdUB >> mode.intra >> mode.inter){
+        result.modes.push_back(mode);
+    }
+    if(static_cast<int>(result.modes.size())!=std::atoi(info.c_str())){
+        std::cout << "Docking result cache entry " << key << " is incomplete" << std::endl;
+        return false;
+    }
+    jobOut.numPose=result.modes.size();
+    getScores(result, jobOut);
+    return true;
+}
+
+void storeResult(const std::string& cacheDir, const std::string& key, JobOutData& jobOut){
+    {
+        std::ofstream(jobOut.dockDir+"/scores.log") << jobOut.scorelog;
+        std::ofstream(jobOut.dockDir+"/poses.pdbqt") << jobOut.pdbqtfile;
+        std::ofstream modeFile(jobOut.dockDir+"/modes.txt");
+        modeFile.precision(17);
+        for(int i=0; i<jobOut.scores.size(); ++i){
+            modeFile << jobOut.scores[i] << " " << jobOut.rmsdLB[i] << " " << jobOut.rmsdUB[i] << " "
+                     << jobOut.intraEn[i] << " " << jobOut.interEn[i] << "\n";
+        }
+    }
+    LBIND::ContentCache(cacheDir).store(key, resultFiles, jobOut.dockDir, std::to_string(jobOut.scores.size()));
+}
+
+void toConduit(JobOutData& jobOut, std::string& dockHDF5File, const std::string& group){
+    try {
+
+        Node n;
+
+        std::string keyPath=group+"/"+jobOut.pdbID +"/"+jobOut.ligID;
+
+        n[keyPath+ "/status"]=jobOut.error;
+
+        std::string recIDMeta =keyPath+ "/meta/";
+        n[recIDMeta+"ligName"]=jobOut.ligName;
+        n[recIDMeta+"numPose"]=jobOut.numPose;
+        n[recIDMeta+"Mesg"]=jobOut.mesg;
+        if(jobOut.cacheLookup!=NOT_CACHED){
+            n[recIDMeta+"resultCache"]=(jobOut.cacheLookup==CACHE_HIT) ? "hit" : "miss";
+        }
+
+        for(const auto& t : jobOut.timing.phases())
+        {
+            n[recIDMeta+"timing/"+t.first]=t.second;
+        }
+
+        for(int i=0; i< jobOut.scores.size(); ++i)
+        {
+            n[recIDMeta+"scores/"+std::to_string(i+1)]=jobOut.scores[i];
+        }
+
+        for(int i=0; i< jobOut.rmsdLB.size(); ++i)
+        {
+            std::string modeMeta=recIDMeta+"modes/"+std::to_string(i+1)+"/";
+            n[modeMeta+"rmsdLB"]=jobOut.rmsdLB[i];
+            n[modeMeta+"rmsdUB"]=jobOut.rmsdUB[i];
+            n[modeMeta+"intra"]=jobOut.intraEn[i];
+            n[modeMeta+"inter"]=jobOut.interEn[i];
+        }
+
+        std::string recIDFile =keyPath + "/file/";
+
+        n[recIDFile+"scores.log"]=jobOut.scorelog;
+        n[recIDFile+"poses.pdbqt"]=jobOut.pdbqtfile;
+
+        LBIND::ScopedTimer timer(jobOut.timing, "hdf5Write");
+        relay::io::hdf5_append(n, dockHDF5File);
+
+    }catch(conduit::Error &error){
+        jobOut.mesg= error.message();
+    }
+
 
-    relay::io::hdf5_close_file(lig_hid);
 }
 
+void toHDF5File(JobInputData& jobInput, JobOutData& jobOut, std::string& dockHDF5File)
+{
+    if(jobInput.screening){
+        //Screening pass results are kept apart so CDT4mmgbsa only sees the final poses
+        toConduit(jobOut, dockHDF5File, "dockPass1");
+        return;
+    }
+
+    if(jobInput.useScoreCF){
+        if(jobOut.scores.size()>0){
+            if(jobOut.scores[0]>jobInput.scoreCF){
+                //Mark the low score compound as "fail" so when restart program won't re-do it
+                jobOut.error=false;
+                //jobOut.numPose=0;
+                jobOut.mesg="Beyond score cutoff";
+                //jobOut.scorelog="";
+                //jobOut.pdbqtfile="";
+                //jobOut.scores.clear();
+            }
+        }else{
+            jobOut.error=false;
+        }
+    }
+    toConduit(jobOut, dockHDF5File);
+
+}
 
 void dockjob(JobInputData& jobInput, JobOutData& jobOut, std::string& localDir){
+    LBIND::JobTiming timing(jobOut.timing);
     try{
         jobOut.error= true;
+        jobOut.cacheLookup=NOT_CACHED;
 //        std::string flex_name, config_name, out_name, log_name;
         if (jobInput.randomize) {
             jobInput.seed = rand();
@@ -256,7 +399,7 @@ void dockjob(JobInputData& jobInput, JobOutData& jobOut, std::string& localDir){
         jobOut.pdbID=keys[0];
         jobOut.ligID=keys[1];
 
-        bool checkLig=checkLigData(jobInput.ligFile, jobOut.ligID);
+        bool checkLig=!jobInput.ligPdbqt.empty() || checkLigData(jobInput.ligFile, jobOut.ligID);
         if(!checkLig) {
             jobOut.error = false;
             return;
@@ -274,24 +417,29 @@ void dockjob(JobInputData& jobInput, JobOutData& jobOut, std::string& localDir){
         bool randomize_only = jobInput.randomize_only;
 
         jobOut.dockDir = localDir + "/scratch/dock/" + jobOut.pdbID + "/" + jobOut.ligID;
-        std::string cmd = "mkdir -p " + jobOut.dockDir;
-        std::string errMesg="mkdir dockDir fails";
-        LBIND::command(cmd, errMesg);
+        LBIND::makeDir(jobOut.dockDir);
         // cd to the rec directory to performance calculation
         chdir(jobOut.dockDir.c_str());
 
 
+        LBIND::ScopedTimer readTimer("hdf5Read");
         grid_dims gd; // n's = 0 via default c'tor
-        getRecData(jobInput, jobOut.pdbID, gd);
+        std::string recPdbqt;
+        getRecData(jobInput, jobOut.pdbID, gd, recPdbqt);
 
         std::string rigid_name =jobOut.dockDir+"/rec_min.pdbqt";
         std::string flex_name = "";
         int exhaustiveness=jobInput.exhaustiveness;
-        int cpu=jobInput.cpu;
+        int cpu=(jobInput.cpu>0) ? jobInput.cpu : LBIND::numAffinityCpus();
 
         std::string ligand_name = jobOut.ligID;
         std::stringstream ligSS;
-        getLigData(jobInput.ligFile, ligand_name, jobOut.ligName, ligSS);
+        if(jobInput.ligPdbqt.empty()){
+            getLigData(jobInput.ligFile, ligand_name, jobOut.ligName, ligSS);
+        }else{
+            ligSS << jobInput.ligPdbqt;
+        }
+        readTimer.stop();
 
 
         sz max_modes_sz = static_cast<sz> (num_modes);
@@ -316,45 +464,56 @@ void dockjob(JobInputData& jobInput, JobOutData& jobOut, std::string& localDir){
 
         std::stringstream log;
 
+        //! Pairs docked before with identical inputs, in this campaign or another one, are not docked again.
+        //! --randomize asks for new poses: its results are stored under "any" but never looked up.
+        std::string cacheKey;
+        if(!jobInput.resultCache.empty()){
+            LBIND::ScopedTimer cacheTimer("resultCache");
+            cacheKey=resultKey(jobInput, recPdbqt, ligSS.str(), gd, weights);
+            if(!jobInput.randomize && fetchResult(jobInput.resultCache, cacheKey, jobOut)){
+                jobOut.cacheLookup=CACHE_HIT;
+                jobOut.scorelog="Docking result cache hit, key "+cacheKey+(jobInput.explicitSeed ? "\n" : " (any seed)\n")
+                                +jobOut.scorelog;
+                jobOut.mesg=(jobOut.scores.size()>0) ? "Finished!" : "No scores!";
+                return;
+            }
+            jobOut.cacheLookup=CACHE_MISS;
+        }
+
         doing(verbosity, "Reading input", log);
 
 //        model m = parse_bundle(rigid_name_opt, flex_name_opt, std::vector<std::string > (1, ligand_name));
+        LBIND::ScopedTimer parseTimer("parsing");
         model m = parse_bundle(rigid_name_opt, flex_name_opt, ligSS);
+        parseTimer.stop();
 
         boost::optional<model> ref;
         done(verbosity, log);
 
-        sz how_many=0;
+        DockResult result;
         main_procedure(m, ref,
                 out_name,
                 score_only, local_only, randomize_only, false, // no_cache == false
-                gd, exhaustiveness,
+                gd, exhaustiveness, jobInput.stepScale,
                 weights,
-                cpu, seed, verbosity, max_modes_sz, energy_range, jobInput.min_rmsd, log, how_many);
+                cpu, jobInput.pinThreads, seed, verbosity, max_modes_sz, energy_range, jobInput.min_rmsd, log, result);
 
-        jobOut.numPose=how_many;
+        jobOut.numPose=result.modes.size();
 
         jobOut.scorelog=log.str();
 
         jobOut.pdbqtfile=out_name.str();
 
-        
-        jobOut.scores.clear();
-        bool success=false;
 
-        if(jobInput.score_only){
-            success = getScoreOnlyScores(jobOut);
-        } else {
-            success = getScores(jobOut);
-        }
-        if(success){
+        if(getScores(result, jobOut)){
             jobOut.mesg="Finished!";
+            if(!cacheKey.empty()){
+                LBIND::ScopedTimer cacheTimer("resultCache");
+                storeResult(jobInput.resultCache, cacheKey, jobOut);
+            }
         }else{
             jobOut.mesg="No scores!";
         }
-        if(how_many<1){
-            jobOut.mesg="No scores!";
-        }
 
     } catch (file_error& e) {
         //std::cerr << "\n\nError: could not open \"" << e.name.string() << "\" for " << (e.in ? "reading" : "writing") << ".\n";
@@ -16,6 +16,8 @@
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
 
+#include "Common/ScopedTimer.h"
+
 
 
 class JobInputData{
@@ -29,11 +31,13 @@ public:
     void serialize(Archive & ar, const unsigned int version)
     {
         ar & useScoreCF;
+        ar & screening;
         ar & flexible;
         ar & randomize;
         ar & score_only;
         ar & local_only;
         ar & randomize_only;
+        ar & pinThreads;
         ar & cpu;
         ar & exhaustiveness;
         ar & num_modes;
@@ -42,33 +46,52 @@ public:
         ar & energy_range;
         ar & min_rmsd;
         ar & granularity;
+        ar & stepScale;
         ar & key;
         ar & recFile;
         ar & ligFile;
         ar & comFile;
+        ar & ligPdbqt;
+        ar & explicitSeed;
+        ar & resultCache;
     }
 
     bool useScoreCF; //switch to turn on score cutoff
+    bool screening;  // pass 1 of two-pass docking, written to dockPass1
     bool flexible;
     bool randomize;
     bool score_only;
     bool local_only;
     bool randomize_only;
-    int cpu;
+    bool pinThreads; // pin docking threads within the rank's CPU set
+    int cpu;         // docking threads per rank, 0 for the size of the rank's CPU set
     int exhaustiveness;
     int num_modes;
 //    int mc_mult;
     int seed;
+    bool explicitSeed; // seed given by the user, otherwise any seed is as good for the result cache
     double scoreCF;  // value for score cutoff     
     double energy_range;
     double min_rmsd;
     double granularity;
+    double stepScale; // fraction of the default Monte Carlo steps
     std::string key;
     std::string recFile;
     std::string ligFile;
     std::string comFile;
+    std::string ligPdbqt; // ligand handed over in memory, read from ligFile when empty
+    std::string resultCache; // docking result cache directory, empty without cache
+    // two-pass docking, used by the master only
+    int pass1Exhaustiveness; // 0 for single pass docking
+    double pass1Steps;
+    double pass2Top;         // percent of the screened pairs re-docked
+    double pass2Cutoff;
+    bool usePass2Cutoff;     // re-dock the pairs scoring below pass2Cutoff instead
 };
 
+//! How a docking result was obtained with a result cache.
+enum CacheLookup { NOT_CACHED=0, CACHE_HIT, CACHE_MISS };
+
 struct JobOutData{
 
 public:
@@ -80,13 +103,25 @@ public:
     std::string dockDir;
     std::string mesg;
     std::vector<double> scores;
+    std::vector<double> rmsdLB;
+    std::vector<double> rmsdUB;
+    std::vector<double> intraEn;
+    std::vector<double> interEn;
     std::string scorelog;
     std::string pdbqtfile;
+    LBIND::PhaseTimes timing; // written to meta/timing, without the HDF5 write itself
+    CacheLookup cacheLookup=NOT_CACHED;
 };
 
 void dockjob(JobInputData& jobInput, JobOutData& jobOut, std::string& workDir);
 
-bool getScores(std::string& log, std::vector<double>& scores);
+void toConduit(JobOutData& jobOut, std::string& dockHDF5File, const std::string& group="dock");
+
+//! Append a docking result to a dock_proc<rank>.hdf5, applying the score cutoff.
+void toHDF5File(JobInputData& jobInput, JobOutData& jobOut, std::string& dockHDF5File);
+
+//! Relative docking cost from the ligand size, same scaling as main_procedure's num_steps.
+double dockCost(int numAtoms, int numTors);
 
 #endif	/* DOCKING_H */
 
@@ -0,0 +1,160 @@
+//
+// MM/GBSA job of CDT4mmgbsa, shared with the CDTStream driver.
+//
+
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <conduit.hpp>
+#include <conduit_relay.hpp>
+#include <conduit_relay_io_hdf5.hpp>
+
+#include "Common/LBindException.h"
+#include "Common/ScopedTimer.h"
+#include "gbsa.h"
+
+using namespace conduit;
+using namespace LBIND;
+
+void toConduit(CDTmeta &cdtMeta, std::string& gbsaHDF5File){
+    try {
+
+        Node n;
+
+        std::string keyPath="gbsa/"+cdtMeta.key;
+
+        n[keyPath+ "/status"]=cdtMeta.error;
+
+        std::string recIDMeta =keyPath+ "/meta/";
+        n[recIDMeta+"ligName"]=cdtMeta.ligName;
+        n[recIDMeta+"comGB"]=cdtMeta.comGB;
+        n[recIDMeta+"ligGB"]=cdtMeta.ligGB;
+        n[recIDMeta+"recGB"]=cdtMeta.recGB;
+        n[recIDMeta+"bindGB"]=cdtMeta.gbbind;
+        n[recIDMeta+"dockScore"]=cdtMeta.dockscore;
+        n[recIDMeta+"Mesg"]=cdtMeta.message;
+
+        for(const auto& t : cdtMeta.timing.phases())
+        {
+            n[recIDMeta+"timing/"+t.first]=t.second;
+        }
+
+        std::string recIDFile =keyPath + "/file/";
+
+        std::vector<std::string> filenames={"Com.prmtop", "Com.inpcrd", "Com_min.rst",
+                                            "Com_min.pdb", "Com_min_GB.out", "Rec_minGB.out",
+                                            "Rec_min.rst"};
+
+        for(std::string& name : filenames)
+        {
+            std::ifstream infile(name);
+            if(infile.good())
+            {
+                std::string buffer((std::istreambuf_iterator<char>(infile)),
+                                   std::istreambuf_iterator<char>());
+                infile.close();
+                n[recIDFile+name] = buffer;
+            }
+            else
+            {
+                std::cout << "File - " << name << " is not there." << std::endl;
+            }
+        }
+
+        ScopedTimer timer(cdtMeta.timing, "hdf5Write");
+        relay::io::hdf5_append(n, gbsaHDF5File);
+
+    }catch(conduit::Error &error){
+        cdtMeta.message= error.message();
+    }
+
+
+}
+
+void mmgbsa(CDTmeta& cdtMeta) {
+
+    JobTiming timing(cdtMeta.timing);
+    try{
+        if(cdtMeta.newapp) {
+            CDTgbsa::runNew(cdtMeta);
+        } else{
+            CDTgbsa::run(cdtMeta);
+        }
+        cdtMeta.message= "Finished!";
+        cdtMeta.error=true;
+
+    } catch (conduit::Error& e){
+        cdtMeta.message= e.what();
+        cdtMeta.error=false;
+    } catch (LBindException& e){
+        cdtMeta.message= e.what();
+        cdtMeta.error=false;
+    }catch (...){
+        cdtMeta.message= "Unknown error";
+        cdtMeta.error=false;
+    }
+
+}
+
+void mmgbsaPair(CDTmeta& cdtMeta, const std::vector<std::string>& poseIDs, std::vector<CDTmeta>& results) {
+
+    std::map<int, std::string> models;
+    std::map<int, double> scores;
+    PhaseTimes shared;
+    std::string error;
+    {
+        JobTiming timing(shared);
+        try{
+            CDTgbsa::loadPair(cdtMeta, models, scores);
+        } catch (conduit::Error& e){
+            error= e.what();
+        } catch (LBindException& e){
+            error= e.what();
+        }catch (...){
+            error= "Unknown error";
+        }
+    }
+
+    std::string pairKey=cdtMeta.key;
+    results.clear();
+    for(const std::string& poseID : poseIDs) {
+        results.push_back(cdtMeta);
+        CDTmeta& poseMeta=results.back();
+        poseMeta.key=pairKey+"/"+poseID;
+        poseMeta.poseID=poseID;
+        // The shared reads count for the first pose
+        if(results.size()==1) poseMeta.timing=shared;
+
+        std::string poseError=error;
+        if(poseError.empty() && !poseMeta.score_only) {
+            int pID=std::stoi(poseID.substr(1));
+            auto itr=models.find(pID);
+            if(itr==models.end()) {
+                poseError="No pose "+poseID+" in poses.pdbqt";
+            }else{
+                poseMeta.pose=itr->second;
+                poseMeta.dockscore=scores.count(pID)>0 ? scores[pID] : 0;
+            }
+        }
+
+        if(poseError.empty()) {
+            mmgbsa(poseMeta);
+        }else{
+            poseMeta.message=poseError;
+            poseMeta.error=false;
+            poseMeta.gbbind=0;
+            poseMeta.comGB=0;
+            poseMeta.recGB=0;
+            poseMeta.ligGB=0;
+        }
+
+        // Only the results are kept
+        poseMeta.recFiles.clear();
+        poseMeta.ligFiles.clear();
+        poseMeta.poses.clear();
+        poseMeta.pose.clear();
+    }
+}
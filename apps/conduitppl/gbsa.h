@@ -0,0 +1,23 @@
+//
+// MM/GBSA job of CDT4mmgbsa, shared with the CDTStream driver.
+//
+
+#ifndef CONVEYORLC_GBSA_H
+#define CONVEYORLC_GBSA_H
+
+#include <string>
+#include <vector>
+
+#include "MM/CDTgbsa.h"
+
+//! Run the GBSA calculation of one pose, cdtMeta.error is true on success.
+void mmgbsa(LBIND::CDTmeta& cdtMeta);
+
+//! Run the poses of the pair cdtMeta.key ("rec/lig") one after another, with the receptor,
+//! ligand and docking data read once. One CDTmeta per pose, in the order of poseIDs.
+void mmgbsaPair(LBIND::CDTmeta& cdtMeta, const std::vector<std::string>& poseIDs, std::vector<LBIND::CDTmeta>& results);
+
+//! Append the result of one pose to a gbsa_proc<rank>.hdf5.
+void toConduit(LBIND::CDTmeta& cdtMeta, std::string& gbsaHDF5File);
+
+#endif //CONVEYORLC_GBSA_H
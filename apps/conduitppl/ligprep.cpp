@@ -0,0 +1,433 @@
+//
+// Ligand preparation job of CDT2Ligand, shared with the CDTStream driver.
+//
+
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/serialization/string.hpp>
+
+#include <conduit.hpp>
+#include <conduit_relay.hpp>
+#include <conduit_relay_io_hdf5.hpp>
+
+#include "Parser/Sdf.h"
+#include "Parser/SdfIndex.h"
+#include "Parser/Pdb.h"
+#include "Parser/AmberPdb.h"
+#include "DataBase/ContentCache.h"
+#include "MM/Amber.h"
+#include "Parser/SanderOutput.h"
+#include "Structure/Sstrm.hpp"
+#include "Common/File.hpp"
+#include "Common/LBindException.h"
+#include "Common/Process.h"
+#include "Common/FileOps.h"
+#include "Common/ScopedTimer.h"
+#include "Common/Tokenize.hpp"
+
+#include "CDT2Ligand.h"
+
+using namespace conduit;
+
+namespace CDT2 {
+
+namespace {
+
+//! Files of a parameterized ligand, written to HDF5 and kept in the parameterization cache
+const std::vector<std::string> ligFiles={"LIG.prmtop", "LIG.lib", "LIG.inpcrd", "LIG_min.pdbqt", "LIG_min.pdb",
+                                         "ligand.mol2", "LIG_min.rst", "LIG_minGB.out", "ligand.frcmod"};
+
+//! Cache key of a ligand: the SDF connection table (counts line, atom and bond blocks with the blanks
+//! normalized, no title or properties), the total charge and everything else that changes the output.
+std::string paramKey(const JobInputData& jobInput, const std::string& charge){
+    std::stringstream key;
+    key << "ligprep-1 amber" << jobInput.ambVersion << " minimize=" << jobInput.minimizeFlg
+        << " score_only=" << jobInput.score_only << " intDiel=" << jobInput.intDiel
+        << " charge=" << charge << "\n";
+
+    std::istringstream sdf(jobInput.sdfBuffer);
+    std::string line;
+    // skip the header block: title, program and comment lines
+    for(int i=0; i<3; ++i) std::getline(sdf, line);
+    while(std::getline(sdf, line)){
+        if(line.compare(0, 6, "M  END")==0) break;
+        std::vector<std::string> fields;
+        tokenize(line, fields, " \t\r");
+        for(const std::string& f : fields) key << f << " ";
+        key << "\n";
+    }
+    return ContentCache::sha1(key.str());
+}
+
+}
+
+void setLigMeta(Node& n, JobOutData& jobOut){
+    n["lig/"+jobOut.ligID + "/status"]=jobOut.error;
+
+    std::string ligIDMeta ="lig/"+jobOut.ligID + "/meta";
+    n[ligIDMeta] = jobOut.ligID;
+
+    n[ligIDMeta + "/name"] = jobOut.ligName;
+    n[ligIDMeta + "/LigPath"] = jobOut.ligPath;
+    n[ligIDMeta + "/GBEN"] = jobOut.gbEn;
+    n[ligIDMeta + "/numAtoms"] = jobOut.numAtoms;
+    n[ligIDMeta + "/numTors"] = jobOut.numTors;
+    n[ligIDMeta + "/Mesg"] = jobOut.message;
+
+    for(const auto& t : jobOut.timing.phases()){
+        n[ligIDMeta + "/timing/" + t.first] = t.second;
+    }
+}
+
+bool toConduit(JobOutData& jobOut, std::string& ligCdtFile, Node& n){
+
+    try {
+
+        setLigMeta(n, jobOut);
+
+        std::string ligIDFile ="lig/"+jobOut.ligID+ "/file/";
+
+        std::cout << "CONDUIT: " << jobOut.ligPath << std::endl;
+
+        for(const std::string& name : ligFiles)
+        {
+            std::string filename=jobOut.ligPath+"/"+name;
+            std::ifstream infile(filename);
+            if(infile.good())
+            {
+                std::string buffer((std::istreambuf_iterator<char>(infile)),
+                                   std::istreambuf_iterator<char>());
+                infile.close();
+                n[ligIDFile+name] = buffer;
+            }
+            else
+            {
+                std::cout << "File - " << filename << " is not there." << std::endl;
+            }
+        }
+
+        ScopedTimer timer(jobOut.timing, "hdf5Write");
+        relay::io::hdf5_append(n, ligCdtFile);
+
+    }catch(conduit::Error &error){
+        jobOut.message= error.message();
+        return false;
+    }
+
+    return true;
+}
+
+bool toConduit(JobOutData& jobOut, std::string& ligCdtFile){
+    Node n;
+    return toConduit(jobOut, ligCdtFile, n);
+}
+
+//! Index entry in ligand.hdf5 for a ligand whose files are in a worker shard
+void toIndex(JobOutData& jobOut, std::string& ligCdtFile, Node& n){
+
+    try {
+        setLigMeta(n, jobOut);
+        if(!jobOut.ligShard.empty()) {
+            n["lig/" + jobOut.ligID + "/meta/shard"] = jobOut.ligShard;
+        }
+        relay::io::hdf5_append(n, ligCdtFile);
+
+    }catch(conduit::Error &error){
+        std::cout << "Index ligand " << jobOut.ligID << " fails: " << error.message() << std::endl;
+    }
+}
+
+//! Worker side: write the ligand to its own shard and clean up the ligand directory
+void toShard(JobInputData& jobInput, JobOutData& jobOut, std::string& shardRel, std::string& shardFile,
+             std::string& localDir, bool useLocalDir){
+
+    jobOut.ligShard=shardRel;
+    if(!toConduit(jobOut, shardFile)){
+        jobOut.error=false;
+        jobOut.ligShard="";
+        return;
+    }
+
+    //! Keep the directory of failed ligand for inspection
+    if(!jobOut.error) return;
+
+    if(useLocalDir || !jobInput.keep) {
+        std::string subDir=localDir+"/scratch/lig/"+jobOut.ligID;
+        try {
+            removeAll(subDir);
+        }catch (LBindException& e){
+            std::cout << e.what() << std::endl;
+        }
+    }
+}
+
+void rmLigDir(JobOutData& jobOut)
+{
+    std::cout << "rmLigDir: " << jobOut.ligPath << std::endl;
+    removeAll(jobOut.ligPath);
+}
+
+void preLigands(JobInputData& jobInput, JobOutData& jobOut, std::string& workDir, std::string& targetDir, bool useLocalDir) {
+
+    JobTiming timing(jobOut.timing);
+    try{
+        jobOut.ligID=jobInput.dirBuffer;
+        jobOut.message="Finished!";
+
+        std::string subDir=workDir+"/scratch/lig/"+jobOut.ligID;
+        std::string tgtDir=targetDir+"/scratch/lig/"+jobOut.ligID;
+        jobOut.ligPath=subDir;
+
+        jobOut.gbEn=0.0;        
+        jobOut.numAtoms=0;
+        jobOut.numTors=0;
+        std::string sdfPath=subDir+"/ligand.sdf";
+
+        if(jobInput.sdfBuffer.empty()){
+            ScopedTimer readTimer("sdfRead");
+            jobInput.sdfBuffer=SdfIndex::read(jobInput.sdfFile, jobInput.sdfOffset, jobInput.sdfLength);
+        }
+
+        makeDir(subDir);
+        std::string errMesg;
+        
+        std::ofstream outFile;
+        try {
+            outFile.open(sdfPath.c_str());
+        }
+        catch(...){
+            std::cout << "preLigands >> Cannot open file" << sdfPath << std::endl;
+        }
+
+        outFile <<jobInput.sdfBuffer;
+        outFile.close();     
+
+        if(!fileExist(sdfPath)){
+            std::string message=sdfPath+" does not exist.";
+            throw LBindException(message);
+        }
+
+        chdir(subDir.c_str());
+
+        std::string sdfFile="ligand.sdf";
+        std::string pdb1File="ligand.pdb";
+
+        errMesg="obabel converting SDF to PDB fails";
+        runProcess({"obabel", "-isdf", sdfFile, "-opdb", "-O", pdb1File}, errMesg, redirectOut("log", false, true));
+
+        std::string pdbFile="ligrn.pdb";
+        std::string tmpFile="ligstrp.pdb";
+
+        boost::scoped_ptr<Pdb> pPdb(new Pdb());   
+
+        //! Rename the atom name.
+        pPdb->renameAtom(pdb1File, pdbFile);
+
+        pPdb->strip(pdbFile, tmpFile);
+
+        boost::scoped_ptr<Sdf> pSdf(new Sdf());
+        if(jobInput.cmpName=="NoName"){
+            jobOut.ligName=pSdf->getTitle(sdfFile);
+        }else{
+            jobOut.ligName=pSdf->getInfo(sdfFile, jobInput.cmpName);
+        }
+
+        //! Ligands parameterized before, here or by another rank, are copied from the cache
+        std::string cacheKey;
+        bool cached=false;
+        if(!jobInput.paramCache.empty()){
+            cacheKey=paramKey(jobInput, pSdf->getInfo(sdfFile, "TOTAL_CHARGE"));
+            std::string info;
+            if(ContentCache(jobInput.paramCache).fetch(cacheKey, subDir, info)){
+                cached=true;
+                jobOut.gbEn=Sstrm<double, std::string>(info);
+                std::cout << "Parameterization cache hit: " << cacheKey << std::endl;
+            }
+        }
+
+        if(!cached){
+            if(jobInput.minimizeFlg) {
+                //! Get ligand charge from SDF file.
+                std::string keyword="TOTAL_CHARGE";
+
+                std::string info=pSdf->getInfo(sdfFile, keyword);
+
+                std::cout << "Charge:" << info << std::endl;
+                int charge=Sstrm<int, std::string>(info);
+                std::string chargeStr=Sstrm<std::string,int>(charge);
+
+                //! Start antechamber calculation
+                std::string output="ligand.mol2";
+                std::string options=" -c bcc -nc "+ chargeStr;
+
+                boost::scoped_ptr<Amber> pAmber(new Amber(jobInput.ambVersion));
+                pAmber->antechamber(tmpFile, output, options);
+
+                {
+                    if(!fileExist(output)){
+                        std::string message="ligand.mol2 does not exist.";
+                        throw LBindException(message);
+                    }
+
+                    if(fileEmpty(output)){
+                        std::string message="ligand.mol2 is empty.";
+                        throw LBindException(message);
+                    }
+                }
+
+                if (jobInput.ambVersion == 16) {
+                    pAmber->parmchk2(output);
+                }else {
+                    pAmber->parmchk(output); // parmchk is deprecated from AMBER16
+                }
+
+                //! leap to obtain forcefield for ligand
+                std::string ligName="LIG";
+                std::string tleapFile="leap.in";
+
+                pAmber->tleapInput(output,ligName,tleapFile, subDir);
+                pAmber->tleap(tleapFile);
+
+                std::string checkFName="LIG.prmtop";
+                {
+                    if(!fileExist(checkFName)){
+                        std::string message="LIG.prmtop does not exist.";
+                        throw LBindException(message);
+                    }
+
+                    if(fileEmpty(checkFName)){
+                        std::string message="LIG.prmtop is empty.";
+                        throw LBindException(message);
+                    }
+                }
+
+                if(jobInput.score_only){
+                    amberToPdb("LIG.prmtop", "LIG.inpcrd", "LIG_minTmp.pdb");
+                }else {
+                    //! GB energy minimization
+                    std::string minFName = "LIG_minGB.in";
+                    {
+                        std::ofstream minFile;
+                        try {
+                            minFile.open(minFName.c_str());
+                        }
+                        catch (...) {
+                            std::string mesg = "mmpbsa::receptor()\n\t Cannot open min file: " + minFName;
+                            throw LBindException(mesg);
+                        }
+
+                        minFile << "title..\n"
+                                << "&cntrl\n"
+                                << "  imin   = 1,\n"
+                                << "  ntmin   = 1,\n"
+                                << "  maxcyc = 2000,\n"
+                                << "  ncyc   = 1000,\n"
+                                << "  ntpr   = 200,\n"
+                                << "  ntb    = 0,\n"
+                                << "  igb    = 5,\n"
+                                << "  gbsa   = 1,\n"
+                                << "  intdiel= " << jobInput.intDiel << ",\n"
+                                << "  cut    = 50,\n"
+                                << " /\n" << std::endl;
+
+                        minFile.close();
+                    }
+
+                    std::string sander = (jobInput.ambVersion == 13) ? "sander13" : "sander";
+                    errMesg = "sander ligand minimization fails";
+                    runProcess({sander, "-O", "-i", "LIG_minGB.in", "-o", "LIG_minGB.out", "-p", "LIG.prmtop", "-c", "LIG.inpcrd",
+                                "-ref", "LIG.inpcrd", "-x", "LIG.mdcrd", "-r", "LIG_min.rst"}, errMesg, redirectOut("log", false, true));
+                    boost::scoped_ptr<SanderOutput> pSanderOutput(new SanderOutput());
+                    std::string sanderOut = "LIG_minGB.out";
+                    double ligGBen = 0;
+                    bool success = pSanderOutput->getEnergy(sanderOut, ligGBen);
+                    jobOut.gbEn = ligGBen;
+
+                    if (!success) {
+                        std::string message = "Ligand GB minimization fails.";
+                        throw LBindException(message);
+                    }
+
+                    //! Use the PDB file of the minimized topology for PDBQT.
+                    amberToPdb("LIG.prmtop", "LIG_min.rst", "LIG_minTmp.pdb");
+                }
+
+            }else{
+
+                symLink("ligstrp.pdb", "LIG_minTmp.pdb", true);
+
+            }
+
+            std::string checkFName = "LIG_minTmp.pdb";
+            if (!fileExist(checkFName)) {
+                std::string message = "LIG_min.pdb minimization PDB file does not exist.";
+                throw LBindException(message);
+            }
+
+            pPdb->fixElement("LIG_minTmp.pdb", "LIG_min.pdb");
+
+            //! Get DPBQT file for ligand from minimized structure.
+            //cmd="prepare_ligand4.py -l  LIG_min.pdb >> log";
+            errMesg="obabel LIG_min.pdbqt fails";
+            runProcess({"obabel", "-ipdb", "LIG_min.pdb", "-xn", "-opdbqt"}, errMesg, redirectOut("LIG_min.pdbqt"));
+
+            checkFName="LIG_min.pdbqt";
+            {
+                if(!fileExist(checkFName)){
+                    std::string message="LIG_min.pdbqt PDBQT file does not exist.";
+                    throw LBindException(message);        
+                }
+
+                if(fileEmpty(checkFName)){
+                    std::string message="LIG_min.pdbqt is empty.";
+                    throw LBindException(message);              
+                }
+            }
+        
+            //! fix the Br element type
+            pPdb->fixBrPdbqt("LIG_min.pdbqt");
+        }
+
+        pPdb->pdbqtSize("LIG_min.pdbqt", jobOut.numAtoms, jobOut.numTors);
+
+        if(!cached && !jobInput.paramCache.empty()){
+            std::stringstream info;
+            info.precision(17);
+            info << jobOut.gbEn;
+            ContentCache(jobInput.paramCache).store(cacheKey, ligFiles, subDir, info.str());
+        }
+
+        //! Sharded output is read from the local directory by the worker itself
+        if(useLocalDir && (!jobInput.shard || jobInput.keep)) {
+            makeDir(tgtDir);
+
+            for(std::string savedFile : ligFiles){
+                if(fileExist(savedFile)) copyFile(savedFile, tgtDir);
+            }
+            std::cout << "BEFORE: " << jobOut.ligPath << std::endl;
+            jobOut.ligPath=tgtDir;
+	    std::cout << "AFTER : " << jobOut.ligPath << std::endl;
+        }
+        chdir(workDir.c_str());
+
+        if(useLocalDir && !jobInput.shard) {
+            removeAll(subDir);
+        }
+
+    } catch (LBindException& e){
+        jobOut.message= e.what();
+        jobOut.error=false;
+        return;
+    }
+
+    jobOut.error=true;
+    return;
+}
+
+
+}//namespace CDT2
@@ -6,6 +6,8 @@
  */
 
 #include "mainProcedure.h"
+#include "Common/Affinity.h"
+#include "Common/ScopedTimer.h"
 
 // which copy
 #include <iostream>
@@ -120,6 +122,36 @@ std::string vina_remark(fl e, fl lb, fl ub) {
     return remark.str();
 }
 
+DockMode make_mode(model& m, const precalculate& prec, const igrid& ig, const conf& c, fl e, fl lb, fl ub) {
+    const vec authentic_v(1000, 1000, 1000);
+    DockMode mode;
+    mode.energy = e;
+    mode.rmsdLB = lb;
+    mode.rmsdUB = ub;
+    mode.intra = m.eval_intramolecular(prec, authentic_v, c);
+    mode.inter = m.eval(prec, ig, authentic_v, c) - mode.intra; // sets c
+    mode.coords = m.get_heavy_atom_movable_coords();
+    return mode;
+}
+
+void write_mode_table(const DockResult& result, std::stringstream& log) {
+    log.setf(std::ios::fixed, std::ios::floatfield);
+    log.setf(std::ios::showpoint);
+    log << '\n';
+    log << "mode |   affinity | dist from best mode\n";
+    log << "     | (kcal/mol) | rmsd l.b.| rmsd u.b.\n";
+    log << "-----+------------+----------+----------\n";
+
+    VINA_FOR_IN(i, result.modes) {
+        const DockMode& mode = result.modes[i];
+        log << std::setw(4) << i + 1
+                << "    " << std::setw(9) << std::setprecision(1) << mode.energy
+                << "  " << std::setw(9) << std::setprecision(3) << mode.rmsdLB
+                << "  " << std::setw(9) << std::setprecision(3) << mode.rmsdUB;
+        log << std::endl;
+    }
+}
+
 output_container remove_redundant(const output_container& in, fl min_rmsd) {
     output_container tmp;
     VINA_FOR_IN(i, in)
@@ -131,7 +163,7 @@ void do_search(model& m, const boost::optional<model>& ref, const scoring_functi
         std::stringstream& out_name,
         const vec& corner1, const vec& corner2,
         const parallel_mc& par, fl energy_range, fl in_min_rmsd, sz num_modes,
-        int seed, int verbosity, bool score_only, bool local_only, std::stringstream& log, const terms& t, const flv& weights, sz& how_many) {
+        int seed, int verbosity, bool score_only, bool local_only, std::stringstream& log, const terms& t, const flv& weights, DockResult& result) {
     conf_size s = m.get_size();
     conf c = m.get_initial_conf();
     fl e = max_fl;
@@ -161,7 +193,7 @@ void do_search(model& m, const boost::optional<model>& ref, const scoring_functi
             log << "WARNING: affinity. Consider reporting this as a bug:\n";
             log << "WARNING: http://vina.scripps.edu/manual.html#bugs\n";
         }
-        how_many=1; // assgin 1 pose for the score_only
+        result.modes.push_back(make_mode(m, prec, nnc, c, e, 0, 0)); // 1 pose for the score_only
     } else if (local_only) {
         output_type out(c, e);
         doing(verbosity, "Performing local search", log);
@@ -174,6 +206,7 @@ void do_search(model& m, const boost::optional<model>& ref, const scoring_functi
         log << std::endl;
         if (!nc.within(m))
             log << "WARNING: not all movable atoms are within the search space\n";
+        result.modes.push_back(make_mode(m, prec, nc, out.c, e, 0, 0));
 
         doing(verbosity, "Writing output", log);
         output_container out_cont;
@@ -187,10 +220,13 @@ void do_search(model& m, const boost::optional<model>& ref, const scoring_functi
         log << std::endl;
         output_container out_cont;
         doing(verbosity, "Performing search", log);
+        LBIND::ScopedTimer searchTimer("mcSearch");
         par(m, out_cont, prec, ig, prec_widened, ig_widened, corner1, corner2, generator);
+        searchTimer.stop();
         done(verbosity, log);
 
         doing(verbosity, "Refining results", log);
+        LBIND::ScopedTimer refineTimer("refinement");
         VINA_FOR_IN(i, out_cont)
         refine_structure(m, prec, nc, out_cont[i], authentic_v, par.mc.ssd_par.evals);
 
@@ -207,41 +243,35 @@ void do_search(model& m, const boost::optional<model>& ref, const scoring_functi
         //std::cout << "DEBUG: number of all possible models with redundant = " << out_cont.size() << std::endl;
         const fl out_min_rmsd = in_min_rmsd;
         out_cont = remove_redundant(out_cont, out_min_rmsd);
+        refineTimer.stop();
 
         done(verbosity, log);
 
-        log.setf(std::ios::fixed, std::ios::floatfield);
-        log.setf(std::ios::showpoint);
-        log << '\n';
-        log << "mode |   affinity | dist from best mode\n";
-        log << "     | (kcal/mol) | rmsd l.b.| rmsd u.b.\n";
-        log << "-----+------------+----------+----------\n";
-
         model best_mode_model = m;
         if (!out_cont.empty())
             best_mode_model.set(out_cont.front().c);
         //std::cout << "DEBUG: number of all possible models = " << out_cont.size() << std::endl;
 
-        how_many = 0;
+        sz how_many = 0;
         std::vector<std::string> remarks;
 
         VINA_FOR_IN(i, out_cont) {
             if (how_many >= num_modes || !not_max(out_cont[i].e) || out_cont[i].e > out_cont[0].e + energy_range) break; // check energy_range sanity FIXME
             ++how_many;
-            log << std::setw(4) << i + 1
-                    << "    " << std::setw(9) << std::setprecision(1) << out_cont[i].e; // intermolecular_energies[i];
             m.set(out_cont[i].c);
             const model& r = ref ? ref.get() : best_mode_model;
             const fl lb = m.rmsd_lower_bound(r);
             const fl ub = m.rmsd_upper_bound(r);
-            log << "  " << std::setw(9) << std::setprecision(3) << lb
-                    << "  " << std::setw(9) << std::setprecision(3) << ub; // FIXME need user-readable error messages in case of failures
 
+            result.modes.push_back(make_mode(m, prec, nc, out_cont[i].c, out_cont[i].e, lb, ub));
             remarks.push_back(vina_remark(out_cont[i].e, lb, ub));
-            log << std::endl;
         }
+        write_mode_table(result, log);
+
         doing(verbosity, "Writing output", log);
+        LBIND::ScopedTimer outputTimer("output");
         write_all_output(m, out_cont, how_many, out_name, remarks);
+        outputTimer.stop();
         done(verbosity, log);
 
         if (how_many < 1) {
@@ -255,9 +285,9 @@ void do_search(model& m, const boost::optional<model>& ref, const scoring_functi
 void main_procedure(model& m, const boost::optional<model>& ref, // m is non-const (FIXME?)
         std::stringstream& out_name,
         bool score_only, bool local_only, bool randomize_only, bool no_cache,
-        const grid_dims& gd, int exhaustiveness,
+        const grid_dims& gd, int exhaustiveness, fl step_scale,
         const flv& weights,
-        int cpu, int seed, int verbosity, sz num_modes, fl energy_range, fl in_min_rmsd, std::stringstream& log, sz& how_many) {
+        int cpu, bool pin_threads, int seed, int verbosity, sz num_modes, fl energy_range, fl in_min_rmsd, std::stringstream& log, DockResult& result) {
 
     doing(verbosity, "Setting up the scoring function", log);
 
@@ -279,6 +309,7 @@ void main_procedure(model& m, const boost::optional<model>& ref, // m is non-con
     parallel_mc par;
     sz heuristic = m.num_movable_atoms() + 10 * m.get_size().num_degrees_of_freedom();
     par.mc.num_steps = unsigned(70 * 3 * (50 + heuristic) / 2); // 2 * 70 -> 8 * 20 // FIXME
+    par.mc.num_steps = std::max(1u, unsigned(step_scale * par.mc.num_steps));
     par.mc.ssd_par.evals = unsigned((25 + m.num_movable_atoms()) / 3);
     //par.mc.min_rmsd = 1.0;
     par.mc.min_rmsd = in_min_rmsd;
@@ -291,6 +322,8 @@ void main_procedure(model& m, const boost::optional<model>& ref, // m is non-con
     par.mc.hunt_cap = vec(10, 10, 10);
     par.num_tasks = exhaustiveness;
     par.num_threads = cpu;
+    if (pin_threads)
+        par.cpus = LBIND::getAffinityCpus();
     par.display_progress = (verbosity > 1);
 
     const fl slope = 1e6; // FIXME: too large? used to be 100
@@ -305,18 +338,21 @@ void main_procedure(model& m, const boost::optional<model>& ref, // m is non-con
                     out_name,
                     corner1, corner2,
                     par, energy_range, in_min_rmsd, num_modes,
-                    seed, verbosity, score_only, local_only, log, t, weights, how_many);
+                    seed, verbosity, score_only, local_only, log, t, weights, result);
         } else {
             bool cache_needed = !(score_only || randomize_only || local_only);
             if (cache_needed) doing(verbosity, "Analyzing the binding site", log);
             cache c("scoring_function_version001", gd, slope, atom_type::XS);
-            if (cache_needed) c.populate(m, prec, m.get_movable_atom_types(prec.atom_typing_used()));
+            if (cache_needed) {
+                LBIND::ScopedTimer gridTimer("gridPopulate");
+                c.populate(m, prec, m.get_movable_atom_types(prec.atom_typing_used()));
+            }
             if (cache_needed) done(verbosity, log);
             do_search(m, ref, wt, prec, c, prec, c, nc,
                     out_name,
                     corner1, corner2,
                     par, energy_range, in_min_rmsd, num_modes,
-                    seed, verbosity, score_only, local_only, log, t, weights, how_many);
+                    seed, verbosity, score_only, local_only, log, t, weights, result);
         }
     }
 }
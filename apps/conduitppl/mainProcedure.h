@@ -34,6 +34,24 @@
 #include "VinaLC/tokenize.h"
 
 
+//! One docking mode (pose) at full precision.
+struct DockMode {
+    fl energy;      // affinity (kcal/mol)
+    fl rmsdLB;      // rmsd lower bound from the best mode
+    fl rmsdUB;      // rmsd upper bound from the best mode
+    fl intra;       // intramolecular energy of the pose
+    fl inter;       // intermolecular energy of the pose
+    vecv coords;    // heavy atom movable coordinates
+};
+
+//! Result of main_procedure, modes are sorted by energy.
+struct DockResult {
+    std::vector<DockMode> modes;
+};
+
+//! Render the mode table of the result in the vina log format.
+void write_mode_table(const DockResult& result, std::stringstream& log);
+
 void doing(int verbosity, const std::string& str, std::stringstream& log);
 void done(int verbosity, std::stringstream& log);
 
@@ -48,9 +66,9 @@ model parse_bundle(const boost::optional<std::string>& rigid_name_opt,
 void main_procedure(model& m, const boost::optional<model>& ref, // m is non-const (FIXME?)
         std::stringstream& out_name,
         bool score_only, bool local_only, bool randomize_only, bool no_cache,
-        const grid_dims& gd, int exhaustiveness,
+        const grid_dims& gd, int exhaustiveness, fl step_scale,
         const flv& weights,
-        int cpu, int seed, int verbosity, sz num_modes, fl energy_range, fl in_min_rmsd, std::stringstream& log, sz& how_many);
+        int cpu, bool pin_threads, int seed, int verbosity, sz num_modes, fl energy_range, fl in_min_rmsd, std::stringstream& log, DockResult& result);
 
 struct usage_error : public std::runtime_error {
 
@@ -296,6 +296,13 @@ Thank you!\n";
                 ("score_only", bool_switch(&jobInput.score_only)->default_value(false), "score only and not perform pose search")
                 ("local_only",     bool_switch(&jobInput.local_only)->default_value(false), "do local search only")
                 ("randomize_only", bool_switch(&jobInput.randomize_only)->default_value(false), "randomize input, attempting to avoid clashes")
+                ("threads-per-rank", value<int>(&jobInput.cpu)->default_value(0), "docking threads per MPI rank (default 0: the number of CPUs the rank is bound to)")
+                ("pin-threads", bool_switch(&jobInput.pinThreads)->default_value(false), "pin docking threads to the CPUs the rank is bound to")
+                ("pass1-exhaustiveness", value<int>(&jobInput.pass1Exhaustiveness)->default_value(0), "exhaustiveness of a screening pass before full docking (default 0: single pass)")
+                ("pass1-steps", value<double>(&jobInput.pass1Steps)->default_value(0.25), "fraction of the Monte Carlo steps in the screening pass (default 0.25)")
+                ("pass2-top", value<double>(&jobInput.pass2Top)->default_value(10.0), "percent of the screened pairs re-docked at full settings (default 10)")
+                ("pass2-cutoff", value<double>(&jobInput.pass2Cutoff), "re-dock the screened pairs scoring below this value instead of the top percent")
+                ("resultCache", value<std::string>(&jobInput.resultCache)->default_value(""), "Shared directory caching the docking results by their inputs (default off). Without --seed the seed is not part of the key: any cached result of the same inputs is reused, give --seed or --randomize to sample new poses")
                 ;
         options_description info("Information (optional)");
         info.add_options()
@@ -355,10 +362,22 @@ Thank you!\n";
             jobInput.comFile="";
         }
         
-        if (jobInput.cpu < 1)
-            jobInput.cpu = 1;
+        if (jobInput.cpu < 0)
+            jobInput.cpu = 0;
+        jobInput.screening = false;
+        jobInput.stepScale = 1.0;
+        jobInput.usePass2Cutoff = (vm.count("pass2-cutoff") > 0);
+        if (jobInput.pass1Exhaustiveness < 0)
+            throw usage_error("pass1-exhaustiveness must be 0 or greater");
+        if (jobInput.pass1Steps <= 0 || jobInput.pass1Steps > 1)
+            throw usage_error("pass1-steps must be in (0, 1]");
+        if (jobInput.pass2Top <= 0 || jobInput.pass2Top > 100)
+            throw usage_error("pass2-top must be in (0, 100]");
+        jobInput.explicitSeed = (vm.count("seed") > 0);
         if (vm.count("seed") == 0)
             jobInput.seed = auto_seed();
+        if (!jobInput.resultCache.empty())
+            jobInput.resultCache = boost::filesystem::absolute(jobInput.resultCache).string();
         if (jobInput.exhaustiveness < 1)
             throw usage_error("exhaustiveness must be 1 or greater");
         if (jobInput.num_modes < 1)
@@ -21,6 +21,9 @@ int mpiParser(int argc, char* argv[],
         std::vector<std::string>& fleList,
         JobInputData& jobInput);
 
+//! Receptor IDs in the receptor HDF5 file that were prepared successfully.
+void saveRec(std::string& fileName, std::vector<std::string>& recList);
+
 #endif
 #endif	/* MPIPARSER_H */
 
@@ -23,7 +23,9 @@
 #include "Structure/Atom.h"
 #include "Common/LBindException.h"
 #include "Common/Tokenize.hpp"
-#include "Common/Command.hpp"
+#include "Common/Process.h"
+#include "Common/FileOps.h"
+#include "MM/Amber.h"
 #include "BackBone/Surface.h"
 #include "BackBone/Grid.h"
 #include "Structure/ParmContainer.h"
@@ -351,7 +353,6 @@ void checkPoint(std::string& checkfile, JobOutData& jobOut){
 
 void minimization(JobInputData& jobInput, JobOutData& jobOut, std::string& checkFName, std::string& recType, std::string& libDir) {
     std::string tleapFName = recType + "_leap.in";
-    std::string cmd = "";
     std::string errMesg = "";
 
     std::vector<std::vector<int> > ssList;
@@ -415,10 +416,8 @@ void minimization(JobInputData& jobInput, JobOutData& jobOut, std::string& check
         tleapFile.close();
     }
 
-    cmd = "tleap -f " + tleapFName + " >& " + recType + "_leap.log";
-    //std::cout <<cmd <<std::endl;
     errMesg = "tleap creating receptor prmtop fails";
-    command(cmd, errMesg);
+    runProcess({"tleap", "-f", tleapFName}, errMesg, redirectOut(recType + "_leap.log", true));
 
     std::string minFName = recType + "_minGB.in";
     {
@@ -447,14 +446,10 @@ void minimization(JobInputData& jobInput, JobOutData& jobOut, std::string& check
                 << " /\n" << std::endl;
         minFile.close();
     }
-    if (jobInput.ambVersion == 13) {
-        cmd = "sander13 -O -i " + recType + "_minGB.in -o " + recType + "_minGB.out  -p " + recType + ".prmtop -c " + recType + ".inpcrd -ref " + recType + ".inpcrd -x " + recType + ".mdcrd -r " + recType + "_min.rst";
-    } else {
-        cmd = "sander -O -i " + recType + "_minGB.in -o " + recType + "_minGB.out  -p " + recType + ".prmtop -c " + recType + ".inpcrd -ref " + recType + ".inpcrd -x " + recType + ".mdcrd -r " + recType + "_min.rst";
-    }
-    //std::cout <<cmd <<std::endl;
+    std::string sander = (jobInput.ambVersion == 13) ? "sander13" : "sander";
     errMesg = "sander receptor minimization fails";
-    command(cmd, errMesg);
+    runProcess({sander, "-O", "-i", recType + "_minGB.in", "-o", recType + "_minGB.out", "-p", recType + ".prmtop",
+                "-c", recType + ".inpcrd", "-ref", recType + ".inpcrd", "-x", recType + ".mdcrd", "-r", recType + "_min.rst"}, errMesg);
 
     boost::scoped_ptr<SanderOutput> pSanderOutput(new SanderOutput());
     std::string sanderOut = recType + "_minGB.out";
@@ -467,15 +462,8 @@ void minimization(JobInputData& jobInput, JobOutData& jobOut, std::string& check
         throw LBindException(message);
     }
 
-    if (jobInput.ambVersion == 16) {
-        cmd = "ambpdb -p " + recType + ".prmtop -aatm -c " + recType + "_min.rst > " + recType + "_min_0.pdb";
-    } else {
-        cmd = "ambpdb -p " + recType + ".prmtop -aatm < " + recType + "_min.rst > " + recType + "_min_0.pdb";
-    }
-
-    //std::cout <<cmd <<std::endl;
     errMesg = "ambpdb converting rst to " + recType + "_min_0.pdb file fails";
-    command(cmd, errMesg);
+    ambpdb(jobInput.ambVersion, recType + ".prmtop", recType + "_min.rst", recType + "_min_0.pdb", true, errMesg);
 
     checkFName = recType + "_min_0.pdb";
     if (!fileExist(checkFName)) {
@@ -483,24 +471,12 @@ void minimization(JobInputData& jobInput, JobOutData& jobOut, std::string& check
         throw LBindException(message);
     }
 
-    cmd = "grep -v END " + recType + "_min_0.pdb > " + recType + "_min_orig.pdb ";
-    //std::cout <<cmd <<std::endl;
-    errMesg = "grep " + recType + "_min_0.pdb fails";
-    command(cmd, errMesg);
+    grepFile(recType + "_min_0.pdb", recType + "_min_orig.pdb", "END", true);
 
-    if (jobInput.ambVersion == 16) {
-        cmd = "ambpdb -p " + recType + ".prmtop -c " + recType + "_min.rst > " + recType + "_min_1.pdb";
-    } else {
-        cmd = "ambpdb -p " + recType + ".prmtop < " + recType + "_min.rst > " + recType + "_min_1.pdb";
-    }
-
-    //std::cout <<cmd <<std::endl;
     errMesg = "ambpdb converting rst to " + recType + "_min_1.pdb file fails";
-    command(cmd, errMesg);
+    ambpdb(jobInput.ambVersion, recType + ".prmtop", recType + "_min.rst", recType + "_min_1.pdb", false, errMesg);
 
-    cmd="ln -sf "+recType + "_min_orig.pdb Rec_min.pdb";
-    errMesg="ln Rec_min.pdb fails for"+recType + "_min_orig.pdb";
-    command(cmd, errMesg);  
+    symLink(recType + "_min_orig.pdb", "Rec_min.pdb", true);
 }
 
 bool preReceptor(JobInputData& jobInput, JobOutData& jobOut, std::string& workDir, std::string& inputDir, std::string& dataPath){
@@ -535,13 +511,9 @@ bool preReceptor(JobInputData& jobInput, JobOutData& jobOut, std::string& workDi
         }
     
         std::string libDir=inputDir+"/lib/";
-        std::string cmd="mkdir -p "+recDir;
-        std::string errMesg="mkdir recDir fails";
-        command(cmd, errMesg);
-
-        cmd="cp "+jobOut.pdbFilePath+" "+recDir;
-        errMesg="cp receptor pdb file fails";
-        command(cmd,errMesg); 
+        makeDir(recDir);
+        copyFile(jobOut.pdbFilePath, recDir);
+        std::string errMesg;
 
         // cd to the rec directory to perform calculation
         chdir(recDir.c_str());
@@ -554,10 +526,8 @@ bool preReceptor(JobInputData& jobInput, JobOutData& jobOut, std::string& workDi
             boost::scoped_ptr<Pdb> pPdb(new Pdb() );
             pPdb->selectAForm(pdbFile, "rec_AForm.pdb");
              //! begin energy minimization of receptor 
-            cmd="reduce -Quiet -Trim  rec_AForm.pdb >& rec_noh.pdb ";
-            //std::cout <<cmd <<std::endl;
             errMesg="reduce converting rec_AForm.pdb fails";
-            command(cmd,errMesg); 
+            runProcess({"reduce", "-Quiet", "-Trim", "rec_AForm.pdb"}, errMesg, redirectOut("rec_noh.pdb", true));
 
             checkFName="rec_noh.pdb";
             if(!fileExist(checkFName)){
@@ -565,15 +535,15 @@ bool preReceptor(JobInputData& jobInput, JobOutData& jobOut, std::string& workDi
                 throw LBindException(message);       
             }     
 
+            std::string hetDict;
             if(jobInput.ambVersion==16 || jobInput.ambVersion==13){
-                cmd="reduce -Quiet -BUILD rec_noh.pdb -DB \""+dataPath+"/amber16_reduce_wwPDB_het_dict.txt\" >& rec_rd.pdb";
+                hetDict=dataPath+"/amber16_reduce_wwPDB_het_dict.txt";
             }else{
-                cmd="reduce -Quiet -BUILD rec_noh.pdb -DB \""+dataPath+"/amber10_reduce_wwPDB_het_dict.txt\" >& rec_rd.pdb";
+                hetDict=dataPath+"/amber10_reduce_wwPDB_het_dict.txt";
             }
 
-            //std::cout <<cmd <<std::endl;
             errMesg="reduce converting rec_noh.pdb fails";
-            command(cmd,errMesg); 
+            runProcess({"reduce", "-Quiet", "-BUILD", "rec_noh.pdb", "-DB", hetDict}, errMesg, redirectOut("rec_rd.pdb", true));
 
 
             checkFName="rec_rd.pdb";
@@ -597,12 +567,9 @@ bool preReceptor(JobInputData& jobInput, JobOutData& jobOut, std::string& workDi
             boost::scoped_ptr<Pdb> pPdb(new Pdb() );
             pPdb->standardlize(b4pdbqt, "std4pdbqt.pdb");
             //cmd="prepare_receptor4.py -r "+b4pdbqt+" -o "+jobOut.pdbid+".pdbqt";
-            cmd="obabel -ipdb std4pdbqt.pdb -opdbqt -xr -O temp.pdbqt >& pdbqt.log";
             errMesg="obabel converting std4pdbqt.pdb  temp.pdbqt to fails";
-            command(cmd,errMesg);  
-            cmd="grep -v REMARK temp.pdbqt > " + jobOut.pdbid+".pdbqt";
-            errMesg="grep to remove REMARK fails";
-            command(cmd,errMesg);  
+            runProcess({"obabel", "-ipdb", "std4pdbqt.pdb", "-opdbqt", "-xr", "-O", "temp.pdbqt"}, errMesg, redirectOut("pdbqt.log", true));
+            grepFile("temp.pdbqt", jobOut.pdbid+".pdbqt", "REMARK", true);
 
         }
 
@@ -23,7 +23,9 @@
 #include "Common/File.hpp"
 #include "Common/Tokenize.hpp"
 #include "Common/LBindException.h"
-#include "Common/Command.hpp"
+#include "Common/Process.h"
+#include "Common/FileOps.h"
+#include "MM/Amber.h"
 #include "XML/XMLHeader.hpp"
 
 #include "PPL2LigandPO.h"
@@ -228,9 +230,8 @@ bool preLigands(JobInputData& jobInput, JobOutData& jobOut, std::string& workDir
         jobOut.gbEn=0.0;        
         std::string sdfPath=subDir+"/ligand.sdf";
 
-        std::string cmd="mkdir -p "+subDir;
-        std::string errMesg="mkdir ligDir fails";
-        command(cmd, errMesg);
+        makeDir(subDir);
+        std::string errMesg;
         
         std::ofstream outFile;
         try {
@@ -254,10 +255,8 @@ bool preLigands(JobInputData& jobInput, JobOutData& jobOut, std::string& workDir
         std::string sdfFile="ligand.sdf";
         std::string pdb1File="ligand.pdb";
 
-        cmd="obabel -isdf " + sdfFile + " -opdb -O " +pdb1File +" >> log";
-        //std::cout << cmd << std::endl;
         errMesg="obabel converting SDF to PDB fails";
-        command(cmd, errMesg);
+        runProcess({"obabel", "-isdf", sdfFile, "-opdb", "-O", pdb1File}, errMesg, redirectOut("log", false, true));
 
         std::string pdbFile="ligrn.pdb";
         std::string tmpFile="ligstrp.pdb";
@@ -353,14 +352,10 @@ bool preLigands(JobInputData& jobInput, JobOutData& jobOut, std::string& workDir
             minFile.close();    
         }          
 
-        if(jobInput.ambVersion==13){
-            cmd="sander13  -O -i LIG_minGB.in -o LIG_minGB.out  -p LIG.prmtop -c LIG.inpcrd -ref LIG.inpcrd  -x LIG.mdcrd -r LIG_min.rst  >> log";
-        }else{
-            cmd="sander  -O -i LIG_minGB.in -o LIG_minGB.out  -p LIG.prmtop -c LIG.inpcrd -ref LIG.inpcrd  -x LIG.mdcrd -r LIG_min.rst  >> log";
-        }
-        //std::cout <<cmd <<std::endl;
+        std::string sander=(jobInput.ambVersion==13) ? "sander13" : "sander";
         errMesg="sander ligand minimization fails";
-        command(cmd, errMesg);
+        runProcess({sander, "-O", "-i", "LIG_minGB.in", "-o", "LIG_minGB.out", "-p", "LIG.prmtop", "-c", "LIG.inpcrd",
+                    "-ref", "LIG.inpcrd", "-x", "LIG.mdcrd", "-r", "LIG_min.rst"}, errMesg, redirectOut("log", false, true));
         boost::scoped_ptr<SanderOutput> pSanderOutput(new SanderOutput());
         std::string sanderOut="LIG_minGB.out";
         double ligGBen=0;
@@ -373,15 +368,8 @@ bool preLigands(JobInputData& jobInput, JobOutData& jobOut, std::string& workDir
         }
 
         //! Use ambpdb generated PDB file for PDBQT.
-        if(jobInput.ambVersion==16){
-            cmd="ambpdb -p LIG.prmtop -c LIG_min.rst > LIG_minTmp.pdb "; 
-        }else{
-            cmd="ambpdb -p LIG.prmtop < LIG_min.rst > LIG_minTmp.pdb ";
-        } 
-
-        //std::cout <<cmd <<std::endl;
         errMesg="ambpdb converting rst to pdb fails";
-        command(cmd, errMesg);   
+        ambpdb(jobInput.ambVersion, "LIG.prmtop", "LIG_min.rst", "LIG_minTmp.pdb", false, errMesg);
 
         checkFName="LIG_minTmp.pdb";
         if(!fileExist(checkFName)){
@@ -395,11 +383,8 @@ bool preLigands(JobInputData& jobInput, JobOutData& jobOut, std::string& workDir
 
         //! Get DPBQT file for ligand from minimized structure.
         //cmd="prepare_ligand4.py -l  LIG_min.pdb >> log";
-        cmd="obabel -ipdb LIG_min.pdb  -xn -opdbqt > LIG_min.pdbqt";
-        //std::cout << cmd << std::endl;
-        //errMesg="prepare_ligand4.py fails";
         errMesg="obabel LIG_min.pdbqt fails";
-        command(cmd, errMesg);
+        runProcess({"obabel", "-ipdb", "LIG_min.pdb", "-xn", "-opdbqt"}, errMesg, redirectOut("LIG_min.pdbqt"));
 
         checkFName="LIG_min.pdbqt";
         {
@@ -415,16 +400,12 @@ bool preLigands(JobInputData& jobInput, JobOutData& jobOut, std::string& workDir
         }
         
         //! fix the Br element type
-        cmd="sed -i '/Br.* LIG/{s! B ! Br!}' LIG_min.pdbqt";
-        //std::cout << cmd << std::endl;
-        errMesg="sed to fix Br fails";
-        command(cmd, errMesg);
+        pPdb->fixBrPdbqt("LIG_min.pdbqt");
 
-        //cmd="rm -f *.in divcon.pdb fort.7 leap.log mopac.pdb ligand.pdb ligrn.pdb ligstrp.pdb LIG_minTmp.pdb";
-        cmd="rm -f divcon.pdb fort.7 leap.log mopac.pdb ligand.pdb ligrn.pdb ligstrp.pdb LIG_minTmp.pdb";
-        //std::cout <<cmd <<std::endl; 
-        errMesg="rm remove intermediate files fails";
-        command(cmd, errMesg);
+        std::vector<std::string> tmpFiles={"divcon.pdb", "fort.7", "leap.log", "mopac.pdb", "ligand.pdb", "ligrn.pdb", "ligstrp.pdb", "LIG_minTmp.pdb"};
+        for(const std::string& tmpFile : tmpFiles){
+            removeAll(tmpFile);
+        }
 
     } catch (LBindException& e){
         jobOut.message= e.what();  
@@ -481,8 +462,7 @@ void splitSDF(POdata& podata, std::vector<std::string>& ligList, std::string& wo
             std::string dir=Sstrm<std::string, int>(count);
                 // ! Goto sub directory
             std::string subDir=workDir+"/scratch/lig/"+dir;   
-            std::string cmd="mkdir -p "+subDir;
-            system(cmd.c_str());  
+            makeDir(subDir);
 
             std::string outputFName=subDir+"/ligand.sdf";
             std::ofstream outFile;
@@ -18,7 +18,8 @@
 #include "Common/Tokenize.hpp"
 #include "Structure/Constants.h"
 #include "Common/File.hpp"
-#include "Common/Command.hpp"
+#include "Common/Process.h"
+#include "Common/FileOps.h"
 #include "Common/LBindException.h"
 #include "XML/XMLHeader.hpp"
 
@@ -197,10 +198,7 @@ bool getPoseCheckData(std::string& checkfile, PoseData& poseData) {
 }
 
 void removeDir(JobOutData& jobOut){
-    std::string cmd="rm -rf lig_" + jobOut.ligID;
-    std::string errMesg="rm exited abnormaly";
-    
-    command(cmd, errMesg);
+    removeAll("lig_" + jobOut.ligID);
     
     return;
 }
@@ -243,9 +241,8 @@ bool postprocess(JobInputData& jobInput, JobOutData& jobOut, std::string& workDi
 
         std::string ligDir = workDir + "/scratch/com/" + jobOut.recID + "/gbsa";
         chdir(ligDir.c_str());
-        std::string cmd = "tar -zcf lig_" + jobOut.ligID + ".tar.gz lig_" + jobOut.ligID;
         std::string errMesg="tar exited abnormaly";
-        command(cmd, errMesg);   
+        runProcess({"tar", "-zcf", "lig_" + jobOut.ligID + ".tar.gz", "lig_" + jobOut.ligID}, errMesg);
         
         std::string ligTarfile="lig_" + jobOut.ligID + ".tar.gz";
         if(!fileExist(ligTarfile)) throw LBindException(ligTarfile+" not exist");
@@ -45,7 +45,7 @@
 #include "VinaLC/weighted_terms.h"
 #include "VinaLC/current_weights.h"
 #include "VinaLC/quasi_newton.h"
-#include "Common/Command.hpp"
+#include "Common/FileOps.h"
 //#include "gzstream.h"
 //#include "tee.h"
 #include "VinaLC/coords.h" // add_to_output_container
@@ -100,9 +100,7 @@ int dockjob(JobInputData& jobInput, JobOutData& jobOut, std::string& workDir){
         bool score_only = false, local_only = false, randomize_only = false; // FIXME
 
         std::string dockDir = workDir + "/scratch/com/" + jobInput.recBuffer + "/dock/" + jobInput.ligBuffer;
-        std::string cmd = "mkdir -p " + dockDir;
-        std::string errMesg="mkdir dockDir fails";
-        LBIND::command(cmd, errMesg);
+        LBIND::makeDir(dockDir);
         // cd to the rec directory to performance calculation
         chdir(dockDir.c_str());
         
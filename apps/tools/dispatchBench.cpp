@@ -0,0 +1,278 @@
+//
+// dispatchBench: replay job times through the dispatcher of the pipeline apps.
+//
+// The jobs are stand-ins that sleep (or spin) for a recorded or synthetic
+// time, so dispatch policies can be compared in a small local MPI run
+// (mpirun -np 17 dispatchBench ...) instead of a campaign. Each policy runs
+// the same jobs through Parallel/Dispatcher.h and reports the makespan, its
+// lower bound, worker efficiency, how busy the root was, and the tail idle
+// time of the workers (end of the run minus the end of their last job).
+//
+//   fifo          flat dispatch, one job at a time, input order
+//   sticky        as fifo, jobs grouped by receptor
+//   lpt           as fifo, longest jobs first
+//   chunked       flat dispatch, workers keep --chunk jobs queued
+//   hierarchical  per-node sub-masters (--node-size fakes the nodes)
+//
+// --switch-cost adds time to a job whose receptor differs from the previous
+// job of the same worker, the cost of loading a receptor and its grids.
+//
+
+#include <cmath>
+#include <ctime>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/mpi.hpp>
+#include <boost/mpi/environment.hpp>
+#include <boost/mpi/communicator.hpp>
+#include <boost/serialization/vector.hpp>
+
+#include "Parallel/Dispatcher.h"
+#include "dispatchBenchPO.h"
+
+namespace mpi = boost::mpi;
+using namespace LBIND;
+
+struct BenchJob {
+    double seconds;
+    int receptor;
+
+    template<class Archive>
+    void serialize(Archive & ar, const unsigned int version){
+        ar & seconds;
+        ar & receptor;
+    }
+};
+
+//! What a rank did during one policy, gathered on the root.
+struct RankStats {
+    long jobs=0;
+    long switches=0;
+    double busy=0;
+    double lastEnd=0;       //!< end of the last job, from the start of the policy
+
+    template<class Archive>
+    void serialize(Archive & ar, const unsigned int version){
+        ar & jobs;
+        ar & switches;
+        ar & busy;
+        ar & lastEnd;
+    }
+};
+
+static double now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec+ts.tv_nsec*1.0e-9;
+}
+
+static void standIn(double seconds, bool spin){
+    if(seconds<=0) return;
+    if(spin){
+        double end=now()+seconds;
+        while(now()<end){}
+        return;
+    }
+    struct timespec ts;
+    ts.tv_sec=static_cast<time_t>(seconds);
+    ts.tv_nsec=static_cast<long>((seconds-ts.tv_sec)*1.0e9);
+    nanosleep(&ts, NULL);
+}
+
+static bool readDurations(const std::string& fileName, std::vector<BenchJob>& jobs){
+    std::ifstream in(fileName);
+    if(!in.good()) return false;
+
+    std::map<std::string, int> receptors;
+    std::string line;
+    while(std::getline(in, line)){
+        std::istringstream ss(line);
+        BenchJob job;
+        std::string rec;
+        if(!(ss >> job.seconds)) continue;
+        ss >> rec;
+        auto it=receptors.find(rec);
+        if(it==receptors.end()){
+            it=receptors.insert(std::make_pair(rec, static_cast<int>(receptors.size()))).first;
+        }
+        job.receptor=it->second;
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+static void makeDurations(const POdata& podata, std::vector<BenchJob>& jobs){
+    std::mt19937 gen(podata.seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::uniform_int_distribution<int> rec(0, podata.numReceptors-1);
+    double mu=std::log(podata.mean)-0.5*podata.sigma*podata.sigma;
+    std::lognormal_distribution<double> lognormal(mu, podata.sigma);
+    double shape=podata.sigma;
+    double xm=podata.mean*(shape-1)/shape;
+
+    for(int i=0; i<podata.numJobs; ++i){
+        BenchJob job;
+        if(podata.dist=="const"){
+            job.seconds=podata.mean;
+        }else if(podata.dist=="uniform"){
+            job.seconds=2*podata.mean*unit(gen);
+        }else if(podata.dist=="lognormal"){
+            job.seconds=lognormal(gen);
+        }else{
+            job.seconds=xm/std::pow(1.0-unit(gen), 1.0/shape);
+        }
+        job.receptor=rec(gen);
+        jobs.push_back(job);
+    }
+}
+
+int main(int argc, char** argv) {
+
+    mpi::environment env(argc, argv);
+    mpi::communicator world;
+
+    if (world.size() < 2) {
+        std::cerr << "Error: Total process less than 2" << std::endl;
+        return 1;
+    }
+
+    POdata podata;
+    bool ok=true;
+    std::vector<BenchJob> jobs;
+    if(world.rank()==0){
+        ok=dispatchBenchPO(argc, argv, podata);
+        if(ok && !podata.durationFile.empty()){
+            ok=readDurations(podata.durationFile, jobs);
+            if(!ok) std::cerr << "Cannot read " << podata.durationFile << std::endl;
+        }else if(ok){
+            makeDurations(podata, jobs);
+        }
+    }
+    broadcast(world, ok, 0);
+    if(!ok) return 1;
+
+    int numPolicies=podata.policies.size();
+    broadcast(world, numPolicies, 0);
+    broadcast(world, podata.scale, 0);
+    broadcast(world, podata.switchCost, 0);
+    broadcast(world, podata.spin, 0);
+
+    double total=0;
+    double longest=0;
+    for(BenchJob& job : jobs){
+        total+=job.seconds*podata.scale;
+        longest=std::max(longest, job.seconds*podata.scale);
+    }
+    if(world.rank()==0){
+        std::cout << "dispatchBench: " << jobs.size() << " jobs, " << total << " Sec. of stand-in work on "
+                  << world.size()-1 << " ranks" << std::endl;
+        std::cout << std::left << std::setw(14) << "policy" << std::right
+                  << std::setw(12) << "makespan" << std::setw(10) << "bound"
+                  << std::setw(12) << "efficiency" << std::setw(12) << "masterBusy"
+                  << std::setw(12) << "tailIdle" << std::setw(12) << "tailMax"
+                  << std::setw(10) << "switches" << std::endl;
+    }
+
+    for(int p=0; p<numPolicies; ++p){
+        std::string policy;
+        DispatchOptions opts;
+        if(world.rank()==0){
+            policy=podata.policies[p];
+        }
+        broadcast(world, policy, 0);
+        broadcast(world, podata.chunk, 0);
+        broadcast(world, podata.nodeSize, 0);
+
+        opts.hierarchical=(policy=="hierarchical");
+        opts.prefetch=(policy=="chunked") ? podata.chunk : 0;
+        if(policy=="hierarchical"){
+            opts.prefetch=1;
+            opts.nodeSize=podata.nodeSize;
+        }
+        opts.logEvery=1;
+
+        Dispatcher<BenchJob, int> dispatcher(world, opts);
+        RankStats stats;
+
+        world.barrier();
+        double start=now();
+
+        if(world.rank()==0){
+            std::vector<BenchJob> order(jobs);
+            if(policy=="sticky"){
+                std::stable_sort(order.begin(), order.end(),
+                                 [](const BenchJob& a, const BenchJob& b){ return a.receptor<b.receptor; });
+            }else if(policy=="lpt"){
+                orderByCost<BenchJob>(order, [](const BenchJob& job){ return job.seconds; });
+            }
+
+            size_t i=0;
+            dispatcher.serve([&](BenchJob& job){
+                if(i>=order.size()) return false;
+                job=order[i++];
+                return true;
+            }, [](int& out){}, order.size());
+        }else{
+            int lastReceptor=-1;
+            dispatcher.work([&](BenchJob& job, int& out){
+                double t=now();
+                double seconds=job.seconds;
+                if(job.receptor!=lastReceptor){
+                    if(lastReceptor>=0) ++stats.switches;
+                    seconds+=podata.switchCost;
+                    lastReceptor=job.receptor;
+                }
+                standIn(seconds*podata.scale, podata.spin);
+                out=0;
+                ++stats.jobs;
+                stats.lastEnd=now()-start;
+                stats.busy+=now()-t;
+            });
+        }
+
+        double makespan=now()-start;
+        broadcast(world, makespan, 0);
+
+        std::vector<RankStats> all;
+        gather(world, stats, all, 0);
+
+        if(world.rank()==0){
+            int numWorkers=0;
+            long switches=0;
+            double busy=0;
+            double tailSum=0;
+            double tailMax=0;
+            for(size_t r=1; r<all.size(); ++r){
+                //! Sub-masters run no jobs.
+                if(all[r].jobs==0) continue;
+                ++numWorkers;
+                switches+=all[r].switches;
+                busy+=all[r].busy;
+                double tail=std::max(0.0, makespan-all[r].lastEnd);
+                tailSum+=tail;
+                tailMax=std::max(tailMax, tail);
+            }
+            double bound=(numWorkers>0) ? std::max(total/numWorkers, longest) : 0;
+            double efficiency=(numWorkers>0 && makespan>0) ? busy/(makespan*numWorkers) : 0;
+            double master=(dispatcher.serveTime()>0) ? dispatcher.serveBusy()/dispatcher.serveTime() : 0;
+
+            std::cout << std::left << std::setw(14) << policy << std::right << std::fixed
+                      << std::setprecision(3)
+                      << std::setw(12) << makespan << std::setw(10) << bound
+                      << std::setw(12) << efficiency << std::setw(12) << master
+                      << std::setw(12) << ((numWorkers>0) ? tailSum/numWorkers : 0) << std::setw(12) << tailMax
+                      << std::setw(10) << switches << std::endl;
+            std::cout.unsetf(std::ios_base::floatfield);
+        }
+    }
+
+    return 0;
+}
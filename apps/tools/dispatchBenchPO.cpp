@@ -0,0 +1,82 @@
+//
+// Command line options of dispatchBench.
+//
+
+#include "dispatchBenchPO.h"
+
+#include <cstdlib>
+#include <iostream>
+
+#include <boost/program_options.hpp>
+
+#include "Common/Tokenize.hpp"
+
+using namespace boost::program_options;
+
+bool dispatchBenchPO(int argc, char** argv, POdata& podata) {
+
+    bool help=false;
+    std::string policies;
+
+    options_description inputs("Jobs:");
+    inputs.add_options()
+            ("durations", value<std::string>(&podata.durationFile), "recorded job times, one \"<seconds> [<receptor>]\" per line")
+            ("dist", value<std::string>(&podata.dist)->default_value("lognormal"), "synthetic job times: const, uniform, lognormal or pareto")
+            ("jobs", value<int>(&podata.numJobs)->default_value(2000), "number of synthetic jobs")
+            ("mean", value<double>(&podata.mean)->default_value(1.0), "mean synthetic job time (seconds)")
+            ("sigma", value<double>(&podata.sigma)->default_value(1.0), "lognormal sigma, or pareto shape (> 1)")
+            ("receptors", value<int>(&podata.numReceptors)->default_value(4), "receptors the synthetic jobs are spread over")
+            ("seed", value<unsigned>(&podata.seed)->default_value(1), "random seed of the synthetic jobs")
+            ;
+    options_description run("Run:");
+    run.add_options()
+            ("scale", value<double>(&podata.scale)->default_value(0.01), "stand-in job time = job time * scale")
+            ("switch-cost", value<double>(&podata.switchCost)->default_value(0.0), "job time (before scale) a worker adds when the receptor changes")
+            ("spin", bool_switch(&podata.spin)->default_value(false), "busy-wait instead of sleeping")
+            ("policies", value<std::string>(&policies)->default_value("fifo,sticky,lpt,chunked,hierarchical"), "comma-separated dispatch policies")
+            ("chunk", value<int>(&podata.chunk)->default_value(4), "jobs a worker keeps queued (chunked), jobs per request (hierarchical)")
+            ("node-size", value<int>(&podata.nodeSize)->default_value(0), "hierarchical: group the workers into nodes of this many ranks, 0 for the real nodes")
+            ("help", bool_switch(&help), "display usage summary")
+            ;
+    options_description desc;
+    desc.add(inputs).add(run);
+
+    try {
+        variables_map vm;
+        store(command_line_parser(argc, argv)
+                .options(desc)
+                .style(command_line_style::default_style ^ command_line_style::allow_guessing)
+                .run(),
+              vm);
+        notify(vm);
+    } catch (boost::program_options::error& e) {
+        std::cerr << "Command line parse error: " << e.what() << '\n' << "\nCorrect usage:\n" << desc << '\n';
+        return false;
+    }
+
+    if (help) {
+        std::cout << desc << '\n';
+        return false;
+    }
+
+    if (podata.dist!="const" && podata.dist!="uniform" && podata.dist!="lognormal" && podata.dist!="pareto") {
+        std::cerr << "Unknown distribution " << podata.dist << "\n\nCorrect usage:\n" << desc << '\n';
+        return false;
+    }
+    if (podata.dist=="pareto" && podata.sigma<=1.0) {
+        std::cerr << "The pareto shape (--sigma) must be larger than 1\n";
+        return false;
+    }
+    if (podata.numReceptors<1) podata.numReceptors=1;
+    if (podata.chunk<1) podata.chunk=1;
+
+    LBIND::tokenize(policies, podata.policies, ",");
+    for (const std::string& policy : podata.policies) {
+        if (policy!="fifo" && policy!="sticky" && policy!="lpt" && policy!="chunked" && policy!="hierarchical") {
+            std::cerr << "Unknown policy " << policy << "\n\nCorrect usage:\n" << desc << '\n';
+            return false;
+        }
+    }
+
+    return true;
+}
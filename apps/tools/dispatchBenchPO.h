@@ -0,0 +1,29 @@
+//
+// Command line options of dispatchBench.
+//
+
+#ifndef CONVEYORLC_DISPATCHBENCHPO_H
+#define CONVEYORLC_DISPATCHBENCHPO_H
+
+#include <string>
+#include <vector>
+
+struct POdata{
+    std::string durationFile;   // recorded job times: "<seconds> [<receptor>]" per line
+    std::string dist;           // synthetic: const, uniform, lognormal or pareto
+    int numJobs;
+    double mean;
+    double sigma;
+    int numReceptors;
+    double scale;               // stand-in job time = recorded time * scale
+    double switchCost;          // seconds a worker loses when the receptor changes
+    bool spin;
+    int chunk;
+    int nodeSize;
+    unsigned seed;
+    std::vector<std::string> policies;
+};
+
+bool dispatchBenchPO(int argc, char** argv, POdata& podata);
+
+#endif //CONVEYORLC_DISPATCHBENCHPO_H
@@ -0,0 +1,279 @@
+//
+// gbCheck: compare the in-process GB engine (MM/GBEnergy) with sander.
+//
+// Each argument is the output of a sander GB run (imin=1, igb=5, gbsa=1),
+// such as Com_minGB_2.out, Rec_minGB.out and Com_min_GB.out in the pose
+// directories of a CDT4mmgbsa run with sander and --keep. The topology, the
+// coordinates and the &cntrl settings are taken from the output itself. The
+// native energy is computed at the input coordinates of a single point
+// (maxcyc=0) and at the final coordinates (the restart file) of a
+// minimization, and compared term by term with the last energy block of the
+// output. gbCheck exits with 1 when a term differs by more than
+// tol + rel-tol * |sander value|.
+//
+// A minimization is also repeated with MM/GBMinimizer from the same input
+// coordinates, restraints and maxcyc, ncyc and drms. The two minimizers take
+// different paths, so only the final unrestrained energy is compared, within
+// min-tol; the RMSD of the final coordinates is printed for reference, and
+// the time to solution next to the CPU and wall times sander reports.
+//
+// With --merge, the receptor and ligand topologies are merged in-process
+// (Parser/PrmtopMerge.h) and compared with the complex topology tleap built
+// from them, as in the first pose of a receptor: the per-atom and
+// per-residue sections must be equal, as must the numbers of bonds, angles,
+// dihedrals and exclusions, and the energy terms of the two topologies at
+// the tleap coordinates must agree within tol.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Common/Affinity.h"
+#include "Common/LBindException.h"
+#include "MM/GBEnergy.h"
+#include "MM/GBMinimizer.h"
+#include "Parser/AmberMask.h"
+#include "Parser/Prmtop.h"
+#include "Parser/PrmtopMerge.h"
+#include "Parser/SanderOutput.h"
+#include "gbCheckPO.h"
+
+using namespace LBIND;
+
+//! sander term name -> native value
+static std::map<std::string, double> termMap(const GBTerms& terms){
+    std::map<std::string, double> m;
+    m["BOND"]=terms.bond;
+    m["ANGLE"]=terms.angle;
+    m["DIHED"]=terms.dihedral;
+    m["VDWAALS"]=terms.vdw;
+    m["EEL"]=terms.eel;
+    m["EGB"]=terms.egb;
+    m["1-4 VDW"]=terms.vdw14;
+    m["1-4 EEL"]=terms.eel14;
+    m["ESURF"]=terms.esurf;
+    return m;
+}
+
+static double setting(const std::map<std::string, std::string>& settings, const std::string& name, double value){
+    std::map<std::string, std::string>::const_iterator it=settings.find(name);
+    return (it==settings.end()) ? value : std::atof(it->second.c_str());
+}
+
+//! File of a sander output relative to the directory sander ran in, the one of the output.
+static std::string inDir(const std::string& outFile, const std::string& fileName){
+    size_t found=outFile.find_last_of("/");
+    if(fileName.empty() || fileName[0]=='/' || found==std::string::npos) return fileName;
+    return outFile.substr(0, found+1)+fileName;
+}
+
+//! Prints the terms side by side; false when one is off.
+static bool compareTerms(const std::map<std::string, double>& sander, const GBTerms& native, const POdata& podata){
+    bool pass=true;
+    std::map<std::string, double> nativeTerms=termMap(native);
+    for(const auto& term : nativeTerms){
+        std::map<std::string, double>::const_iterator ref=sander.find(term.first);
+        if(ref==sander.end()){
+            std::cout << "  " << std::setw(8) << term.first << "  missing in the sander output" << std::endl;
+            pass=false;
+            continue;
+        }
+        double diff=term.second-ref->second;
+        bool ok=std::fabs(diff)<=podata.tol+podata.relTol*std::fabs(ref->second);
+        std::cout << "  " << std::setw(8) << term.first << std::setw(16) << ref->second << std::setw(16) << term.second
+                  << std::setw(12) << diff << (ok ? "" : "  FAIL") << std::endl;
+        pass=pass && ok;
+    }
+    return pass;
+}
+
+static double rmsd(const std::vector<double>& a, const std::vector<double>& b){
+    double sum=0;
+    for(size_t i=0; i<a.size(); ++i) sum+=(a[i]-b[i])*(a[i]-b[i]);
+    return a.empty() ? 0 : std::sqrt(3*sum/a.size());
+}
+
+//! Repeats a sander minimization with MM/GBMinimizer; false when the final energies differ.
+static bool checkMinimizer(const std::string& outFile, const Prmtop& prmtop, const GBOptions& opts,
+                           std::map<std::string, std::string>& settings, std::map<std::string, std::string>& files,
+                           const std::map<std::string, double>& terms, const std::vector<double>& sanderXyz,
+                           const POdata& podata){
+    MinOptions minOpts;
+    minOpts.maxcyc=static_cast<int>(setting(settings, "maxcyc", 1));
+    minOpts.ncyc=static_cast<int>(setting(settings, "ncyc", 10));
+    minOpts.drms=setting(settings, "drms", 1.0e-4);
+
+    std::vector<double> xyz;
+    readAmberCoords(inDir(outFile, files["INPCRD"]), xyz);
+    GBMinimizer minimizer(prmtop);
+    double weight=setting(settings, "restraint_wt", 0);
+    if(setting(settings, "ntr", 0)==1 && weight>0){
+        std::vector<double> ref;
+        readAmberCoords(inDir(outFile, files.count("REFC") ? files["REFC"] : files["INPCRD"]), ref);
+        minimizer.restrain(amberMask(prmtop, settings["restraintmask"]), weight, ref);
+    }
+    auto start=std::chrono::steady_clock::now();
+    GBTerms native=minimizer.minimize(xyz, opts, minOpts);
+    double seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+
+    double sanderEnergy=0;
+    for(const auto& term : terms){
+        if(term.first!="RESTRAINT") sanderEnergy+=term.second;
+    }
+    double diff=native.total()-sanderEnergy;
+    bool pass=std::fabs(diff)<=podata.minTol;
+    std::cout << "  minimizer: sander " << sanderEnergy << ", native " << native.total() << " after "
+              << minimizer.steps() << " steps, diff " << diff << ", RMSD " << rmsd(xyz, sanderXyz) << " A"
+              << (pass ? "" : "  FAIL") << std::endl;
+
+    double cpu=0, wall=0;
+    std::cout << "  time: native " << seconds << " s wall on " << (opts.threads>0 ? opts.threads : numAffinityCpus())
+              << " threads";
+    if(SanderOutput().getTimes(outFile, cpu, wall)){
+        std::cout << ", sander " << cpu << " s CPU, " << wall << " s wall";
+    }
+    std::cout << std::endl;
+    return pass;
+}
+
+//! Native energy of one sander output; false when it does not match.
+static bool checkOutput(const std::string& outFile, const POdata& podata){
+    SanderOutput sanderOutput;
+    std::map<std::string, std::string> settings, files;
+    std::map<std::string, double> terms;
+    if(!sanderOutput.getInput(outFile, settings, files) || !sanderOutput.getTerms(outFile, terms)){
+        std::cout << outFile << ": not a complete sander output (outputs of --gb native cannot be checked)" << std::endl;
+        return false;
+    }
+    if(setting(settings, "igb", 0)!=5 || setting(settings, "gbsa", 0)!=1 || setting(settings, "imin", 0)!=1){
+        std::cout << outFile << ": skipped, not an imin=1, igb=5, gbsa=1 run" << std::endl;
+        return true;
+    }
+
+    GBOptions opts;
+    opts.cut=setting(settings, "cut", 9999.0);  // sander default with igb>0
+    opts.rgbmax=setting(settings, "rgbmax", 25.0);
+    opts.intDiel=setting(settings, "intdiel", 1.0);
+    opts.extDiel=setting(settings, "extdiel", 78.5);
+    opts.surften=setting(settings, "surften", 0.005);
+    opts.threads=podata.threads;
+
+    bool minimized=setting(settings, "maxcyc", 1)>0;
+    std::string prmtopFile=inDir(outFile, files["PARM"]);
+    std::string crdFile=inDir(outFile, minimized ? files["RESTRT"] : files["INPCRD"]);
+
+    Prmtop prmtop;
+    prmtop.read(prmtopFile);
+    GBEnergy engine(prmtop);
+    std::vector<double> xyz;
+    readAmberCoords(crdFile, xyz);
+    GBTerms native=engine.compute(xyz, opts);
+
+    std::cout << outFile << ": " << prmtopFile << " at " << crdFile << " (cut=" << opts.cut
+              << ", intdiel=" << opts.intDiel << ")" << std::endl;
+    std::cout << "      term          sander          native        diff" << std::endl;
+    bool pass=compareTerms(terms, native, podata);
+    if(minimized){
+        pass=checkMinimizer(outFile, prmtop, opts, settings, files, terms, xyz, podata) && pass;
+    }
+    std::cout << (pass ? "  PASS" : "  FAIL") << std::endl;
+    return pass;
+}
+
+//! Equal values of a section in both topologies, the reals to 1e-6 relative.
+static bool sameSection(const Prmtop& merged, const Prmtop& tleap, const std::string& flag){
+    if(!tleap.has(flag)) return true;
+    if(!merged.has(flag)) return false;
+    std::string format=tleap.format(flag);
+    if(format.find_first_of("aA")!=std::string::npos) return merged.strings(flag)==tleap.strings(flag);
+    if(format.find_first_of("iI")!=std::string::npos) return merged.ints(flag)==tleap.ints(flag);
+    std::vector<double> a=merged.reals(flag), b=tleap.reals(flag);
+    if(a.size()!=b.size()) return false;
+    for(size_t i=0; i<a.size(); ++i){
+        if(std::fabs(a[i]-b[i])>1.0e-6*std::max(1.0, std::fabs(b[i]))) return false;
+    }
+    return true;
+}
+
+//! mergePrmtop() of the receptor and ligand against the complex of tleap; false when they differ.
+static bool checkMerge(const std::vector<std::string>& files, const POdata& podata){
+    Prmtop rec, lig, tleap;
+    rec.read(files[0]);
+    lig.read(files[1]);
+    tleap.read(files[2]);
+    Prmtop merged=mergePrmtop(rec, lig);
+
+    std::cout << "merge " << files[0] << " + " << files[1] << " vs " << files[2] << std::endl;
+    bool pass=true;
+    const char* sections[]={"ATOM_NAME", "CHARGE", "ATOMIC_NUMBER", "MASS", "AMBER_ATOM_TYPE",
+                            "TREE_CHAIN_CLASSIFICATION", "JOIN_ARRAY", "IROTAT", "RADIUS_SET", "RADII",
+                            "SCREEN", "RESIDUE_LABEL", "RESIDUE_POINTER", "NUMBER_EXCLUDED_ATOMS"};
+    for(const char* flag : sections){
+        if(!sameSection(merged, tleap, flag)){
+            std::cout << "  " << flag << " differs  FAIL" << std::endl;
+            pass=false;
+        }
+    }
+    // The bonded lists and parameter tables may be ordered differently; their sizes must agree.
+    const Prmtop::Pointer counts[][2]={{Prmtop::NBONH, Prmtop::MBONA}, {Prmtop::NTHETH, Prmtop::MTHETA},
+                                       {Prmtop::NPHIH, Prmtop::MPHIA}, {Prmtop::NNB, Prmtop::NNB}};
+    const char* countNames[]={"bonds", "angles", "dihedrals", "exclusions"};
+    for(int i=0; i<4; ++i){
+        int a=merged.pointer(counts[i][0])+(counts[i][0]==counts[i][1] ? 0 : merged.pointer(counts[i][1]));
+        int b=tleap.pointer(counts[i][0])+(counts[i][0]==counts[i][1] ? 0 : tleap.pointer(counts[i][1]));
+        if(a!=b){
+            std::cout << "  " << countNames[i] << ": merged " << a << ", tleap " << b << "  FAIL" << std::endl;
+            pass=false;
+        }
+    }
+    if(!pass){
+        std::cout << "  FAIL" << std::endl;
+        return false;
+    }
+
+    GBOptions opts;
+    opts.cut=9999.0;
+    opts.threads=podata.threads;
+    std::vector<double> xyz;
+    readAmberCoords(files[3], xyz);
+    GBTerms tleapTerms=GBEnergy(tleap).compute(xyz, opts);
+    GBTerms mergedTerms=GBEnergy(merged).compute(xyz, opts);
+    std::cout << "      term           tleap          merged        diff" << std::endl;
+    pass=compareTerms(termMap(tleapTerms), mergedTerms, podata);
+    std::cout << (pass ? "  PASS" : "  FAIL") << std::endl;
+    return pass;
+}
+
+int main(int argc, char** argv) {
+    POdata podata;
+    if(!gbCheckPO(argc, argv, podata)){
+        return 1;
+    }
+
+    std::cout << std::fixed << std::setprecision(4);
+    bool pass=true;
+    if(!podata.merge.empty()){
+        try{
+            pass=checkMerge(podata.merge, podata);
+        } catch (LBindException& e){
+            std::cout << "merge: " << e.what() << std::endl;
+            pass=false;
+        }
+    }
+    for(const std::string& outFile : podata.sanderOuts){
+        try{
+            pass=checkOutput(outFile, podata) && pass;
+        } catch (LBindException& e){
+            std::cout << outFile << ": " << e.what() << std::endl;
+            pass=false;
+        }
+    }
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,53 @@
+//
+// Command line options of gbCheck.
+//
+
+#include "gbCheckPO.h"
+
+#include <iostream>
+
+#include <boost/program_options.hpp>
+
+using namespace boost::program_options;
+
+bool gbCheckPO(int argc, char** argv, POdata& podata) {
+
+    bool help=false;
+
+    options_description inputs("Check:");
+    inputs.add_options()
+            ("sander", value<std::vector<std::string> >(&podata.sanderOuts), "sander output files (imin=1, igb=5, gbsa=1), also given without --sander")
+            ("merge", value<std::vector<std::string> >(&podata.merge)->multitoken(), "REC.prmtop LIG.prmtop Com.prmtop Com.inpcrd: compare the in-process merge of the receptor and ligand topologies with the tleap complex")
+            ("tol", value<double>(&podata.tol)->default_value(0.01), "allowed difference of each energy term (kcal/mol)")
+            ("rel-tol", value<double>(&podata.relTol)->default_value(1.0e-5), "allowed difference relative to the sander value, added to tol")
+            ("min-tol", value<double>(&podata.minTol)->default_value(1.0), "allowed difference of the final unrestrained energy of a minimization (kcal/mol)")
+            ("threads", value<int>(&podata.threads)->default_value(0), "threads of the native engine, 0 for the CPUs of the process")
+            ("help", bool_switch(&help), "display usage summary")
+            ;
+    positional_options_description positional;
+    positional.add("sander", -1);
+
+    try {
+        variables_map vm;
+        store(command_line_parser(argc, argv)
+                .options(inputs)
+                .positional(positional)
+                .style(command_line_style::default_style ^ command_line_style::allow_guessing)
+                .run(),
+              vm);
+        notify(vm);
+    } catch (boost::program_options::error& e) {
+        std::cerr << "Command line parse error: " << e.what() << '\n' << "\nCorrect usage:\n" << inputs << '\n';
+        return false;
+    }
+
+    if (help || (podata.sanderOuts.empty() && podata.merge.empty())) {
+        std::cout << "gbCheck [options] <sander .out> ...\n" << inputs << '\n';
+        return false;
+    }
+    if (!podata.merge.empty() && podata.merge.size()!=4) {
+        std::cerr << "--merge takes REC.prmtop LIG.prmtop Com.prmtop Com.inpcrd\n";
+        return false;
+    }
+    return true;
+}
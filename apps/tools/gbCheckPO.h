@@ -0,0 +1,22 @@
+//
+// Command line options of gbCheck.
+//
+
+#ifndef CONVEYORLC_GBCHECKPO_H
+#define CONVEYORLC_GBCHECKPO_H
+
+#include <string>
+#include <vector>
+
+struct POdata{
+    std::vector<std::string> sanderOuts;    // sander output files to compare with
+    std::vector<std::string> merge;         // REC.prmtop LIG.prmtop Com.prmtop Com.inpcrd, the last two from tleap
+    double tol;                             // kcal/mol, per energy term
+    double relTol;                          // relative to the sander value, added to tol
+    double minTol;                          // kcal/mol, final energy of the native minimizer
+    int threads;
+};
+
+bool gbCheckPO(int argc, char** argv, POdata& podata);
+
+#endif //CONVEYORLC_GBCHECKPO_H
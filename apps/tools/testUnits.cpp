@@ -0,0 +1,328 @@
+//
+// Checks of the library units that need neither AmberTools nor MPI.
+//
+// Usage: testUnits [testfiles directory]
+// Scratch files go to a temporary directory that is removed at the end.
+// Exits with 1 if any check fails.
+//
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <utime.h>
+#include <sys/stat.h>
+
+#include <boost/filesystem.hpp>
+
+#include "Common/LBindException.h"
+#include "DataBase/ContentCache.h"
+#include "MM/GBEnergy.h"
+#include "Parser/AmberMask.h"
+#include "Parser/Prmtop.h"
+#include "Parser/PrmtopMerge.h"
+#include "Parser/SdfIndex.h"
+
+
+using namespace LBIND;
+
+static int numFailed=0;
+
+static void check(bool pass, const std::string& what){
+    std::cout << (pass ? "  PASS  " : "  FAIL  ") << what << std::endl;
+    if(!pass) ++numFailed;
+}
+
+static std::string readText(const std::string& fileName){
+    std::ifstream inFile(fileName.c_str(), std::ios::binary);
+    std::ostringstream text;
+    text << inFile.rdbuf();
+    return text.str();
+}
+
+static void writeText(const std::string& fileName, const std::string& text){
+    std::ofstream outFile(fileName.c_str(), std::ios::binary);
+    outFile << text;
+}
+
+//! Sets the modification time of fileName to mtime.
+static void setMtime(const std::string& fileName, time_t mtime){
+    struct utimbuf times;
+    times.actime=mtime;
+    times.modtime=mtime;
+    utime(fileName.c_str(), &times);
+}
+
+//! The records of index read back from fileName equal records.
+static bool sameRecords(const SdfIndex& index, const std::string& fileName, const std::vector<std::string>& records){
+    if(index.size()!=records.size()) return false;
+    int64_t offset=0;
+    for(size_t i=0; i<records.size(); ++i){
+        if(index.offset(i)!=offset || index.length(i)!=static_cast<int64_t>(records[i].size())) return false;
+        if(SdfIndex::read(fileName, index.offset(i), index.length(i))!=records[i]) return false;
+        offset+=records[i].size();
+    }
+    return true;
+}
+
+void testSdfIndex(const std::string& testDir, const std::string& workDir){
+    std::cout << "SdfIndex" << std::endl;
+    // Records of different lengths, so that reordering them keeps the size and moves the offsets.
+    std::string alanine=readText(testDir+"/alanine.sdf");
+    std::string ligand=readText(testDir+"/ligand.sdf");
+    check(alanine.size()!=ligand.size(), "test records differ in length");
+
+    std::string sdfFile=workDir+"/library.sdf";
+    std::vector<std::string> records={alanine, ligand, alanine};
+    writeText(sdfFile, alanine+ligand+alanine);
+    struct stat st;
+    stat(sdfFile.c_str(), &st);
+    time_t mtime=st.st_mtime;
+
+    SdfIndex index;
+    index.build(sdfFile, false);
+    check(sameRecords(index, sdfFile, records), "offsets and lengths of 3 records");
+
+    std::string idxFile=sdfFile+".idx";
+    boost::filesystem::remove(idxFile);
+    SdfIndex cached;
+    cached.build(sdfFile);
+    check(boost::filesystem::exists(idxFile), "index cache written");
+    SdfIndex loaded;
+    loaded.build(sdfFile);
+    check(sameRecords(loaded, sdfFile, records), "index loaded from the cache");
+
+    // A record without the trailing newline still ends at the end of the file.
+    records.push_back(ligand.substr(0, ligand.size()-1));
+    writeText(sdfFile, alanine+ligand+alanine+records.back());
+    setMtime(sdfFile, mtime);
+    SdfIndex grown;
+    grown.build(sdfFile);
+    check(sameRecords(grown, sdfFile, records), "cache rebuilt after a size change");
+
+    // Same size, new offsets: only the modification time tells the cache is stale.
+    records={ligand, alanine, alanine, records.back()};
+    writeText(sdfFile, ligand+alanine+alanine+records.back());
+    setMtime(sdfFile, mtime+10);
+    SdfIndex reordered;
+    reordered.build(sdfFile);
+    check(sameRecords(reordered, sdfFile, records), "cache rebuilt after an mtime change");
+}
+
+//! Same flags, formats and fields in both topologies.
+static bool sameTopology(const Prmtop& a, const Prmtop& b){
+    if(a.versionLine()!=b.versionLine() || a.sectionFlags()!=b.sectionFlags()) return false;
+    for(const std::string& flag : a.sectionFlags()){
+        if(a.format(flag)!=b.format(flag) || a.strings(flag)!=b.strings(flag)) return false;
+    }
+    return true;
+}
+
+static bool sameReals(const std::vector<double>& a, const std::vector<double>& b){
+    if(a.size()!=b.size()) return false;
+    for(size_t i=0; i<a.size(); ++i){
+        if(std::fabs(a[i]-b[i])>1.0e-6*std::max(1.0, std::fabs(b[i]))) return false;
+    }
+    return true;
+}
+
+// com.prmtop is the complex of rec.prmtop (ALA, GLY) and lig.prmtop (LIG) in
+// the layout tleap writes: %FLAG and %FORMAT lines padded to 80 columns, atom
+// names numbered within each residue and atom types named after the element.
+void testPrmtop(const std::string& testDir, const std::string& workDir){
+    std::cout << "Prmtop" << std::endl;
+    Prmtop com;
+    com.read(testDir+"/com.prmtop");
+    check(com.natom()==25 && com.pointer(Prmtop::NRES)==3, "POINTERS of com.prmtop");
+    check(com.strings("RESIDUE_LABEL")==std::vector<std::string>({"ALA", "GLY", "LIG"}), "RESIDUE_LABEL");
+    check(com.ints("RESIDUE_POINTER")==std::vector<int>({1, 13, 19}), "RESIDUE_POINTER");
+    check(com.reals("CHARGE").size()==25 && com.strings("ATOM_NAME")[24]=="H7", "CHARGE and ATOM_NAME");
+
+    std::string outFile=workDir+"/com.prmtop";
+    com.write(outFile);
+    Prmtop copy;
+    copy.read(outFile);
+    check(sameTopology(com, copy), "write and read back");
+    std::string againFile=workDir+"/again.prmtop";
+    copy.write(againFile);
+    check(readText(againFile)==readText(outFile), "second write unchanged");
+
+    std::vector<double> charge=com.reals("CHARGE");
+    charge[24]+=0.5;
+    std::vector<std::string> names=com.strings("ATOM_NAME");
+    names[0]="CA";
+    std::vector<int> pointers=com.ints("POINTERS");
+    copy.set("CHARGE", "5E16.8", charge);
+    copy.set("ATOM_NAME", "20a4", names);
+    copy.set("POINTERS", "10I8", pointers);
+    copy.set("EXTRA_SECTION", "10I8", std::vector<int>({1, 2, 3}));
+    copy.write(outFile);
+    copy.read(outFile);
+    check(sameReals(copy.reals("CHARGE"), charge) && copy.strings("ATOM_NAME")==names
+          && copy.ints("POINTERS")==pointers, "set() sections written and read back");
+    check(copy.sectionFlags().back()=="EXTRA_SECTION" && copy.ints("EXTRA_SECTION").size()==3, "set() appends a new section");
+
+    bool thrown=false;
+    try{
+        Prmtop bad;
+        bad.parse("%FLAG TITLE\n%FORMAT(20a4)\nMOL\n");
+    }catch(LBindException& e){
+        thrown=true;
+    }
+    check(thrown, "no POINTERS section is an error");
+}
+
+void testMergePrmtop(const std::string& testDir){
+    std::cout << "mergePrmtop" << std::endl;
+    Prmtop rec, lig, com;
+    rec.read(testDir+"/rec.prmtop");
+    lig.read(testDir+"/lig.prmtop");
+    com.read(testDir+"/com.prmtop");
+    Prmtop merged=mergePrmtop(rec, lig);
+
+    check(merged.natom()==com.natom(), "number of atoms");
+    const char* sections[]={"ATOM_NAME", "AMBER_ATOM_TYPE", "RESIDUE_LABEL", "RESIDUE_POINTER",
+                            "ATOMIC_NUMBER", "NUMBER_EXCLUDED_ATOMS", "JOIN_ARRAY", "IROTAT"};
+    for(const char* flag : sections){
+        check(merged.strings(flag)==com.strings(flag), flag);
+    }
+    for(const char* flag : {"CHARGE", "MASS", "RADII", "SCREEN"}){
+        check(sameReals(merged.reals(flag), com.reals(flag)), flag);
+    }
+    // Bonded lists and type tables may be ordered differently; the energy may not.
+    std::vector<double> xyz;
+    readAmberCoords(testDir+"/com.inpcrd", xyz);
+    GBOptions opts;
+    opts.cut=9999.0;
+    opts.threads=1;
+    GBTerms a=GBEnergy(merged).compute(xyz, opts);
+    GBTerms b=GBEnergy(com).compute(xyz, opts);
+    check(sameReals({a.bond, a.angle, a.dihedral, a.vdw14, a.eel14, a.vdw, a.eel, a.egb, a.esurf},
+                    {b.bond, b.angle, b.dihedral, b.vdw14, b.eel14, b.vdw, b.eel, b.egb, b.esurf}),
+          "GB energy terms of merged and complex topologies");
+
+    Prmtop boxed=lig;
+    std::vector<int> pointers=boxed.ints("POINTERS");
+    pointers[Prmtop::IFBOX]=1;
+    boxed.set("POINTERS", "10I8", pointers);
+    bool thrown=false;
+    try{
+        mergePrmtop(rec, boxed);
+    }catch(LBindException& e){
+        thrown=true;
+    }
+    check(thrown, "periodic box is refused");
+}
+
+static int maskCount(const Prmtop& prmtop, const std::string& mask){
+    std::vector<bool> selected=amberMask(prmtop, mask);
+    int count=0;
+    for(bool s : selected) count+=s;
+    return (selected.size()==static_cast<size_t>(prmtop.natom())) ? count : -1;
+}
+
+void testAmberMask(const std::string& testDir){
+    std::cout << "AmberMask" << std::endl;
+    Prmtop com;
+    com.read(testDir+"/com.prmtop");
+    // ALA: C1 C2 H3 C4 C5 H6 C7 O8 C9 C10 H11 H12, GLY: C1 H2 C3 O4 C5 H6, LIG: O1 C2 C3 H4 C5 O6 H7
+    const std::pair<std::string, int> masks[]={
+        {":LIG", 7}, {":1-2", 18}, {":ALA,3", 19}, {":*", 25}, {"@C1", 2}, {"@C=", 13},
+        {"@H?", 6}, {"@%O", 4}, {"@1-3,25", 4}, {":LIG@O1", 1}, {":GLY | :LIG@O1", 7},
+        {"!:LIG & @%H", 6}, {"(:1 & @%C) | :3@H?", 9}, {"!(:1-2)", 7}};
+    for(const std::pair<std::string, int>& mask : masks){
+        int count=maskCount(com, mask.first);
+        check(count==mask.second, "\""+mask.first+"\" selects "+std::to_string(count)
+              +" of "+std::to_string(mask.second)+" atoms");
+    }
+    for(const std::string& mask : {":LIG &", "(:1", ":LIG<:5"}){
+        bool thrown=false;
+        try{
+            amberMask(com, mask);
+        }catch(LBindException& e){
+            thrown=true;
+        }
+        check(thrown, "\""+mask+"\" is an error");
+    }
+}
+
+//! A fetched entry is complete and written by a single writer: every file holds its info line.
+static bool wholeEntry(const std::string& dir, const std::string& info){
+    return info.compare(0, 7, "writer ")==0
+           && readText(dir+"/LIG.prmtop")==info && readText(dir+"/LIG.inpcrd")==info;
+}
+
+void testContentCache(const std::string& workDir){
+    std::cout << "ContentCache" << std::endl;
+    check(ContentCache::sha1("abc")=="a9993e364706816aba3e25717850c26c9cd0d89d", "sha1 of \"abc\"");
+
+    std::string cacheDir=workDir+"/cache";
+    ContentCache cache(cacheDir);
+    std::string key=ContentCache::sha1("ligand");
+    std::string info;
+    check(!cache.fetch(key, workDir, info), "miss on an empty cache");
+
+    // Writers store the same key at once, each with its own files, and read it back right away.
+    const int numWriters=8;
+    std::vector<std::string> fetched(numWriters);
+    std::vector<std::thread> writers;
+    for(int i=0; i<numWriters; ++i){
+        std::string srcDir=workDir+"/src"+std::to_string(i);
+        boost::filesystem::create_directories(srcDir);
+        std::string text="writer "+std::to_string(i);
+        writeText(srcDir+"/LIG.prmtop", text);
+        writeText(srcDir+"/LIG.inpcrd", text);
+    }
+    for(int i=0; i<numWriters; ++i){
+        writers.push_back(std::thread([&cache, &key, &fetched, &workDir, i](){
+            std::string srcDir=workDir+"/src"+std::to_string(i);
+            std::string destDir=workDir+"/dest"+std::to_string(i);
+            boost::filesystem::create_directories(destDir);
+            cache.store(key, {"LIG.prmtop", "LIG.inpcrd", "LIG.missing"}, srcDir, "writer "+std::to_string(i));
+            std::string info;
+            if(cache.fetch(key, destDir, info) && wholeEntry(destDir, info)) fetched[i]=info;
+        }));
+    }
+    for(std::thread& t : writers) t.join();
+
+    bool sameInfo=true;
+    for(int i=0; i<numWriters; ++i) sameInfo=sameInfo && !fetched[i].empty() && fetched[i]==fetched[0];
+    check(sameInfo, "every writer fetches the same complete entry");
+
+    std::string destDir=workDir+"/dest";
+    boost::filesystem::create_directories(destDir);
+    check(cache.fetch(key, destDir, info) && info==fetched[0] && wholeEntry(destDir, info)
+          && !boost::filesystem::exists(destDir+"/LIG.missing"), "entry holds the files that existed");
+
+    int numEntries=std::distance(boost::filesystem::directory_iterator(cacheDir+"/"+key.substr(0, 2)),
+                                 boost::filesystem::directory_iterator());
+    check(numEntries==1, "one entry for the key");
+    check(boost::filesystem::is_empty(cacheDir+"/tmp"), "no temporaries left");
+}
+
+int main(int argc, char** argv) {
+    std::string testDir=(argc>1) ? argv[1] : "testfiles";
+    boost::filesystem::path workDir=boost::filesystem::temp_directory_path()
+            / boost::filesystem::unique_path("testUnits-%%%%-%%%%");
+    boost::filesystem::create_directories(workDir);
+
+    try{
+        testSdfIndex(testDir, workDir.string());
+        testPrmtop(testDir, workDir.string());
+        testMergePrmtop(testDir);
+        testAmberMask(testDir);
+        testContentCache(workDir.string());
+    }catch(LBindException& e){
+        check(false, std::string("exception: ")+e.what());
+    }
+
+    boost::filesystem::remove_all(workDir);
+    std::cout << (numFailed==0 ? "All checks passed" : std::to_string(numFailed)+" checks failed") << std::endl;
+    return numFailed==0 ? 0 : 1;
+}
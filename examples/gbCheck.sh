@@ -0,0 +1,17 @@
+#!/bin/bash
+# Compare the in-process GB engine with sander on the poses rescored by
+# CDT4mmgbsa.sh (run it with the default "--gb sander" first).
+
+export LBindData=/usr/gapps/aha/quartz/conveyorlc_10/data
+export PATH=/usr/gapps/aha/quartz/conveyorlc_10/bin:/usr/gapps/aha/quartz/bin:$PATH
+
+status=0
+for pose in scratch/gbsa/*/*/*/; do
+    [ -f "$pose/Com_minGB_2.out" ] || continue
+    gbCheck "$pose/Com_minGB_2.out" "$pose/Rec_minGB.out" "$pose/Com_min_GB.out" || status=1
+    # Complex topologies from tleap, the first pose of each receptor
+    if [ -f "$pose/Com_leap.log" ]; then
+        (cd "$pose" && gbCheck --merge REC.prmtop LIG.prmtop Com.prmtop Com.inpcrd) || status=1
+    fi
+done
+exit $status
@@ -18,6 +18,8 @@
 #include "Parser/Pdb.h"
 #include "Structure/Sstrm.hpp"
 #include "Common/LBindException.h"
+#include "Common/Affinity.h"
+#include "Common/ParallelFor.h"
 
 #include <boost/scoped_ptr.hpp>
 #include <boost/smart_ptr/scoped_ptr.hpp>
@@ -32,7 +34,8 @@ Grid::Grid(Complex *pCom)  :
     spacing(1.4),
     cutoffCoef(1.1),
     boxExtend(2.0),
-    outputPDB(true)
+    outputPDB(true),
+    threads(0)
 {
 }
 
@@ -44,7 +47,8 @@ Grid::Grid(Complex *pCom, bool outPDB)  :
     spacing(1.4),
     cutoffCoef(1.1),
     boxExtend(2.0),
-    outputPDB(outPDB)
+    outputPDB(outPDB),
+    threads(0)
 {
 }
 
@@ -78,6 +82,10 @@ void Grid::setBoxExtend(double boxExtend) {
     this->boxExtend=boxExtend;
 }
 
+void Grid::setThreads(int threads) {
+    this->threads=threads;
+}
+
 void Grid::run(double probeRadius, int numberSphere, double minVolume){
     probe=probeRadius;
     numSphere=numberSphere;
@@ -170,35 +178,36 @@ void Grid::getGridBox(){
     int yHighIndex=static_cast<int>(yMax/spacing)+1;
     int zHighIndex=static_cast<int>(zMax/spacing)+1;
         
-    for(int i=xLowIndex; i<xHighIndex; ++i){
-        for(int j=yLowIndex; j<yHighIndex; ++j){
-            for(int k=zLowIndex; k<zHighIndex; ++k){
-                double xGrid=static_cast<double>(i)*spacing;
-                double yGrid=static_cast<double>(j)*spacing;
-                double zGrid=static_cast<double>(k)*spacing;
-                bool isOverlap=false;
-                
-                for(unsigned m=0; m<atomList.size(); ++m){                    
-                    Atom* pAtom=atomList[m];
-                    double dist2=pAtom->getCoords()->dist2(xGrid, yGrid, zGrid);
-                    double r=pAtom->getElement()->getVDWRadius()+probe;
-//                    
-                    if(dist2<r*r){
-                        isOverlap=true;
-                        break;
-                        
-                    } // skip grid generation
-//                    
-   
-                }
-
-                if(!isOverlap){
-                    Coor3d *pCoor = new Coor3d(xGrid, yGrid, zGrid);
-                    grids.push_back(pCoor); 
-                }
+    int nx=std::max(0, xHighIndex-xLowIndex);
+    int ny=std::max(0, yHighIndex-yLowIndex);
+    int nz=std::max(0, zHighIndex-zLowIndex);
+    int nThreads=(threads>0) ? threads : numAffinityCpus();
+    
+    // Points are tested in parallel and kept in the i, j, k order of the serial loop.
+    std::vector<char> isOpen(nx*ny*nz, 0);
+    parallelForEach(nx*ny*nz, nThreads, 256, [&](int n){
+        double xGrid=static_cast<double>(xLowIndex+n/(ny*nz))*spacing;
+        double yGrid=static_cast<double>(yLowIndex+(n/nz)%ny)*spacing;
+        double zGrid=static_cast<double>(zLowIndex+n%nz)*spacing;
+        
+        for(unsigned m=0; m<atomList.size(); ++m){                    
+            Atom* pAtom=atomList[m];
+            double dist2=pAtom->getCoords()->dist2(xGrid, yGrid, zGrid);
+            double r=pAtom->getElement()->getVDWRadius()+probe;
+            if(dist2<r*r){
+                return; // skip grid generation
             }
         }
-        
+        isOpen[n]=1;
+    });
+    
+    for(int n=0; n<nx*ny*nz; ++n){
+        if(isOpen[n]){
+            Coor3d *pCoor = new Coor3d(static_cast<double>(xLowIndex+n/(ny*nz))*spacing,
+                                       static_cast<double>(yLowIndex+(n/nz)%ny)*spacing,
+                                       static_cast<double>(zLowIndex+n%nz)*spacing);
+            grids.push_back(pCoor); 
+        }
     }
     
     
@@ -212,8 +221,11 @@ void Grid::getGridBox(){
 void Grid::getSiteGrids() {
     
     std::vector<Coor3d*> tmpGrids;
+    std::vector<char> isSite(grids.size(), 0);
+    int nThreads=(threads>0) ? threads : numAffinityCpus();
     
-    for(unsigned g=0; g<grids.size(); ++g){
+    // The cost of a point depends on how buried it is; hand them out in small blocks.
+    parallelForEach(static_cast<int>(grids.size()), nThreads, 16, [&](int g){
         
         int numAccPoint = 0;
         Coor3d *pGrid=grids[g];
@@ -243,6 +255,13 @@ void Grid::getSiteGrids() {
         //std::cout <<"Ratio: " << ratio <<std::endl;
 
         if (ratio > 0.6) {
+            isSite[g]=1;
+        }
+    });
+    
+    for(unsigned g=0; g<grids.size(); ++g){
+        if(isSite[g]){
+            Coor3d *pGrid=grids[g];
             Coor3d* tmpPoint=new Coor3d(pGrid->getX(),pGrid->getY(),pGrid->getZ());
             tmpGrids.push_back(tmpPoint);
         }
@@ -37,6 +37,8 @@ public:
     void setSpacing(double spacing);
     void setCutoffCoef(double cutoffCoeff);
     void setBoxExtend(double boxExtend);
+    //! Threads for the box and cavity point searches, 0 (the default) for the CPUs the process is bound to.
+    void setThreads(int threads);
     void writeCutRecPDB(std::string& fileName, Complex* pComplex, double cutRadius);
         
 private:
@@ -67,6 +69,7 @@ private:
     double cutoffCoef;
     double boxExtend;
     bool outputPDB;
+    int threads;
     
     int siteIndex;
     int numSites;
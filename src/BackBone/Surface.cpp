@@ -14,6 +14,8 @@
 #include "Structure/Fragment.h"
 #include "Structure/Molecule.h"
 #include "Structure/Complex.h"
+#include "Common/Affinity.h"
+#include "Common/ParallelFor.h"
 
 namespace LBIND{
 
@@ -21,7 +23,8 @@ Surface::Surface(Complex* pCom) :
     pComplex(pCom), 
     numSphere(960),
     totalSASA(0),
-    probe(1.4){
+    probe(1.4),
+    threads(0){
 
 }
 
@@ -52,6 +55,10 @@ double Surface::getTotalSASA(){
     return totalSASA;
 }
 
+void Surface::setThreads(int threads){
+    this->threads=threads;
+}
+
 void Surface::generateSpPoints(){
     
     double inc=PI*(3-sqrt(5));
@@ -94,49 +101,57 @@ void Surface::findNeighbors(Atom *curAtom, std::vector<Atom*>& neighborAtoms, do
 
 void Surface::calculateSASA(){
     
+    // Atoms are independent; the areas are summed afterwards in atom order so the total does
+    // not depend on the number of threads.
+    std::vector<double> areas(atomList.size());
+    int nThreads=(threads>0) ? threads : numAffinityCpus();
+    parallelForEach(static_cast<int>(atomList.size()), nThreads, 16, [&](int i){
+        areas[i]=atomSASA(atomList[i]);
+    });
+    
+    for(unsigned i=0; i<atomList.size(); ++i){
+        atomList[i]->setSASA(areas[i]);
+        totalSASA+=areas[i];
+    }
+    
+}
+
+double Surface::atomSASA(Atom* curAtom){
+    
     const double coef=4.0*PI/numSphere;
     const double cutoff=2*probe;
     
-    // Calculate SASA for each atom;
-    for(int i=0; i<atomList.size(); ++i){
-        Atom *curAtom=atomList[i];
-        std::vector<Atom*> neighborAtoms;
-        findNeighbors(curAtom, neighborAtoms,cutoff);
-        
-        double radius=curAtom->getElement()->getVDWRadius()+probe;
-        //std::cout << "Atom " << curAtom->getName() << " radius "<< curAtom->getElement()->getVDWRadius() << std::endl;
+    std::vector<Atom*> neighborAtoms;
+    findNeighbors(curAtom, neighborAtoms,cutoff);
+    
+    double radius=curAtom->getElement()->getVDWRadius()+probe;
+    
+    int numAccPoint=0;
+    
+    for(int j=0; j<spPoints.size(); ++j){
+        double xPoint=radius*spPoints[j]->getX()+curAtom->getX();
+        double yPoint=radius*spPoints[j]->getY()+curAtom->getY();
+        double zPoint=radius*spPoints[j]->getZ()+curAtom->getZ();
+        Coor3d coorPoint(xPoint, yPoint, zPoint);
         
-        int numAccPoint=0;
+        bool isAccPoint=true;
         
-        for(int j=0; j<spPoints.size(); ++j){
-            double xPoint=radius*spPoints[j]->getX()+curAtom->getX();
-            double yPoint=radius*spPoints[j]->getY()+curAtom->getY();
-            double zPoint=radius*spPoints[j]->getZ()+curAtom->getZ();
-            Coor3d coorPoint(xPoint, yPoint, zPoint);
-            
-            bool isAccPoint=true;
-            
-            for(int k=0; k<neighborAtoms.size(); ++k){
-                Atom *pAtom=neighborAtoms[k];
-                double dist2=pAtom->getCoords()->dist2(coorPoint);
-                double r=probe+pAtom->getElement()->getVDWRadius();
-                if(dist2<r*r){
-                    isAccPoint=false;
-                    break;
-                }
-            }
-            
-            if(isAccPoint){
-                ++numAccPoint;
+        for(int k=0; k<neighborAtoms.size(); ++k){
+            Atom *pAtom=neighborAtoms[k];
+            double dist2=pAtom->getCoords()->dist2(coorPoint);
+            double r=probe+pAtom->getElement()->getVDWRadius();
+            if(dist2<r*r){
+                isAccPoint=false;
+                break;
             }
         }
         
-        double area=coef*radius*radius*numAccPoint;       
-        curAtom->setSASA(area);
-        totalSASA+=area;
+        if(isAccPoint){
+            ++numAccPoint;
+        }
     }
-        
     
+    return coef*radius*radius*numAccPoint;
 }
 
 }//namespace LBIND
\ No newline at end of file
@@ -32,18 +32,22 @@ public:
     
     void run(double prob, int numSphere);
     double getTotalSASA();
+    //! Threads for the per-atom areas, 0 (the default) for the CPUs the process is bound to.
+    void setThreads(int threads);
     
 private:
     void generateSpPoints();
     void getAtomList();
     void findNeighbors(Atom* curAtom, std::vector<Atom*>& neighborAtoms, double cutoff);
     void calculateSASA();
+    double atomSASA(Atom* curAtom);
     
 private:
     Complex *pComplex;
     int numSphere;
     double probe;
     double totalSASA;
+    int threads;
     std::vector<Coor3d*> spPoints; // list of 3d coordinates of points on a sphere
     std::vector<Atom*> atomList;
 };
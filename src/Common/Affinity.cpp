@@ -0,0 +1,49 @@
+//
+// CPU affinity of the process, for sizing and pinning thread pools.
+//
+
+#include "Common/Affinity.h"
+
+#include <boost/thread/thread.hpp>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace LBIND {
+
+std::vector<int> getAffinityCpus(){
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    if(sched_getaffinity(0, sizeof(mask), &mask)==0){
+        for(int i=0; i<CPU_SETSIZE; ++i){
+            if(CPU_ISSET(i, &mask)) cpus.push_back(i);
+        }
+    }
+#endif
+    return cpus;
+}
+
+int numAffinityCpus(){
+    int num=getAffinityCpus().size();
+    if(num>0) return num;
+
+    num=boost::thread::hardware_concurrency();
+    return (num>0) ? num : 1;
+}
+
+bool pinThread(int cpu){
+#ifdef __linux__
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(cpu, &mask);
+    return pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask)==0;
+#else
+    return false;
+#endif
+}
+
+}//namespace LBIND
@@ -0,0 +1,26 @@
+//
+// CPU affinity of the process, for sizing and pinning thread pools.
+//
+// Under srun/mpirun each rank gets its own CPU set; threads sized from
+// hardware_concurrency() oversubscribe the node when several ranks share it.
+//
+
+#ifndef CONVEYORLC_AFFINITY_H
+#define CONVEYORLC_AFFINITY_H
+
+#include <vector>
+
+namespace LBIND {
+
+//! CPUs in the affinity mask of the calling process.
+std::vector<int> getAffinityCpus();
+
+//! Number of CPUs in the affinity mask, at least 1.
+int numAffinityCpus();
+
+//! Pin the calling thread to one CPU, false if that fails.
+bool pinThread(int cpu);
+
+}//namespace LBIND
+
+#endif //CONVEYORLC_AFFINITY_H
@@ -0,0 +1,118 @@
+//
+// Native replacements for the mkdir/rm/cp/ln/grep/cat shell commands.
+//
+
+#include "Common/FileOps.h"
+
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+#include <boost/range/iterator_range.hpp>
+
+#include "Common/LBindException.h"
+
+namespace fs = boost::filesystem;
+
+namespace LBIND {
+
+void makeDir(const std::string& dir){
+    boost::system::error_code ec;
+    fs::create_directories(dir, ec);
+    if(ec && !fs::is_directory(dir)){
+        throw LBindException("mkdir fails for "+dir+": "+ec.message());
+    }
+}
+
+void removeAll(const std::string& path){
+    boost::system::error_code ec;
+    fs::remove_all(path, ec);
+    if(ec){
+        throw LBindException("Remove fails for "+path+": "+ec.message());
+    }
+}
+
+void copyFile(const std::string& from, const std::string& to){
+    std::string toFile=to;
+    if(fs::is_directory(to)){
+        toFile=(fs::path(to)/fs::path(from).filename()).string();
+    }
+
+    std::ifstream inFile(from.c_str(), std::ios::binary);
+    if(!inFile.good()){
+        throw LBindException("Copy fails, cannot open "+from);
+    }
+    std::ofstream outFile(toFile.c_str(), std::ios::binary|std::ios::trunc);
+    if(!outFile.good()){
+        throw LBindException("Copy fails, cannot write "+toFile);
+    }
+    // an empty file sets failbit on the output stream
+    if(inFile.peek()!=std::ifstream::traits_type::eof()){
+        outFile << inFile.rdbuf();
+    }
+    outFile.close();
+    if(!outFile){
+        throw LBindException("Copy fails for "+from+" to "+toFile);
+    }
+}
+
+void copyFiles(const std::vector<std::string>& files, const std::string& dir){
+    for(const std::string& file : files){
+        copyFile(file, dir);
+    }
+}
+
+void copyDirFiles(const std::string& fromDir, const std::string& dir){
+    for(auto& entry : boost::make_iterator_range(fs::directory_iterator(fromDir), {})){
+        if(fs::is_regular_file(entry.path())){
+            copyFile(entry.path().string(), dir);
+        }
+    }
+}
+
+void symLink(const std::string& target, const std::string& link, bool force){
+    boost::system::error_code ec;
+    if(force){
+        fs::remove(link, ec);
+    }
+    fs::create_symlink(target, link, ec);
+    if(ec){
+        throw LBindException("Link fails for "+link+": "+ec.message());
+    }
+}
+
+void grepFile(const std::string& in, const std::string& out, const std::string& pattern, bool invert){
+    std::ifstream inFile(in.c_str());
+    if(!inFile.good()){
+        throw LBindException("grep fails, cannot open "+in);
+    }
+    std::ofstream outFile(out.c_str());
+    if(!outFile.good()){
+        throw LBindException("grep fails, cannot write "+out);
+    }
+
+    std::string fileLine;
+    while(std::getline(inFile, fileLine)){
+        bool found=(fileLine.find(pattern)!=std::string::npos);
+        if(found!=invert){
+            outFile << fileLine << '\n';
+        }
+    }
+}
+
+void catFiles(const std::vector<std::string>& files, const std::string& out){
+    std::ofstream outFile(out.c_str(), std::ios::binary|std::ios::trunc);
+    if(!outFile.good()){
+        throw LBindException("cat fails, cannot write "+out);
+    }
+    for(const std::string& file : files){
+        std::ifstream inFile(file.c_str(), std::ios::binary);
+        if(!inFile.good()){
+            throw LBindException("cat fails, cannot open "+file);
+        }
+        if(inFile.peek()!=std::ifstream::traits_type::eof()){
+            outFile << inFile.rdbuf();
+        }
+    }
+}
+
+}//namespace LBIND
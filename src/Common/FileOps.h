@@ -0,0 +1,41 @@
+//
+// Native replacements for the mkdir/rm/cp/ln/grep/cat shell commands.
+//
+// All functions throw LBindException on failure, like LBIND::command.
+//
+
+#ifndef CONVEYORLC_FILEOPS_H
+#define CONVEYORLC_FILEOPS_H
+
+#include <string>
+#include <vector>
+
+namespace LBIND {
+
+//! mkdir -p dir
+void makeDir(const std::string& dir);
+
+//! rm -rf path
+void removeAll(const std::string& path);
+
+//! cp from to; to may be an existing directory.
+void copyFile(const std::string& from, const std::string& to);
+
+//! cp file1 file2 ... dir
+void copyFiles(const std::vector<std::string>& files, const std::string& dir);
+
+//! cp fromDir/* dir (regular files only)
+void copyDirFiles(const std::string& fromDir, const std::string& dir);
+
+//! ln -s target link, or ln -sf with force.
+void symLink(const std::string& target, const std::string& link, bool force=false);
+
+//! grep pattern in > out, or grep -v with invert. The pattern is a plain string.
+void grepFile(const std::string& in, const std::string& out, const std::string& pattern, bool invert=false);
+
+//! cat file1 file2 ... > out
+void catFiles(const std::vector<std::string>& files, const std::string& out);
+
+}//namespace LBIND
+
+#endif //CONVEYORLC_FILEOPS_H
@@ -0,0 +1,58 @@
+//
+// Ligand index for the sharded ligand HDF5 output of CDT2Ligand.
+//
+
+#include <conduit.hpp>
+#include <conduit_relay.hpp>
+#include <conduit_relay_io_hdf5.hpp>
+
+#include "Common/LigIndex.h"
+#include "Common/LBindException.h"
+
+using namespace conduit;
+
+namespace LBIND {
+
+static std::string shardFile(const std::string& ligFile, const std::string& shard){
+    if(shard[0]=='/') return shard;
+
+    size_t found=ligFile.find_last_of("/");
+    if(found==std::string::npos) return shard;
+    return ligFile.substr(0, found)+"/"+shard;
+}
+
+void loadLigand(const std::string& ligFile, const std::string& ligID, Node& nLig){
+    // Partial I/O
+    relay::io::load(ligFile+":lig/"+ligID, nLig);
+
+    if(nLig.has_path("file") || !nLig.has_path("meta/shard")) return;
+
+    std::string dataFile=shardFile(ligFile, nLig["meta/shard"].as_string());
+    Node nFile;
+    relay::io::load(dataFile+":lig/"+ligID+"/file", nFile);
+    if(nFile.number_of_children()==0){
+        throw LBindException("Ligand "+ligID+" has no files in shard "+dataFile);
+    }
+    nLig["file"].set(nFile);
+}
+
+void getLigSizes(const std::string& ligFile, const std::vector<std::string>& ligIDs,
+                 std::unordered_map<std::string, std::pair<int, int> >& sizes){
+
+    hid_t lig_hid=relay::io::hdf5_open_file_for_read(ligFile);
+    for(const std::string& ligID : ligIDs){
+        std::string metaPath="lig/"+ligID+"/meta/";
+        if(!relay::io::hdf5_has_path(lig_hid, metaPath+"numAtoms")) continue;
+        try {
+            Node nAtoms, nTors;
+            relay::io::hdf5_read(lig_hid, metaPath+"numAtoms", nAtoms);
+            relay::io::hdf5_read(lig_hid, metaPath+"numTors", nTors);
+            sizes[ligID]=std::make_pair(nAtoms.to_int(), nTors.to_int());
+        }catch(conduit::Error& e){
+            continue;
+        }
+    }
+    relay::io::hdf5_close_file(lig_hid);
+}
+
+}//namespace LBIND
@@ -0,0 +1,33 @@
+//
+// Ligand index for the sharded ligand HDF5 output of CDT2Ligand.
+//
+// ligand.hdf5 either carries the ligand files itself (single writer) or only
+// a light index entry lig/<ligID>/{status,meta} with meta/shard pointing to
+// the per-rank shard (relative to the directory of ligand.hdf5) that holds
+// lig/<ligID>/file. Readers go through loadLigand() and do not need to know
+// which layout was used.
+//
+
+#ifndef CONVEYORLC_LIGINDEX_H
+#define CONVEYORLC_LIGINDEX_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace conduit {
+    class Node;
+}
+
+namespace LBIND {
+
+//! Load lig/<ligID> from the index, pulling file/ from the shard if needed.
+void loadLigand(const std::string& ligFile, const std::string& ligID, conduit::Node& nLig);
+
+//! Heavy atoms and torsions from meta/numAtoms and meta/numTors; ligands without them are left out.
+void getLigSizes(const std::string& ligFile, const std::vector<std::string>& ligIDs,
+                 std::unordered_map<std::string, std::pair<int, int> >& sizes);
+
+}//namespace LBIND
+
+#endif //CONVEYORLC_LIGINDEX_H
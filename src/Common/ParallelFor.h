@@ -0,0 +1,61 @@
+//
+// Loops split over threads, for the numeric kernels that run inside one rank.
+//
+// The number of threads is usually numAffinityCpus(), the CPUs the rank is
+// bound to. Loops with few iterations run on the calling thread.
+//
+
+#ifndef CONVEYORLC_PARALLELFOR_H
+#define CONVEYORLC_PARALLELFOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace LBIND {
+
+//! body(begin, end, thread) over [0, n) in blocks, on up to threads threads.
+template<class F>
+void parallelFor(int n, int threads, F body){
+    threads=std::max(1, std::min(threads, n/64+1));
+    if(threads==1){
+        body(0, n, 0);
+        return;
+    }
+    std::vector<std::thread> pool;
+    int chunk=(n+threads-1)/threads;
+    for(int t=0; t<threads; ++t){
+        int begin=t*chunk;
+        int end=std::min(n, begin+chunk);
+        pool.push_back(std::thread(body, begin, end, t));
+    }
+    for(std::thread& th : pool) th.join();
+}
+
+//! body(i) for every i in [0, n), handed out in blocks of grain to up to threads threads as they
+//! become free; for loops whose iterations differ much in cost.
+template<class F>
+void parallelForEach(int n, int threads, int grain, F body){
+    grain=std::max(1, grain);
+    threads=std::max(1, std::min(threads, (n+grain-1)/grain));
+    if(threads==1){
+        for(int i=0; i<n; ++i) body(i);
+        return;
+    }
+    std::atomic<int> next(0);
+    auto worker=[&](){
+        for(int begin=next.fetch_add(grain); begin<n; begin=next.fetch_add(grain)){
+            int end=std::min(n, begin+grain);
+            for(int i=begin; i<end; ++i) body(i);
+        }
+    };
+    std::vector<std::thread> pool;
+    for(int t=1; t<threads; ++t) pool.push_back(std::thread(worker));
+    worker();
+    for(std::thread& th : pool) th.join();
+}
+
+}//namespace LBIND
+
+#endif //CONVEYORLC_PARALLELFOR_H
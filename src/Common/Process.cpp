@@ -0,0 +1,144 @@
+//
+// Run external tools with posix_spawn.
+//
+
+#include "Common/Process.h"
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "Common/LBindException.h"
+#include "Common/ScopedTimer.h"
+
+extern char **environ;
+
+namespace LBIND {
+
+static int defaultTimeout(){
+    const char* env=std::getenv("CONVEYORLC_TIMEOUT");
+    if(env==NULL) return 0;
+    int timeout=std::atoi(env);
+    return (timeout>0) ? timeout : 0;
+}
+
+static double wallTime(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec+ts.tv_nsec*1.0e-9;
+}
+
+static void sleepSec(double sec){
+    struct timespec ts;
+    ts.tv_sec=static_cast<time_t>(sec);
+    ts.tv_nsec=static_cast<long>((sec-ts.tv_sec)*1.0e9);
+    nanosleep(&ts, NULL);
+}
+
+//! Wait for pid; on timeout send SIGTERM, then SIGKILL after a grace period. Throws LBindException
+//! when waitpid fails, since status then says nothing about the child.
+static bool waitChild(pid_t pid, int timeout, int& status, const std::string& errMesg){
+    if(timeout<=0){
+        while(waitpid(pid, &status, 0)<0){
+            if(errno!=EINTR) throw LBindException(errMesg+": waitpid fails: "+strerror(errno));
+        }
+        return true;
+    }
+
+    double start=wallTime();
+    double delay=0.001;
+    while(true){
+        pid_t ret=waitpid(pid, &status, WNOHANG);
+        if(ret==pid) return true;
+        if(ret<0 && errno!=EINTR) throw LBindException(errMesg+": waitpid fails: "+strerror(errno));
+        if(wallTime()-start>timeout) break;
+        sleepSec(delay);
+        if(delay<0.05) delay*=2;
+    }
+
+    kill(pid, SIGTERM);
+    for(int i=0; i<20; ++i){
+        if(waitpid(pid, &status, WNOHANG)==pid) return false;
+        sleepSec(0.1);
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, &status, 0);
+    return false;
+}
+
+ProcessIO redirectOut(const std::string& out, bool mergeErr, bool append){
+    ProcessIO io;
+    io.out=out;
+    io.mergeErr=mergeErr;
+    io.appendOut=append;
+    return io;
+}
+
+int runProcess(const std::vector<std::string>& args, const std::string& errMesg, const ProcessIO& io){
+    if(args.empty()){
+        throw LBindException(errMesg);
+    }
+
+    //! Wall time of the tool goes to tools/<program> of the running job.
+    ScopedTimer timer("tools/"+args[0].substr(args[0].find_last_of('/')+1));
+
+    std::string cmd=args[0];
+    std::vector<char*> argv;
+    for(const std::string& arg : args){
+        argv.push_back(const_cast<char*>(arg.c_str()));
+        if(&arg!=&args[0]) cmd+=" "+arg;
+    }
+    argv.push_back(NULL);
+
+    posix_spawn_file_actions_t actions;
+    int rc=posix_spawn_file_actions_init(&actions);
+    if(rc!=0){
+        throw LBindException(errMesg+": "+strerror(rc));
+    }
+    if(rc==0 && !io.in.empty()){
+        rc=posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, io.in.c_str(), O_RDONLY, 0);
+    }
+    if(rc==0 && !io.out.empty()){
+        int flags=O_WRONLY|O_CREAT|(io.appendOut ? O_APPEND : O_TRUNC);
+        rc=posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, io.out.c_str(), flags, 0644);
+    }
+    if(rc==0 && io.mergeErr){
+        rc=posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+    }else if(rc==0 && !io.err.empty()){
+        rc=posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, io.err.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    }
+    if(rc!=0){
+        posix_spawn_file_actions_destroy(&actions);
+        throw LBindException(errMesg+": "+strerror(rc));
+    }
+
+    pid_t pid;
+    rc=posix_spawnp(&pid, argv[0], &actions, NULL, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if(rc!=0){
+        throw LBindException(errMesg+": "+strerror(rc));
+    }
+
+    int timeout=(io.timeout<0) ? defaultTimeout() : io.timeout;
+    int status=0;
+    if(!waitChild(pid, timeout, status, errMesg)){
+        throw LBindException(errMesg+": timeout after "+std::to_string(timeout)+" seconds");
+    }
+
+    if(WIFEXITED(status)){
+        std::cout << cmd << " return normally exit code " << WEXITSTATUS(status) << '\n';
+        return WEXITSTATUS(status);
+    }
+
+    throw LBindException(errMesg);
+}
+
+}//namespace LBIND
@@ -0,0 +1,35 @@
+//
+// Run external tools (tleap, sander, obabel, reduce, ...) with posix_spawn.
+//
+// No shell is involved: the program gets argv directly and the redirections
+// are done on the file descriptors of the child. Errors follow
+// LBIND::command: a LBindException is thrown if the program cannot be
+// started, is killed by a signal or times out; the exit code is returned.
+//
+
+#ifndef CONVEYORLC_PROCESS_H
+#define CONVEYORLC_PROCESS_H
+
+#include <string>
+#include <vector>
+
+namespace LBIND {
+
+struct ProcessIO {
+    std::string in;         //!< stdin from this file (< in)
+    std::string out;        //!< stdout to this file (> out)
+    bool appendOut=false;   //!< >> out instead of > out
+    std::string err;        //!< stderr to this file (2> err)
+    bool mergeErr=false;    //!< stderr goes to stdout (>& out)
+    int timeout=-1;         //!< seconds, 0 for no limit, -1 for the CONVEYORLC_TIMEOUT default
+};
+
+//! Stdout to out (stderr too with mergeErr), appended with append.
+ProcessIO redirectOut(const std::string& out, bool mergeErr=false, bool append=false);
+
+//! Run args[0] (looked up in PATH) with arguments args[1..].
+int runProcess(const std::vector<std::string>& args, const std::string& errMesg, const ProcessIO& io=ProcessIO());
+
+}//namespace LBIND
+
+#endif //CONVEYORLC_PROCESS_H
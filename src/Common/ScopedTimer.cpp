@@ -0,0 +1,113 @@
+//
+// Wall time of the phases of a job.
+//
+
+#include "Common/ScopedTimer.h"
+
+#include <ctime>
+#include <iomanip>
+
+namespace LBIND {
+
+static thread_local PhaseTimes* currentTimes=NULL;
+
+void PhaseTimes::add(const std::string& phase, double seconds){
+    times[phase]+=seconds;
+}
+
+void PhaseTimes::clear(){
+    times.clear();
+}
+
+PhaseTimes* PhaseTimes::current(){
+    return currentTimes;
+}
+
+void PhaseTimes::setCurrent(PhaseTimes* times){
+    currentTimes=times;
+}
+
+JobTiming::JobTiming(PhaseTimes& times) : previous(PhaseTimes::current()){
+    PhaseTimes::setCurrent(&times);
+}
+
+JobTiming::~JobTiming(){
+    PhaseTimes::setCurrent(previous);
+}
+
+ScopedTimer::ScopedTimer(const std::string& name) :
+    times(PhaseTimes::current()), phase(name), start(times ? now() : 0)
+{
+}
+
+ScopedTimer::ScopedTimer(PhaseTimes& t, const std::string& name) :
+    times(&t), phase(name), start(now())
+{
+}
+
+ScopedTimer::~ScopedTimer(){
+    stop();
+}
+
+void ScopedTimer::stop(){
+    if(times){
+        times->add(phase, now()-start);
+        times=NULL;
+    }
+}
+
+double ScopedTimer::now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec+ts.tv_nsec*1.0e-9;
+}
+
+TimingSummary::TimingSummary() : edges({0.01, 0.1, 1, 10, 100, 1000}){
+}
+
+void TimingSummary::add(const PhaseTimes& times){
+    for(const auto& t : times.phases()){
+        Phase& p=phases[t.first];
+        if(p.hist.empty()) p.hist.resize(edges.size()+1, 0);
+
+        ++p.count;
+        p.total+=t.second;
+        if(t.second>p.max) p.max=t.second;
+
+        size_t bin=0;
+        while(bin<edges.size() && t.second>=edges[bin]) ++bin;
+        ++p.hist[bin];
+    }
+}
+
+void TimingSummary::print(std::ostream& os, int rank) const {
+    if(phases.empty()) return;
+
+    std::ios_base::fmtflags flags=os.flags();
+    std::streamsize precision=os.precision();
+    os << "Rank= " << rank << " Timing histogram bins (Sec.):";
+    for(double e : edges){
+        os << " <" << e;
+    }
+    os << " >=" << edges.back() << '\n';
+
+    for(const auto& p : phases){
+        const Phase& ph=p.second;
+        os << "Rank= " << rank << " Timing " << std::left << std::setw(16) << p.first << std::right
+           << " jobs= " << ph.count
+           << std::fixed << std::setprecision(3)
+           << " total= " << ph.total
+           << " mean= " << ph.total/ph.count
+           << " max= " << ph.max
+           << " hist=";
+        for(long n : ph.hist){
+            os << ' ' << n;
+        }
+        os << '\n';
+    }
+    os.flags(flags);
+    os.precision(precision);
+    os << std::flush;
+}
+
+}//namespace LBIND
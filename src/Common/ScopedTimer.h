@@ -0,0 +1,108 @@
+//
+// Wall time of the phases of a job (HDF5 read, parsing, MC search, external
+// tools, ...).
+//
+// A worker makes a PhaseTimes current for the job it runs with JobTiming;
+// ScopedTimer objects anywhere below add their lifetime to a phase of it,
+// so the timing does not have to be passed through every call. Without a
+// current PhaseTimes a ScopedTimer does nothing. The current PhaseTimes is
+// per thread: time multithreaded parts around the call that starts the
+// threads.
+//
+// The times are written with the job results under meta/timing, and each
+// rank adds its jobs to a TimingSummary printed at the end of the run.
+//
+
+#ifndef CONVEYORLC_SCOPEDTIMER_H
+#define CONVEYORLC_SCOPEDTIMER_H
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/serialization/map.hpp>
+#include <boost/serialization/string.hpp>
+
+namespace LBIND {
+
+//! Seconds spent per phase of one job.
+class PhaseTimes {
+public:
+    void add(const std::string& phase, double seconds);
+    void clear();
+    const std::map<std::string, double>& phases() const { return times; }
+
+    template<class Archive>
+    void serialize(Archive & ar, const unsigned int version){
+        ar & times;
+    }
+
+    //! PhaseTimes of the job running on this thread, NULL outside a job.
+    static PhaseTimes* current();
+
+private:
+    friend class JobTiming;
+    static void setCurrent(PhaseTimes* times);
+
+    std::map<std::string, double> times;
+};
+
+//! Makes times the current PhaseTimes of this thread until it goes out of scope.
+class JobTiming {
+public:
+    explicit JobTiming(PhaseTimes& times);
+    ~JobTiming();
+
+private:
+    JobTiming(const JobTiming&);
+    JobTiming& operator=(const JobTiming&);
+
+    PhaseTimes* previous;
+};
+
+//! Adds its lifetime, or the time until stop(), to a phase.
+class ScopedTimer {
+public:
+    //! Phase of the current PhaseTimes, nothing happens if there is none.
+    explicit ScopedTimer(const std::string& phase);
+    ScopedTimer(PhaseTimes& times, const std::string& phase);
+    ~ScopedTimer();
+
+    void stop();
+
+    //! Monotonic wall clock in seconds.
+    static double now();
+
+private:
+    ScopedTimer(const ScopedTimer&);
+    ScopedTimer& operator=(const ScopedTimer&);
+
+    PhaseTimes* times;
+    std::string phase;
+    double start;
+};
+
+//! Per-rank summary: count, total and a histogram of the per-job time of each phase.
+class TimingSummary {
+public:
+    TimingSummary();
+
+    void add(const PhaseTimes& times);
+    void print(std::ostream& os, int rank) const;
+
+private:
+    struct Phase {
+        long count=0;
+        double total=0;
+        double max=0;
+        std::vector<long> hist;
+    };
+
+    std::vector<double> edges;      //!< upper bin edges in seconds, the last bin is open
+    std::map<std::string, Phase> phases;
+};
+
+}//namespace LBIND
+
+#endif //CONVEYORLC_SCOPEDTIMER_H
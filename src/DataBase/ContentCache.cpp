@@ -0,0 +1,126 @@
+//
+// Content-addressed file cache shared by many ranks.
+//
+
+#include "DataBase/ContentCache.h"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+
+#include "Common/FileOps.h"
+#include "Common/LBindException.h"
+#include "DataBase/SHA1.h"
+
+namespace fs = boost::filesystem;
+
+namespace LBIND {
+
+namespace {
+
+const char* manifestName="MANIFEST";
+
+//! Unique within the cache for this process: host, pid and a counter.
+std::string tmpName(const std::string& key){
+    static std::atomic<int> counter(0);
+    char host[256]={0};
+    gethostname(host, sizeof(host)-1);
+    std::stringstream ss;
+    ss << key << "." << host << "." << getpid() << "." << counter++;
+    return ss.str();
+}
+
+}
+
+ContentCache::ContentCache(const std::string& dir) : dir(dir) {
+}
+
+std::string ContentCache::sha1(const std::string& data){
+    CSHA1 sha;
+    sha.Update(reinterpret_cast<const UINT_8*>(data.data()), data.size());
+    sha.Final();
+
+    UINT_8 digest[20];
+    if(!sha.GetHash(digest)){
+        throw LBindException("ContentCache::sha1 >> cannot get the digest");
+    }
+    std::string hex;
+    char digit[3];
+    for(UINT_8 c : digest){
+        std::snprintf(digit, sizeof(digit), "%02x", c);
+        hex+=digit;
+    }
+    return hex;
+}
+
+std::string ContentCache::entryDir(const std::string& key) const {
+    return dir+"/"+key.substr(0, 2)+"/"+key;
+}
+
+bool ContentCache::fetch(const std::string& key, const std::string& destDir, std::string& info) const {
+    std::string entry=entryDir(key);
+    std::ifstream manifest((entry+"/"+manifestName).c_str());
+    if(!manifest.good()) return false;
+
+    std::getline(manifest, info);
+    std::vector<std::string> files;
+    std::string file;
+    while(std::getline(manifest, file)){
+        if(!file.empty()) files.push_back(file);
+    }
+
+    try {
+        for(const std::string& f : files){
+            copyFile(entry+"/"+f, destDir+"/"+f);
+        }
+    } catch (LBindException& e){
+        std::cout << "ContentCache: cannot read entry " << key << ": " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void ContentCache::store(const std::string& key, const std::vector<std::string>& files, const std::string& srcDir,
+                         const std::string& info) const {
+    std::string entry=entryDir(key);
+    if(fs::exists(entry+"/"+manifestName)) return;
+
+    std::string tmpDir=dir+"/tmp/"+tmpName(key);
+    try {
+        makeDir(tmpDir);
+        std::ofstream manifest((tmpDir+"/"+manifestName).c_str());
+        manifest << info << "\n";
+        for(const std::string& f : files){
+            std::string from=srcDir+"/"+f;
+            if(!fs::exists(from)) continue;
+            copyFile(from, tmpDir+"/"+f);
+            manifest << f << "\n";
+        }
+        manifest.close();
+        if(!manifest){
+            throw LBindException("cannot write "+tmpDir+"/"+manifestName);
+        }
+
+        //! rename fails when another rank has stored the key meanwhile; its copy is as good as ours.
+        makeDir(dir+"/"+key.substr(0, 2));
+        boost::system::error_code ec;
+        fs::rename(tmpDir, entry, ec);
+        if(!ec) return;
+        if(!fs::exists(entry+"/"+manifestName)){
+            std::cout << "ContentCache: cannot store entry " << key << ": " << ec.message() << std::endl;
+        }
+    } catch (LBindException& e){
+        std::cout << "ContentCache: cannot store entry " << key << ": " << e.what() << std::endl;
+    }
+
+    boost::system::error_code ec;
+    fs::remove_all(tmpDir, ec);
+}
+
+}//namespace LBIND
@@ -0,0 +1,42 @@
+//
+// Content-addressed file cache shared by many ranks, usually on the parallel
+// file system.
+//
+// An entry is a directory <dir>/<k0k1>/<key> holding copies of the files it
+// was stored with and a MANIFEST (an info line, then the file names). A
+// writer fills a private directory under <dir>/tmp and renames it into
+// place, so readers only ever see complete entries. When two ranks store the
+// same key the first rename wins and the other copy is dropped.
+//
+
+#ifndef CONVEYORLC_CONTENTCACHE_H
+#define CONVEYORLC_CONTENTCACHE_H
+
+#include <string>
+#include <vector>
+
+namespace LBIND {
+
+class ContentCache {
+public:
+    explicit ContentCache(const std::string& dir);
+
+    //! Hex SHA1 digest of data.
+    static std::string sha1(const std::string& data);
+
+    //! Copies the files of entry key into destDir and returns its info line; false on a miss.
+    bool fetch(const std::string& key, const std::string& destDir, std::string& info) const;
+
+    //! Stores the files of srcDir that exist under key. Failures are reported and ignored.
+    void store(const std::string& key, const std::vector<std::string>& files, const std::string& srcDir,
+               const std::string& info) const;
+
+private:
+    std::string entryDir(const std::string& key) const;
+
+    std::string dir;
+};
+
+}//namespace LBIND
+
+#endif //CONVEYORLC_CONTENTCACHE_H
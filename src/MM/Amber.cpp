@@ -17,7 +17,8 @@
 #include "BackBone/Ligand.h"
 #include "Common/Tokenize.hpp"
 #include "Common/LBindException.h"
-#include "Common/Command.hpp"
+#include "Common/Process.h"
+#include "Common/FileOps.h"
 
 namespace LBIND {
 
@@ -55,9 +56,11 @@ void Amber::reduce(std::string& input, std::string& output, std::string& options
     //! Assue PDB file name suffix is .pdb
     //    std::string pdbFNbase=pdbFName.substr(0,pdbFName.size()-4);
     //! reduce sustiva.pdb > sustiva_h.pdb
-    std::string cmd = AMBERPATH + "/bin/reduce " + options + " " + input + " > " + output;
+    std::vector<std::string> args={AMBERPATH + "/bin/reduce"};
+    tokenize(options, args);
+    args.push_back(input);
     std::string errMesg = "Amber::reduce fails";
-    command(cmd, errMesg);   
+    runProcess(args, errMesg, redirectOut(output));
 }
 
 void Amber::antechamber(std::string& input, std::string& output, std::string& options){
@@ -69,35 +72,27 @@ void Amber::antechamber(std::string& input, std::string& output, std::string& op
 //    char buffer[256];
 //    snprintf(buffer, sizeof(buffer), "%g", totCharge);
 //    std::string strTotalCharge=buffer;
-    std::string cmd=AMBERPATH +"/bin/antechamber -i " +input + " -fi pdb -o "
-            + output + " -fo mol2 -s 0 -pf yes "+options+" >& antechamber.out"; 
-    //std::cout << cmd << std::endl;
+    std::vector<std::string> args={AMBERPATH +"/bin/antechamber", "-i", input, "-fi", "pdb", "-o",
+                                   output, "-fo", "mol2", "-s", "0", "-pf", "yes"};
+    tokenize(options, args);
     std::string errMesg = "Amber::antechamber fails options "+options;
-    command(cmd, errMesg);      
+    runProcess(args, errMesg, redirectOut("antechamber.out", true));
 }
 
 void Amber::parmchk(std::string mol2FName){
     //! Assue PDB file name suffix is .mol2
     std::string mol2FBase=mol2FName.substr(0,mol2FName.size()-5);
     //! parmchk -i sustiva.mol2 -f mol2 -o sustiva.frcmod
-    std::string cmd=AMBERPATH +"/bin/parmchk -i " + mol2FName + " -f mol2 -o "
-            +mol2FBase+".frcmod";
-
-    //std::cout << cmd << std::endl;
     std::string errMesg = "Amber::parmchk fails";
-    command(cmd, errMesg);       
+    runProcess({AMBERPATH +"/bin/parmchk", "-i", mol2FName, "-f", "mol2", "-o", mol2FBase+".frcmod"}, errMesg);
 }
 
 void Amber::parmchk2(std::string mol2FName){
     //! Assue PDB file name suffix is .mol2
     std::string mol2FBase=mol2FName.substr(0,mol2FName.size()-5);
     //! parmchk -i sustiva.mol2 -f mol2 -o sustiva.frcmod
-    std::string cmd=AMBERPATH +"/bin/parmchk2 -i " + mol2FName + " -f mol2 -o "
-                    +mol2FBase+".frcmod";
-
-    //std::cout << cmd << std::endl;
     std::string errMesg = "Amber::parmchk2 fails";
-    command(cmd, errMesg);
+    runProcess({AMBERPATH +"/bin/parmchk2", "-i", mol2FName, "-f", "mol2", "-o", mol2FBase+".frcmod"}, errMesg);
 }
 
 void Amber::ligLeapInput(std::string pdbid, std::string ligName, std::string tleapFName){
@@ -195,10 +190,8 @@ void Amber::tleapInput(std::string& mol2FName, std::string& ligName, std::string
 }
 
 void Amber::tleap(std::string input){
-    std::string cmd=AMBERPATH +"/bin/tleap -f " + input + " > leap.out";
-    //std::cout << cmd << std::endl;
     std::string errMesg = "Amber::tleap fails";
-    command(cmd, errMesg);      
+    runProcess({AMBERPATH +"/bin/tleap", "-f", input}, errMesg, redirectOut("leap.out"));
 }
 
 
@@ -222,23 +215,16 @@ void Amber::minimization(std::string pdbid){
     minFile.close();    
 
     //! sander -O -i min.in -o 1FKO_sus_min.out -p 1FKO_sus.prmtop -c 1FKO_sus.inpcrd  -r 1FKO_sus_min.crd  & 
-    std::string cmd;
-    if(version==13){
-    	cmd=AMBERPATH +"/bin/sander13 -O -i "+pdbid+"-min.in -o "+pdbid+"-min.out -p "
-            +pdbid +".prmtop -c " + pdbid +".inpcrd -r "+pdbid+"-min.crd";
-    }else{
-    	cmd=AMBERPATH +"/bin/sander -O -i "+pdbid+"-min.in -o "+pdbid+"-min.out -p "
-            +pdbid +".prmtop -c " + pdbid +".inpcrd -r "+pdbid+"-min.crd";
-    }
-    //std::cout << cmd << std::endl;
+    std::string sander=(version==13) ? AMBERPATH +"/bin/sander13" : AMBERPATH +"/bin/sander";
     std::string errMesg = "Amber::minimization sander fails";
-    command(cmd, errMesg);      
+    runProcess({sander, "-O", "-i", pdbid+"-min.in", "-o", pdbid+"-min.out", "-p", pdbid +".prmtop",
+                "-c", pdbid +".inpcrd", "-r", pdbid+"-min.crd"}, errMesg);
     
     //!ambpdb -p 1FKO_sus.prmtop <1FKO_sus_min.crd > 1FKO_sus_min.pdb
-    cmd=AMBERPATH +"/bin/ambpdb -p " + pdbid +".prmtop < "+pdbid+"-min.crd > "+pdbid+"-min.pdb";
-    //std::cout << cmd << std::endl;
+    ProcessIO io=redirectOut(pdbid+"-min.pdb");
+    io.in=pdbid+"-min.crd";
     errMesg = "Amber::minimization ambpdb fails";
-    command(cmd, errMesg); 
+    runProcess({AMBERPATH +"/bin/ambpdb", "-p", pdbid +".prmtop"}, errMesg, io);
        
     //! Analysis the output
     std::string minlogFName=pdbid+"-min.out";
@@ -294,9 +280,7 @@ void Amber::prepLigands(){
     for(unsigned i=0; i<ligList.size(); ++i){
         std::string ligname=ligList[i]->getName();
         std::string ligFBase=pdbid+"-lig-"+ligname;
-        std::string cmd="mkdir -p "+ligFBase;
-        std::string errMesg = "Amber::prepLigands mkdir fails";
-        command(cmd, errMesg);       
+        makeDir(ligFBase);
         chdir(ligFBase.c_str());        
         std::string input=ligname+".pdb";
         std::string output=ligname+"-rd.pdb";
@@ -319,5 +303,20 @@ void Amber::prepLigands(){
     }
 }
 
+void ambpdb(int version, const std::string& prmtop, const std::string& crd, const std::string& pdb,
+            bool aatm, const std::string& errMesg){
+    //! ambpdb from PATH, as the pipeline tools run sander and tleap from PATH
+    std::vector<std::string> args={"ambpdb", "-p", prmtop};
+    if(aatm) args.push_back("-aatm");
+
+    ProcessIO io=redirectOut(pdb);
+    if(version==16){
+        args.push_back("-c");
+        args.push_back(crd);
+    }else{
+        io.in=crd;
+    }
+    runProcess(args, errMesg, io);
+}
 
 }//namespace LBIND 
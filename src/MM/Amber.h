@@ -46,6 +46,10 @@ private:
     std::string AMBERPATH;
 };
 
+//! ambpdb -p prmtop [-aatm] -c crd > pdb; before AMBER16 the coordinates are read from stdin.
+void ambpdb(int version, const std::string& prmtop, const std::string& crd, const std::string& pdb,
+            bool aatm, const std::string& errMesg);
+
 }//namespace LBIND 
 #endif	/* AMBER_H */
 
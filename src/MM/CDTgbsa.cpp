@@ -4,6 +4,10 @@
 
 #include <unistd.h>
 
+#include <algorithm>
+#include <mutex>
+#include <sstream>
+
 #include <conduit.hpp>
 #include <conduit_relay.hpp>
 #include <conduit_relay_io_hdf5.hpp>
@@ -11,14 +15,24 @@
 
 #include <boost/scoped_ptr.hpp>
 
-#include "Common/Command.hpp"
+#include "Common/Process.h"
+#include "Common/FileOps.h"
+#include "Common/LBindException.h"
 #include "Common/File.hpp"
 #include "Common/Tokenize.hpp"
+#include "Common/LigIndex.h"
+#include "Common/ScopedTimer.h"
 #include "MM/CDTgbsa.h"
+#include "Parser/AmberPdb.h"
 #include "Parser/Pdb.h"
+#include "Parser/PosePdb.h"
+#include "Parser/Prmtop.h"
+#include "Parser/PrmtopMerge.h"
 #include "Parser/SanderOutput.h"
 #include "CDTgbsa.h"
 #include "MM/Amber.h"
+#include "MM/GBEnergy.h"
+#include "MM/GBMinimizer.h"
 
 using namespace conduit;
 
@@ -26,13 +40,26 @@ namespace LBIND{
 
 void CDTgbsa::getLigData(CDTmeta &cdtMeta) {
 
+    // Streaming and grouped poses: the prepared ligand comes with the job, ligGB is already set
+    if(cdtMeta.ligFiles.empty()) {
+        loadLigData(cdtMeta);
+    }
+
+    for (auto &file : cdtMeta.ligFiles) {
+        std::ofstream outfile(file.first);
+        outfile << file.second;
+    }
+}
+
+void CDTgbsa::loadLigData(CDTmeta &cdtMeta) {
+
     Node nLig;
 
     //hid_t lig_hid = relay::io::hdf5_open_file_for_read(cdtMeta.workDir+"/"+cdtMeta.ligFile);
     //relay::io::hdf5_read(lig_hid, n);
-    // Partial I/O
-    std::string ligFilePath=cdtMeta.workDir+"/"+cdtMeta.ligFile+":lig/" + cdtMeta.ligID;
-    relay::io::load(ligFilePath, nLig);
+    // Partial I/O, files may come from a ligand shard
+    std::string ligFilePath=cdtMeta.workDir+"/"+cdtMeta.ligFile;
+    loadLigand(ligFilePath, cdtMeta.ligID, nLig);
 
     //Node nLig = n["lig/" + cdtMeta.ligID];
     int status = nLig["status"].as_int();
@@ -47,14 +74,13 @@ void CDTgbsa::getLigData(CDTmeta &cdtMeta) {
     }else{
         throw LBindException("Ligand " + cdtMeta.ligID + " has no GB energy");
     }
-    std::vector<std::string> filenames = {"LIG.lib", "LIG_min.pdbqt", "ligand.frcmod", "LIG_min.pdb", "ligand.mol2"};
+    std::vector<std::string> filenames = {"LIG.lib", "LIG_min.pdbqt", "ligand.frcmod", "LIG_min.pdb", "ligand.mol2",
+                                          "LIG.prmtop"};
 
     for (std::string &name : filenames) {
 
         if(nLig.has_path("file/" + name)) {
-            std::ofstream outfile(name);
-            std::string outLines = nLig["file/" + name].as_string();
-            outfile << outLines;
+            cdtMeta.ligFiles[name] = nLig["file/" + name].as_string();
         }
 
     }
@@ -64,6 +90,18 @@ void CDTgbsa::getLigData(CDTmeta &cdtMeta) {
 }
 
 void CDTgbsa::getRecData(CDTmeta &cdtMeta)
+{
+    if(cdtMeta.recFiles.empty()) {
+        loadRecData(cdtMeta);
+    }
+
+    for (auto &file : cdtMeta.recFiles) {
+        std::ofstream outfile(file.first);
+        outfile << file.second;
+    }
+}
+
+void CDTgbsa::loadRecData(CDTmeta &cdtMeta)
 {
     Node nRec;
 
@@ -79,6 +117,7 @@ void CDTgbsa::getRecData(CDTmeta &cdtMeta)
         throw LBindException("Receptor " + cdtMeta.recID + " preparation failed");
     }
 
+    cdtMeta.nonRes.clear();
     if(nRec.has_path("meta/NonStdAA"))
     {
         Node nNonRes = nRec["meta/NonStdAA"];
@@ -96,9 +135,7 @@ void CDTgbsa::getRecData(CDTmeta &cdtMeta)
     for (std::string &name : filenames) {
 
         if(nRec.has_path("file/" + name)) {
-            std::ofstream outfile(name);
-            std::string outLines = nRec["file/" + name].as_string();
-            outfile << outLines;
+            cdtMeta.recFiles[name] = nRec["file/" + name].as_string();
         }
 
     }
@@ -107,8 +144,9 @@ void CDTgbsa::getRecData(CDTmeta &cdtMeta)
 
 }
 
-void CDTgbsa::getDockData(LBIND::CDTmeta &cdtMeta)
+void CDTgbsa::loadDockData(LBIND::CDTmeta &cdtMeta)
 {
+    std::string name="poses.pdbqt";
     Node n;
 
     //
@@ -129,54 +167,70 @@ void CDTgbsa::getDockData(LBIND::CDTmeta &cdtMeta)
         cdtMeta.ligName="NoName";
     }
 
-    std::string name="poses.pdbqt";
-    std::ofstream outfile(name);
-    std::string outLines = n["file/"+name].as_string();
-    outfile << outLines;
+    cdtMeta.poses = n["file/"+name].as_string();
 
+    if(cdtMeta.score_only && n.has_path("meta/scores/1")) {
+        cdtMeta.dockscore = n["meta/scores/1"].as_double();
+    }
+}
+
+void CDTgbsa::getDockData(LBIND::CDTmeta &cdtMeta)
+{
+    // Streaming: poses, ligName and dockscore come with the job
+    if(cdtMeta.poses.empty()) {
+        loadDockData(cdtMeta);
+    }
+
+    cdtMeta.ligPdb.clear();
     if(cdtMeta.score_only) {
-        if(n.has_path("meta/scores/1")) {
-            cdtMeta.dockscore = n["meta/scores/1"].as_double();
-        }
         return;
     }
-    //hid_t dock_hid=relay::io::hdf5_open_file_for_read(dockHDF5file);
-    //relay::io::hdf5_read(dock_hid, n);
-
-    //std::string posespdbqt="poses.pdbqt";
-    //std::vector<std::string> filenames = {posespdbqt};
-
-    //for (std::string &name : filenames) {
-    //    std::ofstream outfile(name);
-    //    std::string outLines = n["dock/"+cdtMeta.recID+"/"+cdtMeta.ligID+"/file/" + name].as_string();
-    //    outfile << outLines;
-    //}
-    //relay::io::hdf5_close_file(dock_hid);
-    //! Processing poses
-
-    std::string ligpdbqt="lig_model.pdbqt";
-    boost::scoped_ptr<Pdb> pPdb(new Pdb());
-    std::string pIDstr=cdtMeta.poseID.substr(1, cdtMeta.poseID.size()-1);
-    int pID=std::stoi(pIDstr);
 
-    if(cdtMeta.useScoreCF){
-        double pose1score=0;
-        pPdb->readByModel(name, "pose1.pdbqt", 1, pose1score);
-        if(pose1score > cdtMeta.scoreCF){
+    //! Processing poses
+    std::string pose=cdtMeta.pose;
+    if(pose.empty()) {
+        // Grouped poses are split by loadPair and dockscore is already set; split the others here
+        std::map<int, std::string> models;
+        std::map<int, double> scores;
+        boost::scoped_ptr<Pdb> pPdb(new Pdb());
+        pPdb->readModels(cdtMeta.poses, models, scores);
+        int pID=std::stoi(cdtMeta.poseID.substr(1));
+
+        if(cdtMeta.useScoreCF && scores.count(1)>0 && scores[1] > cdtMeta.scoreCF){
             cdtMeta.gbbind=0;
             cdtMeta.comGB=0;
             cdtMeta.recGB=0;
             cdtMeta.ligGB=0;
             throw LBindException("Docking score is higher than threshold");
         }
+        if(models.count(pID)==0){
+            throw LBindException("No pose "+cdtMeta.poseID+" in the docking output");
+        }
+        pose=models[pID];
+        cdtMeta.dockscore=scores[pID];
+    }
+
+    //! The pose on the atom names of LIG.prmtop, with the hydrogens PDBQT leaves out
+    if(cdtMeta.ligFiles.count("LIG.prmtop")>0 && cdtMeta.ligFiles.count("LIG_min.pdb")>0) {
+        try {
+            Prmtop ligTop;
+            ligTop.parse(cdtMeta.ligFiles["LIG.prmtop"]);
+            cdtMeta.ligPdb=PosePdb(ligTop, cdtMeta.ligFiles["LIG_min.pdb"]).pdb(pose);
+            return;
+        } catch (LBindException& e){
+            std::cout << e.what() << ", using obabel and tleap" << std::endl;
+        }
     }
 
-    pPdb->readByModel(name, ligpdbqt, pID, cdtMeta.dockscore);
+    std::string ligpdbqt="lig_model.pdbqt";
+    {
+        std::ofstream outfile(ligpdbqt);
+        outfile << pose;
+    }
 
     std::string posePDB="lig_model.pdb";
-    std::string cmd="obabel -ipdbqt "+ligpdbqt+" -opdb -O "+posePDB;
     std::string errMesg="obabel fail to convert ligand pdbqt to pdb";
-    command(cmd, errMesg);
+    runProcess({"obabel", "-ipdbqt", ligpdbqt, "-opdb", "-O", posePDB}, errMesg);
 
 
     std::string tleapFName="Lig_leap.in";
@@ -207,10 +261,67 @@ void CDTgbsa::getDockData(LBIND::CDTmeta &cdtMeta)
         tleapFile.close();
     }
 
-    cmd="tleap -f "+tleapFName+" >& lig_leap.log";
-    //std::cout <<cmd <<std::endl;
-    errMesg="Ligand tleap fails";
-    command(cmd, errMesg);
+    errMesg = "Ligand tleap fails";
+    runProcess({"tleap", "-f", tleapFName}, errMesg, redirectOut("lig_leap.log", true));
+
+    std::ifstream ligFile("lig_full.pdb");
+    cdtMeta.ligPdb.assign(std::istreambuf_iterator<char>(ligFile), std::istreambuf_iterator<char>());
+}
+
+void CDTgbsa::loadPair(CDTmeta &cdtMeta, std::map<int, std::string>& models, std::map<int, double>& scores)
+{
+    std::vector<std::string> keystrs;
+    tokenize(cdtMeta.key, keystrs, "/");
+    if(keystrs.size()==2){
+        cdtMeta.recID=keystrs[0];
+        cdtMeta.ligID=keystrs[1];
+    }else{
+        throw LBindException("Key should have 2 fields: "+cdtMeta.key);
+    }
+
+    ScopedTimer timer("hdf5Read");
+    loadLigData(cdtMeta);
+    loadRecData(cdtMeta);
+    loadDockData(cdtMeta);
+    timer.stop();
+
+    if(cdtMeta.score_only) {
+        return;
+    }
+
+    ScopedTimer parseTimer("parsing");
+    boost::scoped_ptr<Pdb> pPdb(new Pdb());
+    pPdb->readModels(cdtMeta.poses, models, scores);
+
+    if(cdtMeta.useScoreCF && scores.count(1)>0 && scores[1] > cdtMeta.scoreCF){
+        throw LBindException("Docking score is higher than threshold");
+    }
+}
+
+void CDTgbsa::complexPdb(CDTmeta &cdtMeta, const std::string& ligPdb){
+    std::map<std::string, std::string>::const_iterator rec=cdtMeta.recFiles.find("rec_min.pdb");
+    if(rec==cdtMeta.recFiles.end()){
+        throw LBindException("Receptor "+cdtMeta.recID+" has no rec_min.pdb");
+    }
+
+    //! The receptor without END records, as "grep -v END", then the ligand and one END
+    std::string com;
+    std::istringstream recIn(rec->second);
+    std::string line;
+    while(std::getline(recIn, line)){
+        if(line.find("END")==std::string::npos) com+=line+"\n";
+    }
+    std::istringstream ligIn(ligPdb);
+    while(std::getline(ligIn, line)){
+        if(line.compare(0, 3, "END")!=0) com+=line+"\n";
+    }
+    com+="END\n";
+
+    std::ofstream outFile("com_init.pdb");
+    outFile << com;
+    if(!outFile){
+        throw LBindException("Cannot write com_init.pdb");
+    }
 }
 
 void CDTgbsa::ligMinimize(CDTmeta &cdtMeta){
@@ -238,6 +349,12 @@ void CDTgbsa::ligMinimize(CDTmeta &cdtMeta){
     }
 
     //! GB energy minimization
+    MinOptions minOpts;
+    if(nativeMinimize(cdtMeta, "LIG.prmtop", "LIG.inpcrd", 15, minOpts, "", 0, "LIG_minGB.out", "LIG_min.rst",
+                      cdtMeta.ligGB)){
+        return;
+    }
+
     std::string minFName = "LIG_minGB.in";
     {
         std::ofstream minFile;
@@ -266,15 +383,10 @@ void CDTgbsa::ligMinimize(CDTmeta &cdtMeta){
         minFile.close();
     }
 
-    std::string cmd;
-    if (cdtMeta.version == 13) {
-        cmd = "sander13  -O -i LIG_minGB.in -o LIG_minGB.out  -p LIG.prmtop -c LIG.inpcrd -ref LIG.inpcrd  -x LIG.mdcrd -r LIG_min.rst  >> log";
-    } else {
-        cmd = "sander  -O -i LIG_minGB.in -o LIG_minGB.out  -p LIG.prmtop -c LIG.inpcrd -ref LIG.inpcrd  -x LIG.mdcrd -r LIG_min.rst  >> log";
-    }
-    //std::cout <<cmd <<std::endl;
     std::string errMesg = "sander ligand minimization fails";
-    command(cmd, errMesg);
+    runProcess({cdtMeta.version == 13 ? "sander13" : "sander", "-O", "-i", "LIG_minGB.in", "-o", "LIG_minGB.out", "-p",
+                "LIG.prmtop", "-c", "LIG.inpcrd", "-ref", "LIG.inpcrd", "-x", "LIG.mdcrd", "-r", "LIG_min.rst"},
+                errMesg, redirectOut("log", false, true));
     boost::scoped_ptr<SanderOutput> pSanderOutput(new SanderOutput());
     std::string sanderOut = "LIG_minGB.out";
     double ligGBen = 0;
@@ -283,187 +395,57 @@ void CDTgbsa::ligMinimize(CDTmeta &cdtMeta){
     return;
 }
 
-void CDTgbsa::run(CDTmeta &cdtMeta){
-
-    std::vector<std::string> keystrs;
-    tokenize(cdtMeta.key, keystrs, "/");
-    if(keystrs.size()==3){
-        cdtMeta.recID=keystrs[0];
-        cdtMeta.ligID=keystrs[1];
-        cdtMeta.poseID=keystrs[2];
-    }else{
-        throw LBindException("Key should have 3 fields: "+cdtMeta.key);
-    }
+namespace {
 
-    std::string libDir=cdtMeta.inputDir+"/lib/";
-    std::string poseDir=cdtMeta.localDir+"/scratch/gbsa/"+cdtMeta.key;
-    cdtMeta.poseDir=poseDir;
+//! Receptor topology built by tleap, kept for the later poses of the receptor.
+struct RecTopology {
+    std::string prmtop;
+    std::vector<std::string> atomNames;
+};
 
-    std::string cmd="mkdir -p "+poseDir;
-    std::string errMesg="CDTgbsa::run mkdir poseDir fails";
-    command(cmd, errMesg);
-    chdir(poseDir.c_str());
+std::map<std::string, RecTopology> recTopologies;
+std::mutex recTopologyMutex;
 
-    getLigData(cdtMeta);
-    getRecData(cdtMeta);
-    getDockData(cdtMeta);
+}
 
-    if(cdtMeta.score_only){
-        ligMinimize(cdtMeta);
-        cmd = "grep -v END rec_min.pdb > dd.pdb && cat dd.pdb LIG_min.pdb > com_init.pdb";
-    }else {
-        cmd = "grep -v END rec_min.pdb   > dd.pdb && cat dd.pdb lig_full.pdb > com_init.pdb";
-    }
-    errMesg="MMGBSA::run combine rec and lig to com pdb fails";
-    command(cmd, errMesg);
+void CDTgbsa::recTopology(CDTmeta &cdtMeta, const std::string& libDir, const std::vector<std::vector<int> >& ssList){
+    ScopedTimer timer("recTopology");
 
-    std::vector<std::vector<int> > ssList;
+    // The receptor atoms come first in the complex and keep their topology from pose to pose,
+    // so only the coordinates of REC.inpcrd change. They are cut from the minimized complex.
+    std::string cacheKey=cdtMeta.recID+"/"+std::to_string(cdtMeta.version);
+    RecTopology cached;
     {
-        std::string stdPdbFile="rec_min.pdb";
-        boost::scoped_ptr<Pdb> pPdb(new Pdb() );
-        pPdb->getDisulfide(stdPdbFile, ssList);
+        std::lock_guard<std::mutex> lock(recTopologyMutex);
+        auto it=recTopologies.find(cacheKey);
+        if(it!=recTopologies.end()) cached=it->second;
     }
 
-    std::string tleapFName="Com_leap.in";
-    {
-        std::ofstream tleapFile;
-        try {
-            tleapFile.open(tleapFName.c_str());
-        }
-        catch(...){
-            std::string mesg="Cannot open tleap file: "+tleapFName;
-            throw LBindException(mesg);
-        }
-
-        if(cdtMeta.version==16 || cdtMeta.version==13){
-            tleapFile << "source leaprc.ff14SB" << std::endl;
-            tleapFile << "source leaprc.phosaa10\n";
-        }else{
-            tleapFile << "source leaprc.ff99SB" << std::endl;
-        }
-        tleapFile << "source leaprc.gaff\n"
-                  << "source leaprc.water.tip3p\n";
-
-        for(unsigned int i=0; i<cdtMeta.nonRes.size(); ++i){
-            std::string nonResRaw=cdtMeta.nonRes[i];
-            std::vector<std::string> nonResStrs;
-            const std::string delimiter=".";
-            tokenize(nonResRaw, nonResStrs, delimiter);
-            if(nonResStrs.size()==2 && nonResStrs[1]=="M"){
-                tleapFile << nonResStrs[0] <<" = loadmol2 "<< libDir << nonResStrs[0] << ".mol2 \n";
-            }else{
-                tleapFile << "loadoff " << libDir << nonResStrs[0] << ".off \n";
-            }
-
-            tleapFile << "loadamberparams "<< libDir << nonResStrs[0] <<".frcmod \n";
-        }
-
-        tleapFile << "loadamberparams ligand.frcmod\n"
-                  << "loadoff LIG.lib\n"
-                  << "COM = loadpdb com_init.pdb\n";
-
-        for(unsigned int i=0; i<ssList.size(); ++i){
-            std::vector<int> pair=ssList[i];
-            if(pair.size()==2){
-                tleapFile << "bond COM."<< pair[0] <<".SG COM." << pair[1] <<".SG \n";
+    Prmtop comTop;
+    comTop.read("Com.prmtop");
+    std::vector<double> xyz;
+    readAmberCoords("Com_min.rst", xyz);
+
+    if(!cached.prmtop.empty()){
+        std::vector<std::string> comNames=comTop.strings("ATOM_NAME");
+        bool match=comNames.size()>=cached.atomNames.size()
+                   && std::equal(cached.atomNames.begin(), cached.atomNames.end(), comNames.begin());
+        if(match){
+            xyz.resize(3*cached.atomNames.size());
+            {
+                std::ofstream outFile("REC.prmtop");
+                outFile << cached.prmtop;
             }
+            writeAmberCoords("REC.inpcrd", xyz, "REC");
+            return;
         }
-
-        tleapFile << "set default PBRadii mbondi2\n"
-                  << "saveamberparm COM Com.prmtop Com.inpcrd\n"
-                  << "quit \n";
-
-        tleapFile.close();
-    }
-
-    cmd="tleap -f "+tleapFName+" >& Com_leap.log";
-    errMesg="Complex tleap fails";
-    command(cmd, errMesg);
-
-    std::string checkFName="Com.prmtop";
-    {
-        if(!fileExist(checkFName)){
-            std::string message="Com.prmtop file does not exist.";
-            throw LBindException(message);
-        }
-
-        if(fileEmpty(checkFName)){
-            std::string message="Com.prmtop is empty.";
-            throw LBindException(message);
-        }
-    }
-
-    // Skip minimization
-    if(!cdtMeta.minimize){
-        // receptor energy calculation
-        cmd="ambpdb -p Com.prmtop -aatm < Com.inpcrd > Com_min.pdb";
-        errMesg="ambpdb complex fails";
-        command(cmd, errMesg);
-        return;
-    }
-
-    std::string minFName="Com_min.in";
-    {
-        std::ofstream minFile;
-        try {
-            minFile.open(minFName.c_str());
-        }
-        catch(...){
-            std::string mesg="Cannot open min file: "+minFName;
-            throw LBindException(mesg);
-        }
-        minFile << "title..\n"
-                << "&cntrl\n"
-                << "  imin   = 1,\n"
-                << "  ntmin   = 3,\n"
-                << "  maxcyc = 2000,\n"
-                << "  ncyc   = 1000,\n"
-                << "  ntpr   = 200,\n"
-                << "  ntb    = 0,\n"
-                << "  igb    = 5,\n"
-                << "  gbsa   = 1,\n"
-                << "  intdiel= " << cdtMeta.intDiel << ",\n"
-                << "  cut    = 15,\n"
-                << "  ntr=1,\n"
-                << "  restraint_wt=5.0,\n"
-                << "  restraintmask='!@H= & !:LIG'\n"
-                << " /\n" << std::endl;
-
-        minFile.close();
-    }
-
-    std::string sanderOut="Com_min_GB.out";
-    if(cdtMeta.version==13){
-        cmd="sander13  -O -i Com_min.in -o Com_min_GB.out -p Com.prmtop -c Com.inpcrd -ref Com.inpcrd  -x Com.mdcrd -r Com_min.rst";
-    }else{
-        cmd="sander  -O -i Com_min.in -o Com_min_GB.out -p Com.prmtop -c Com.inpcrd -ref Com.inpcrd  -x Com.mdcrd -r Com_min.rst";
-    }
-    //std::cout <<cmd <<std::endl;
-    errMesg="Complex minimization fails";
-    command(cmd, errMesg);
-
-    boost::scoped_ptr<SanderOutput> pSanderOutput(new SanderOutput());
-    cdtMeta.comGB=0;
-    bool success=pSanderOutput->getEAmber(sanderOut,cdtMeta.comGB);
-    if(!success) throw LBindException("Cannot get complex GB energy");
-
-    std::cout << "Complex GB Minimization Energy: " << cdtMeta.comGB <<" kcal/mol."<< std::endl;
-
-    // receptor energy calculation
-    if (cdtMeta.version == 16) {
-        cmd="ambpdb -p Com.prmtop -aatm -c Com_min.rst > Com_min.pdb";
-    } else {
-        cmd="ambpdb -p Com.prmtop -aatm < Com_min.rst > Com_min.pdb";
+        std::cout << "Receptor " << cdtMeta.recID << " atoms differ from the cached topology, rebuilding REC.prmtop" << std::endl;
     }
-    errMesg="ambpdb complex fails";
-    command(cmd, errMesg);
 
-    cmd="grep -v LIG Com_min.pdb > rec_tmp.pdb ";
-    errMesg="Grep LIG Com_min.pdb fails";
-    command(cmd, errMesg);
+    AmberPdb(comTop).write("rec_tmp.pdb", xyz, true, AmberPdb::EXCEPT, "LIG");
 
     // For receptor energy re-calculation
-    tleapFName="rec_leap.in";
+    std::string tleapFName="rec_leap.in";
 
     {
         std::ofstream tleapFile;
@@ -514,12 +496,10 @@ void CDTgbsa::run(CDTmeta &cdtMeta){
         tleapFile.close();
     }
 
-    cmd="tleap -f rec_leap.in >& rec_leap.log";
-    //std::cout <<cmd <<std::endl;
-    errMesg="MMGBSA::run tleap receptor fails";
-    command(cmd, errMesg);
+    std::string errMesg = "MMGBSA::run tleap receptor fails";
+    runProcess({"tleap", "-f", "rec_leap.in"}, errMesg, redirectOut("rec_leap.log", true));
 
-    checkFName="REC.prmtop";
+    std::string checkFName="REC.prmtop";
     {
         if(!fileExist(checkFName)){
             std::string message="REC.prmtop file does not exist.";
@@ -531,101 +511,153 @@ void CDTgbsa::run(CDTmeta &cdtMeta){
             throw LBindException(message);
         }
     }
-    // end receptor energy re-calculation
 
-    minFName="Rec_minGB.in";
+    RecTopology recTop;
     {
-        std::ofstream minFile;
-        try {
-            minFile.open(minFName.c_str());
-        }
-        catch(...){
-            std::string mesg="Cannot open min file: "+minFName;
-            throw LBindException(mesg);
-        }
+        std::ifstream inFile("REC.prmtop");
+        std::stringstream buffer;
+        buffer << inFile.rdbuf();
+        recTop.prmtop=buffer.str();
+    }
+    Prmtop prmtop;
+    prmtop.parse(recTop.prmtop);
+    recTop.atomNames=prmtop.strings("ATOM_NAME");
+    recTop.atomNames.resize(prmtop.natom());
 
-        minFile << "title..\n"
-                << "&cntrl\n"
-                << "  imin   = 1,\n"
-                << "  ntmin   = 3,\n"
-                << "  maxcyc = 1,\n"
-                << "  ncyc   = 1,\n"
-                << "  ntpr   = 1,\n"
-                << "  ntb    = 0,\n"
-                << "  igb    = 5,\n"
-                << "  gbsa   = 1,\n"
-                << "  intdiel= " << cdtMeta.intDiel << ",\n"
-                << "  cut    = 15,\n"
-                << "  ntr=1,\n"
-                << "  restraint_wt=5.0,\n"
-                << "  restraintmask='!@H='\n"
-                << " /\n";
+    std::lock_guard<std::mutex> lock(recTopologyMutex);
+    recTopologies[cacheKey]=recTop;
+}
 
-        minFile.close();
-    }
+bool CDTgbsa::comTopology(CDTmeta &cdtMeta){
+    if(!cdtMeta.mergeTop) return false;
 
-    if(cdtMeta.version==13){
-        cmd="sander13 -O -i Rec_minGB.in -o Rec_minGB.out  -p REC.prmtop -c REC.inpcrd -ref REC.inpcrd -x REC.mdcrd -r Rec_min.rst";
-    }else{
-        cmd="sander -O -i Rec_minGB.in -o Rec_minGB.out  -p REC.prmtop -c REC.inpcrd -ref REC.inpcrd -x REC.mdcrd -r Rec_min.rst";
+    std::string cacheKey=cdtMeta.recID+"/"+std::to_string(cdtMeta.version);
+    RecTopology cached;
+    {
+        std::lock_guard<std::mutex> lock(recTopologyMutex);
+        auto it=recTopologies.find(cacheKey);
+        if(it==recTopologies.end()) return false;
+        cached=it->second;
     }
-    //std::cout <<cmd <<std::endl;
-    errMesg="MMGBSA::run receptor minimization fails";
-    command(cmd, errMesg);
-
-    sanderOut="Rec_minGB.out";
-    cdtMeta.recGB=0;
-    success=pSanderOutput->getEnergy(sanderOut, cdtMeta.recGB);
-    if(!success) throw LBindException("Cannot get receptor GB energy");
 
-    cdtMeta.gbbind=cdtMeta.comGB-cdtMeta.recGB-cdtMeta.ligGB;
+    ScopedTimer timer("comTopology");
+    try {
+        std::map<std::string, std::string>::const_iterator lig=cdtMeta.ligFiles.find("LIG.prmtop");
+        if(lig==cdtMeta.ligFiles.end()){
+            throw LBindException("Ligand "+cdtMeta.ligID+" has no LIG.prmtop");
+        }
+        Prmtop recTop, ligTop;
+        recTop.parse(cached.prmtop);
+        ligTop.parse(lig->second);
+        Prmtop comTop=mergePrmtop(recTop, ligTop);
 
+        std::vector<double> xyz;
+        {
+            std::ifstream inFile("com_init.pdb");
+            AmberPdb(comTop).coords(inFile, xyz);
+        }
+        comTop.write("Com.prmtop");
+        writeAmberCoords("Com.inpcrd", xyz, "COM");
+        return true;
+    } catch (LBindException& e){
+        std::cout << e.what() << ", using tleap" << std::endl;
+    }
+    return false;
+}
 
+bool CDTgbsa::nativeSinglePoint(CDTmeta &cdtMeta, const std::string& prmtopFile, const std::string& crdFile,
+                                double cut, const std::string& outFile, double& energy){
+    if(!cdtMeta.nativeGB) return false;
+
+    ScopedTimer timer("nativeGB");
+    try {
+        Prmtop prmtop;
+        prmtop.read(prmtopFile);
+        GBEnergy engine(prmtop);
+
+        std::vector<double> xyz;
+        readAmberCoords(crdFile, xyz);
+
+        GBOptions opts;
+        opts.cut=cut;
+        opts.intDiel=cdtMeta.intDiel;
+        GBTerms terms=engine.compute(xyz, opts);
+
+        std::ofstream out(outFile);
+        out << "In-process GB single point (igb=5, gbsa=1, cut=" << cut << ", intdiel=" << cdtMeta.intDiel
+            << "): " << prmtopFile << " " << crdFile << "\n";
+        terms.print(out);
+
+        energy=terms.total();
+        return true;
+    } catch (LBindException& e){
+        std::cout << e.what() << ", using sander" << std::endl;
+    }
+    return false;
 }
 
+bool CDTgbsa::nativeMinimize(CDTmeta &cdtMeta, const std::string& prmtopFile, const std::string& crdFile,
+                             double cut, const MinOptions& minOpts, const std::string& mask, double weight,
+                             const std::string& outFile, const std::string& rstFile, double& energy){
+    if(!cdtMeta.nativeGB) return false;
+
+    ScopedTimer timer("nativeGB");
+    try {
+        GBOptions opts;
+        opts.cut=cut;
+        opts.intDiel=cdtMeta.intDiel;
+        GBTerms terms=minimizeAmber(prmtopFile, crdFile, opts, minOpts, mask, weight, rstFile, outFile);
+
+        energy=terms.total();
+        return true;
+    } catch (LBindException& e){
+        std::cout << e.what() << ", using sander" << std::endl;
+    }
+    return false;
+}
 
-void CDTgbsa::runNew(CDTmeta &cdtMeta){
+void CDTgbsa::run(CDTmeta &cdtMeta){
 
-        std::vector<std::string> keystrs;
-        tokenize(cdtMeta.key, keystrs, "/");
-        if(keystrs.size()==3){
-            cdtMeta.recID=keystrs[0];
-            cdtMeta.ligID=keystrs[1];
-            cdtMeta.poseID=keystrs[2];
-        }else{
-            throw LBindException("Key should have 3 fields: "+cdtMeta.key);
-        }
+    std::vector<std::string> keystrs;
+    tokenize(cdtMeta.key, keystrs, "/");
+    if(keystrs.size()==3){
+        cdtMeta.recID=keystrs[0];
+        cdtMeta.ligID=keystrs[1];
+        cdtMeta.poseID=keystrs[2];
+    }else{
+        throw LBindException("Key should have 3 fields: "+cdtMeta.key);
+    }
 
-        std::string libDir=cdtMeta.inputDir+"/lib/";
-        std::string poseDir=cdtMeta.localDir+"/scratch/gbsa/"+cdtMeta.key;
-        cdtMeta.poseDir=poseDir;
+    std::string libDir=cdtMeta.inputDir+"/lib/";
+    std::string poseDir=cdtMeta.localDir+"/scratch/gbsa/"+cdtMeta.key;
+    cdtMeta.poseDir=poseDir;
 
-        std::string cmd="mkdir -p "+poseDir;
-        std::string errMesg="CDTgbsa::run mkdir poseDir fails";
-        command(cmd, errMesg);
-        chdir(poseDir.c_str());
+    makeDir(poseDir);
+    std::string errMesg;
+    chdir(poseDir.c_str());
 
+    {
+        ScopedTimer timer("hdf5Read");
         getLigData(cdtMeta);
-
+        getRecData(cdtMeta);
         getDockData(cdtMeta);
+    }
 
-        getRecData(cdtMeta);
-
-        if(cdtMeta.score_only){
-            cmd = "grep -v END rec_min.pdb > dd.pdb && cat dd.pdb LIG_min.pdb > com_init.pdb";
-        }else {
-            cmd = "grep -v END rec_min.pdb   > dd.pdb && cat dd.pdb lig_full.pdb > com_init.pdb";
-        }
-        errMesg="MMGBSA::run combine rec and lig to com pdb fails";
-        command(cmd, errMesg);
+    if(cdtMeta.score_only){
+        ligMinimize(cdtMeta);
+        complexPdb(cdtMeta, cdtMeta.ligFiles["LIG_min.pdb"]);
+    }else {
+        complexPdb(cdtMeta, cdtMeta.ligPdb);
+    }
 
-        std::vector<std::vector<int> > ssList;
-        {
-            std::string stdPdbFile="rec_min.pdb";
-            boost::scoped_ptr<Pdb> pPdb(new Pdb() );
-            pPdb->getDisulfide(stdPdbFile, ssList);
-        }
+    std::vector<std::vector<int> > ssList;
+    {
+        std::string stdPdbFile="rec_min.pdb";
+        boost::scoped_ptr<Pdb> pPdb(new Pdb() );
+        pPdb->getDisulfide(stdPdbFile, ssList);
+    }
 
+    if(!comTopology(cdtMeta)){
         std::string tleapFName="Com_leap.in";
         {
             std::ofstream tleapFile;
@@ -678,33 +710,37 @@ void CDTgbsa::runNew(CDTmeta &cdtMeta){
             tleapFile.close();
         }
 
-        cmd="tleap -f "+tleapFName+" >& Com_leap.log";
-        errMesg="Complex tleap fails";
-        command(cmd, errMesg);
-
-        std::string checkFName="Com.prmtop";
-        {
-            if(!fileExist(checkFName)){
-                std::string message="Com.prmtop file does not exist.";
-                throw LBindException(message);
-            }
+        errMesg = "Complex tleap fails";
+        runProcess({"tleap", "-f", tleapFName}, errMesg, redirectOut("Com_leap.log", true));
+    }
 
-            if(fileEmpty(checkFName)){
-                std::string message="Com.prmtop is empty.";
-                throw LBindException(message);
-            }
+    std::string checkFName="Com.prmtop";
+    {
+        if(!fileExist(checkFName)){
+            std::string message="Com.prmtop file does not exist.";
+            throw LBindException(message);
         }
 
-        // Skip minimization
-        if(!cdtMeta.minimize){
-            // receptor energy calculation
-            cmd="ambpdb -p Com.prmtop -aatm < Com.inpcrd > Com_min.pdb";
-            errMesg="ambpdb complex fails";
-            command(cmd, errMesg);
-            return;
+        if(fileEmpty(checkFName)){
+            std::string message="Com.prmtop is empty.";
+            throw LBindException(message);
         }
+    }
 
-        std::string minFName="Com_min.in";
+    // Skip minimization
+    if(!cdtMeta.minimize){
+        // receptor energy calculation
+        amberToPdb("Com.prmtop", "Com.inpcrd", "Com_min.pdb", true);
+        return;
+    }
+
+    std::string sanderOut="Com_min_GB.out";
+    boost::scoped_ptr<SanderOutput> pSanderOutput(new SanderOutput());
+    bool success=true;
+    std::string minFName="Com_min.in";
+    MinOptions minOpts;
+    if(!nativeMinimize(cdtMeta, "Com.prmtop", "Com.inpcrd", 15, minOpts, "!@H= & !:LIG", 5.0, sanderOut,
+                       "Com_min.rst", cdtMeta.comGB)){
         {
             std::ofstream minFile;
             try {
@@ -717,7 +753,7 @@ void CDTgbsa::runNew(CDTmeta &cdtMeta){
             minFile << "title..\n"
                     << "&cntrl\n"
                     << "  imin   = 1,\n"
-                    << "  ntmin   = 1,\n"
+                    << "  ntmin   = 3,\n"
                     << "  maxcyc = 2000,\n"
                     << "  ncyc   = 1000,\n"
                     << "  ntpr   = 200,\n"
@@ -725,165 +761,248 @@ void CDTgbsa::runNew(CDTmeta &cdtMeta){
                     << "  igb    = 5,\n"
                     << "  gbsa   = 1,\n"
                     << "  intdiel= " << cdtMeta.intDiel << ",\n"
-                    << "  cut    = 25,\n"
-                    << "  drms=1e-3,\n"
+                    << "  cut    = 15,\n"
                     << "  ntr=1,\n"
                     << "  restraint_wt=5.0,\n"
-                    << "  restraintmask='@CA,C,N= & !:LIG'\n"
+                    << "  restraintmask='!@H= & !:LIG'\n"
                     << " /\n" << std::endl;
 
             minFile.close();
         }
 
-        std::string sanderOut="Com_min_GB.out";
-        if(cdtMeta.version==13){
-            cmd="sander13  -O -i Com_min.in -o Com_min_GB.out -p Com.prmtop -c Com.inpcrd -ref Com.inpcrd  -x Com.mdcrd -r Com_min.rst";
-        }else{
-            cmd="sander  -O -i Com_min.in -o Com_min_GB.out -p Com.prmtop -c Com.inpcrd -ref Com.inpcrd  -x Com.mdcrd -r Com_min.rst";
-        }
-        //std::cout <<cmd <<std::endl;
-        errMesg="Complex minimization fails";
-        command(cmd, errMesg);
+        errMesg = "Complex minimization fails";
+        runProcess({cdtMeta.version == 13 ? "sander13" : "sander", "-O", "-i", "Com_min.in", "-o", "Com_min_GB.out", "-p",
+                    "Com.prmtop", "-c", "Com.inpcrd", "-ref", "Com.inpcrd", "-x", "Com.mdcrd", "-r", "Com_min.rst"},
+                    errMesg);
 
-        boost::scoped_ptr<SanderOutput> pSanderOutput(new SanderOutput());
-        //cdtMeta.comGB=0;
-        //bool success=pSanderOutput->getEAmber(sanderOut,cdtMeta.comGB);
-        //if(!success) throw LBindException("Cannot get complex GB energy");
+        cdtMeta.comGB=0;
+        success=pSanderOutput->getEAmber(sanderOut,cdtMeta.comGB);
+        if(!success) throw LBindException("Cannot get complex GB energy");
+    }
 
-    // end receptor energy re-calculation
+    std::cout << "Complex GB Minimization Energy: " << cdtMeta.comGB <<" kcal/mol."<< std::endl;
 
-    minFName="Com_minGB_2.in";
-    {
-        std::ofstream minFile;
-        try {
-            minFile.open(minFName.c_str());
-        }
-        catch(...){
-            std::string mesg="Cannot open min file: "+minFName;
-            throw LBindException(mesg);
+    // receptor energy calculation
+    amberToPdb("Com.prmtop", "Com_min.rst", "Com_min.pdb", true);
+
+    recTopology(cdtMeta, libDir, ssList);
+
+    if(!nativeSinglePoint(cdtMeta, "REC.prmtop", "REC.inpcrd", 15, "Rec_minGB.out", cdtMeta.recGB)){
+        minFName="Rec_minGB.in";
+        {
+            std::ofstream minFile;
+            try {
+                minFile.open(minFName.c_str());
+            }
+            catch(...){
+                std::string mesg="Cannot open min file: "+minFName;
+                throw LBindException(mesg);
+            }
+
+            minFile << "title..\n"
+                    << "&cntrl\n"
+                    << "  imin   = 1,\n"
+                    << "  ntmin   = 3,\n"
+                    << "  maxcyc = 1,\n"
+                    << "  ncyc   = 1,\n"
+                    << "  ntpr   = 1,\n"
+                    << "  ntb    = 0,\n"
+                    << "  igb    = 5,\n"
+                    << "  gbsa   = 1,\n"
+                    << "  intdiel= " << cdtMeta.intDiel << ",\n"
+                    << "  cut    = 15,\n"
+                    << "  ntr=1,\n"
+                    << "  restraint_wt=5.0,\n"
+                    << "  restraintmask='!@H='\n"
+                    << " /\n";
+
+            minFile.close();
         }
 
-        minFile << "title..\n"
-                << "&cntrl\n"
-                << "  imin   = 1,\n"
-                << "  ntmin   = 1,\n"
-                << "  maxcyc = 0,\n"
-                << "  ncyc   = 0,\n"
-                << "  ntpr   = 1,\n"
-                << "  ntb    = 0,\n"
-                << "  igb    = 5,\n"
-                << "  gbsa   = 1,\n"
-                << "  intdiel= " << cdtMeta.intDiel << ",\n"
-                << "  cut    = 999,\n"
-                << "  ntr=0,\n"
-                << "  restraint_wt=5.0,\n"
-                << "  restraintmask='!@H='\n"
-                << " /\n";
+        errMesg = "MMGBSA::run receptor minimization fails";
+        runProcess({cdtMeta.version == 13 ? "sander13" : "sander", "-O", "-i", "Rec_minGB.in", "-o", "Rec_minGB.out", "-p",
+                    "REC.prmtop", "-c", "REC.inpcrd", "-ref", "REC.inpcrd", "-x", "REC.mdcrd", "-r", "Rec_min.rst"},
+                    errMesg);
 
-        minFile.close();
+        sanderOut="Rec_minGB.out";
+        cdtMeta.recGB=0;
+        success=pSanderOutput->getEnergy(sanderOut, cdtMeta.recGB);
+        if(!success) throw LBindException("Cannot get receptor GB energy");
     }
 
-    if(cdtMeta.version==13){
-        cmd="sander13 -O -i Com_minGB_2.in -o Com_minGB_2.out  -p Com.prmtop -c Com_min.rst -ref Com_min.rst -x Com2.mdcrd -r Com_min2.rst";
-    }else{
-        cmd="sander -O -i Com_minGB_2.in -o Com_minGB_2.out -p Com.prmtop -c Com_min.rst -ref Com_min.rst -x Com2.mdcrd -r Com_min2.rst";
-    }
-    //std::cout <<cmd <<std::endl;
-    errMesg="MMGBSA::run complex energy fails";
-    command(cmd, errMesg);
+    cdtMeta.gbbind=cdtMeta.comGB-cdtMeta.recGB-cdtMeta.ligGB;
 
-    sanderOut="Com_minGB_2.out";
-    cdtMeta.comGB=0;
-    bool success=pSanderOutput->getEnergy(sanderOut, cdtMeta.comGB);
-    if(!success) throw LBindException("Cannot get complex GB energy");
 
-        std::cout << "Complex GB Minimization Energy: " << cdtMeta.comGB <<" kcal/mol."<< std::endl;
+}
 
-        // receptor energy calculation
-        if (cdtMeta.version == 16) {
-            cmd="ambpdb -p Com.prmtop -aatm -c Com_min.rst > Com_min.pdb";
-        } else {
-            cmd="ambpdb -p Com.prmtop -aatm < Com_min.rst > Com_min.pdb";
+
+void CDTgbsa::runNew(CDTmeta &cdtMeta){
+
+        std::vector<std::string> keystrs;
+        tokenize(cdtMeta.key, keystrs, "/");
+        if(keystrs.size()==3){
+            cdtMeta.recID=keystrs[0];
+            cdtMeta.ligID=keystrs[1];
+            cdtMeta.poseID=keystrs[2];
+        }else{
+            throw LBindException("Key should have 3 fields: "+cdtMeta.key);
         }
-        errMesg="ambpdb complex fails";
-        command(cmd, errMesg);
 
-        cmd="grep -v LIG Com_min.pdb > rec_tmp.pdb ";
-        errMesg="Grep REC Com_min.pdb fails";
-        command(cmd, errMesg);
+        std::string libDir=cdtMeta.inputDir+"/lib/";
+        std::string poseDir=cdtMeta.localDir+"/scratch/gbsa/"+cdtMeta.key;
+        cdtMeta.poseDir=poseDir;
 
-        // For receptor energy re-calculation
-        tleapFName="rec_leap.in";
+        makeDir(poseDir);
+        std::string errMesg;
+        chdir(poseDir.c_str());
 
         {
-            std::ofstream tleapFile;
-            try {
-                tleapFile.open(tleapFName.c_str());
-            }
-            catch(...){
-                std::string mesg="Cannot open tleap file: "+tleapFName;
-                throw LBindException(mesg);
-            }
+            ScopedTimer timer("hdf5Read");
+            getLigData(cdtMeta);
 
-            if (cdtMeta.version == 16 || cdtMeta.version==13) {
-                tleapFile << "source leaprc.ff14SB\n";
-                tleapFile << "source leaprc.phosaa10\n";
-            } else {
-                tleapFile << "source leaprc.ff99SB\n";
-            }
+            getDockData(cdtMeta);
 
-            tleapFile << "source leaprc.gaff\n";
-            tleapFile << "source leaprc.water.tip3p\n";
+            getRecData(cdtMeta);
+        }
 
-            for(unsigned int i=0; i<cdtMeta.nonRes.size(); ++i){
-                std::string nonResRaw=cdtMeta.nonRes[i];
-                std::vector<std::string> nonResStrs;
-                const std::string delimiter=".";
-                tokenize(nonResRaw, nonResStrs, delimiter);
-                if(nonResStrs.size()==2 && nonResStrs[1]=="M"){
-                    tleapFile << nonResStrs[0] <<" = loadmol2 "<< libDir << nonResStrs[0] << ".mol2 \n";
-                }else{
-                    tleapFile << "loadoff " << libDir << nonResStrs[0] << ".off \n";
+        complexPdb(cdtMeta, cdtMeta.score_only ? cdtMeta.ligFiles["LIG_min.pdb"] : cdtMeta.ligPdb);
+
+        std::vector<std::vector<int> > ssList;
+        {
+            std::string stdPdbFile="rec_min.pdb";
+            boost::scoped_ptr<Pdb> pPdb(new Pdb() );
+            pPdb->getDisulfide(stdPdbFile, ssList);
+        }
+
+        std::string tleapFName="Com_leap.in";
+        if(!comTopology(cdtMeta)){
+            {
+                std::ofstream tleapFile;
+                try {
+                    tleapFile.open(tleapFName.c_str());
+                }
+                catch(...){
+                    std::string mesg="Cannot open tleap file: "+tleapFName;
+                    throw LBindException(mesg);
                 }
 
-                tleapFile << "loadamberparams "<< libDir << nonResStrs[0] <<".frcmod \n";
-            }
+                if(cdtMeta.version==16 || cdtMeta.version==13){
+                    tleapFile << "source leaprc.ff14SB" << std::endl;
+                    tleapFile << "source leaprc.phosaa10\n";
+                }else{
+                    tleapFile << "source leaprc.ff99SB" << std::endl;
+                }
+                tleapFile << "source leaprc.gaff\n"
+                          << "source leaprc.water.tip3p\n";
+
+                for(unsigned int i=0; i<cdtMeta.nonRes.size(); ++i){
+                    std::string nonResRaw=cdtMeta.nonRes[i];
+                    std::vector<std::string> nonResStrs;
+                    const std::string delimiter=".";
+                    tokenize(nonResRaw, nonResStrs, delimiter);
+                    if(nonResStrs.size()==2 && nonResStrs[1]=="M"){
+                        tleapFile << nonResStrs[0] <<" = loadmol2 "<< libDir << nonResStrs[0] << ".mol2 \n";
+                    }else{
+                        tleapFile << "loadoff " << libDir << nonResStrs[0] << ".off \n";
+                    }
+
+                    tleapFile << "loadamberparams "<< libDir << nonResStrs[0] <<".frcmod \n";
+                }
 
-            tleapFile << "REC = loadpdb rec_tmp.pdb\n";
+                tleapFile << "loadamberparams ligand.frcmod\n"
+                          << "loadoff LIG.lib\n"
+                          << "COM = loadpdb com_init.pdb\n";
 
-            for(unsigned int i=0; i<ssList.size(); ++i){
-                std::vector<int> pair=ssList[i];
-                if(pair.size()==2){
-                    tleapFile << "bond REC."<< pair[0] <<".SG REC." << pair[1] <<".SG \n";
+                for(unsigned int i=0; i<ssList.size(); ++i){
+                    std::vector<int> pair=ssList[i];
+                    if(pair.size()==2){
+                        tleapFile << "bond COM."<< pair[0] <<".SG COM." << pair[1] <<".SG \n";
+                    }
                 }
+
+                tleapFile << "set default PBRadii mbondi2\n"
+                          << "saveamberparm COM Com.prmtop Com.inpcrd\n"
+                          << "quit \n";
+
+                tleapFile.close();
             }
-            tleapFile << "set default PBRadii mbondi2\n"
-                      << "saveamberparm REC REC.prmtop REC.inpcrd\n"
-                      << "quit\n";
 
-            tleapFile.close();
+            errMesg = "Complex tleap fails";
+            runProcess({"tleap", "-f", tleapFName}, errMesg, redirectOut("Com_leap.log", true));
         }
 
-        cmd="tleap -f rec_leap.in >& rec_leap.log";
-        //std::cout <<cmd <<std::endl;
-        errMesg="MMGBSA::run tleap receptor fails";
-        command(cmd, errMesg);
-
-        checkFName="REC.prmtop";
+        std::string checkFName="Com.prmtop";
         {
             if(!fileExist(checkFName)){
-                std::string message="REC.prmtop file does not exist.";
+                std::string message="Com.prmtop file does not exist.";
                 throw LBindException(message);
             }
 
             if(fileEmpty(checkFName)){
-                std::string message="REC.prmtop is empty.";
+                std::string message="Com.prmtop is empty.";
                 throw LBindException(message);
             }
         }
-        // end receptor energy re-calculation
 
-        minFName="Rec_minGB.in";
+        // Skip minimization
+        if(!cdtMeta.minimize){
+            // receptor energy calculation
+            amberToPdb("Com.prmtop", "Com.inpcrd", "Com_min.pdb", true);
+            return;
+        }
+
+        std::string sanderOut="Com_min_GB.out";
+        boost::scoped_ptr<SanderOutput> pSanderOutput(new SanderOutput());
+        std::string minFName="Com_min.in";
+        MinOptions minOpts;
+        minOpts.drms=1.0e-3;
+        if(!nativeMinimize(cdtMeta, "Com.prmtop", "Com.inpcrd", 25, minOpts, "@CA,C,N= & !:LIG", 5.0, sanderOut,
+                           "Com_min.rst", cdtMeta.comGB)){
+            {
+                std::ofstream minFile;
+                try {
+                    minFile.open(minFName.c_str());
+                }
+                catch(...){
+                    std::string mesg="Cannot open min file: "+minFName;
+                    throw LBindException(mesg);
+                }
+                minFile << "title..\n"
+                        << "&cntrl\n"
+                        << "  imin   = 1,\n"
+                        << "  ntmin   = 1,\n"
+                        << "  maxcyc = 2000,\n"
+                        << "  ncyc   = 1000,\n"
+                        << "  ntpr   = 200,\n"
+                        << "  ntb    = 0,\n"
+                        << "  igb    = 5,\n"
+                        << "  gbsa   = 1,\n"
+                        << "  intdiel= " << cdtMeta.intDiel << ",\n"
+                        << "  cut    = 25,\n"
+                        << "  drms=1e-3,\n"
+                        << "  ntr=1,\n"
+                        << "  restraint_wt=5.0,\n"
+                        << "  restraintmask='@CA,C,N= & !:LIG'\n"
+                        << " /\n" << std::endl;
+
+                minFile.close();
+            }
+
+            errMesg = "Complex minimization fails";
+            runProcess({cdtMeta.version == 13 ? "sander13" : "sander", "-O", "-i", "Com_min.in", "-o", "Com_min_GB.out",
+                        "-p", "Com.prmtop", "-c", "Com.inpcrd", "-ref", "Com.inpcrd", "-x", "Com.mdcrd", "-r",
+                        "Com_min.rst"}, errMesg);
+
+            //cdtMeta.comGB=0;
+            //bool success=pSanderOutput->getEAmber(sanderOut,cdtMeta.comGB);
+            //if(!success) throw LBindException("Cannot get complex GB energy");
+        }
+
+    // end receptor energy re-calculation
+
+    bool success=true;
+    if(!nativeSinglePoint(cdtMeta, "Com.prmtop", "Com_min.rst", 999, "Com_minGB_2.out", cdtMeta.comGB)){
+        minFName="Com_minGB_2.in";
         {
             std::ofstream minFile;
             try {
@@ -914,23 +1033,74 @@ void CDTgbsa::runNew(CDTmeta &cdtMeta){
             minFile.close();
         }
 
-        if(cdtMeta.version==13){
-            cmd="sander13 -O -i Rec_minGB.in -o Rec_minGB.out  -p REC.prmtop -c REC.inpcrd -ref REC.inpcrd -x REC.mdcrd -r Rec_min.rst";
-        }else{
-            cmd="sander -O -i Rec_minGB.in -o Rec_minGB.out  -p REC.prmtop -c REC.inpcrd -ref REC.inpcrd -x REC.mdcrd -r Rec_min.rst";
-        }
-        //std::cout <<cmd <<std::endl;
-        errMesg="MMGBSA::run receptor minimization fails";
-        command(cmd, errMesg);
+        errMesg = "MMGBSA::run complex energy fails";
+        runProcess({cdtMeta.version == 13 ? "sander13" : "sander", "-O", "-i", "Com_minGB_2.in", "-o", "Com_minGB_2.out",
+                    "-p", "Com.prmtop", "-c", "Com_min.rst", "-ref", "Com_min.rst", "-x", "Com2.mdcrd", "-r",
+                    "Com_min2.rst"}, errMesg);
 
-        sanderOut="Rec_minGB.out";
-        cdtMeta.recGB=0;
-        success=pSanderOutput->getEnergy(sanderOut, cdtMeta.recGB);
-        if(!success) throw LBindException("Cannot get receptor GB energy");
+        sanderOut="Com_minGB_2.out";
+        cdtMeta.comGB=0;
+        success=pSanderOutput->getEnergy(sanderOut, cdtMeta.comGB);
+        if(!success) throw LBindException("Cannot get complex GB energy");
+    }
+
+        std::cout << "Complex GB Minimization Energy: " << cdtMeta.comGB <<" kcal/mol."<< std::endl;
 
-    cmd="grep LIG Com_min.pdb > lig_tmp.pdb ";
-    errMesg="Grep LIG Com_min.pdb fails";
-    command(cmd, errMesg);
+        // receptor energy calculation
+        amberToPdb("Com.prmtop", "Com_min.rst", "Com_min.pdb", true);
+
+        recTopology(cdtMeta, libDir, ssList);
+
+        if(!nativeSinglePoint(cdtMeta, "REC.prmtop", "REC.inpcrd", 999, "Rec_minGB.out", cdtMeta.recGB)){
+            minFName="Rec_minGB.in";
+            {
+                std::ofstream minFile;
+                try {
+                    minFile.open(minFName.c_str());
+                }
+                catch(...){
+                    std::string mesg="Cannot open min file: "+minFName;
+                    throw LBindException(mesg);
+                }
+
+                minFile << "title..\n"
+                        << "&cntrl\n"
+                        << "  imin   = 1,\n"
+                        << "  ntmin   = 1,\n"
+                        << "  maxcyc = 0,\n"
+                        << "  ncyc   = 0,\n"
+                        << "  ntpr   = 1,\n"
+                        << "  ntb    = 0,\n"
+                        << "  igb    = 5,\n"
+                        << "  gbsa   = 1,\n"
+                        << "  intdiel= " << cdtMeta.intDiel << ",\n"
+                        << "  cut    = 999,\n"
+                        << "  ntr=0,\n"
+                        << "  restraint_wt=5.0,\n"
+                        << "  restraintmask='!@H='\n"
+                        << " /\n";
+
+                minFile.close();
+            }
+
+            errMesg = "MMGBSA::run receptor minimization fails";
+            runProcess({cdtMeta.version == 13 ? "sander13" : "sander", "-O", "-i", "Rec_minGB.in", "-o", "Rec_minGB.out",
+                        "-p", "REC.prmtop", "-c", "REC.inpcrd", "-ref", "REC.inpcrd", "-x", "REC.mdcrd", "-r",
+                        "Rec_min.rst"}, errMesg);
+
+            sanderOut="Rec_minGB.out";
+            cdtMeta.recGB=0;
+            success=pSanderOutput->getEnergy(sanderOut, cdtMeta.recGB);
+            if(!success) throw LBindException("Cannot get receptor GB energy");
+        }
+
+    {
+        Prmtop comTop;
+        comTop.read("Com.prmtop");
+        std::vector<double> xyz;
+        readAmberCoords("Com_min.rst", xyz);
+        AmberPdb(comTop).write("lig_tmp.pdb", xyz, true, AmberPdb::ONLY, "LIG");
+    }
 
     tleapFName="Lig_leap2.in";
     {
@@ -960,10 +1130,8 @@ void CDTgbsa::runNew(CDTmeta &cdtMeta){
         tleapFile.close();
     }
 
-    cmd="tleap -f "+tleapFName+" >& lig_leap.log";
-    //std::cout <<cmd <<std::endl;
-    errMesg="Ligand tleap fails";
-    command(cmd, errMesg);
+    errMesg = "Ligand tleap fails";
+    runProcess({"tleap", "-f", tleapFName}, errMesg, redirectOut("lig_leap.log", true));
     checkFName="LIG.prmtop";
     {
         if(!fileExist(checkFName)){
@@ -978,46 +1146,44 @@ void CDTgbsa::runNew(CDTmeta &cdtMeta){
     }
 
     //! GB energy minimization
-    minFName = "LIG_minGB.in";
-    {
-        std::ofstream minFile;
-        try {
-            minFile.open(minFName.c_str());
-        }
-        catch (...) {
-            std::string mesg = "mmpbsa::receptor()\n\t Cannot open min file: " + minFName;
-            throw LBindException(mesg);
-        }
+    if(!nativeSinglePoint(cdtMeta, "LIG.prmtop", "LIG.inpcrd", 999, "LIG_minGB.out", cdtMeta.ligGB)){
+        minFName = "LIG_minGB.in";
+        {
+            std::ofstream minFile;
+            try {
+                minFile.open(minFName.c_str());
+            }
+            catch (...) {
+                std::string mesg = "mmpbsa::receptor()\n\t Cannot open min file: " + minFName;
+                throw LBindException(mesg);
+            }
 
-        minFile << "title..\n"
-                << "&cntrl\n"
-                << "  imin   = 1,\n"
-                << "  ntmin   = 1,\n"
-                << "  maxcyc = 0,\n"
-                << "  ncyc   = 0,\n"
-                << "  ntpr   = 1,\n"
-                << "  ntb    = 0,\n"
-                << "  igb    = 5,\n"
-                << "  gbsa   = 1,\n"
-                << "  intdiel= " << cdtMeta.intDiel << ",\n"
-                << "  cut    = 999,\n"
-                << " /\n" << std::endl;
+            minFile << "title..\n"
+                    << "&cntrl\n"
+                    << "  imin   = 1,\n"
+                    << "  ntmin   = 1,\n"
+                    << "  maxcyc = 0,\n"
+                    << "  ncyc   = 0,\n"
+                    << "  ntpr   = 1,\n"
+                    << "  ntb    = 0,\n"
+                    << "  igb    = 5,\n"
+                    << "  gbsa   = 1,\n"
+                    << "  intdiel= " << cdtMeta.intDiel << ",\n"
+                    << "  cut    = 999,\n"
+                    << " /\n" << std::endl;
 
-        minFile.close();
-    }
+            minFile.close();
+        }
 
-    if (cdtMeta.version == 13) {
-        cmd = "sander13  -O -i LIG_minGB.in -o LIG_minGB.out  -p LIG.prmtop -c LIG.inpcrd -ref LIG.inpcrd  -x LIG.mdcrd -r LIG_min.rst  >> log";
-    } else {
-        cmd = "sander  -O -i LIG_minGB.in -o LIG_minGB.out  -p LIG.prmtop -c LIG.inpcrd -ref LIG.inpcrd  -x LIG.mdcrd -r LIG_min.rst  >> log";
+        errMesg = "sander ligand minimization fails";
+        runProcess({cdtMeta.version == 13 ? "sander13" : "sander", "-O", "-i", "LIG_minGB.in", "-o", "LIG_minGB.out", "-p",
+                    "LIG.prmtop", "-c", "LIG.inpcrd", "-ref", "LIG.inpcrd", "-x", "LIG.mdcrd", "-r", "LIG_min.rst"},
+                    errMesg, redirectOut("log", false, true));
+        sanderOut = "LIG_minGB.out";
+        double ligGBen = 0;
+        success = pSanderOutput->getEnergy(sanderOut, ligGBen);
+        cdtMeta.ligGB = ligGBen;
     }
-    //std::cout <<cmd <<std::endl;
-    errMesg = "sander ligand minimization fails";
-    command(cmd, errMesg);
-    sanderOut = "LIG_minGB.out";
-    double ligGBen = 0;
-    success = pSanderOutput->getEnergy(sanderOut, ligGBen);
-    cdtMeta.ligGB = ligGBen;
 
         cdtMeta.gbbind=cdtMeta.comGB-cdtMeta.recGB-cdtMeta.ligGB;
 
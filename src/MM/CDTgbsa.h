@@ -7,6 +7,12 @@
 
 // It is ugly
 
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Common/ScopedTimer.h"
+#include "MM/GBMinimizer.h"
 
 namespace LBIND{
 
@@ -32,6 +38,8 @@ struct CDTmeta{
     bool score_only;
     bool newapp;
     bool minimize;
+    bool nativeGB=false; // GB minimizations and single-point energies in-process (MM/GBEnergy) instead of sander
+    bool mergeTop=false; // Com.prmtop of the later poses merged in-process (Parser/PrmtopMerge.h) instead of tleap
     bool useScoreCF; //switch to turn on score cutoff
     double scoreCF;  // value for score cutoff
     double intDiel;
@@ -48,6 +56,15 @@ struct CDTmeta{
 
     std::vector<std::string> nonRes;
 
+    // Streaming (CDTStream): inputs handed over in memory instead of read from HDF5
+    std::map<std::string, std::string> ligFiles; // ligand file name -> contents
+    std::string poses;                           // docked poses PDBQT
+    // Grouped poses (CDT4mmgbsa): receptor data read once per receptor-ligand pair
+    std::map<std::string, std::string> recFiles; // receptor file name -> contents
+    std::string pose;                            // PDBQT of poseID, split from poses
+    std::string ligPdb;                          // PDB lines of the posed ligand, set by getDockData
+    PhaseTimes timing;                           // written to meta/timing, without the HDF5 write itself
+
 };
 
 class CDTgbsa {
@@ -60,13 +77,45 @@ public:
     static void run(CDTmeta & cdtMeta);
     static void runNew(CDTmeta & cdtMeta);
 
+    //! Read the ligand, receptor and docking data of the pair cdtMeta.key ("rec/lig") into
+    //! cdtMeta once for all its poses, and split the poses by model ID.
+    static void loadPair(CDTmeta & cdtMeta, std::map<int, std::string>& models, std::map<int, double>& scores);
+
 private:
     static void getLigData(CDTmeta & cdtMeta);
     static void getRecData(CDTmeta & cdtMeta);
     static void getDockData(CDTmeta & cdtMeta);
 
+    static void loadLigData(CDTmeta & cdtMeta);
+    static void loadRecData(CDTmeta & cdtMeta);
+    static void loadDockData(CDTmeta & cdtMeta);
+
     static void ligMinimize(CDTmeta &cdtMeta);
 
+    //! com_init.pdb from the receptor rec_min.pdb and the ligand PDB lines, in one write.
+    static void complexPdb(CDTmeta &cdtMeta, const std::string& ligPdb);
+
+    //! Single-point energy (imin=1, igb=5, gbsa=1) of a topology and coordinate file with MM/GBEnergy,
+    //! the terms written to outFile. False without cdtMeta.nativeGB or for an unsupported topology,
+    //! the caller then runs sander.
+    static bool nativeSinglePoint(CDTmeta &cdtMeta, const std::string& prmtopFile, const std::string& crdFile,
+                                  double cut, const std::string& outFile, double& energy);
+
+    //! GB minimization (imin=1, igb=5, gbsa=1) of crdFile with MM/GBMinimizer, restrained on an Amber mask
+    //! when weight>0; writes rstFile and the log to outFile, energy is the unrestrained final energy.
+    //! False as for nativeSinglePoint.
+    static bool nativeMinimize(CDTmeta &cdtMeta, const std::string& prmtopFile, const std::string& crdFile,
+                               double cut, const MinOptions& minOpts, const std::string& mask, double weight,
+                               const std::string& outFile, const std::string& rstFile, double& energy);
+
+    //! REC.prmtop and REC.inpcrd of the minimized complex; tleap runs once per receptor and worker.
+    static void recTopology(CDTmeta &cdtMeta, const std::string& libDir, const std::vector<std::vector<int> >& ssList);
+
+    //! Com.prmtop and Com.inpcrd without tleap: the cached receptor topology merged with LIG.prmtop, the
+    //! coordinates taken from com_init.pdb. False without cdtMeta.mergeTop, before the receptor is cached
+    //! or when the topologies cannot be merged; the caller then runs tleap.
+    static bool comTopology(CDTmeta &cdtMeta);
+
 };
 
 }//namespace LBIND
@@ -0,0 +1,723 @@
+//
+// In-process Amber energy with the OBC generalized Born model (igb=5).
+//
+
+#include "MM/GBEnergy.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iomanip>
+
+#include "Common/Affinity.h"
+#include "Common/LBindException.h"
+#include "Common/ParallelFor.h"
+#include "Parser/Prmtop.h"
+
+namespace LBIND {
+
+namespace {
+
+const double PI=3.14159265358979323846;
+const double probeRadius=1.4;
+
+// OBC II, as igb=5 in sander
+const double gbOffset=0.09;
+const double gbAlpha=1.0;
+const double gbBeta=0.8;
+const double gbGamma=4.85;
+
+inline double dist2(const std::vector<double>& xyz, int i, int j){
+    double dx=xyz[3*i]-xyz[3*j];
+    double dy=xyz[3*i+1]-xyz[3*j+1];
+    double dz=xyz[3*i+2]-xyz[3*j+2];
+    return dx*dx+dy*dy+dz*dz;
+}
+
+//! Descreening integral of Hawkins, Cramer and Truhlar of a sphere ri by a sphere sj at distance r,
+//! in the closed forms of sander's egb; its derivative by r goes to dI when not NULL.
+inline double descreen(double ri, double sj, double r, double* dI){
+    double r2=r*r;
+    if(r>ri+sj){
+        double d2=r2-sj*sj;
+        double lg=std::log((r-sj)/(r+sj));
+        if(dI) *dI=0.5*(-2.0*r*sj/(d2*d2)-0.5*lg/r2+sj/(r*d2));
+        return 0.5*(sj/d2+0.5*lg/r);
+    }else if(r>std::fabs(ri-sj)){
+        double theta=0.5*(r2+ri*ri-sj*sj)/(ri*r);
+        double uij=1.0/(r+sj);
+        double lg=std::log(ri*uij);
+        if(dI){
+            double dTheta=0.5*(r2-ri*ri+sj*sj)/(ri*r2);
+            *dI=0.25*(-dTheta/ri+uij*uij-lg/r2-uij/r);
+        }
+        return 0.25*((2.0-theta)/ri-uij+lg/r);
+    }else if(ri<sj){
+        double d2=r2-sj*sj;
+        double lg=std::log((sj-r)/(sj+r));
+        if(dI) *dI=0.5*(-2.0*r*sj/(d2*d2)-0.5*lg/r2+sj/(r*d2));
+        return 0.5*(sj/d2+2.0/ri+0.5*lg/r);
+    }
+    if(dI) *dI=0;
+    return 0;
+}
+
+//! Atom index from a prmtop atom pointer (3*(i-1), possibly negated).
+inline int atomIndex(int pointer){
+    return std::abs(pointer)/3;
+}
+
+}
+
+//! Atoms binned in cubic cells of the cutoff size; neighbors are searched in the 27 surrounding cells.
+//! With a skin the cells are larger than the cutoff, and the bins stay valid until an atom moves skin/2.
+class GBEnergy::CellList {
+public:
+    CellList(const std::vector<double>& xyz, double cutoff, double skin=0) : cut2(cutoff*cutoff) {
+        int n=xyz.size()/3;
+        double lo[3]={0, 0, 0};
+        double hi[3]={0, 0, 0};
+        for(int d=0; d<3 && n>0; ++d){
+            lo[d]=hi[d]=xyz[d];
+            for(int i=1; i<n; ++i){
+                lo[d]=std::min(lo[d], xyz[3*i+d]);
+                hi[d]=std::max(hi[d], xyz[3*i+d]);
+            }
+        }
+        size=std::max(cutoff+skin, 1.0);
+        for(int d=0; d<3; ++d){
+            origin[d]=lo[d];
+            dim[d]=std::max(1, static_cast<int>((hi[d]-lo[d])/size)+1);
+        }
+
+        cellOf.resize(n);
+        start.assign(dim[0]*dim[1]*dim[2]+1, 0);
+        for(int i=0; i<n; ++i){
+            int c[3];
+            for(int d=0; d<3; ++d){
+                c[d]=std::min(dim[d]-1, static_cast<int>((xyz[3*i+d]-origin[d])/size));
+            }
+            cellOf[i]=(c[0]*dim[1]+c[1])*dim[2]+c[2];
+            ++start[cellOf[i]+1];
+        }
+        for(size_t c=1; c<start.size(); ++c) start[c]+=start[c-1];
+        atoms.resize(n);
+        std::vector<int> fill(start.begin(), start.end()-1);
+        for(int i=0; i<n; ++i) atoms[fill[cellOf[i]]++]=i;
+    }
+
+    //! f(j, r2) for every atom j != i within the cutoff.
+    template<class F>
+    void forNeighbors(const std::vector<double>& xyz, int i, F f) const {
+        int cell=cellOf[i];
+        int cz=cell%dim[2];
+        int cy=(cell/dim[2])%dim[1];
+        int cx=cell/(dim[1]*dim[2]);
+        for(int x=std::max(0, cx-1); x<=std::min(dim[0]-1, cx+1); ++x){
+            for(int y=std::max(0, cy-1); y<=std::min(dim[1]-1, cy+1); ++y){
+                for(int z=std::max(0, cz-1); z<=std::min(dim[2]-1, cz+1); ++z){
+                    int c=(x*dim[1]+y)*dim[2]+z;
+                    for(int a=start[c]; a<start[c+1]; ++a){
+                        int j=atoms[a];
+                        if(j==i) continue;
+                        double r2=dist2(xyz, i, j);
+                        if(r2<cut2) f(j, r2);
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    double cut2;
+    double size;
+    double origin[3];
+    int dim[3];
+    std::vector<int> cellOf;
+    std::vector<int> start;
+    std::vector<int> atoms;
+};
+
+double GBTerms::total() const {
+    return bond+angle+dihedral+vdw+eel+egb+vdw14+eel14+esurf;
+}
+
+void GBTerms::print(std::ostream& os) const {
+    std::ios_base::fmtflags flags=os.flags();
+    std::streamsize precision=os.precision();
+    os << std::fixed << std::setprecision(4)
+       << " ENERGY   = " << std::setw(14) << total() << "\n"
+       << " BOND     = " << std::setw(14) << bond << "  ANGLE    = " << std::setw(14) << angle
+       << "  DIHED      = " << std::setw(14) << dihedral << "\n"
+       << " VDWAALS  = " << std::setw(14) << vdw << "  EEL      = " << std::setw(14) << eel
+       << "  EGB        = " << std::setw(14) << egb << "\n"
+       << " 1-4 VDW  = " << std::setw(14) << vdw14 << "  1-4 EEL  = " << std::setw(14) << eel14
+       << "  ESURF      = " << std::setw(14) << esurf << std::endl;
+    os.flags(flags);
+    os.precision(precision);
+}
+
+GBEnergy::GBEnergy(const Prmtop& prmtop){
+    if(prmtop.pointer(Prmtop::IFBOX)!=0){
+        throw LBindException("GBEnergy >> periodic topologies are not supported");
+    }
+    if(prmtop.pointer(Prmtop::NUMEXTRA)!=0){
+        throw LBindException("GBEnergy >> extra points are not supported");
+    }
+
+    numAtoms=prmtop.natom();
+    numTypes=prmtop.pointer(Prmtop::NTYPES);
+
+    charge=prmtop.reals("CHARGE");
+    rborn=prmtop.reals("RADII");
+    screen=prmtop.reals("SCREEN");
+    acoef=prmtop.reals("LENNARD_JONES_ACOEF");
+    bcoef=prmtop.reals("LENNARD_JONES_BCOEF");
+
+    typeIndex=prmtop.ints("ATOM_TYPE_INDEX");
+    for(int& t : typeIndex) --t;
+    nbIndex=prmtop.ints("NONBONDED_PARM_INDEX");
+    for(int& idx : nbIndex){
+        // Negative indices are 10-12 hydrogen bond terms, absent from current force fields
+        idx=(idx>0) ? idx-1 : -1;
+    }
+
+    if(static_cast<int>(charge.size())<numAtoms || static_cast<int>(rborn.size())<numAtoms
+       || static_cast<int>(screen.size())<numAtoms || static_cast<int>(typeIndex.size())<numAtoms){
+        throw LBindException("GBEnergy >> truncated per-atom sections in the topology");
+    }
+
+    std::vector<double> bondK=prmtop.reals("BOND_FORCE_CONSTANT");
+    std::vector<double> bondR=prmtop.reals("BOND_EQUIL_VALUE");
+    for(const char* flag : {"BONDS_INC_HYDROGEN", "BONDS_WITHOUT_HYDROGEN"}){
+        std::vector<int> list=prmtop.ints(flag);
+        for(size_t b=0; b+2<list.size(); b+=3){
+            int type=list[b+2]-1;
+            bonds.push_back(Bond{atomIndex(list[b]), atomIndex(list[b+1]), bondK[type], bondR[type]});
+        }
+    }
+
+    std::vector<double> angleK=prmtop.reals("ANGLE_FORCE_CONSTANT");
+    std::vector<double> angleT=prmtop.reals("ANGLE_EQUIL_VALUE");
+    for(const char* flag : {"ANGLES_INC_HYDROGEN", "ANGLES_WITHOUT_HYDROGEN"}){
+        std::vector<int> list=prmtop.ints(flag);
+        for(size_t a=0; a+3<list.size(); a+=4){
+            int type=list[a+3]-1;
+            angles.push_back(Angle{atomIndex(list[a]), atomIndex(list[a+1]), atomIndex(list[a+2]),
+                                   angleK[type], angleT[type]});
+        }
+    }
+
+    std::vector<double> dihK=prmtop.reals("DIHEDRAL_FORCE_CONSTANT");
+    std::vector<double> dihN=prmtop.reals("DIHEDRAL_PERIODICITY");
+    std::vector<double> dihPhase=prmtop.reals("DIHEDRAL_PHASE");
+    std::vector<double> scee=prmtop.has("SCEE_SCALE_FACTOR") ? prmtop.reals("SCEE_SCALE_FACTOR")
+                                                              : std::vector<double>(dihK.size(), 1.2);
+    std::vector<double> scnb=prmtop.has("SCNB_SCALE_FACTOR") ? prmtop.reals("SCNB_SCALE_FACTOR")
+                                                              : std::vector<double>(dihK.size(), 2.0);
+    for(const char* flag : {"DIHEDRALS_INC_HYDROGEN", "DIHEDRALS_WITHOUT_HYDROGEN"}){
+        std::vector<int> list=prmtop.ints(flag);
+        for(size_t d=0; d+4<list.size(); d+=5){
+            int type=list[d+4]-1;
+            // A negative third atom marks a dihedral whose 1-4 pair is counted elsewhere
+            // (multi-term or ring); a negative fourth atom marks an improper.
+            Dihedral dih{atomIndex(list[d]), atomIndex(list[d+1]), atomIndex(list[d+2]), atomIndex(list[d+3]),
+                         dihK[type], dihN[type], dihPhase[type], list[d+2]>=0 && list[d+3]>=0,
+                         scee[type]>0 ? scee[type] : 1.2, scnb[type]>0 ? scnb[type] : 2.0};
+            dihedrals.push_back(dih);
+        }
+    }
+
+    std::vector<int> numExcluded=prmtop.ints("NUMBER_EXCLUDED_ATOMS");
+    std::vector<int> excludedList=prmtop.ints("EXCLUDED_ATOMS_LIST");
+    excluded.resize(numAtoms);
+    size_t pos=0;
+    for(int i=0; i<numAtoms && i<static_cast<int>(numExcluded.size()); ++i){
+        for(int e=0; e<numExcluded[i] && pos<excludedList.size(); ++e, ++pos){
+            // 0 is the placeholder of an atom without exclusions
+            int j=excludedList[pos]-1;
+            if(j>i && j<numAtoms){
+                excluded[i].push_back(j);
+                excluded[j].push_back(i);
+            }
+        }
+    }
+    for(std::vector<int>& excl : excluded) std::sort(excl.begin(), excl.end());
+
+    assignLcpo(prmtop);
+}
+
+void GBEnergy::assignLcpo(const Prmtop& prmtop){
+    std::vector<std::string> types=prmtop.strings("AMBER_ATOM_TYPE");
+    std::vector<int> element;
+    if(prmtop.has("ATOMIC_NUMBER")){
+        element=prmtop.ints("ATOMIC_NUMBER");
+    }else{
+        element.resize(numAtoms, 0);
+        for(int i=0; i<numAtoms && i<static_cast<int>(types.size()); ++i){
+            switch(std::toupper(types[i].empty() ? ' ' : types[i][0])){
+                case 'H': element[i]=1; break;
+                case 'C': element[i]=6; break;
+                case 'N': element[i]=7; break;
+                case 'O': element[i]=8; break;
+                case 'P': element[i]=15; break;
+                case 'S': element[i]=16; break;
+                default: element[i]=0;
+            }
+        }
+    }
+
+    std::vector<int> numBonds(numAtoms, 0);
+    std::vector<int> numHeavy(numAtoms, 0);
+    for(const Bond& b : bonds){
+        ++numBonds[b.i];
+        ++numBonds[b.j];
+        if(element[b.j]!=1) ++numHeavy[b.i];
+        if(element[b.i]!=1) ++numHeavy[b.j];
+    }
+
+    // LCPO parameters (Weiser, Shenkin and Still, J. Comput. Chem. 20, 217 (1999)) by element,
+    // hybridization and number of bonded heavy atoms.
+    const Lcpo none={0, 0, 0, 0, 0};
+    const Lcpo cSp3[5]={{1.70, 0.77887, -0.28063, -0.0012968, 0.00039328},
+                        {1.70, 0.77887, -0.28063, -0.0012968, 0.00039328},
+                        {1.70, 0.56482, -0.19608, -0.0010219, 0.0002658},
+                        {1.70, 0.23348, -0.072627, -0.00020079, 0.00007967},
+                        {1.70, 0.00000, 0.00000, 0.00000, 0.00000}};
+    const Lcpo cSp2[2]={{1.70, 0.51245, -0.15966, -0.00019781, 0.00016392},
+                        {1.70, 0.070344, -0.019015, -0.000022009, 0.000016875}};
+    const Lcpo oSp3[2]={{1.60, 0.77914, -0.25262, -0.0016056, 0.00035071},
+                        {1.60, 0.49392, -0.16038, -0.00015512, 0.00016453}};
+    const Lcpo oSp2={1.60, 0.68563, -0.1868, -0.00135573, 0.00023743};
+    const Lcpo oCarboxyl={1.60, 0.88857, -0.33421, -0.0018683, 0.00049372};
+    const Lcpo nSp3[3]={{1.65, 0.078602, -0.29198, -0.0006537, 0.00036247},
+                        {1.65, 0.22599, -0.036648, -0.0012297, 0.000080038},
+                        {1.65, 0.051481, -0.012603, -0.00032006, 0.000024774}};
+    const Lcpo nSp2[3]={{1.65, 0.73511, -0.22116, -0.00089148, 0.0002523},
+                        {1.65, 0.41102, -0.12254, -0.000075448, 0.00011804},
+                        {1.65, 0.062577, -0.017874, -0.00008312, 0.000019849}};
+    const Lcpo sAny[2]={{1.90, 0.7722, -0.26393, 0.0010629, 0.0002179},
+                        {1.90, 0.54581, -0.19477, -0.0012873, 0.00029247}};
+    const Lcpo pAny[2]={{1.90, 0.3865, -0.18249, -0.0036598, 0.0004264},
+                        {1.90, 0.03873, -0.0089339, 0.0000083582, 0.0000030381}};
+
+    lcpo.assign(numAtoms, none);
+    for(int i=0; i<numAtoms; ++i){
+        int heavy=numHeavy[i];
+        std::string type=(i<static_cast<int>(types.size())) ? types[i] : "";
+        switch(element[i]){
+            case 1:
+                break;
+            case 6:
+                lcpo[i]=(numBonds[i]==4) ? cSp3[std::min(heavy, 4)] : cSp2[(heavy>=3) ? 1 : 0];
+                break;
+            case 7:
+                lcpo[i]=(numBonds[i]==4 || type=="N3" || type=="n3") ? nSp3[std::max(0, std::min(heavy, 3)-1)]
+                                                                       : nSp2[std::max(0, std::min(heavy, 3)-1)];
+                break;
+            case 8:
+                if(type=="O2"){
+                    lcpo[i]=oCarboxyl;
+                }else if(numBonds[i]>=2){
+                    lcpo[i]=oSp3[(heavy>=2) ? 1 : 0];
+                }else{
+                    lcpo[i]=oSp2;
+                }
+                break;
+            case 16:
+                lcpo[i]=sAny[(heavy>=2) ? 1 : 0];
+                break;
+            case 15:
+                lcpo[i]=pAny[(heavy>=4) ? 1 : 0];
+                break;
+            default:
+                // Halogens and metals: treated as a terminal sp3 carbon
+                lcpo[i]=cSp3[1];
+        }
+    }
+}
+
+GBEnergy::~GBEnergy(){
+}
+
+GBTerms GBEnergy::compute(const std::vector<double>& xyz, const GBOptions& opts) const {
+    if(static_cast<int>(xyz.size())!=3*numAtoms){
+        throw LBindException("GBEnergy >> coordinates do not match the topology");
+    }
+    int threads=(opts.threads>0) ? opts.threads : numAffinityCpus();
+
+    GBTerms terms;
+    bonded(xyz, terms, NULL);
+
+    std::vector<double> radii;
+    {
+        CellList cells(xyz, opts.rgbmax);
+        bornRadii(xyz, cells, threads, radii, NULL);
+    }
+    {
+        CellList cells(xyz, opts.cut);
+        pairs(xyz, cells, radii, opts, threads, terms, NULL, NULL);
+    }
+
+    double maxRadius=maxLcpoRadius();
+    if(maxRadius>0){
+        CellList cells(xyz, 2.0*(maxRadius+probeRadius));
+        terms.esurf=surfaceArea(xyz, cells, opts.surften, threads, NULL);
+    }
+    return terms;
+}
+
+GBTerms GBEnergy::gradient(const std::vector<double>& xyz, const GBOptions& opts, std::vector<double>& grad){
+    if(static_cast<int>(xyz.size())!=3*numAtoms){
+        throw LBindException("GBEnergy >> coordinates do not match the topology");
+    }
+    int threads=(opts.threads>0) ? opts.threads : numAffinityCpus();
+
+    bool rebuild=!gbCells || opts.cut!=cellOpts.cut || opts.rgbmax!=cellOpts.rgbmax || opts.skin!=cellOpts.skin;
+    double limit2=0.25*opts.skin*opts.skin;
+    for(int i=0; i<3*numAtoms && !rebuild; i+=3){
+        double dx=xyz[i]-cellXyz[i];
+        double dy=xyz[i+1]-cellXyz[i+1];
+        double dz=xyz[i+2]-cellXyz[i+2];
+        rebuild=(dx*dx+dy*dy+dz*dz>=limit2);
+    }
+    if(rebuild){
+        double maxRadius=maxLcpoRadius();
+        gbCells.reset(new CellList(xyz, opts.rgbmax, opts.skin));
+        pairCells.reset(new CellList(xyz, opts.cut, opts.skin));
+        sasaCells.reset((maxRadius>0) ? new CellList(xyz, 2.0*(maxRadius+probeRadius), opts.skin) : NULL);
+        cellXyz=xyz;
+        cellOpts=opts;
+    }
+
+    grad.assign(3*numAtoms, 0.0);
+    GBTerms terms;
+    bonded(xyz, terms, grad.data());
+
+    dBorn.resize(numAtoms);
+    bornRadii(xyz, *gbCells, threads, born, dBorn.data());
+    dEdB.assign(numAtoms, 0.0);
+    pairs(xyz, *pairCells, born, opts, threads, terms, grad.data(), dEdB.data());
+    bornChain(xyz, *gbCells, dEdB, dBorn, threads, grad.data());
+
+    if(sasaCells){
+        sasaGrads.resize(threads);
+        terms.esurf=surfaceArea(xyz, *sasaCells, opts.surften, threads, &sasaGrads);
+        for(const std::vector<double>& g : sasaGrads){
+            for(int k=0; k<3*numAtoms; ++k) grad[k]+=g[k];
+        }
+    }
+    return terms;
+}
+
+void GBEnergy::bonded(const std::vector<double>& xyz, GBTerms& terms, double* grad) const {
+    for(const Bond& b : bonds){
+        double r=std::sqrt(dist2(xyz, b.i, b.j));
+        double dr=r-b.r0;
+        terms.bond+=b.k*dr*dr;
+        if(grad){
+            double de=2.0*b.k*dr/r;
+            for(int d=0; d<3; ++d){
+                double g=de*(xyz[3*b.i+d]-xyz[3*b.j+d]);
+                grad[3*b.i+d]+=g;
+                grad[3*b.j+d]-=g;
+            }
+        }
+    }
+
+    for(const Angle& a : angles){
+        double v1[3], v2[3];
+        for(int d=0; d<3; ++d){
+            v1[d]=xyz[3*a.i+d]-xyz[3*a.j+d];
+            v2[d]=xyz[3*a.k+d]-xyz[3*a.j+d];
+        }
+        double dot=v1[0]*v2[0]+v1[1]*v2[1]+v1[2]*v2[2];
+        double n1=std::sqrt(v1[0]*v1[0]+v1[1]*v1[1]+v1[2]*v1[2]);
+        double n2=std::sqrt(v2[0]*v2[0]+v2[1]*v2[1]+v2[2]*v2[2]);
+        double c=std::max(-1.0, std::min(1.0, dot/(n1*n2)));
+        double dt=std::acos(c)-a.theta0;
+        terms.angle+=a.k0*dt*dt;
+        if(grad){
+            // dE/dc, with sin(theta) kept away from 0 for linear angles
+            double de=-2.0*a.k0*dt/std::max(1.0e-8, std::sqrt(1.0-c*c));
+            for(int d=0; d<3; ++d){
+                double gi=de*(v2[d]/(n1*n2)-c*v1[d]/(n1*n1));
+                double gk=de*(v1[d]/(n1*n2)-c*v2[d]/(n2*n2));
+                grad[3*a.i+d]+=gi;
+                grad[3*a.k+d]+=gk;
+                grad[3*a.j+d]-=gi+gk;
+            }
+        }
+    }
+
+    for(const Dihedral& dih : dihedrals){
+        double b1[3], b2[3], b3[3];
+        for(int d=0; d<3; ++d){
+            b1[d]=xyz[3*dih.j+d]-xyz[3*dih.i+d];
+            b2[d]=xyz[3*dih.k+d]-xyz[3*dih.j+d];
+            b3[d]=xyz[3*dih.l+d]-xyz[3*dih.k+d];
+        }
+        double n1[3]={b1[1]*b2[2]-b1[2]*b2[1], b1[2]*b2[0]-b1[0]*b2[2], b1[0]*b2[1]-b1[1]*b2[0]};
+        double n2[3]={b2[1]*b3[2]-b2[2]*b3[1], b2[2]*b3[0]-b2[0]*b3[2], b2[0]*b3[1]-b2[1]*b3[0]};
+        double b2len2=b2[0]*b2[0]+b2[1]*b2[1]+b2[2]*b2[2];
+        double b2len=std::sqrt(b2len2);
+        double y=b2len*(b1[0]*n2[0]+b1[1]*n2[1]+b1[2]*n2[2]);
+        double x=n1[0]*n2[0]+n1[1]*n2[1]+n1[2]*n2[2];
+        double phi=std::atan2(y, x);
+        double period=std::fabs(dih.n);
+        terms.dihedral+=dih.k0*(1.0+std::cos(period*phi-dih.phase));
+        if(grad){
+            double n1len2=n1[0]*n1[0]+n1[1]*n1[1]+n1[2]*n1[2];
+            double n2len2=n2[0]*n2[0]+n2[1]*n2[1]+n2[2]*n2[2];
+            if(n1len2>1.0e-12 && n2len2>1.0e-12){
+                double de=-dih.k0*period*std::sin(period*phi-dih.phase);
+                double f12=(b1[0]*b2[0]+b1[1]*b2[1]+b1[2]*b2[2])/b2len2;
+                double f32=(b3[0]*b2[0]+b3[1]*b2[1]+b3[2]*b2[2])/b2len2;
+                for(int d=0; d<3; ++d){
+                    double gi=-de*b2len*n1[d]/n1len2;
+                    double gl=de*b2len*n2[d]/n2len2;
+                    grad[3*dih.i+d]+=gi;
+                    grad[3*dih.l+d]+=gl;
+                    grad[3*dih.j+d]+=f32*gl-(f12+1.0)*gi;
+                    grad[3*dih.k+d]+=f12*gi-(f32+1.0)*gl;
+                }
+            }
+        }
+
+        if(dih.pair14){
+            double r2=dist2(xyz, dih.i, dih.l);
+            double r=std::sqrt(r2);
+            double eel=charge[dih.i]*charge[dih.l]/(r*dih.scee);
+            terms.eel14+=eel;
+            double de=-0.5*eel/r2;
+            int idx=nbIndex[numTypes*typeIndex[dih.i]+typeIndex[dih.l]];
+            if(idx>=0){
+                double r6i=1.0/(r2*r2*r2);
+                double a=acoef[idx]*r6i*r6i/dih.scnb;
+                double b=bcoef[idx]*r6i/dih.scnb;
+                terms.vdw14+=a-b;
+                de+=(-6.0*a+3.0*b)/r2;
+            }
+            if(grad){
+                for(int d=0; d<3; ++d){
+                    double g=2.0*de*(xyz[3*dih.i+d]-xyz[3*dih.l+d]);
+                    grad[3*dih.i+d]+=g;
+                    grad[3*dih.l+d]-=g;
+                }
+            }
+        }
+    }
+}
+
+void GBEnergy::bornRadii(const std::vector<double>& xyz, const CellList& cells, int threads,
+                         std::vector<double>& born, double* dBorn) const {
+    born.resize(numAtoms);
+
+    parallelFor(numAtoms, threads, [&](int begin, int end, int){
+        for(int i=begin; i<end; ++i){
+            double ri=rborn[i]-gbOffset;
+            double sum=0;
+            cells.forNeighbors(xyz, i, [&](int j, double r2){
+                sum+=descreen(ri, screen[j]*(rborn[j]-gbOffset), std::sqrt(r2), NULL);
+            });
+
+            // OBC rescaling of the effective radius
+            double psi=sum*ri;
+            double th=std::tanh((gbAlpha-gbBeta*psi+gbGamma*psi*psi)*psi);
+            born[i]=1.0/(1.0/ri-th/rborn[i]);
+            if(dBorn){
+                dBorn[i]=born[i]*born[i]*(1.0-th*th)*(gbAlpha-2.0*gbBeta*psi+3.0*gbGamma*psi*psi)*ri/rborn[i];
+            }
+        }
+    });
+}
+
+void GBEnergy::pairs(const std::vector<double>& xyz, const CellList& cells, const std::vector<double>& born,
+                     const GBOptions& opts, int threads, GBTerms& terms, double* grad, double* dEdB) const {
+    double intDielI=1.0/opts.intDiel;
+    double gbScale=intDielI-1.0/opts.extDiel;
+
+    // Each pair is visited from both atoms; the energy is counted from the lower index, and with
+    // gradients each atom accumulates its own derivatives, so threads write disjoint atoms.
+    std::vector<GBTerms> partial(threads);
+    parallelFor(numAtoms, threads, [&](int begin, int end, int t){
+        GBTerms& part=partial[t];
+        for(int i=begin; i<end; ++i){
+            double qi=charge[i];
+            double bi=born[i];
+            const std::vector<int>& excl=excluded[i];
+            int ti=numTypes*typeIndex[i];
+            double gx=0, gy=0, gz=0;
+
+            // Self term of the GB polarization
+            part.egb-=0.5*gbScale*qi*qi/bi;
+            double db=0.5*gbScale*qi*qi/(bi*bi);
+
+            cells.forNeighbors(xyz, i, [&](int j, double r2){
+                if(j<i && !grad) return;
+                double qiqj=qi*charge[j];
+                double bb=bi*born[j];
+                double ex=std::exp(-r2/(4.0*bb));
+                double f2=r2+bb*ex;
+                double f=std::sqrt(f2);
+                if(j>i) part.egb-=gbScale*qiqj/f;
+
+                double de=0;    // dE/dr2
+                if(grad){
+                    double dEdf=gbScale*qiqj/f2;
+                    de+=dEdf*(1.0-0.25*ex)/(2.0*f);
+                    db+=dEdf*ex*(1.0+r2/(4.0*bb))/(2.0*f)*born[j];
+                }
+
+                if(!std::binary_search(excl.begin(), excl.end(), j)){
+                    double eel=intDielI*qiqj/std::sqrt(r2);
+                    if(j>i) part.eel+=eel;
+                    de-=0.5*eel/r2;
+                    int idx=nbIndex[ti+typeIndex[j]];
+                    if(idx>=0){
+                        double r6i=1.0/(r2*r2*r2);
+                        double a=acoef[idx]*r6i*r6i;
+                        double b=bcoef[idx]*r6i;
+                        if(j>i) part.vdw+=a-b;
+                        de+=(-6.0*a+3.0*b)/r2;
+                    }
+                }
+                if(grad){
+                    gx+=2.0*de*(xyz[3*i]-xyz[3*j]);
+                    gy+=2.0*de*(xyz[3*i+1]-xyz[3*j+1]);
+                    gz+=2.0*de*(xyz[3*i+2]-xyz[3*j+2]);
+                }
+            });
+
+            if(grad){
+                grad[3*i]+=gx;
+                grad[3*i+1]+=gy;
+                grad[3*i+2]+=gz;
+                dEdB[i]+=db;
+            }
+        }
+    });
+
+    for(const GBTerms& part : partial){
+        terms.egb+=part.egb;
+        terms.eel+=part.eel;
+        terms.vdw+=part.vdw;
+    }
+}
+
+void GBEnergy::bornChain(const std::vector<double>& xyz, const CellList& cells, const std::vector<double>& dEdB,
+                         const std::vector<double>& dBorn, int threads, double* grad) const {
+    // A pair (i, j) enters the Born radius of i (j descreening) and of j (i descreening).
+    parallelFor(numAtoms, threads, [&](int begin, int end, int){
+        for(int i=begin; i<end; ++i){
+            double ri=rborn[i]-gbOffset;
+            double si=screen[i]*ri;
+            double ci=dEdB[i]*dBorn[i];
+            double gx=0, gy=0, gz=0;
+            cells.forNeighbors(xyz, i, [&](int j, double r2){
+                double rj=rborn[j]-gbOffset;
+                double r=std::sqrt(r2);
+                double dij=0, dji=0;
+                descreen(ri, screen[j]*rj, r, &dij);
+                descreen(rj, si, r, &dji);
+                double de=(ci*dij+dEdB[j]*dBorn[j]*dji)/r;
+                gx+=de*(xyz[3*i]-xyz[3*j]);
+                gy+=de*(xyz[3*i+1]-xyz[3*j+1]);
+                gz+=de*(xyz[3*i+2]-xyz[3*j+2]);
+            });
+            grad[3*i]+=gx;
+            grad[3*i+1]+=gy;
+            grad[3*i+2]+=gz;
+        }
+    });
+}
+
+double GBEnergy::maxLcpoRadius() const {
+    double maxRadius=0;
+    for(const Lcpo& p : lcpo) maxRadius=std::max(maxRadius, p.radius);
+    return maxRadius;
+}
+
+double GBEnergy::surfaceArea(const std::vector<double>& xyz, const CellList& cells, double surften, int threads,
+                             std::vector<std::vector<double> >* grads) const {
+    // Area of sphere a buried by sphere b, at distance r, and its derivative by r
+    auto overlap=[](double ra, double rb, double r){
+        return PI*ra*(2.0*ra-r-(ra*ra-rb*rb)/r);
+    };
+    auto dOverlap=[](double ra, double rb, double r){
+        return PI*ra*(-1.0+(ra*ra-rb*rb)/(r*r));
+    };
+
+    if(grads){
+        for(std::vector<double>& g : *grads) g.assign(3*numAtoms, 0.0);
+    }
+
+    std::vector<double> partial(threads, 0.0);
+    parallelFor(numAtoms, threads, [&](int begin, int end, int t){
+        std::vector<int> neighbors;
+        std::vector<double> dist;
+        double* g=grads ? (*grads)[t].data() : NULL;
+        for(int i=begin; i<end; ++i){
+            const Lcpo& pi=lcpo[i];
+            if(pi.radius<=0) continue;
+            double ri=pi.radius+probeRadius;
+
+            neighbors.clear();
+            dist.clear();
+            cells.forNeighbors(xyz, i, [&](int j, double r2){
+                if(lcpo[j].radius<=0) return;
+                double rj=lcpo[j].radius+probeRadius;
+                if(r2<(ri+rj)*(ri+rj)){
+                    neighbors.push_back(j);
+                    dist.push_back(std::sqrt(r2));
+                }
+            });
+
+            double sum2=0, sum3=0, sum4=0;
+            for(size_t a=0; a<neighbors.size(); ++a){
+                int j=neighbors[a];
+                double rj=lcpo[j].radius+probeRadius;
+                double aij=overlap(ri, rj, dist[a]);
+                double cjk=surften*(pi.p3+pi.p4*aij);
+                double ajk=0;
+                for(size_t b=0; b<neighbors.size(); ++b){
+                    if(b==a) continue;
+                    int k=neighbors[b];
+                    double rk=lcpo[k].radius+probeRadius;
+                    double rjk2=dist2(xyz, j, k);
+                    if(rjk2<(rj+rk)*(rj+rk)){
+                        double rjk=std::sqrt(rjk2);
+                        ajk+=overlap(rj, rk, rjk);
+                        if(g){
+                            double de=cjk*dOverlap(rj, rk, rjk)/rjk;
+                            for(int d=0; d<3; ++d){
+                                double gd=de*(xyz[3*j+d]-xyz[3*k+d]);
+                                g[3*j+d]+=gd;
+                                g[3*k+d]-=gd;
+                            }
+                        }
+                    }
+                }
+                sum2+=aij;
+                sum3+=ajk;
+                sum4+=aij*ajk;
+                if(g){
+                    double de=surften*(pi.p2+pi.p4*ajk)*dOverlap(ri, rj, dist[a])/dist[a];
+                    for(int d=0; d<3; ++d){
+                        double gd=de*(xyz[3*i+d]-xyz[3*j+d]);
+                        g[3*i+d]+=gd;
+                        g[3*j+d]-=gd;
+                    }
+                }
+            }
+            double area=pi.p1*4.0*PI*ri*ri+pi.p2*sum2+pi.p3*sum3+pi.p4*sum4;
+            partial[t]+=area;
+        }
+    });
+
+    double total=0;
+    for(double p : partial) total+=p;
+    return surften*total;
+}
+
+}//namespace LBIND
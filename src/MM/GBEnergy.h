@@ -0,0 +1,116 @@
+//
+// In-process Amber energy of one structure with the OBC generalized Born
+// model, the terms of a sander single point with ntb=0, igb=5 and gbsa=1:
+// bonds, angles, dihedrals, 1-4 and non-bonded van der Waals and Coulomb,
+// GB polarization and the LCPO surface area term.
+//
+// The topology is read once from a Prmtop; compute() then only needs the
+// coordinates. The non-bonded, Born radius and surface area loops run over
+// cell lists, split over threads. gradient() adds the analytic first
+// derivatives for minimization (MM/GBMinimizer.h) and keeps its cell lists
+// between calls.
+//
+
+#ifndef CONVEYORLC_GBENERGY_H
+#define CONVEYORLC_GBENERGY_H
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace LBIND {
+
+class Prmtop;
+
+struct GBOptions {
+    double cut=15.0;        //!< non-bonded and GB pair cutoff (sander cut)
+    double rgbmax=25.0;     //!< cutoff of the Born radius sums (sander rgbmax)
+    double intDiel=1.0;     //!< solute dielectric (sander intdiel)
+    double extDiel=78.5;    //!< solvent dielectric (sander extdiel)
+    double surften=0.005;   //!< kcal/mol/A^2 (sander surften)
+    int threads=0;          //!< 0 for the CPUs of the process affinity mask
+    double skin=1.0;        //!< cell list margin of gradient(); lists are rebuilt after a move of skin/2
+};
+
+//! Energy terms in kcal/mol, named as in the sander output.
+struct GBTerms {
+    double bond=0;
+    double angle=0;
+    double dihedral=0;
+    double vdw=0;
+    double eel=0;
+    double egb=0;
+    double vdw14=0;
+    double eel14=0;
+    double esurf=0;
+
+    double total() const;
+    void print(std::ostream& os) const;
+};
+
+class GBEnergy {
+public:
+    //! Throws LBindException for topologies the engine does not handle (periodic boxes, extra points).
+    explicit GBEnergy(const Prmtop& prmtop);
+    ~GBEnergy();
+
+    int natom() const { return numAtoms; }
+
+    //! Energy at xyz (x1 y1 z1 x2 ...).
+    GBTerms compute(const std::vector<double>& xyz, const GBOptions& opts) const;
+
+    //! Energy and its gradient in kcal/mol/A (grad is resized to 3*natom). Meant for a series of nearby
+    //! structures: the cell lists of the previous call are reused until an atom has moved skin/2.
+    GBTerms gradient(const std::vector<double>& xyz, const GBOptions& opts, std::vector<double>& grad);
+
+private:
+    class CellList;
+
+    struct Bond { int i, j; double k, r0; };
+    struct Angle { int i, j, k; double k0, theta0; };
+    struct Dihedral { int i, j, k, l; double k0, n, phase; bool pair14; double scee, scnb; };
+    struct Lcpo { double radius, p1, p2, p3, p4; };
+
+    // The grad, dBorn and dEdB arguments are NULL for energies only.
+    void bonded(const std::vector<double>& xyz, GBTerms& terms, double* grad) const;
+    void bornRadii(const std::vector<double>& xyz, const CellList& cells, int threads,
+                   std::vector<double>& born, double* dBorn) const;
+    void pairs(const std::vector<double>& xyz, const CellList& cells, const std::vector<double>& born,
+               const GBOptions& opts, int threads, GBTerms& terms, double* grad, double* dEdB) const;
+    void bornChain(const std::vector<double>& xyz, const CellList& cells, const std::vector<double>& dEdB,
+                   const std::vector<double>& dBorn, int threads, double* grad) const;
+    double surfaceArea(const std::vector<double>& xyz, const CellList& cells, double surften, int threads,
+                       std::vector<std::vector<double> >* grads) const;
+    double maxLcpoRadius() const;
+
+    void assignLcpo(const Prmtop& prmtop);
+
+    int numAtoms;
+    int numTypes;
+    std::vector<double> charge;         //!< in units of the prmtop (e * 18.2223)
+    std::vector<int> typeIndex;         //!< 0-based LJ type
+    std::vector<int> nbIndex;           //!< ntypes*ti+tj -> LJ coefficient index, -1 for none
+    std::vector<double> acoef;
+    std::vector<double> bcoef;
+    std::vector<double> rborn;
+    std::vector<double> screen;
+    std::vector<Bond> bonds;
+    std::vector<Angle> angles;
+    std::vector<Dihedral> dihedrals;
+    std::vector<std::vector<int> > excluded;   //!< per atom, all excluded partners, sorted
+    std::vector<Lcpo> lcpo;                     //!< radius 0 for atoms without surface (hydrogens)
+
+    // State of gradient() between calls
+    std::unique_ptr<CellList> gbCells;
+    std::unique_ptr<CellList> pairCells;
+    std::unique_ptr<CellList> sasaCells;
+    std::vector<double> cellXyz;                //!< coordinates the cell lists were built at
+    GBOptions cellOpts;
+    std::vector<double> born, dBorn, dEdB;
+    std::vector<std::vector<double> > sasaGrads;   //!< per thread
+};
+
+}//namespace LBIND
+
+#endif //CONVEYORLC_GBENERGY_H
@@ -0,0 +1,304 @@
+//
+// In-process GB energy minimization.
+//
+
+#include "MM/GBMinimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+#include "Common/LBindException.h"
+#include "Parser/AmberMask.h"
+#include "Parser/Prmtop.h"
+
+namespace LBIND {
+
+namespace {
+
+double dot(const std::vector<double>& a, const std::vector<double>& b){
+    double sum=0;
+    for(size_t k=0; k<a.size(); ++k) sum+=a[k]*b[k];
+    return sum;
+}
+
+//! Largest per-atom length of a 3N vector.
+double maxAtomNorm(const std::vector<double>& v, int* atom=NULL){
+    double max2=0;
+    for(size_t i=0; i+2<v.size(); i+=3){
+        double n2=v[i]*v[i]+v[i+1]*v[i+1]+v[i+2]*v[i+2];
+        if(n2>max2){
+            max2=n2;
+            if(atom) *atom=i/3;
+        }
+    }
+    return std::sqrt(max2);
+}
+
+}
+
+GBMinimizer::GBMinimizer(const Prmtop& prmtop) : engine(prmtop) {
+    atomNames=prmtop.strings("ATOM_NAME");
+    atomNames.resize(engine.natom());
+}
+
+void GBMinimizer::restrain(const std::vector<bool>& selected, double weight, const std::vector<double>& ref){
+    if(static_cast<int>(ref.size())!=3*engine.natom() || static_cast<int>(selected.size())!=engine.natom()){
+        throw LBindException("GBMinimizer::restrain >> reference does not match the topology");
+    }
+    restrained.clear();
+    for(int i=0; i<engine.natom(); ++i){
+        if(selected[i]) restrained.push_back(i);
+    }
+    refXyz=ref;
+    this->weight=weight;
+}
+
+double GBMinimizer::evaluate(const std::vector<double>& xyz, const GBOptions& gbOpts, std::vector<double>& grad,
+                             GBTerms& terms){
+    terms=engine.gradient(xyz, gbOpts, grad);
+    double restraint=0;
+    for(int i : restrained){
+        for(int d=0; d<3; ++d){
+            double dx=xyz[3*i+d]-refXyz[3*i+d];
+            restraint+=weight*dx*dx;
+            grad[3*i+d]+=2.0*weight*dx;
+        }
+    }
+    return terms.total()+restraint;
+}
+
+GBTerms GBMinimizer::minimize(std::vector<double>& xyz, const GBOptions& gbOpts, const MinOptions& opts,
+                              std::ostream* log){
+    int n3=3*engine.natom();
+    if(static_cast<int>(xyz.size())!=n3){
+        throw LBindException("GBMinimizer >> coordinates do not match the topology");
+    }
+    if(n3==0) return GBTerms();
+
+    GBTerms terms;
+    double energy=evaluate(xyz, gbOpts, grad, terms);
+    eRestraint=energy-terms.total();
+    rmsGrad=std::sqrt(dot(grad, grad)/n3);
+    numSteps=0;
+    if(log){
+        *log << "\n   NSTEP       ENERGY          RMS            GMAX         NAME    NUMBER\n";
+        report(*log, 1, energy, grad, terms);
+    }
+
+    double step=opts.dx0;
+    double lastDrop=0;
+    bool restart=true;
+    while(numSteps<opts.maxcyc && rmsGrad>opts.drms){
+        ++numSteps;
+        bool steepest=(numSteps<=opts.ncyc);
+
+        dir.resize(n3);
+        if(steepest || restart){
+            for(int k=0; k<n3; ++k) dir[k]=-grad[k];
+        }else{
+            // Polak-Ribiere, reset to steepest descent when it stops going downhill
+            double num=0, den=0;
+            for(int k=0; k<n3; ++k){
+                num+=grad[k]*(grad[k]-prevGrad[k]);
+                den+=prevGrad[k]*prevGrad[k];
+            }
+            double beta=(den>0) ? std::max(0.0, num/den) : 0;
+            for(int k=0; k<n3; ++k) dir[k]=-grad[k]+beta*dir[k];
+            if(dot(dir, grad)>=0){
+                for(int k=0; k<n3; ++k) dir[k]=-grad[k];
+            }
+        }
+
+        double dirNorm=std::sqrt(dot(dir, dir));
+        double alphaMax=opts.dxm/maxAtomNorm(dir);
+        trialXyz.resize(n3);
+
+        if(steepest){
+            // sander: grow the step after a decrease, halve it otherwise
+            double alpha=std::min(step/dirNorm, alphaMax);
+            for(int k=0; k<n3; ++k) trialXyz[k]=xyz[k]+alpha*dir[k];
+            double trial=evaluate(trialXyz, gbOpts, trialGrad, trialTerms);
+            if(trial<energy){
+                xyz.swap(trialXyz);
+                grad.swap(trialGrad);
+                terms=trialTerms;
+                eRestraint=trial-terms.total();
+                lastDrop=energy-trial;
+                energy=trial;
+                step=std::min(1.2*alpha*dirNorm, opts.dxm);
+            }else{
+                step=0.5*alpha*dirNorm;
+            }
+        }else{
+            // First trial from the last energy drop (quadratic model)
+            double slope=dot(grad, dir);
+            double alpha=(lastDrop>0 && !restart) ? -2.02*lastDrop/slope : step/dirNorm;
+            alpha=std::min(alpha, alphaMax);
+            double trial=energy;
+            bool accepted=lineSearch(xyz, energy, slope, alpha, alphaMax, gbOpts, trial);
+
+            if(accepted){
+                prevGrad.swap(grad);
+                grad.swap(trialGrad);
+                xyz.swap(trialXyz);
+                terms=trialTerms;
+                eRestraint=trial-terms.total();
+                lastDrop=energy-trial;
+                energy=trial;
+                step=alpha*dirNorm;
+                restart=false;
+            }else if(restart){
+                // No decrease even along the gradient: as far down as the line search can go
+                break;
+            }else{
+                restart=true;
+                step=opts.dx0;
+            }
+        }
+
+        rmsGrad=std::sqrt(dot(grad, grad)/n3);
+        if(log && opts.ntpr>0 && numSteps%opts.ntpr==0){
+            *log << "\n   NSTEP       ENERGY          RMS            GMAX         NAME    NUMBER\n";
+            report(*log, numSteps, energy, grad, terms);
+        }
+    }
+
+    if(log){
+        *log << "\n                    FINAL RESULTS\n"
+             << "\n   NSTEP       ENERGY          RMS            GMAX         NAME    NUMBER\n";
+        report(*log, std::max(numSteps, 1), energy, grad, terms);
+    }
+    return terms;
+}
+
+bool GBMinimizer::lineSearch(const std::vector<double>& xyz, double energy, double slope, double& alpha,
+                             double alphaMax, const GBOptions& gbOpts, double& trial){
+    // Strong Wolfe conditions (Nocedal and Wright, algorithms 3.5 and 3.6): sufficient decrease and a
+    // directional derivative reduced to a tenth, as conjugate gradients need near-exact line minima.
+    const double c1=1.0e-4;
+    const double c2=0.1;
+    const int maxTrials=12;
+    int n3=xyz.size();
+
+    auto at=[&](double a){
+        for(int k=0; k<n3; ++k) trialXyz[k]=xyz[k]+a*dir[k];
+        trial=evaluate(trialXyz, gbOpts, trialGrad, trialTerms);
+        return trial;
+    };
+    // The lowest acceptable point so far, the fallback when the trials run out
+    bool haveBest=false;
+    double bestEnergy=energy;
+    double bestAlpha=0;
+    auto keep=[&](double a){
+        if(trial<bestEnergy && trial<=energy+c1*a*slope){
+            haveBest=true;
+            bestEnergy=trial;
+            bestAlpha=a;
+            bestXyz=trialXyz;
+            bestGrad=trialGrad;
+            bestTerms=trialTerms;
+        }
+    };
+
+    double lo=0, eLo=energy, dLo=slope;
+    double hi=0, eHi=energy;
+    bool bracketed=false;
+    double a=alpha;
+    for(int tries=0; tries<maxTrials; ++tries){
+        if(bracketed){
+            // Minimum of the quadratic through (lo, eLo, dLo) and (hi, eHi), kept inside the bracket
+            double width=hi-lo;
+            double curvature=eHi-eLo-dLo*width;
+            a=(curvature>0) ? lo-0.5*dLo*width*width/curvature : lo+0.5*width;
+            double lower=std::min(lo+0.1*width, hi-0.1*width);
+            double upper=std::max(lo+0.1*width, hi-0.1*width);
+            a=std::max(lower, std::min(upper, a));
+        }
+        double e=at(a);
+        double d=dot(trialGrad, dir);
+        keep(a);
+
+        if(e>energy+c1*a*slope || e>=eLo){
+            hi=a;
+            eHi=e;
+            bracketed=true;
+            continue;
+        }
+        if(std::fabs(d)<=-c2*slope){
+            alpha=a;
+            return true;
+        }
+        if(bracketed && d*(hi-lo)>=0){
+            hi=lo;
+            eHi=eLo;
+        }else if(!bracketed && d>=0){
+            hi=lo;
+            eHi=eLo;
+            bracketed=true;
+        }
+        lo=a;
+        eLo=e;
+        dLo=d;
+        if(!bracketed){
+            if(a>=alphaMax) break;
+            a=std::min(2.0*a, alphaMax);
+        }
+    }
+
+    if(!haveBest) return false;
+    alpha=bestAlpha;
+    trial=bestEnergy;
+    trialXyz.swap(bestXyz);
+    trialGrad.swap(bestGrad);
+    trialTerms=bestTerms;
+    return true;
+}
+
+void GBMinimizer::report(std::ostream& log, int step, double energy, const std::vector<double>& grad,
+                         const GBTerms& terms) const {
+    int atom=0;
+    double gmax=maxAtomNorm(grad, &atom);
+    char line[128];
+    std::snprintf(line, sizeof(line), "%7d %16.4E %14.4E %14.4E     %-4s %9d\n",
+                  step, energy, rmsGrad, gmax, atomNames[atom].c_str(), atom+1);
+    log << line << "\n";
+    terms.print(log);
+    std::snprintf(line, sizeof(line), " RESTRAINT  = %14.4f\n EAMBER     = %14.4f\n", eRestraint, terms.total());
+    log << line;
+}
+
+GBTerms minimizeAmber(const std::string& prmtopFile, const std::string& crdFile, const GBOptions& gbOpts,
+                      const MinOptions& minOpts, const std::string& mask, double weight,
+                      const std::string& rstFile, const std::string& outFile, double* restraint){
+    Prmtop prmtop;
+    prmtop.read(prmtopFile);
+    GBMinimizer minimizer(prmtop);
+
+    std::vector<double> xyz;
+    readAmberCoords(crdFile, xyz);
+    if(weight>0 && !mask.empty()){
+        minimizer.restrain(amberMask(prmtop, mask), weight, xyz);
+    }
+
+    std::ofstream out(outFile.c_str());
+    if(!out.good()){
+        throw LBindException("minimizeAmber >> Cannot open file "+outFile);
+    }
+    out << "In-process GB minimization (igb=5, gbsa=1, cut=" << gbOpts.cut << ", intdiel=" << gbOpts.intDiel
+        << ", maxcyc=" << minOpts.maxcyc << ", ncyc=" << minOpts.ncyc << ", drms=" << minOpts.drms << "): "
+        << prmtopFile << " " << crdFile << "\n";
+    if(weight>0 && !mask.empty()){
+        out << "restraintmask='" << mask << "', restraint_wt=" << weight << "\n";
+    }
+
+    GBTerms terms=minimizer.minimize(xyz, gbOpts, minOpts, &out);
+    out << "\n" << minimizer.steps() << " steps, final RMS gradient " << minimizer.rms() << std::endl;
+
+    writeAmberCoords(rstFile, xyz, "GBMinimizer");
+    if(restraint) *restraint=minimizer.restraintEnergy();
+    return terms;
+}
+
+}//namespace LBIND
@@ -0,0 +1,82 @@
+//
+// In-process energy minimization with the GB energy of MM/GBEnergy.h, the
+// counterpart of a sander run with imin=1, ntmin=1, igb=5 and gbsa=1: ncyc
+// steepest-descent steps, then Polak-Ribiere conjugate gradients with a
+// strong Wolfe line search, up to maxcyc steps or an RMS gradient below
+// drms. Positional restraints follow sander ntr=1 (restraint_wt and
+// restraintmask against the starting coordinates).
+//
+// Each energy evaluation is threaded (GBOptions::threads) and reuses the
+// cell lists of the previous step while the atoms stay within the skin.
+//
+
+#ifndef CONVEYORLC_GBMINIMIZER_H
+#define CONVEYORLC_GBMINIMIZER_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "MM/GBEnergy.h"
+
+namespace LBIND {
+
+struct MinOptions {
+    int maxcyc=2000;        //!< maximum number of steps (sander maxcyc)
+    int ncyc=1000;          //!< steepest-descent steps before conjugate gradients (sander ncyc)
+    double drms=1.0e-4;     //!< converged below this RMS gradient, kcal/mol/A (sander drms)
+    double dx0=0.01;        //!< initial step length, A (sander dx0)
+    double dxm=0.5;         //!< largest move of an atom in one step, A
+    int ntpr=0;             //!< log every ntpr steps, 0 for the first and last only
+};
+
+class GBMinimizer {
+public:
+    explicit GBMinimizer(const Prmtop& prmtop);
+
+    //! Harmonic restraints weight*|x-ref|^2 (kcal/mol/A^2) on the selected atoms.
+    void restrain(const std::vector<bool>& selected, double weight, const std::vector<double>& ref);
+
+    //! Minimizes xyz in place. Returns the unrestrained energy terms of the final coordinates.
+    GBTerms minimize(std::vector<double>& xyz, const GBOptions& gbOpts, const MinOptions& opts,
+                     std::ostream* log=NULL);
+
+    double restraintEnergy() const { return eRestraint; }
+    int steps() const { return numSteps; }
+    double rms() const { return rmsGrad; }
+
+private:
+    double evaluate(const std::vector<double>& xyz, const GBOptions& gbOpts, std::vector<double>& grad,
+                    GBTerms& terms);
+    //! Searches xyz+alpha*dir for a lower energy; the point found is left in trialXyz, trialGrad and trialTerms.
+    bool lineSearch(const std::vector<double>& xyz, double energy, double slope, double& alpha, double alphaMax,
+                    const GBOptions& gbOpts, double& trial);
+    void report(std::ostream& log, int step, double energy, const std::vector<double>& grad,
+                const GBTerms& terms) const;
+
+    GBEnergy engine;
+    std::vector<std::string> atomNames;
+    std::vector<int> restrained;
+    std::vector<double> refXyz;
+    double weight=0;
+
+    double eRestraint=0;
+    int numSteps=0;
+    double rmsGrad=0;
+
+    // Work vectors, kept between steps
+    std::vector<double> grad, trialXyz, trialGrad, dir, prevGrad;
+    std::vector<double> bestXyz, bestGrad;
+    GBTerms trialTerms, bestTerms;
+};
+
+//! minimize() of the topology prmtopFile from the coordinates crdFile, restrained on an Amber mask
+//! when weight>0. Writes the final coordinates to rstFile and the log to outFile; the restraint
+//! energy goes to restraint when not NULL. Throws LBindException for unsupported topologies.
+GBTerms minimizeAmber(const std::string& prmtopFile, const std::string& crdFile, const GBOptions& gbOpts,
+                      const MinOptions& minOpts, const std::string& mask, double weight,
+                      const std::string& rstFile, const std::string& outFile, double* restraint=NULL);
+
+}//namespace LBIND
+
+#endif //CONVEYORLC_GBMINIMIZER_H
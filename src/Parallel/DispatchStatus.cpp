@@ -0,0 +1,94 @@
+//
+// Throughput of a dispatcher run, kept by the root.
+//
+
+#include "Parallel/DispatchStatus.h"
+
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+namespace LBIND {
+
+static double wallTime(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec+ts.tv_nsec*1.0e-9;
+}
+
+DispatchStatus::DispatchStatus(const std::string& file, double interval, int workers, long jobs) :
+    fileName(file), every(interval), numWorkers(workers), total(jobs),
+    numDispatched(0), numDone(0), numFailed(0),
+    start(wallTime()), lastTime(start), lastDone(0), rate(-1)
+{
+}
+
+void DispatchStatus::update(bool force){
+    double t=wallTime();
+    if(!force && t-lastTime<every) return;
+
+    //! Exponential moving average over the intervals, so the ETA follows changes in the job mix.
+    if(t>lastTime){
+        double current=(numDone-lastDone)/(t-lastTime);
+        rate=(rate<0) ? current : 0.3*current+0.7*rate;
+    }
+    lastTime=t;
+    lastDone=numDone;
+
+    double eta=-1;
+    if(total>=0 && rate>0){
+        eta=(total-numDone)/rate;
+    }
+
+    std::cout << "Dispatcher: " << numDone;
+    if(total>=0) std::cout << "/" << total;
+    std::cout << " done, " << numFailed << " failed, " << numDispatched-numDone << " in flight, "
+              << std::fixed << std::setprecision(2) << rate << " jobs/s";
+    if(eta>=0) std::cout << ", ETA " << std::setprecision(0) << eta << " Sec.";
+    std::cout.unsetf(std::ios_base::floatfield);
+    std::cout << std::setprecision(6) << std::endl;
+
+    if(!fileName.empty()) write(t, eta);
+}
+
+void DispatchStatus::write(double t, double eta) const {
+    double elapsed=t-start;
+    double busySum=0;
+    for(auto& b : busyTime){
+        busySum+=b.second;
+    }
+    double utilization=(elapsed>0 && numWorkers>0) ? busySum/(elapsed*numWorkers) : 0;
+
+    //! Write a new file and rename it, so a reader never sees half a file.
+    std::string tmpName=fileName+".tmp";
+    {
+        std::ofstream out(tmpName);
+        if(!out.good()) return;
+
+        out << std::fixed << std::setprecision(3)
+            << "{\n"
+            << "  \"elapsed\": " << elapsed << ",\n"
+            << "  \"workers\": " << numWorkers << ",\n"
+            << "  \"total\": " << total << ",\n"
+            << "  \"dispatched\": " << numDispatched << ",\n"
+            << "  \"done\": " << numDone << ",\n"
+            << "  \"failed\": " << numFailed << ",\n"
+            << "  \"inFlight\": " << numDispatched-numDone << ",\n"
+            << "  \"rate\": " << rate << ",\n"
+            << "  \"meanRate\": " << ((elapsed>0) ? numDone/elapsed : 0) << ",\n"
+            << "  \"eta\": " << eta << ",\n"
+            << "  \"utilization\": " << utilization << ",\n"
+            << "  \"busy\": {";
+        bool first=true;
+        for(auto& b : busyTime){
+            out << (first ? "" : ",") << "\n    \"" << b.first << "\": " << b.second;
+            first=false;
+        }
+        out << "\n  }\n}\n";
+    }
+    std::rename(tmpName.c_str(), fileName.c_str());
+}
+
+}//namespace LBIND
@@ -0,0 +1,52 @@
+//
+// Throughput of a dispatcher run, kept by the root.
+//
+// The root counts jobs handed out, results and failures, and the workers
+// report the time they spent on jobs. Every few seconds the counters go to a
+// small JSON file (rewritten in place, so it can be polled during a run) and
+// to one line on stdout: done/total, failures, jobs in flight, a moving
+// average of the jobs per second and the ETA it gives.
+//
+
+#ifndef CONVEYORLC_DISPATCHSTATUS_H
+#define CONVEYORLC_DISPATCHSTATUS_H
+
+#include <map>
+#include <string>
+
+namespace LBIND {
+
+class DispatchStatus {
+public:
+    //! fileName empty for no file, total<0 when the number of jobs is not known.
+    DispatchStatus(const std::string& fileName, double every, int numWorkers, long total);
+
+    void dispatched(long num) { numDispatched+=num; }
+    void finished(long num, long failed) { numDone+=num; numFailed+=failed; }
+    void busy(int rank, double seconds) { busyTime[rank]+=seconds; }
+
+    //! Write the file and the log line if the interval has passed, or now with force.
+    void update(bool force=false);
+
+private:
+    void write(double t, double eta) const;
+
+    std::string fileName;
+    double every;
+    int numWorkers;
+    long total;
+
+    long numDispatched;
+    long numDone;
+    long numFailed;
+    std::map<int, double> busyTime;     //!< rank -> seconds spent running jobs
+
+    double start;
+    double lastTime;
+    long lastDone;
+    double rate;                        //!< moving average of the jobs per second, <0 before the first interval
+};
+
+}//namespace LBIND
+
+#endif //CONVEYORLC_DISPATCHSTATUS_H
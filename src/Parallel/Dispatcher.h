@@ -0,0 +1,770 @@
+//
+// Master/worker job dispatch for the Conduit pipeline applications.
+//
+// Rank 0 (root) generates the jobs and receives the results. On nodes with
+// enough ranks the lowest non-root rank becomes a sub-master: it asks the
+// root for chunks of jobs and feeds the workers of its node, so the root
+// sees one request per chunk instead of one per job. When the root runs out
+// of jobs, an idle sub-master steals half of the queue of the busiest one.
+// Smaller nodes talk to the root directly.
+//
+// A worker sends one message per job: the result of the previous job, which
+// is also the request for the next one. The request goes out with isend/irecv
+// before the current job starts, so a worker keeps one job queued ahead and
+// does not wait for a busy master between jobs. JobIn and JobOut must be
+// serializable with Boost.Serialization.
+//
+// The root and the sub-masters never block in a send: their messages go out
+// with isend and are completed while they keep receiving. Otherwise a
+// sub-master reporting results and the root answering its chunk request
+// could both wait in a send, once the messages are too large for MPI to
+// buffer.
+//
+// With speculation on, the last jobs handed out (about one per worker) are
+// tracked by the root. A worker tells the root when it begins one, so the
+// time a tail job waits in a sub-master or prefetch queue does not count as
+// run time. Once there is nothing left to hand out, idle ranks get copies of
+// the tail jobs that have run much longer than an average job, never the
+// worker already running one.
+// Before persisting a tail job a worker claims it from the root: only the
+// first copy to finish gets the claim and has its result kept, the others
+// only clean up. Apps opt in when their workers persist in a commit step.
+//
+// The root keeps throughput counters (see DispatchStatus.h) and writes them
+// to a status file every CONVEYORLC_STATUS_EVERY seconds (default 30).
+// CONVEYORLC_STATUS names the file, or turns it off with "off". Workers log
+// only every CONVEYORLC_LOG_EVERY-th job (default 100) through logJob().
+//
+// CONVEYORLC_DISPATCH=flat turns the sub-masters off, CONVEYORLC_CHUNK sets
+// the number of jobs per sub-master request and CONVEYORLC_PREFETCH the
+// number of jobs a worker keeps queued (0 for none). CONVEYORLC_SPECULATE=off
+// disables speculation in the apps that use it.
+//
+
+#ifndef CONVEYORLC_DISPATCHER_H
+#define CONVEYORLC_DISPATCHER_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+#include <boost/mpi.hpp>
+#include <boost/optional.hpp>
+#include <boost/serialization/vector.hpp>
+
+#include "Parallel/DispatchStatus.h"
+
+namespace LBIND {
+
+struct DispatchOptions {
+    bool hierarchical=true; //!< use per-node sub-masters
+    int chunk=0;            //!< jobs per sub-master request, 0 for 4 per local worker
+    int minGroup=4;         //!< non-root ranks a node needs to get a sub-master
+    int prefetch=1;         //!< jobs a worker keeps queued besides the running one
+    bool speculate=false;   //!< run copies of straggler jobs, see allowSpeculation()
+    std::string statusFile; //!< root status file, empty for none, see statusTo()
+    double statusEvery=30;  //!< seconds between status updates
+    int logEvery=100;       //!< workers log every logEvery-th job, 1 for all
+    int nodeSize=0;         //!< benchmarks: group the non-root ranks into nodes of this size, 0 for the real nodes
+
+    static DispatchOptions fromEnv(){
+        DispatchOptions opts;
+        const char* mode=std::getenv("CONVEYORLC_DISPATCH");
+        if(mode!=NULL && std::string(mode)=="flat"){
+            opts.hierarchical=false;
+        }
+        const char* chunk=std::getenv("CONVEYORLC_CHUNK");
+        if(chunk!=NULL){
+            opts.chunk=std::max(0, std::atoi(chunk));
+        }
+        const char* prefetch=std::getenv("CONVEYORLC_PREFETCH");
+        if(prefetch!=NULL){
+            opts.prefetch=std::max(0, std::atoi(prefetch));
+        }
+        const char* status=std::getenv("CONVEYORLC_STATUS");
+        if(status!=NULL && std::string(status)!="off"){
+            opts.statusFile=status;
+        }
+        const char* every=std::getenv("CONVEYORLC_STATUS_EVERY");
+        if(every!=NULL && std::atof(every)>0){
+            opts.statusEvery=std::atof(every);
+        }
+        const char* logEvery=std::getenv("CONVEYORLC_LOG_EVERY");
+        if(logEvery!=NULL){
+            opts.logEvery=std::max(1, std::atoi(logEvery));
+        }
+        return opts;
+    }
+
+    //! Default status file of an app, CONVEYORLC_STATUS overrides it.
+    DispatchOptions& statusTo(const std::string& fileName){
+        if(std::getenv("CONVEYORLC_STATUS")==NULL){
+            statusFile=fileName;
+        }
+        return *this;
+    }
+
+    //! For apps whose workers persist results in a commit step only.
+    DispatchOptions& allowSpeculation(){
+        const char* env=std::getenv("CONVEYORLC_SPECULATE");
+        speculate=(env==NULL || std::string(env)!="off");
+        return *this;
+    }
+};
+
+//! Longest-processing-time-first order: jobs by decreasing cost. Jobs without
+//! an estimate (cost<0) get the mean of the known ones.
+template<class T>
+void orderByCost(std::vector<T>& jobs, std::function<double(const T&)> cost){
+    std::vector<std::pair<double, size_t> > order;
+    double sum=0;
+    int known=0;
+    for(size_t i=0; i<jobs.size(); ++i){
+        double c=cost(jobs[i]);
+        if(c>=0){
+            sum+=c;
+            ++known;
+        }
+        order.push_back(std::make_pair(c, i));
+    }
+    double mean=(known>0) ? sum/known : 0;
+    for(auto& o : order){
+        if(o.first<0) o.first=mean;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [](const std::pair<double, size_t>& a, const std::pair<double, size_t>& b){ return a.first>b.first; });
+
+    std::vector<T> sorted;
+    sorted.reserve(jobs.size());
+    for(auto& o : order){
+        sorted.push_back(jobs[o.second]);
+    }
+    jobs.swap(sorted);
+}
+
+template<class JobIn, class JobOut>
+class Dispatcher {
+public:
+    typedef std::function<bool(JobIn&)> Source;             //!< next job, false when there is none left
+    typedef std::function<void(JobOut&)> Sink;              //!< called on the root for every result
+    typedef std::function<void(JobIn&, JobOut&)> Work;      //!< run one job on a worker
+    typedef std::function<void(JobIn&, JobOut&, bool)> Commit; //!< persist a result, false for a losing copy
+    typedef std::function<bool(const JobOut&)> Check;       //!< true for a failed job
+
+    Dispatcher(boost::mpi::communicator& comm, const DispatchOptions& options=DispatchOptions::fromEnv());
+
+    bool isRoot() const { return world.rank()==0; }
+
+    //! Root: hand out all jobs from next and pass the results to sink. total
+    //! is the number of jobs next gives, for the ETA, or -1 if not known.
+    void serve(Source next, Sink sink, long total=-1);
+
+    //! Root: count the results for which failed returns true as failures.
+    void setFailed(Check check) { failed=check; }
+
+    //! Other ranks: run jobs with fn, or relay them as a sub-master. commit
+    //! runs after fn; with speculation it must be the only step that persists.
+    void work(Work fn, Commit commit=Commit());
+
+    //! Worker: the running job is a tail job that may have several copies.
+    bool speculative() const { return jobID>=0; }
+
+    //! Worker: the running job is sampled for logging, the first one and every logEvery-th.
+    bool logJob() const { return jobCount%opts.logEvery==1 || opts.logEvery==1; }
+
+    //! Root: wall time of the last serve(), and the part of it spent handling messages.
+    double serveTime() const { return serveWall; }
+    double serveBusy() const { return serveWall-serveWait; }
+
+private:
+    enum Role { ROOT, SUBMASTER, WORKER };
+
+    static const int reportTag=11;
+    static const int chunkTag=12;
+    static const int stealTag=13;
+    static const int stolenTag=14;
+    static const int claimTag=15;
+    static const int grantTag=16;
+    static const int startTag=17;
+
+    struct Report {
+        std::vector<JobOut> outs;
+        int want=0;         //!< number of jobs requested
+        int backlog=0;      //!< jobs queued at a sub-master
+        bool done=false;    //!< sender has finished, no reply is expected
+        std::vector<int> busyRanks;         //!< workers and the seconds they ran jobs
+        std::vector<double> busySeconds;    //!< since their last report
+
+        template<class Archive>
+        void serialize(Archive & ar, const unsigned int version){
+            ar & outs;
+            ar & want;
+            ar & backlog;
+            ar & done;
+            ar & busyRanks;
+            ar & busySeconds;
+        }
+
+        void addBusy(std::map<int, double>& busy){
+            for(auto& b : busy){
+                busyRanks.push_back(b.first);
+                busySeconds.push_back(b.second);
+            }
+            busy.clear();
+        }
+    };
+
+    struct Chunk {
+        std::vector<JobIn> jobs;
+        std::vector<long> ids;  //!< root id of the tail jobs, -1 for the others
+        bool last=false;        //!< no more jobs will follow
+
+        template<class Archive>
+        void serialize(Archive & ar, const unsigned int version){
+            ar & jobs;
+            ar & ids;
+            ar & last;
+        }
+    };
+
+    //! Root: a tail job that has not been claimed yet.
+    struct Flight {
+        JobIn job;
+        double start=-1;            //!< when a worker began the first copy, -1 while it is queued
+        int copies=1;               //!< copies handed out
+        std::vector<int> workers;   //!< workers that began a copy
+    };
+
+    typedef std::deque<std::pair<JobIn, long> > Queue;
+
+    //! Non-blocking sends, the buffers kept until they complete.
+    class Outbox {
+    public:
+        template<class T>
+        void send(boost::mpi::communicator& comm, int dest, int tag, const T& value){
+            std::shared_ptr<T> buffer=std::make_shared<T>(value);
+            sends.push_back(std::make_pair(comm.isend(dest, tag, *buffer), std::shared_ptr<void>(buffer)));
+        }
+
+        //! Forget the sends that have completed.
+        void progress(){
+            for(auto it=sends.begin(); it!=sends.end(); ){
+                if(it->first.test()){
+                    it=sends.erase(it);
+                }else{
+                    ++it;
+                }
+            }
+        }
+
+        void flush(){
+            for(auto& send : sends){
+                send.first.wait();
+            }
+            sends.clear();
+        }
+
+    private:
+        std::list<std::pair<boost::mpi::request, std::shared_ptr<void> > > sends;
+    };
+
+    void setTopology();
+    bool steal(int thief, std::map<int, int>& backlog, std::map<int, int>& stealFor, std::map<int, bool>& closed);
+    void subMaster();
+    void worker(Work fn, Commit commit);
+    static void pause(double& delay);
+    static double now();
+
+    boost::mpi::communicator& world;
+    DispatchOptions opts;
+    Role role;
+    int master;                         //!< rank this rank reports to
+    std::vector<int> localWorkers;      //!< workers of a sub-master
+    std::map<int, bool> clients;        //!< root: rank -> is a sub-master
+    int numWorkers;                     //!< ranks that run jobs
+    long jobID;                         //!< worker: id of the running job
+    long jobCount;                      //!< worker: jobs started
+    Check failed;
+    double serveWall;                   //!< root: last serve() wall time
+    double serveWait;                   //!< root: time of it spent waiting for a message
+    Outbox outbox;                      //!< root and sub-master sends, worker start notices
+};
+
+template<class JobIn, class JobOut>
+Dispatcher<JobIn, JobOut>::Dispatcher(boost::mpi::communicator& comm, const DispatchOptions& options) :
+    world(comm), opts(options), role(WORKER), master(0), numWorkers(0), jobID(-1), jobCount(0), serveWall(0), serveWait(0)
+{
+    setTopology();
+}
+
+template<class JobIn, class JobOut>
+void Dispatcher<JobIn, JobOut>::setTopology(){
+    //! Ranks sharing memory are on the same node, the node is named by its lowest world rank.
+    MPI_Comm nodeComm;
+    MPI_Comm_split_type(world, MPI_COMM_TYPE_SHARED, world.rank(), MPI_INFO_NULL, &nodeComm);
+    boost::mpi::communicator node(nodeComm, boost::mpi::comm_take_ownership);
+    int leader=world.rank();
+    boost::mpi::broadcast(node, leader, 0);
+    if(opts.nodeSize>0){
+        leader=(world.rank()==0) ? 0 : 1+(world.rank()-1)/opts.nodeSize*opts.nodeSize;
+    }
+
+    std::vector<int> leaders;
+    boost::mpi::all_gather(world, leader, leaders);
+
+    std::map<int, std::vector<int> > groups;
+    for(int r=1; r<world.size(); ++r){
+        groups[leaders[r]].push_back(r);
+    }
+
+    int numSub=0;
+    for(auto& group : groups){
+        std::vector<int>& ranks=group.second;
+        bool useSub=opts.hierarchical && static_cast<int>(ranks.size())>=opts.minGroup;
+        if(useSub){
+            ++numSub;
+            clients[ranks[0]]=true;
+            for(unsigned i=1; i<ranks.size(); ++i){
+                if(ranks[i]==world.rank()) master=ranks[0];
+            }
+            if(ranks[0]==world.rank()){
+                role=SUBMASTER;
+                localWorkers.assign(ranks.begin()+1, ranks.end());
+            }
+        }else{
+            for(int r : ranks){
+                clients[r]=false;
+            }
+        }
+    }
+
+    numWorkers=world.size()-1-numSub;
+    if(world.rank()==0){
+        role=ROOT;
+        std::cout << "Dispatcher: " << numSub << " sub-masters, "
+                  << clients.size()-numSub << " workers on the root" << std::endl;
+    }
+
+    if(role==SUBMASTER && opts.chunk<=0){
+        opts.chunk=4*localWorkers.size();
+    }
+}
+
+template<class JobIn, class JobOut>
+void Dispatcher<JobIn, JobOut>::pause(double& delay){
+    struct timespec ts;
+    ts.tv_sec=0;
+    ts.tv_nsec=static_cast<long>(delay*1.0e9);
+    nanosleep(&ts, NULL);
+    if(delay<0.002) delay*=2;
+}
+
+template<class JobIn, class JobOut>
+double Dispatcher<JobIn, JobOut>::now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec+ts.tv_nsec*1.0e-9;
+}
+
+template<class JobIn, class JobOut>
+bool Dispatcher<JobIn, JobOut>::steal(int thief, std::map<int, int>& backlog, std::map<int, int>& stealFor, std::map<int, bool>& closed){
+    int victim=-1;
+    int most=1;
+    for(auto& b : backlog){
+        if(b.first==thief || closed[b.first] || stealFor.count(b.first)>0) continue;
+        if(b.second>most){
+            most=b.second;
+            victim=b.first;
+        }
+    }
+    if(victim<0) return false;
+
+    outbox.send(world, victim, stealTag, thief);
+    stealFor[victim]=thief;
+    backlog[victim]=0;
+    return true;
+}
+
+template<class JobIn, class JobOut>
+void Dispatcher<JobIn, JobOut>::serve(Source next, Sink sink, long total){
+    int active=clients.size();
+    bool exhausted=false;
+    std::map<int, int> backlog;     //!< last reported queue size of the sub-masters
+    std::map<int, int> stealFor;    //!< victim -> thief of an outstanding steal
+    std::map<int, bool> closed;     //!< sub-masters that got their last chunk
+
+    //! The jobs still in ahead when next runs dry are the tail jobs.
+    size_t tail=opts.speculate ? numWorkers : 0;
+    std::deque<JobIn> ahead;
+    std::map<long, Flight> inFlight;
+    long nextID=0;
+    std::deque<int> parked;         //!< clients waiting for a copy of a straggler
+    long results=0;
+    double startTime=now();
+    double delay=0.00005;
+    serveWait=0;
+    DispatchStatus status(opts.statusFile, opts.statusEvery, numWorkers, total);
+
+    auto fill=[&](Chunk& chunk, int want){
+        while(static_cast<int>(chunk.jobs.size())<want){
+            while(!exhausted && ahead.size()<=tail){
+                JobIn jobIn;
+                if(next(jobIn)){
+                    ahead.push_back(jobIn);
+                }else{
+                    exhausted=true;
+                }
+            }
+            if(ahead.empty()) break;
+
+            long id=-1;
+            if(exhausted && opts.speculate){
+                id=nextID++;
+                inFlight[id].job=ahead.front();
+            }
+            chunk.jobs.push_back(ahead.front());
+            chunk.ids.push_back(id);
+            ahead.pop_front();
+            status.dispatched(1);
+        }
+    };
+
+    //! Copy of the oldest tail job that has run more than twice the average.
+    auto duplicate=[&](int dest){
+        if(results==0) return false;
+        double t=now();
+        double limit=2.0*(t-startTime)*numWorkers/results;
+        auto oldest=inFlight.end();
+        for(auto it=inFlight.begin(); it!=inFlight.end(); ++it){
+            Flight& flight=it->second;
+            if(flight.copies>1 || flight.start<0 || t-flight.start<limit) continue;
+            if(std::find(flight.workers.begin(), flight.workers.end(), dest)!=flight.workers.end()) continue;
+            if(oldest==inFlight.end() || flight.start<oldest->second.start) oldest=it;
+        }
+        if(oldest==inFlight.end()) return false;
+
+        ++oldest->second.copies;
+        Chunk chunk;
+        chunk.jobs.push_back(oldest->second.job);
+        chunk.ids.push_back(oldest->first);
+        outbox.send(world, dest, chunkTag, chunk);
+        std::cout << "Dispatcher: copy of tail job " << oldest->first << " to rank " << dest
+                  << " after " << t-oldest->second.start << " Sec." << std::endl;
+        return true;
+    };
+
+    //! Nothing left to hand out to dest: a copy of a straggler, wait or stop.
+    auto drain=[&](int dest){
+        if(!inFlight.empty()){
+            if(!duplicate(dest)) parked.push_back(dest);
+            return;
+        }
+        Chunk chunk;
+        chunk.last=true;
+        outbox.send(world, dest, chunkTag, chunk);
+        if(clients[dest]){
+            closed[dest]=true;
+        }
+    };
+
+    while(active>0){
+        outbox.progress();
+        if(!parked.empty()){
+            size_t num=parked.size();
+            for(size_t i=0; i<num; ++i){
+                int dest=parked.front();
+                parked.pop_front();
+                drain(dest);
+            }
+        }
+
+        boost::optional<boost::mpi::status> st;
+        double waitStart=now();
+        if(parked.empty()){
+            st=world.probe(boost::mpi::any_source, boost::mpi::any_tag);
+        }else{
+            st=world.iprobe(boost::mpi::any_source, boost::mpi::any_tag);
+            if(!st){
+                pause(delay);
+                serveWait+=now()-waitStart;
+                continue;
+            }
+            delay=0.00005;
+        }
+        serveWait+=now()-waitStart;
+        int src=st->source();
+
+        if(st->tag()==reportTag){
+            Report report;
+            world.recv(src, reportTag, report);
+            long numFailed=0;
+            for(JobOut& out : report.outs){
+                if(failed && failed(out)) ++numFailed;
+                sink(out);
+            }
+            results+=report.outs.size();
+            status.finished(report.outs.size(), numFailed);
+            for(size_t i=0; i<report.busyRanks.size(); ++i){
+                status.busy(report.busyRanks[i], report.busySeconds[i]);
+            }
+            status.update();
+            if(report.done){
+                --active;
+                continue;
+            }
+            if(clients[src]) backlog[src]=report.backlog;
+            if(report.want<=0) continue;
+
+            Chunk chunk;
+            fill(chunk, report.want);
+            if(!chunk.jobs.empty()){
+                outbox.send(world, src, chunkTag, chunk);
+                continue;
+            }
+
+            if(clients[src] && steal(src, backlog, stealFor, closed)) continue;
+            drain(src);
+        }else if(st->tag()==stolenTag){
+            Chunk stolen;
+            world.recv(src, stolenTag, stolen);
+            int thief=stealFor[src];
+            stealFor.erase(src);
+
+            if(!stolen.jobs.empty()){
+                outbox.send(world, thief, chunkTag, stolen);
+            }else if(!steal(thief, backlog, stealFor, closed)){
+                drain(thief);
+            }
+        }else if(st->tag()==startTag){
+            long id;
+            world.recv(src, startTag, id);
+            auto it=inFlight.find(id);
+            if(it!=inFlight.end()){
+                if(it->second.start<0) it->second.start=now();
+                it->second.workers.push_back(src);
+            }
+        }else if(st->tag()==claimTag){
+            //! First copy to finish wins.
+            long id;
+            world.recv(src, claimTag, id);
+            int granted=inFlight.erase(id);
+            outbox.send(world, src, grantTag, granted);
+        }else{
+            std::cerr << "Dispatcher: unexpected message tag " << st->tag() << " from " << src << std::endl;
+            world.abort(1);
+        }
+    }
+    outbox.flush();
+    status.update(true);
+    serveWall=now()-startTime;
+}
+
+template<class JobIn, class JobOut>
+void Dispatcher<JobIn, JobOut>::work(Work fn, Commit commit){
+    if(role==SUBMASTER){
+        subMaster();
+    }else{
+        worker(fn, commit);
+    }
+}
+
+template<class JobIn, class JobOut>
+void Dispatcher<JobIn, JobOut>::subMaster(){
+    Queue queue;
+    std::vector<JobOut> outs;
+    std::map<int, double> busy;                 //!< job time of the local workers, passed on to the root
+    std::deque<std::pair<int, int> > idle;     //!< workers waiting for jobs, and how many they want
+    bool requested=false;
+    bool last=false;
+    int stopped=0;
+    int numLocal=localWorkers.size();
+    size_t lowWater=std::max(1, numLocal);
+    double delay=0.00005;
+
+    auto sendJobs=[&](int dest, int want){
+        Chunk chunk;
+        while(!queue.empty() && static_cast<int>(chunk.jobs.size())<want){
+            chunk.jobs.push_back(queue.front().first);
+            chunk.ids.push_back(queue.front().second);
+            queue.pop_front();
+        }
+        chunk.last=chunk.jobs.empty();
+        world.send(dest, chunkTag, chunk); // the worker posted its irecv with the request
+
+    };
+
+    while(true){
+        if(!requested && !last && queue.size()<=lowWater){
+            Report report;
+            report.outs.swap(outs);
+            report.addBusy(busy);
+            report.want=opts.chunk;
+            report.backlog=queue.size();
+            outbox.send(world, 0, reportTag, report);
+            requested=true;
+        }else if(static_cast<int>(outs.size())>=opts.chunk){
+            Report report;
+            report.outs.swap(outs);
+            report.addBusy(busy);
+            report.backlog=queue.size();
+            outbox.send(world, 0, reportTag, report);
+        }
+        outbox.progress();
+
+        if(last && stopped==numLocal) break;
+
+        boost::optional<boost::mpi::status> st=world.iprobe(boost::mpi::any_source, boost::mpi::any_tag);
+        if(!st){
+            pause(delay);
+            continue;
+        }
+        delay=0.00005;
+
+        int src=st->source();
+        if(st->tag()==reportTag){
+            Report report;
+            world.recv(src, reportTag, report);
+            outs.insert(outs.end(), report.outs.begin(), report.outs.end());
+            for(size_t i=0; i<report.busyRanks.size(); ++i){
+                busy[report.busyRanks[i]]+=report.busySeconds[i];
+            }
+            if(report.done){
+                ++stopped;
+            }else if(report.want<=0){
+                continue;
+            }else if(!queue.empty() || last){
+                sendJobs(src, report.want);
+            }else{
+                idle.push_back(std::make_pair(src, report.want));
+            }
+        }else if(st->tag()==chunkTag){
+            Chunk chunk;
+            world.recv(src, chunkTag, chunk);
+            requested=false;
+            for(size_t i=0; i<chunk.jobs.size(); ++i){
+                queue.push_back(std::make_pair(chunk.jobs[i], chunk.ids[i]));
+            }
+            last=chunk.last;
+            while(!idle.empty() && (!queue.empty() || last)){
+                sendJobs(idle.front().first, idle.front().second);
+                idle.pop_front();
+            }
+        }else if(st->tag()==stealTag){
+            int thief;
+            world.recv(src, stealTag, thief);
+            Chunk chunk;
+            size_t half=queue.size()/2;
+            for(size_t i=0; i<half; ++i){
+                chunk.jobs.push_back(queue.back().first);
+                chunk.ids.push_back(queue.back().second);
+                queue.pop_back();
+            }
+            outbox.send(world, 0, stolenTag, chunk);
+        }else{
+            std::cerr << "Dispatcher: unexpected message tag " << st->tag() << " from " << src << std::endl;
+            world.abort(1);
+        }
+    }
+
+    Report report;
+    report.outs.swap(outs);
+    report.addBusy(busy);
+    report.done=true;
+    outbox.send(world, 0, reportTag, report);
+    outbox.flush();
+}
+
+template<class JobIn, class JobOut>
+void Dispatcher<JobIn, JobOut>::worker(Work fn, Commit commit){
+    Queue queue;
+    std::vector<JobOut> outs;
+    std::map<int, double> busy;
+    bool last=false;
+    size_t depth=opts.prefetch;
+
+    //! At most one request is in flight, the buffers live until it completes.
+    bool pending=false;
+    Report report;
+    Chunk chunk;
+    boost::mpi::request reqs[2];
+
+    auto receive=[&](){
+        for(size_t i=0; i<chunk.jobs.size(); ++i){
+            queue.push_back(std::make_pair(chunk.jobs[i], chunk.ids[i]));
+        }
+        last=chunk.last;
+        chunk.jobs.clear();
+        chunk.ids.clear();
+        pending=false;
+    };
+
+    while(true){
+        //! Ask for the next jobs before running the current one.
+        if(!pending && !last && queue.size()<=depth){
+            report.outs.swap(outs);
+            outs.clear();
+            report.busyRanks.clear();
+            report.busySeconds.clear();
+            report.addBusy(busy);
+            report.want=depth+1-queue.size();
+            reqs[0]=world.isend(master, reportTag, report);
+            reqs[1]=world.irecv(master, chunkTag, chunk);
+            pending=true;
+        }
+
+        if(queue.empty()){
+            if(!pending) break;
+            boost::mpi::wait_all(reqs, reqs+2);
+            receive();
+            continue;
+        }
+
+        JobIn jobIn=queue.front().first;
+        jobID=queue.front().second;
+        queue.pop_front();
+        ++jobCount;
+        if(jobID>=0){
+            outbox.send(world, 0, startTag, jobID);
+        }
+        outbox.progress();
+        double start=now();
+        JobOut jobOut;
+        fn(jobIn, jobOut);
+
+        bool won=true;
+        if(jobID>=0){
+            int granted=0;
+            world.send(0, claimTag, jobID);
+            world.recv(0, grantTag, granted);
+            won=(granted!=0);
+        }
+        if(commit) commit(jobIn, jobOut, won);
+        if(won) outs.push_back(jobOut);
+        jobID=-1;
+        busy[world.rank()]+=now()-start;
+
+        if(pending && boost::mpi::test_all(reqs, reqs+2)){
+            receive();
+        }
+    }
+
+    outbox.flush();
+    Report done;
+    done.outs.swap(outs);
+    done.addBusy(busy);
+    done.done=true;
+    world.send(master, reportTag, done);
+}
+
+}//namespace LBIND
+
+#endif //CONVEYORLC_DISPATCHER_H
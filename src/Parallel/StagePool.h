@@ -0,0 +1,283 @@
+//
+// Stage pools for streaming several pipeline stages through one MPI job.
+//
+// Rank 0 (root) keeps one queue per stage. When a task finishes, the root
+// routes its result into tasks of later stages, so an item moves on as soon
+// as it is done instead of waiting for the whole stage. Every other rank is a
+// worker; the stage of its last task is its pool. The root moves workers
+// between pools so the pool sizes follow the work each stage needs per input
+// item,
+//
+//     share(s) ~ fanout(s) * time(s)
+//
+// with fanout(s) the observed number of stage s tasks per stage 0 task and
+// time(s) the observed mean task time. A worker stays in its pool while the
+// pool has queued tasks and is not above its share, otherwise it goes to the
+// stage with queued tasks that is furthest below its share (later stages win
+// ties, which drains the pipeline). New input is only pulled while the later
+// stages have fewer than backlog tasks queued per worker, which bounds the
+// memory held in the queues.
+//
+// Task needs an int member stage. Task and Result must be serializable with
+// Boost.Serialization.
+//
+
+#ifndef CONVEYORLC_STAGEPOOL_H
+#define CONVEYORLC_STAGEPOOL_H
+
+#include <algorithm>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include <boost/mpi.hpp>
+
+namespace LBIND {
+
+template<class Task, class Result>
+class StagePool {
+public:
+    typedef std::function<bool(Task&)> Source;                                  //!< next input task, false when there is none left
+    typedef std::function<void(Task&, Result&, std::vector<Task>&)> Route;      //!< root: follow-up tasks of a finished task
+    typedef std::function<void(Task&, Result&)> Work;                           //!< run one task of any stage on a worker
+
+    StagePool(boost::mpi::communicator& comm, int numStages, int backlog=2);
+
+    bool isRoot() const { return world.rank()==0; }
+
+    //! Root: stream the tasks from next through the stages.
+    void serve(Source next, Route route);
+
+    //! Other ranks: run the tasks the root assigns.
+    void work(Work fn);
+
+private:
+    static const int reportTag=21;
+    static const int assignTag=22;
+
+    struct Report {
+        bool has=false;     //!< out holds the result of the last task
+        double seconds=0;   //!< wall time of the last task
+        Result out;
+
+        template<class Archive>
+        void serialize(Archive & ar, const unsigned int version){
+            ar & has;
+            ar & seconds;
+            if(has) ar & out;
+        }
+    };
+
+    struct Assign {
+        bool last=false;    //!< no more tasks, the worker stops
+        Task task;
+
+        template<class Archive>
+        void serialize(Archive & ar, const unsigned int version){
+            ar & last;
+            if(!last) ar & task;
+        }
+    };
+
+    std::vector<double> shares() const;
+    int pickStage(int pool, const std::vector<std::deque<Task> >& queues) const;
+    static double now();
+
+    boost::mpi::communicator& world;
+    int numStages;
+    int backlog;
+    int numWorkers;
+
+    std::vector<long> created;      //!< tasks queued per stage
+    std::vector<long> finished;     //!< tasks done per stage
+    std::vector<double> busy;       //!< task seconds per stage
+    std::vector<int> running;       //!< workers running a task per stage
+};
+
+template<class Task, class Result>
+StagePool<Task, Result>::StagePool(boost::mpi::communicator& comm, int stages, int queued) :
+    world(comm), numStages(stages), backlog(queued), numWorkers(comm.size()-1),
+    created(stages, 0), finished(stages, 0), busy(stages, 0), running(stages, 0)
+{
+}
+
+template<class Task, class Result>
+double StagePool<Task, Result>::now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec+ts.tv_nsec*1.0e-9;
+}
+
+template<class Task, class Result>
+std::vector<double> StagePool<Task, Result>::shares() const {
+    //! Stages without a timing yet count as the mean of the timed ones.
+    double sumTime=0;
+    int timed=0;
+    for(int s=0; s<numStages; ++s){
+        if(finished[s]>0){
+            sumTime+=busy[s]/finished[s];
+            ++timed;
+        }
+    }
+    double defTime=(timed>0) ? sumTime/timed : 1.0;
+
+    std::vector<double> work(numStages, 0);
+    double total=0;
+    for(int s=0; s<numStages; ++s){
+        double fanout=(created[0]>0) ? static_cast<double>(created[s])/created[0] : 1.0;
+        double time=(finished[s]>0) ? busy[s]/finished[s] : defTime;
+        work[s]=fanout*time;
+        total+=work[s];
+    }
+    for(int s=0; s<numStages; ++s){
+        work[s]=(total>0) ? work[s]/total : 1.0/numStages;
+    }
+    return work;
+}
+
+template<class Task, class Result>
+int StagePool<Task, Result>::pickStage(int pool, const std::vector<std::deque<Task> >& queues) const {
+    std::vector<double> share=shares();
+    if(pool>=0 && !queues[pool].empty() && running[pool]<share[pool]*numWorkers){
+        return pool;
+    }
+
+    int best=-1;
+    double bestDeficit=0;
+    for(int s=numStages-1; s>=0; --s){
+        if(queues[s].empty()) continue;
+        double deficit=share[s]*numWorkers-running[s];
+        if(best<0 || deficit>bestDeficit){
+            best=s;
+            bestDeficit=deficit;
+        }
+    }
+    return best;
+}
+
+template<class Task, class Result>
+void StagePool<Task, Result>::serve(Source next, Route route){
+    //! Without a worker nothing would run and the stream would end as if it were done.
+    if(numWorkers<1){
+        std::cerr << "StagePool: needs at least 2 processes, got " << world.size() << std::endl;
+        world.abort(1);
+    }
+
+    std::vector<std::deque<Task> > queues(numStages);
+    std::map<int, Task> inFlight;       //!< rank -> running task
+    std::map<int, int> pool;            //!< rank -> stage of its last task
+    std::deque<int> idle;
+    bool exhausted=false;
+    int active=numWorkers;
+    int moves=0;
+
+    auto refill=[&](){
+        while(!exhausted){
+            long downstream=0;
+            for(int s=1; s<numStages; ++s){
+                downstream+=queues[s].size();
+            }
+            if(!queues[0].empty() || downstream>=static_cast<long>(backlog)*numWorkers) break;
+
+            Task task;
+            if(next(task)){
+                queues[task.stage].push_back(task);
+                ++created[task.stage];
+            }else{
+                exhausted=true;
+            }
+        }
+    };
+
+    auto assignIdle=[&](){
+        refill();
+        size_t num=idle.size();
+        for(size_t i=0; i<num; ++i){
+            int dest=idle.front();
+            idle.pop_front();
+
+            int stage=pickStage(pool.count(dest)>0 ? pool[dest] : -1, queues);
+            if(stage<0){
+                if(exhausted && inFlight.empty()){
+                    Assign assign;
+                    assign.last=true;
+                    world.send(dest, assignTag, assign);
+                    --active;
+                }else{
+                    idle.push_back(dest);
+                }
+                continue;
+            }
+
+            if(pool.count(dest)>0 && pool[dest]!=stage) ++moves;
+            pool[dest]=stage;
+            ++running[stage];
+
+            Assign assign;
+            assign.task=queues[stage].front();
+            queues[stage].pop_front();
+            inFlight[dest]=assign.task;
+            world.send(dest, assignTag, assign);
+            refill();
+        }
+    };
+
+    while(active>0){
+        Report report;
+        boost::mpi::status st=world.recv(boost::mpi::any_source, reportTag, report);
+        int src=st.source();
+
+        if(report.has){
+            Task& task=inFlight[src];
+            int stage=task.stage;
+            --running[stage];
+            ++finished[stage];
+            busy[stage]+=report.seconds;
+
+            std::vector<Task> more;
+            route(task, report.out, more);
+            for(Task& t : more){
+                queues[t.stage].push_back(t);
+                ++created[t.stage];
+            }
+            inFlight.erase(src);
+        }
+        idle.push_back(src);
+
+        //! Waiting workers may have something to do now, not only the one that reported.
+        assignIdle();
+    }
+
+    std::vector<double> share=shares();
+    for(int s=0; s<numStages; ++s){
+        double mean=(finished[s]>0) ? busy[s]/finished[s] : 0;
+        std::cout << "StagePool: stage " << s << " tasks " << finished[s] << " mean " << mean
+                  << " Sec. share " << share[s] << std::endl;
+    }
+    std::cout << "StagePool: " << moves << " pool changes" << std::endl;
+}
+
+template<class Task, class Result>
+void StagePool<Task, Result>::work(Work fn){
+    Report report;
+    while(true){
+        world.send(0, reportTag, report);
+
+        Assign assign;
+        world.recv(0, assignTag, assign);
+        if(assign.last) break;
+
+        double start=now();
+        report=Report();
+        fn(assign.task, report.out);
+        report.has=true;
+        report.seconds=now()-start;
+    }
+}
+
+}//namespace LBIND
+
+#endif //CONVEYORLC_STAGEPOOL_H
@@ -0,0 +1,206 @@
+//
+// Atom selection with Amber mask syntax.
+//
+
+#include "Parser/AmberMask.h"
+
+#include <cctype>
+#include <cstdlib>
+
+#include "Common/LBindException.h"
+#include "Common/Tokenize.hpp"
+#include "Parser/Prmtop.h"
+
+namespace LBIND {
+
+namespace {
+
+//! "*" and "=" match any run of characters, "?" one character.
+bool wildMatch(const char* pattern, const char* name){
+    if(*pattern=='\0') return *name=='\0';
+    if(*pattern=='*' || *pattern=='='){
+        for(const char* n=name; ; ++n){
+            if(wildMatch(pattern+1, n)) return true;
+            if(*n=='\0') return false;
+        }
+    }
+    if(*name=='\0') return false;
+    if(*pattern=='?' || *pattern==*name) return wildMatch(pattern+1, name+1);
+    return false;
+}
+
+bool isNumber(const std::string& s){
+    if(s.empty()) return false;
+    for(char c : s){
+        if(!std::isdigit(static_cast<unsigned char>(c))) return false;
+    }
+    return true;
+}
+
+class MaskParser {
+public:
+    MaskParser(const Prmtop& prmtop, const std::string& mask) : mask(mask), pos(0) {
+        natom=prmtop.natom();
+        atomNames=prmtop.strings("ATOM_NAME");
+        atomTypes=prmtop.strings("AMBER_ATOM_TYPE");
+        std::vector<std::string> resNames=prmtop.strings("RESIDUE_LABEL");
+        std::vector<int> resStart=prmtop.ints("RESIDUE_POINTER");
+        int nres=prmtop.pointer(Prmtop::NRES);
+        atomNames.resize(natom);
+        atomTypes.resize(natom);
+        resNames.resize(nres);
+        resStart.resize(nres);
+        resStart.push_back(natom+1);
+
+        resOf.assign(natom, 0);
+        resNameOf.assign(natom, "");
+        for(int r=0; r<nres; ++r){
+            for(int i=resStart[r]-1; i<resStart[r+1]-1 && i<natom; ++i){
+                if(i<0) continue;
+                resOf[i]=r+1;
+                resNameOf[i]=resNames[r];
+            }
+        }
+    }
+
+    std::vector<bool> parse(){
+        std::vector<bool> sel=orExpr();
+        skipBlanks();
+        if(pos<mask.size()) fail("unexpected '"+mask.substr(pos, 1)+"'");
+        return sel;
+    }
+
+private:
+    void fail(const std::string& what) const {
+        throw LBindException("amberMask >> "+what+" in mask \""+mask+"\"");
+    }
+
+    void skipBlanks(){
+        while(pos<mask.size() && std::isspace(static_cast<unsigned char>(mask[pos]))) ++pos;
+    }
+
+    bool accept(char c){
+        skipBlanks();
+        if(pos<mask.size() && mask[pos]==c){
+            ++pos;
+            return true;
+        }
+        return false;
+    }
+
+    std::vector<bool> orExpr(){
+        std::vector<bool> sel=andExpr();
+        while(accept('|')){
+            std::vector<bool> rhs=andExpr();
+            for(int i=0; i<natom; ++i) sel[i]=sel[i] || rhs[i];
+        }
+        return sel;
+    }
+
+    std::vector<bool> andExpr(){
+        std::vector<bool> sel=unary();
+        while(accept('&')){
+            std::vector<bool> rhs=unary();
+            for(int i=0; i<natom; ++i) sel[i]=sel[i] && rhs[i];
+        }
+        return sel;
+    }
+
+    std::vector<bool> unary(){
+        if(accept('!')){
+            std::vector<bool> sel=unary();
+            sel.flip();
+            return sel;
+        }
+        if(accept('(')){
+            std::vector<bool> sel=orExpr();
+            if(!accept(')')) fail("missing ')'");
+            return sel;
+        }
+        return selector();
+    }
+
+    //! One or more ":..." and "@..." parts, all of which must match.
+    std::vector<bool> selector(){
+        skipBlanks();
+        if(pos>=mask.size() || (mask[pos]!=':' && mask[pos]!='@')) fail("expected ':' or '@'");
+
+        std::vector<bool> sel(natom, true);
+        while(pos<mask.size() && (mask[pos]==':' || mask[pos]=='@')){
+            char kind=mask[pos++];
+            size_t end=pos;
+            while(end<mask.size() && std::string(":@!&|() \t").find(mask[end])==std::string::npos) ++end;
+            std::string list=mask.substr(pos, end-pos);
+            if(list.find_first_of("<>")!=std::string::npos) fail("distance operators are not supported");
+            pos=end;
+
+            std::vector<bool> part=(kind==':') ? residues(list) : atoms(list);
+            for(int i=0; i<natom; ++i) sel[i]=sel[i] && part[i];
+        }
+        return sel;
+    }
+
+    //! Items of a list as [first, last] numbers, or as a name pattern with first=-1.
+    void items(const std::string& list, std::vector<std::string>& names, std::vector<std::pair<int, int> >& ranges){
+        std::vector<std::string> fields;
+        tokenize(list, fields, ",");
+        if(fields.empty()) fail("empty selection");
+        for(const std::string& f : fields){
+            size_t dash=f.find('-');
+            if(isNumber(f)){
+                int n=std::atoi(f.c_str());
+                ranges.push_back(std::make_pair(n, n));
+            }else if(dash!=std::string::npos && isNumber(f.substr(0, dash)) && isNumber(f.substr(dash+1))){
+                ranges.push_back(std::make_pair(std::atoi(f.substr(0, dash).c_str()), std::atoi(f.substr(dash+1).c_str())));
+            }else{
+                names.push_back(f);
+            }
+        }
+    }
+
+    static bool matches(const std::vector<std::string>& names, const std::vector<std::pair<int, int> >& ranges,
+                        const std::string& name, int number){
+        for(const std::pair<int, int>& r : ranges){
+            if(number>=r.first && number<=r.second) return true;
+        }
+        for(const std::string& n : names){
+            if(wildMatch(n.c_str(), name.c_str())) return true;
+        }
+        return false;
+    }
+
+    std::vector<bool> residues(const std::string& list){
+        std::vector<std::string> names;
+        std::vector<std::pair<int, int> > ranges;
+        items(list, names, ranges);
+        std::vector<bool> sel(natom, false);
+        for(int i=0; i<natom; ++i) sel[i]=matches(names, ranges, resNameOf[i], resOf[i]);
+        return sel;
+    }
+
+    std::vector<bool> atoms(const std::string& list){
+        bool byType=!list.empty() && list[0]=='%';
+        std::vector<std::string> names;
+        std::vector<std::pair<int, int> > ranges;
+        items(byType ? list.substr(1) : list, names, ranges);
+        std::vector<bool> sel(natom, false);
+        for(int i=0; i<natom; ++i) sel[i]=matches(names, ranges, byType ? atomTypes[i] : atomNames[i], i+1);
+        return sel;
+    }
+
+    const std::string& mask;
+    size_t pos;
+    int natom;
+    std::vector<std::string> atomNames;
+    std::vector<std::string> atomTypes;
+    std::vector<int> resOf;
+    std::vector<std::string> resNameOf;
+};
+
+}
+
+std::vector<bool> amberMask(const Prmtop& prmtop, const std::string& mask){
+    return MaskParser(prmtop, mask).parse();
+}
+
+}//namespace LBIND
@@ -0,0 +1,25 @@
+//
+// Atom selection with Amber mask syntax, as in sander restraintmask.
+//
+// Supported: ":" residue names or numbers, "@" atom names or numbers, "@%"
+// atom types, ranges (1-10), lists (CA,C,N), the wildcards "*", "=" and "?",
+// the operators "!", "&" and "|", and parentheses. ":LIG@C1" is ":LIG & @C1".
+// Distance operators (<:, >@) are not supported.
+//
+
+#ifndef CONVEYORLC_AMBERMASK_H
+#define CONVEYORLC_AMBERMASK_H
+
+#include <string>
+#include <vector>
+
+namespace LBIND {
+
+class Prmtop;
+
+//! One flag per atom of prmtop; throws LBindException for a mask it cannot parse.
+std::vector<bool> amberMask(const Prmtop& prmtop, const std::string& mask);
+
+}//namespace LBIND
+
+#endif //CONVEYORLC_AMBERMASK_H
@@ -0,0 +1,199 @@
+//
+// PDB files and Complex structures from an Amber topology and coordinates.
+//
+
+#include "Parser/AmberPdb.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+
+#include "Common/LBindException.h"
+#include "Parser/Prmtop.h"
+#include "Structure/Atom.h"
+#include "Structure/Complex.h"
+#include "Structure/Fragment.h"
+#include "Structure/Molecule.h"
+
+namespace LBIND {
+
+static const char* elementSymbol(int z){
+    static const char* symbols[]={"", "H", "He", "Li", "Be", "B", "C", "N", "O", "F", "Ne",
+                                  "Na", "Mg", "Al", "Si", "P", "S", "Cl", "Ar", "K", "Ca",
+                                  "Sc", "Ti", "V", "Cr", "Mn", "Fe", "Co", "Ni", "Cu", "Zn",
+                                  "Ga", "Ge", "As", "Se", "Br", "Kr", "Rb", "Sr", "Y", "Zr",
+                                  "Nb", "Mo", "Tc", "Ru", "Rh", "Pd", "Ag", "Cd", "In", "Sn",
+                                  "Sb", "Te", "I"};
+    if(z<0 || z>=static_cast<int>(sizeof(symbols)/sizeof(symbols[0]))) return "";
+    return symbols[z];
+}
+
+AmberPdb::AmberPdb(const Prmtop& prmtop){
+    int natom=prmtop.natom();
+    atomNames=prmtop.strings("ATOM_NAME");
+    atomNames.resize(natom);
+    resNames=prmtop.strings("RESIDUE_LABEL");
+    resStart=prmtop.ints("RESIDUE_POINTER");
+    resNames.resize(prmtop.pointer(Prmtop::NRES));
+    resStart.resize(resNames.size());
+    for(int& s : resStart) --s;
+    resStart.push_back(natom);
+
+    charges=prmtop.reals("CHARGE");
+    charges.resize(natom);
+    for(double& q : charges) q/=18.2223;
+
+    elements.assign(natom, "");
+    if(prmtop.has("ATOMIC_NUMBER")){
+        std::vector<int> z=prmtop.ints("ATOMIC_NUMBER");
+        for(int i=0; i<natom && i<static_cast<int>(z.size()); ++i) elements[i]=elementSymbol(z[i]);
+    }
+
+    std::vector<int> resOf(natom, 0);
+    for(size_t r=0; r+1<resStart.size(); ++r){
+        for(int i=resStart[r]; i<resStart[r+1] && i<natom; ++i) resOf[i]=r;
+    }
+    std::vector<bool> linked(resNames.size(), false);
+    for(const char* flag : {"BONDS_INC_HYDROGEN", "BONDS_WITHOUT_HYDROGEN"}){
+        if(!prmtop.has(flag)) continue;
+        std::vector<int> list=prmtop.ints(flag);
+        for(size_t b=0; b+2<list.size(); b+=3){
+            int ri=resOf[std::abs(list[b])/3];
+            int rj=resOf[std::abs(list[b+1])/3];
+            if(std::abs(ri-rj)==1) linked[std::min(ri, rj)]=true;
+        }
+    }
+    terAfter.resize(resNames.size());
+    for(size_t r=0; r<resNames.size(); ++r) terAfter[r]=!linked[r];
+}
+
+void AmberPdb::write(const std::string& fileName, const std::vector<double>& xyz, bool aatm,
+                     Select select, const std::string& resName, bool end) const {
+    if(xyz.size()!=3*atomNames.size()){
+        throw LBindException("AmberPdb::write >> coordinates do not match the topology for "+fileName);
+    }
+    std::ofstream outFile(fileName.c_str());
+    if(!outFile.good()){
+        throw LBindException("AmberPdb::write >> Cannot open file "+fileName);
+    }
+    write(outFile, xyz, aatm, select, resName, end);
+}
+
+void AmberPdb::write(std::ostream& outFile, const std::vector<double>& xyz, bool aatm,
+                     Select select, const std::string& resName, bool end) const {
+    if(xyz.size()!=3*atomNames.size()){
+        throw LBindException("AmberPdb::write >> coordinates do not match the topology");
+    }
+
+    char line[96];
+    int serial=0;
+    bool open=false;
+    for(size_t r=0; r+1<resStart.size(); ++r){
+        bool keep=(select==ALL) || ((resNames[r]==resName)==(select==ONLY));
+        if(keep){
+            for(int i=resStart[r]; i<resStart[r+1]; ++i){
+                const std::string& name=atomNames[i];
+                std::string col=(aatm || name.size()>=4) ? name : " "+name;
+                ++serial;
+                std::snprintf(line, sizeof(line), "ATOM  %5d %-4.4s %-4.4s %4d    %8.3f%8.3f%8.3f%6.2f%6.2f          %2s\n",
+                              serial%100000, col.c_str(), resNames[r].c_str(), static_cast<int>((r+1)%10000),
+                              xyz[3*i], xyz[3*i+1], xyz[3*i+2], 1.0, 0.0, elements[i].c_str());
+                outFile << line;
+            }
+            open=true;
+        }
+        if(open && terAfter[r]){
+            outFile << "TER\n";
+            open=false;
+        }
+    }
+    if(end) outFile << "END\n";
+}
+
+void AmberPdb::coords(std::istream& in, std::vector<double>& xyz) const {
+    auto trim=[](const std::string& s){
+        size_t first=s.find_first_not_of(" ");
+        if(first==std::string::npos) return std::string();
+        return s.substr(first, s.find_last_not_of(" \r")-first+1);
+    };
+
+    // A new residue starts when name, chain, number or insertion code change, or after TER
+    std::vector<std::map<std::string, std::vector<double> > > residues;
+    std::string line, resKey;
+    while(std::getline(in, line)){
+        if(line.compare(0, 3, "TER")==0){
+            resKey.clear();
+            continue;
+        }
+        if(line.size()<54 || (line.compare(0, 4, "ATOM")!=0 && line.compare(0, 6, "HETATM")!=0)) continue;
+        std::string key=line.substr(17, 10);
+        if(residues.empty() || key!=resKey) residues.push_back(std::map<std::string, std::vector<double> >());
+        resKey=key;
+
+        std::string name=trim(line.substr(12, 4));
+        std::vector<double>& pos=residues.back()[name];
+        if(!pos.empty()){
+            throw LBindException("AmberPdb::coords >> atom "+name+" repeats in residue "+key);
+        }
+        for(int d=0; d<3; ++d) pos.push_back(std::atof(line.substr(30+8*d, 8).c_str()));
+    }
+
+    if(residues.size()+1!=resStart.size()){
+        throw LBindException("AmberPdb::coords >> the PDB residues do not match the topology");
+    }
+    xyz.assign(3*atomNames.size(), 0);
+    for(size_t r=0; r<residues.size(); ++r){
+        if(static_cast<int>(residues[r].size())!=resStart[r+1]-resStart[r]){
+            throw LBindException("AmberPdb::coords >> residue "+std::to_string(r+1)+" does not match the topology");
+        }
+        for(int i=resStart[r]; i<resStart[r+1]; ++i){
+            auto it=residues[r].find(trim(atomNames[i]));
+            if(it==residues[r].end()){
+                throw LBindException("AmberPdb::coords >> atom "+trim(atomNames[i])+" of residue "
+                                     +std::to_string(r+1)+" is not in the PDB file");
+            }
+            for(int d=0; d<3; ++d) xyz[3*i+d]=it->second[d];
+        }
+    }
+}
+
+void AmberPdb::toComplex(const std::vector<double>& xyz, Complex* pComplex) const {
+    if(xyz.size()!=3*atomNames.size()){
+        throw LBindException("AmberPdb::toComplex >> coordinates do not match the topology");
+    }
+
+    Molecule* pMolecule=NULL;
+    int molID=0;
+    for(size_t r=0; r+1<resStart.size(); ++r){
+        if(pMolecule==NULL){
+            pMolecule=pComplex->addMolecule();
+            pMolecule->setID(++molID);
+            pMolecule->setName(" ");
+        }
+        Fragment* pRes=pMolecule->addFragment();
+        pRes->setID(r+1);
+        pRes->setName(resNames[r]);
+        for(int i=resStart[r]; i<resStart[r+1]; ++i){
+            Atom* pAtom=pRes->addAtom();
+            pAtom->setID(i+1);
+            pAtom->setFileID(i+1);
+            pAtom->setName(atomNames[i]);
+            pAtom->setCoords(xyz[3*i], xyz[3*i+1], xyz[3*i+2]);
+            pAtom->setSymbol(elements[i]);
+            pAtom->setCharge(charges[i]);
+        }
+        if(terAfter[r]) pMolecule=NULL;
+    }
+}
+
+void amberToPdb(const std::string& prmtopFile, const std::string& crdFile, const std::string& pdbFile, bool aatm){
+    Prmtop prmtop;
+    prmtop.read(prmtopFile);
+    std::vector<double> xyz;
+    readAmberCoords(crdFile, xyz);
+    AmberPdb(prmtop).write(pdbFile, xyz, aatm);
+}
+
+}//namespace LBIND
@@ -0,0 +1,62 @@
+//
+// PDB files and Complex structures from an Amber topology and coordinates,
+// the in-process counterpart of "ambpdb -p prmtop -c crd > pdb".
+//
+// Residues are numbered from 1 in topology order. A TER card closes a
+// residue that has no bond to the next one, so chains and separate
+// molecules (ligand, ions) stay apart when tleap reads the file back.
+//
+
+#ifndef CONVEYORLC_AMBERPDB_H
+#define CONVEYORLC_AMBERPDB_H
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace LBIND {
+
+class Prmtop;
+class Complex;
+
+class AmberPdb {
+public:
+    explicit AmberPdb(const Prmtop& prmtop);
+
+    //! Which residues write() keeps.
+    enum Select { ALL, ONLY, EXCEPT };
+
+    //! aatm: Amber atom names left-justified (ambpdb -aatm) instead of PDB alignment.
+    //! With ONLY or EXCEPT, only the residues named (or not named) resName are written.
+    void write(const std::string& fileName, const std::vector<double>& xyz, bool aatm=false,
+               Select select=ALL, const std::string& resName="", bool end=true) const;
+    void write(std::ostream& out, const std::vector<double>& xyz, bool aatm=false,
+               Select select=ALL, const std::string& resName="", bool end=true) const;
+
+    //! Coordinates in topology order from a PDB file of the same residues, e.g. written by tleap or
+    //! by write(); within a residue the atoms are matched by name. Throws LBindException when a
+    //! residue or atom does not match.
+    void coords(std::istream& in, std::vector<double>& xyz) const;
+
+    //! One Molecule per TER-separated part, one Fragment per residue.
+    void toComplex(const std::vector<double>& xyz, Complex* pComplex) const;
+
+    int natom() const { return atomNames.size(); }
+
+private:
+    std::vector<std::string> atomNames;
+    std::vector<std::string> elements;
+    std::vector<double> charges;            //!< in electrons
+    std::vector<std::string> resNames;
+    std::vector<int> resStart;              //!< first atom of each residue, plus natom
+    std::vector<bool> terAfter;             //!< residue ends a chain or molecule
+};
+
+//! ambpdb -p prmtop [-aatm] -c crd > pdb, without running ambpdb.
+void amberToPdb(const std::string& prmtopFile, const std::string& crdFile, const std::string& pdbFile,
+                bool aatm=false);
+
+}//namespace LBIND
+
+#endif //CONVEYORLC_AMBERPDB_H
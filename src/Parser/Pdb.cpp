@@ -27,6 +27,7 @@
 #include <algorithm>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/algorithm/string/trim.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/regex.hpp>
 
@@ -1062,6 +1063,53 @@ bool Pdb::readByModel(const std::string& inFileName, const std::string& outFileN
         
 }
 
+int Pdb::readModels(const std::string& pdbStr, std::map<int, std::string>& models, std::map<int, double>& scores){
+
+    std::istringstream inStream(pdbStr);
+    std::string fileLine="";
+
+    const std::string modelStr="MODEL";
+    const std::string endmdlStr="ENDMDL";
+    const std::string vinaStr="VINA";
+
+    bool scoreFlag=false;
+    std::string* pModel=NULL;
+    int modelID=0;
+
+    while(std::getline(inStream, fileLine)){
+
+        if(fileLine.compare(0,6, endmdlStr)==0){
+            pModel=NULL;
+        }
+
+        if(pModel!=NULL){
+            pModel->append(fileLine);
+            pModel->append("\n");
+            if(scoreFlag && fileLine.size()>7 && fileLine.compare(7, 4, vinaStr)==0){
+                std::vector<std::string> tokens;
+                tokenize(fileLine, tokens);
+                if(tokens.size()>3){
+                    scores[modelID]=Sstrm<double, std::string>(tokens[3]);
+                }
+                scoreFlag=false;
+            }
+        }
+
+        if(fileLine.compare(0,5, modelStr)==0){
+            std::vector<std::string> tokens;
+            tokenize(fileLine, tokens);
+            if(tokens.size()>1){
+                modelID=Sstrm<int, std::string>(tokens[1]);
+                pModel=&models[modelID];
+                pModel->clear();
+                scoreFlag=true;
+            }
+        }
+    }
+
+    return models.size();
+}
+
 int Pdb::splitByModel(const std::string& inFileName, const std::string& outFileBase){
     std::ifstream inFile;
     try {
@@ -2395,4 +2443,63 @@ void Pdb::fixElementStr(const std::string inputStr, std::string &outputStr) {
 
 }
 
+//! Same as sed -i '/Br.* LIG/{s! B ! Br!}' on the obabel PDBQT output.
+void Pdb::fixBrPdbqt(const std::string& fileName){
+
+    std::ifstream inFile(fileName.c_str());
+    if(!inFile.good()){
+        std::string message= "PDB::fixBrPdbqt >> Cannot open file" + fileName;
+        throw LBindException(message);
+    }
+
+    std::vector<std::string> lines;
+    std::string fileLine="";
+    while(std::getline(inFile, fileLine)){
+        size_t brPos=fileLine.find("Br");
+        if(brPos!=std::string::npos && fileLine.find(" LIG", brPos+2)!=std::string::npos){
+            size_t pos=fileLine.find(" B ");
+            if(pos!=std::string::npos){
+                fileLine.replace(pos, 3, " Br");
+            }
+        }
+        lines.push_back(fileLine);
+    }
+    inFile.close();
+
+    std::ofstream outFile(fileName.c_str());
+    if(!outFile.good()){
+        std::string message= "PDB::fixBrPdbqt >> Cannot open file" + fileName;
+        throw LBindException(message);
+    }
+    for(std::string& line : lines){
+        outFile << line << std::endl;
+    }
+}
+
+//! Heavy atoms and rotatable bonds (BRANCH records) of a ligand PDBQT file.
+void Pdb::pdbqtSize(const std::string& fileName, int& numHeavyAtoms, int& numTors){
+
+    std::ifstream inFile(fileName.c_str());
+    if(!inFile.good()){
+        std::string message= "PDB::pdbqtSize >> Cannot open file" + fileName;
+        throw LBindException(message);
+    }
+
+    numHeavyAtoms=0;
+    numTors=0;
+    std::string fileLine="";
+    while(std::getline(inFile, fileLine)){
+        if(fileLine.compare(0, 6, "BRANCH")==0){
+            ++numTors;
+        }else if(fileLine.compare(0, 4, "ATOM")==0 || fileLine.compare(0, 6, "HETATM")==0){
+            //! AutoDock type in columns 78-79, H and HD are hydrogens.
+            std::string adType= (fileLine.size()>77) ? fileLine.substr(77, 2) : "";
+            boost::trim(adType);
+            if(adType!="H" && adType!="HD"){
+                ++numHeavyAtoms;
+            }
+        }
+    }
+}
+
 }// namespace LBIND
@@ -9,6 +9,7 @@
 #define	_PDB_H
 
 #include <iostream>
+#include <map>
 #include <vector>
 #include <boost/shared_ptr.hpp>
 
@@ -50,6 +51,8 @@ public:
     
     int splitByModel(const std::string& inFileName, const std::string& outFileBase);
     bool readByModel(const std::string& inFileName, const std::string& outFile, int modelID, double& score);
+    //! All models of a multi-model PDB(QT) in one pass, as readByModel writes them, keyed by model ID.
+    int readModels(const std::string& pdbStr, std::map<int, std::string>& models, std::map<int, double>& scores);
     
     void selectAForm(const std::string& inFileName, const std::string& outFileName);
     
@@ -62,6 +65,8 @@ public:
     
     void fixElement(const std::string& inFileName, const std::string& outFileName);
     void fixElementStr(const std::string inputStr, std::string& outputStr);
+    void fixBrPdbqt(const std::string& fileName);
+    void pdbqtSize(const std::string& fileName, int& numHeavyAtoms, int& numTors);
 //    void write(const std::string& fileName, boost::shared_ptr<Conformer> pConformer);
 //    void write(const std::string& fileName, Conformer* pConformer);
     
@@ -0,0 +1,180 @@
+//
+// Docked ligand poses (PDBQT) as PDB lines of the prepared ligand.
+//
+
+#include "Parser/PosePdb.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+#include "Common/LBindException.h"
+#include "Parser/Prmtop.h"
+
+namespace LBIND {
+
+namespace {
+
+std::string trim(const std::string& s){
+    size_t first=s.find_first_not_of(" \t");
+    if(first==std::string::npos) return "";
+    size_t last=s.find_last_not_of(" \t\r");
+    return s.substr(first, last-first+1);
+}
+
+//! Atom name and coordinates of an ATOM or HETATM line; false for other records.
+bool atomLine(const std::string& line, std::string& name, double* xyz){
+    if(line.size()<54 || (line.compare(0, 4, "ATOM")!=0 && line.compare(0, 6, "HETATM")!=0)) return false;
+    name=trim(line.substr(12, 4));
+    for(int d=0; d<3; ++d) xyz[d]=std::atof(line.substr(30+8*d, 8).c_str());
+    return true;
+}
+
+//! Orthonormal frame from the vectors u and v; false when they are (nearly) parallel.
+bool frame(const double* u, const double* v, double e[3][3]){
+    double nu=std::sqrt(u[0]*u[0]+u[1]*u[1]+u[2]*u[2]);
+    if(nu<1.0e-6) return false;
+    for(int d=0; d<3; ++d) e[0][d]=u[d]/nu;
+    double proj=e[0][0]*v[0]+e[0][1]*v[1]+e[0][2]*v[2];
+    for(int d=0; d<3; ++d) e[1][d]=v[d]-proj*e[0][d];
+    double nv=std::sqrt(e[1][0]*e[1][0]+e[1][1]*e[1][1]+e[1][2]*e[1][2]);
+    if(nv<1.0e-3*nu) return false;
+    for(int d=0; d<3; ++d) e[1][d]/=nv;
+    e[2][0]=e[0][1]*e[1][2]-e[0][2]*e[1][1];
+    e[2][1]=e[0][2]*e[1][0]-e[0][0]*e[1][2];
+    e[2][2]=e[0][0]*e[1][1]-e[0][1]*e[1][0];
+    return true;
+}
+
+}
+
+PosePdb::PosePdb(const Prmtop& prmtop, const std::string& minPdb) : writer(prmtop) {
+    int natom=prmtop.natom();
+    std::vector<std::string> names=prmtop.strings("ATOM_NAME");
+    names.resize(natom);
+    for(int i=0; i<natom; ++i) atomIndex[trim(names[i])]=i;
+
+    hydrogen.assign(natom, false);
+    if(prmtop.has("ATOMIC_NUMBER")){
+        std::vector<int> z=prmtop.ints("ATOMIC_NUMBER");
+        for(int i=0; i<natom && i<static_cast<int>(z.size()); ++i) hydrogen[i]=(z[i]==1);
+    }else{
+        std::vector<double> mass=prmtop.reals("MASS");
+        for(int i=0; i<natom && i<static_cast<int>(mass.size()); ++i) hydrogen[i]=(mass[i]<1.5);
+    }
+
+    bonded.assign(natom, std::vector<int>());
+    for(const char* flag : {"BONDS_INC_HYDROGEN", "BONDS_WITHOUT_HYDROGEN"}){
+        if(!prmtop.has(flag)) continue;
+        std::vector<int> list=prmtop.ints(flag);
+        for(size_t b=0; b+2<list.size(); b+=3){
+            int i=std::abs(list[b])/3;
+            int j=std::abs(list[b+1])/3;
+            if(i>=natom || j>=natom) continue;
+            bonded[i].push_back(j);
+            bonded[j].push_back(i);
+        }
+    }
+
+    minXyz.assign(3*natom, 0);
+    std::vector<bool> found(natom, false);
+    std::istringstream in(minPdb);
+    std::string line, name;
+    double xyz[3];
+    while(std::getline(in, line)){
+        if(!atomLine(line, name, xyz)) continue;
+        std::map<std::string, int>::const_iterator it=atomIndex.find(name);
+        if(it==atomIndex.end()){
+            throw LBindException("PosePdb >> atom "+name+" of LIG_min.pdb is not in the ligand topology");
+        }
+        for(int d=0; d<3; ++d) minXyz[3*it->second+d]=xyz[d];
+        found[it->second]=true;
+    }
+    for(int i=0; i<natom; ++i){
+        if(!found[i]) throw LBindException("PosePdb >> atom "+trim(names[i])+" is missing in LIG_min.pdb");
+    }
+}
+
+void PosePdb::coords(const std::string& pdbqt, std::vector<double>& xyz) const {
+    int natom=hydrogen.size();
+    xyz.assign(3*natom, 0);
+    std::vector<bool> found(natom, false);
+
+    std::istringstream in(pdbqt);
+    std::string line, name;
+    double pos[3];
+    while(std::getline(in, line)){
+        if(!atomLine(line, name, pos)) continue;
+        std::map<std::string, int>::const_iterator it=atomIndex.find(name);
+        if(it==atomIndex.end() || found[it->second]){
+            throw LBindException("PosePdb >> pose atom "+name+" does not match the ligand topology");
+        }
+        for(int d=0; d<3; ++d) xyz[3*it->second+d]=pos[d];
+        found[it->second]=true;
+    }
+
+    std::vector<double> pose=xyz;
+    for(int h=0; h<natom; ++h){
+        if(found[h]) continue;
+        if(!hydrogen[h] || bonded[h].size()!=1 || !found[bonded[h][0]]){
+            throw LBindException("PosePdb >> cannot place atom "+std::to_string(h+1)+" missing in the pose");
+        }
+        int p=bonded[h][0];
+
+        // Frame atoms: two posed neighbours of p, or one and a posed neighbour of it
+        std::vector<std::pair<int, int> > frames;
+        for(int a : bonded[p]){
+            if(!found[a]) continue;
+            for(int b : bonded[p]){
+                if(b!=a && found[b]) frames.push_back(std::make_pair(a, b));
+            }
+            for(int b : bonded[a]){
+                if(b!=p && found[b]) frames.push_back(std::make_pair(a, b));
+            }
+        }
+
+        bool placed=false;
+        for(size_t f=0; f<frames.size() && !placed; ++f){
+            placed=place(h, p, frames[f].first, frames[f].second, pose, xyz);
+        }
+        if(!placed){
+            throw LBindException("PosePdb >> no frame to place hydrogen "+std::to_string(h+1));
+        }
+    }
+}
+
+bool PosePdb::place(int h, int p, int a, int b, const std::vector<double>& pose, std::vector<double>& xyz) const {
+    double from[3][3], to[3][3];
+    double u[3], v[3];
+    for(int d=0; d<3; ++d){
+        u[d]=minXyz[3*a+d]-minXyz[3*p+d];
+        v[d]=minXyz[3*b+d]-minXyz[3*p+d];
+    }
+    if(!frame(u, v, from)) return false;
+    for(int d=0; d<3; ++d){
+        u[d]=pose[3*a+d]-pose[3*p+d];
+        v[d]=pose[3*b+d]-pose[3*p+d];
+    }
+    if(!frame(u, v, to)) return false;
+
+    double r[3];
+    for(int d=0; d<3; ++d) r[d]=minXyz[3*h+d]-minXyz[3*p+d];
+    for(int d=0; d<3; ++d){
+        xyz[3*h+d]=pose[3*p+d];
+    }
+    for(int k=0; k<3; ++k){
+        double c=r[0]*from[k][0]+r[1]*from[k][1]+r[2]*from[k][2];
+        for(int d=0; d<3; ++d) xyz[3*h+d]+=c*to[k][d];
+    }
+    return true;
+}
+
+std::string PosePdb::pdb(const std::string& pdbqt) const {
+    std::vector<double> xyz;
+    coords(pdbqt, xyz);
+    std::ostringstream out;
+    writer.write(out, xyz, false, AmberPdb::ALL, "", false);
+    return out.str();
+}
+
+}//namespace LBIND
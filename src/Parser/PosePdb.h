@@ -0,0 +1,51 @@
+//
+// Docked ligand poses (PDBQT) as PDB lines of the prepared ligand, the
+// in-process counterpart of "obabel -ipdbqt -opdb" followed by tleap adding
+// the hydrogens the PDBQT file leaves out.
+//
+// Pose atoms are matched to the ligand topology by atom name. A missing
+// hydrogen is placed from the minimized ligand the pose was docked from, in
+// the local frame of its heavy atom and two neighbours, so bond lengths and
+// angles are those of the minimized structure.
+//
+
+#ifndef CONVEYORLC_POSEPDB_H
+#define CONVEYORLC_POSEPDB_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Parser/AmberPdb.h"
+
+namespace LBIND {
+
+class Prmtop;
+
+class PosePdb {
+public:
+    //! prmtop: the ligand topology (LIG.prmtop); minPdb: the contents of LIG_min.pdb.
+    PosePdb(const Prmtop& prmtop, const std::string& minPdb);
+
+    //! Coordinates of all ligand atoms for the pose in pdbqt (the lines of one model).
+    //! Throws LBindException for a pose atom not in the topology or a hydrogen it cannot place.
+    void coords(const std::string& pdbqt, std::vector<double>& xyz) const;
+
+    //! ATOM and TER lines of the pose, without END.
+    std::string pdb(const std::string& pdbqt) const;
+
+private:
+    //! Places atom h bonded to p from the frame p, a, b of the minimized and posed coordinates;
+    //! false when the three atoms are collinear.
+    bool place(int h, int p, int a, int b, const std::vector<double>& pose, std::vector<double>& xyz) const;
+
+    AmberPdb writer;
+    std::map<std::string, int> atomIndex;   //!< atom name -> index
+    std::vector<bool> hydrogen;
+    std::vector<std::vector<int> > bonded;
+    std::vector<double> minXyz;             //!< coordinates of LIG_min.pdb in topology order
+};
+
+}//namespace LBIND
+
+#endif //CONVEYORLC_POSEPDB_H
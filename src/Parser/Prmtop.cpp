@@ -0,0 +1,257 @@
+//
+// Reader for Amber topology (prmtop) and coordinate (inpcrd/restart) files.
+//
+
+#include "Parser/Prmtop.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include "Common/LBindException.h"
+
+namespace LBIND {
+
+static std::string trim(const std::string& str){
+    size_t first=str.find_first_not_of(' ');
+    if(first==std::string::npos) return "";
+    size_t last=str.find_last_not_of(' ');
+    return str.substr(first, last-first+1);
+}
+
+//! Field width of a Fortran format such as (20a4), (10I8) or (5E16.8).
+static int fieldWidth(const std::string& format){
+    size_t pos=format.find_first_of("aAiIeEfF");
+    if(pos==std::string::npos) return 0;
+    return std::atoi(format.c_str()+pos+1);
+}
+
+void Prmtop::read(const std::string& fileName){
+    std::ifstream inFile(fileName.c_str());
+    if(!inFile.good()){
+        throw LBindException("Prmtop::read >> Cannot open file "+fileName);
+    }
+    std::stringstream buffer;
+    buffer << inFile.rdbuf();
+    parse(buffer.str());
+}
+
+void Prmtop::parse(const std::string& text){
+    version.clear();
+    flags.clear();
+    sections.clear();
+    pointers.clear();
+
+    std::istringstream in(text);
+    std::string line;
+    Section* current=NULL;
+    while(std::getline(in, line)){
+        if(!line.empty() && line[line.size()-1]=='\r') line.erase(line.size()-1);
+
+        if(line.compare(0, 8, "%VERSION")==0){
+            version=line;
+        }else if(line.compare(0, 5, "%FLAG")==0){
+            std::string flag=trim(line.substr(5));
+            flags.push_back(flag);
+            current=&sections[flag];
+        }else if(line.compare(0, 7, "%FORMAT")==0){
+            if(current==NULL) throw LBindException("Prmtop::parse >> %FORMAT before %FLAG");
+            current->format=trim(line.substr(7));
+            current->width=fieldWidth(current->format);
+        }else if(line.compare(0, 8, "%COMMENT")==0){
+            continue;
+        }else if(current!=NULL){
+            current->lines.push_back(line);
+        }
+    }
+
+    if(!has("POINTERS")){
+        throw LBindException("Prmtop::parse >> No POINTERS section");
+    }
+    pointers=ints("POINTERS");
+}
+
+void Prmtop::write(const std::string& fileName) const {
+    std::ofstream outFile(fileName.c_str());
+    if(!outFile.good()){
+        throw LBindException("Prmtop::write >> Cannot open file "+fileName);
+    }
+    if(!version.empty()) outFile << version << "\n";
+    for(const std::string& flag : flags){
+        const Section& sec=sections.find(flag)->second;
+        outFile << "%FLAG " << flag << "\n"
+                << "%FORMAT" << sec.format << "\n";
+        for(const std::string& line : sec.lines){
+            outFile << line << "\n";
+        }
+    }
+}
+
+bool Prmtop::has(const std::string& flag) const {
+    return sections.find(flag)!=sections.end();
+}
+
+const Prmtop::Section& Prmtop::section(const std::string& flag) const {
+    std::map<std::string, Section>::const_iterator it=sections.find(flag);
+    if(it==sections.end()){
+        throw LBindException("Prmtop >> No section "+flag);
+    }
+    if(it->second.width<=0){
+        throw LBindException("Prmtop >> Unknown format "+it->second.format+" of "+flag);
+    }
+    return it->second;
+}
+
+std::vector<std::string> Prmtop::strings(const std::string& flag) const {
+    const Section& sec=section(flag);
+    std::vector<std::string> fields;
+    for(const std::string& line : sec.lines){
+        for(size_t pos=0; pos<line.size(); pos+=sec.width){
+            fields.push_back(trim(line.substr(pos, sec.width)));
+        }
+    }
+    return fields;
+}
+
+std::vector<int> Prmtop::ints(const std::string& flag) const {
+    const Section& sec=section(flag);
+    std::vector<int> fields;
+    for(const std::string& line : sec.lines){
+        for(size_t pos=0; pos+sec.width<=line.size(); pos+=sec.width){
+            fields.push_back(std::atoi(line.substr(pos, sec.width).c_str()));
+        }
+    }
+    return fields;
+}
+
+std::vector<double> Prmtop::reals(const std::string& flag) const {
+    const Section& sec=section(flag);
+    std::vector<double> fields;
+    for(const std::string& line : sec.lines){
+        for(size_t pos=0; pos+sec.width<=line.size(); pos+=sec.width){
+            fields.push_back(std::atof(line.substr(pos, sec.width).c_str()));
+        }
+    }
+    return fields;
+}
+
+int Prmtop::pointer(Pointer p) const {
+    if(static_cast<size_t>(p)>=pointers.size()){
+        throw LBindException("Prmtop >> POINTERS section is too short");
+    }
+    return pointers[p];
+}
+
+Prmtop::Section& Prmtop::reset(const std::string& flag, const std::string& format, int& perLine){
+    if(!has(flag)) flags.push_back(flag);
+    Section& sec=sections[flag];
+    sec.format=format;
+    sec.width=fieldWidth(format);
+    sec.lines.clear();
+    perLine=std::atoi(format.c_str()+format.find_first_of("0123456789"));
+    if(sec.width<=0 || perLine<=0){
+        throw LBindException("Prmtop::set >> Unknown format "+format+" of "+flag);
+    }
+    return sec;
+}
+
+//! Fields joined perLine to a line; an empty section is one empty line, as tleap writes it.
+static void addLines(const std::vector<std::string>& fields, int perLine, std::vector<std::string>& lines){
+    std::string line;
+    for(size_t i=0; i<fields.size(); ++i){
+        line+=fields[i];
+        if(static_cast<int>(i%perLine)==perLine-1 || i+1==fields.size()){
+            lines.push_back(line);
+            line.clear();
+        }
+    }
+    if(fields.empty()) lines.push_back("");
+}
+
+void Prmtop::set(const std::string& flag, const std::string& format, const std::vector<int>& values){
+    int perLine=0;
+    Section& sec=reset(flag, format, perLine);
+    std::vector<std::string> fields;
+    char buf[32];
+    for(int v : values){
+        std::snprintf(buf, sizeof(buf), "%*d", sec.width, v);
+        fields.push_back(buf);
+    }
+    addLines(fields, perLine, sec.lines);
+    if(flag=="POINTERS") pointers=values;
+}
+
+void Prmtop::set(const std::string& flag, const std::string& format, const std::vector<double>& values){
+    int perLine=0;
+    Section& sec=reset(flag, format, perLine);
+    size_t dot=format.find('.');
+    int precision=(dot==std::string::npos) ? 8 : std::atoi(format.c_str()+dot+1);
+    std::vector<std::string> fields;
+    char buf[64];
+    for(double v : values){
+        std::snprintf(buf, sizeof(buf), "%*.*E", sec.width, precision, v);
+        fields.push_back(buf);
+    }
+    addLines(fields, perLine, sec.lines);
+}
+
+void Prmtop::set(const std::string& flag, const std::string& format, const std::vector<std::string>& values){
+    int perLine=0;
+    Section& sec=reset(flag, format, perLine);
+    std::vector<std::string> fields;
+    for(const std::string& v : values){
+        std::string field=v.substr(0, sec.width);
+        field.resize(sec.width, ' ');
+        fields.push_back(field);
+    }
+    addLines(fields, perLine, sec.lines);
+}
+
+void readAmberCoords(const std::string& fileName, std::vector<double>& xyz){
+    std::ifstream inFile(fileName.c_str());
+    if(!inFile.good()){
+        throw LBindException("readAmberCoords >> Cannot open file "+fileName);
+    }
+
+    std::string line;
+    std::getline(inFile, line); // title
+    std::getline(inFile, line);
+    int natom=0;
+    std::istringstream(line) >> natom;
+    if(natom<=0){
+        throw LBindException("readAmberCoords >> No atom count in "+fileName);
+    }
+
+    // 6F12.7
+    const size_t width=12;
+    xyz.clear();
+    xyz.reserve(3*natom);
+    while(xyz.size()<3*static_cast<size_t>(natom) && std::getline(inFile, line)){
+        for(size_t pos=0; pos+width<=line.size() && xyz.size()<3*static_cast<size_t>(natom); pos+=width){
+            xyz.push_back(std::atof(line.substr(pos, width).c_str()));
+        }
+    }
+    if(xyz.size()!=3*static_cast<size_t>(natom)){
+        throw LBindException("readAmberCoords >> Truncated coordinates in "+fileName);
+    }
+}
+
+void writeAmberCoords(const std::string& fileName, const std::vector<double>& xyz, const std::string& title){
+    std::ofstream outFile(fileName.c_str());
+    if(!outFile.good()){
+        throw LBindException("writeAmberCoords >> Cannot open file "+fileName);
+    }
+
+    outFile << title << "\n";
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "%6d\n", static_cast<int>(xyz.size()/3));
+    outFile << buf;
+    for(size_t i=0; i<xyz.size(); ++i){
+        std::snprintf(buf, sizeof(buf), "%12.7f", xyz[i]);
+        outFile << buf;
+        if(i%6==5 || i+1==xyz.size()) outFile << "\n";
+    }
+}
+
+}//namespace LBIND
@@ -0,0 +1,80 @@
+//
+// Reader for Amber topology (prmtop) and coordinate (inpcrd/restart) files.
+//
+// A prmtop is a list of %FLAG sections, each with a Fortran %FORMAT such as
+// (20a4), (10I8) or (5E16.8). The sections are kept as raw lines and decoded
+// on request, so reading a large receptor topology stays cheap.
+//
+
+#ifndef CONVEYORLC_PRMTOP_H
+#define CONVEYORLC_PRMTOP_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace LBIND {
+
+class Prmtop {
+public:
+    //! POINTERS entries, in file order.
+    enum Pointer { NATOM=0, NTYPES, NBONH, MBONA, NTHETH, MTHETA, NPHIH, MPHIA,
+                   NHPARM, NPARM, NNB, NRES, NBONA, NTHETA, NPHIA, NUMBND,
+                   NUMANG, NPTRA, NATYP, NPHB, IFPERT, NBPER, NGPER, NDPER,
+                   MBPER, MGPER, MDPER, IFBOX, NMXRS, IFCAP, NUMEXTRA, NCOPY };
+
+    //! Throws LBindException if the file cannot be read or is not a prmtop.
+    void read(const std::string& fileName);
+    void parse(const std::string& text);
+
+    //! The sections as read, in file order.
+    void write(const std::string& fileName) const;
+
+    bool has(const std::string& flag) const;
+
+    //! Fields of a section, trimmed of blanks for the character formats.
+    std::vector<std::string> strings(const std::string& flag) const;
+    std::vector<int> ints(const std::string& flag) const;
+    std::vector<double> reals(const std::string& flag) const;
+
+    int pointer(Pointer p) const;
+    int natom() const { return pointer(NATOM); }
+
+    //! Section flags in file order.
+    const std::vector<std::string>& sectionFlags() const { return flags; }
+    std::string format(const std::string& flag) const { return section(flag).format; }
+
+    //! Replaces a section, or appends it, with the values written in a format such as (10I8),
+    //! (5E16.8) or (20a4). Setting POINTERS updates pointer().
+    void set(const std::string& flag, const std::string& format, const std::vector<int>& values);
+    void set(const std::string& flag, const std::string& format, const std::vector<double>& values);
+    void set(const std::string& flag, const std::string& format, const std::vector<std::string>& values);
+    void setVersion(const std::string& line) { version=line; }
+    const std::string& versionLine() const { return version; }
+
+private:
+    struct Section {
+        std::string format;
+        int width=0;
+        std::vector<std::string> lines;
+    };
+
+    const Section& section(const std::string& flag) const;
+    //! The section of flag, appended if new, with format set and no lines; returns the fields per line.
+    Section& reset(const std::string& flag, const std::string& format, int& perLine);
+
+    std::string version;
+    std::vector<std::string> flags;
+    std::map<std::string, Section> sections;
+    std::vector<int> pointers;
+};
+
+//! Coordinates of an inpcrd or restart file (x1 y1 z1 x2 ...), without velocities or box.
+void readAmberCoords(const std::string& fileName, std::vector<double>& xyz);
+
+//! Write xyz as an inpcrd file sander can read with -c.
+void writeAmberCoords(const std::string& fileName, const std::vector<double>& xyz, const std::string& title);
+
+}//namespace LBIND
+
+#endif //CONVEYORLC_PRMTOP_H
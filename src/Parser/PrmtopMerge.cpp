@@ -0,0 +1,221 @@
+//
+// Combined Amber topology of two molecules.
+//
+
+#include "Parser/PrmtopMerge.h"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+
+#include "Common/LBindException.h"
+
+namespace LBIND {
+
+namespace {
+
+//! Lennard-Jones well depth and radius (half of Rmin) of each atom type, from the diagonal of the
+//! A and B tables; throws when a pair of types is off the Lorentz-Berthelot rule.
+void ljTypes(const Prmtop& p, std::vector<double>& eps, std::vector<double>& radius){
+    int nt=p.pointer(Prmtop::NTYPES);
+    std::vector<int> ico=p.ints("NONBONDED_PARM_INDEX");
+    std::vector<double> acoef=p.reals("LENNARD_JONES_ACOEF");
+    std::vector<double> bcoef=p.reals("LENNARD_JONES_BCOEF");
+    if(static_cast<int>(ico.size())!=nt*nt){
+        throw LBindException("mergePrmtop >> NONBONDED_PARM_INDEX does not match NTYPES");
+    }
+    for(int idx : ico){
+        if(idx<=0 || idx>static_cast<int>(acoef.size()) || idx>static_cast<int>(bcoef.size())){
+            throw LBindException("mergePrmtop >> hydrogen-bond (10-12) terms are not supported");
+        }
+    }
+
+    eps.assign(nt, 0);
+    radius.assign(nt, 0);
+    for(int i=0; i<nt; ++i){
+        double a=acoef[ico[i*nt+i]-1];
+        double b=bcoef[ico[i*nt+i]-1];
+        if(a>0 && b>0){
+            eps[i]=b*b/(4.0*a);
+            radius[i]=0.5*std::pow(2.0*a/b, 1.0/6.0);
+        }else if(a!=0 || b!=0){
+            throw LBindException("mergePrmtop >> unsupported Lennard-Jones parameters");
+        }
+    }
+
+    auto close=[](double x, double y){
+        return std::fabs(x-y)<=1.0e-5*std::max(std::fabs(x), std::fabs(y))+1.0e-6;
+    };
+    for(int i=0; i<nt; ++i){
+        for(int j=i+1; j<nt; ++j){
+            double r=radius[i]+radius[j];
+            double e=std::sqrt(eps[i]*eps[j]);
+            double r6=r*r*r*r*r*r;
+            if(!close(acoef[ico[i*nt+j]-1], e*r6*r6) || !close(bcoef[ico[i*nt+j]-1], 2.0*e*r6)){
+                throw LBindException("mergePrmtop >> Lennard-Jones pairs off the combining rule are not supported");
+            }
+        }
+    }
+}
+
+//! a, then b with the atom indices (3*index, the sign kept for dihedrals) and the type of each
+//! group of entries shifted.
+std::vector<int> appendList(const Prmtop& a, const Prmtop& b, const std::string& flag, int group,
+                            int atomShift, int typeShift){
+    std::vector<int> list=a.ints(flag);
+    std::vector<int> bList=b.ints(flag);
+    for(size_t k=0; k<bList.size(); ++k){
+        int v=bList[k];
+        if(static_cast<int>(k%group)==group-1){
+            v+=typeShift;
+        }else{
+            v=(v<0) ? v-3*atomShift : v+3*atomShift;
+        }
+        list.push_back(v);
+    }
+    return list;
+}
+
+template<typename T>
+std::vector<T> concat(std::vector<T> a, const std::vector<T>& b){
+    a.insert(a.end(), b.begin(), b.end());
+    return a;
+}
+
+}
+
+Prmtop mergePrmtop(const Prmtop& a, const Prmtop& b){
+    static const std::set<std::string> stringFlags={"TITLE", "ATOM_NAME", "AMBER_ATOM_TYPE",
+        "TREE_CHAIN_CLASSIFICATION", "RESIDUE_LABEL"};
+    static const std::set<std::string> realFlags={"CHARGE", "MASS", "RADII", "SCREEN",
+        "BOND_FORCE_CONSTANT", "BOND_EQUIL_VALUE", "ANGLE_FORCE_CONSTANT", "ANGLE_EQUIL_VALUE",
+        "DIHEDRAL_FORCE_CONSTANT", "DIHEDRAL_PERIODICITY", "DIHEDRAL_PHASE", "SCEE_SCALE_FACTOR",
+        "SCNB_SCALE_FACTOR", "SOLTY", "HBOND_ACOEF", "HBOND_BCOEF", "HBCUT"};
+    static const std::set<std::string> intFlags={"ATOMIC_NUMBER", "NUMBER_EXCLUDED_ATOMS", "JOIN_ARRAY",
+        "IROTAT"};
+    static const std::set<std::string> otherFlags={"POINTERS", "ATOM_TYPE_INDEX", "NONBONDED_PARM_INDEX",
+        "LENNARD_JONES_ACOEF", "LENNARD_JONES_BCOEF", "RESIDUE_POINTER", "EXCLUDED_ATOMS_LIST",
+        "BONDS_INC_HYDROGEN", "BONDS_WITHOUT_HYDROGEN", "ANGLES_INC_HYDROGEN", "ANGLES_WITHOUT_HYDROGEN",
+        "DIHEDRALS_INC_HYDROGEN", "DIHEDRALS_WITHOUT_HYDROGEN", "RADIUS_SET", "IPOL"};
+
+    std::set<std::string> aFlags(a.sectionFlags().begin(), a.sectionFlags().end());
+    std::set<std::string> bFlags(b.sectionFlags().begin(), b.sectionFlags().end());
+    if(aFlags!=bFlags){
+        throw LBindException("mergePrmtop >> the topologies have different sections");
+    }
+    for(const std::string& flag : aFlags){
+        if(!stringFlags.count(flag) && !realFlags.count(flag) && !intFlags.count(flag) && !otherFlags.count(flag)){
+            throw LBindException("mergePrmtop >> section "+flag+" is not supported");
+        }
+    }
+    for(Prmtop::Pointer p : {Prmtop::IFPERT, Prmtop::NBPER, Prmtop::NGPER, Prmtop::NDPER, Prmtop::MBPER,
+                             Prmtop::MGPER, Prmtop::MDPER, Prmtop::IFBOX, Prmtop::IFCAP, Prmtop::NUMEXTRA}){
+        if(a.pointer(p)!=0 || b.pointer(p)!=0){
+            throw LBindException("mergePrmtop >> boxes, caps, perturbation and extra points are not supported");
+        }
+    }
+    if(a.has("IPOL") && (a.ints("IPOL")!=std::vector<int>(1, 0) || b.ints("IPOL")!=std::vector<int>(1, 0))){
+        throw LBindException("mergePrmtop >> polarizable topologies are not supported");
+    }
+    if(a.has("RADIUS_SET") && a.strings("RADIUS_SET")!=b.strings("RADIUS_SET")){
+        throw LBindException("mergePrmtop >> the topologies have different GB radius sets");
+    }
+
+    int na=a.natom();
+    int nta=a.pointer(Prmtop::NTYPES);
+    int nt=nta+b.pointer(Prmtop::NTYPES);
+
+    std::vector<double> eps, radius, bEps, bRadius;
+    ljTypes(a, eps, radius);
+    ljTypes(b, bEps, bRadius);
+    eps=concat(eps, bEps);
+    radius=concat(radius, bRadius);
+
+    Prmtop c;
+    c.setVersion(a.versionLine());
+    for(const std::string& flag : a.sectionFlags()){
+        std::string format=a.format(flag);
+
+        if(flag=="TITLE" || flag=="RADIUS_SET"){
+            c.set(flag, format, a.strings(flag));
+        }else if(flag=="IPOL"){
+            c.set(flag, format, a.ints(flag));
+        }else if(stringFlags.count(flag)){
+            c.set(flag, format, concat(a.strings(flag), b.strings(flag)));
+        }else if(realFlags.count(flag)){
+            c.set(flag, format, concat(a.reals(flag), b.reals(flag)));
+        }else if(intFlags.count(flag)){
+            c.set(flag, format, concat(a.ints(flag), b.ints(flag)));
+        }else if(flag=="POINTERS"){
+            c.set(flag, format, a.ints(flag)); // counts are set below
+        }else if(flag=="ATOM_TYPE_INDEX" || flag=="RESIDUE_POINTER"){
+            int shift=(flag=="ATOM_TYPE_INDEX") ? nta : na;
+            std::vector<int> list=b.ints(flag);
+            for(int& v : list) v+=shift;
+            c.set(flag, format, concat(a.ints(flag), list));
+        }else if(flag=="EXCLUDED_ATOMS_LIST"){
+            std::vector<int> list=b.ints(flag);
+            for(int& v : list){
+                if(v>0) v+=na;
+            }
+            c.set(flag, format, concat(a.ints(flag), list));
+        }else if(flag=="BONDS_INC_HYDROGEN" || flag=="BONDS_WITHOUT_HYDROGEN"){
+            c.set(flag, format, appendList(a, b, flag, 3, na, a.pointer(Prmtop::NUMBND)));
+        }else if(flag=="ANGLES_INC_HYDROGEN" || flag=="ANGLES_WITHOUT_HYDROGEN"){
+            c.set(flag, format, appendList(a, b, flag, 4, na, a.pointer(Prmtop::NUMANG)));
+        }else if(flag=="DIHEDRALS_INC_HYDROGEN" || flag=="DIHEDRALS_WITHOUT_HYDROGEN"){
+            c.set(flag, format, appendList(a, b, flag, 5, na, a.pointer(Prmtop::NPTRA)));
+        }else if(flag=="NONBONDED_PARM_INDEX"){
+            // tleap layout: the pair (i, j), i<=j, is entry j*(j-1)/2+i (1-based)
+            std::vector<int> ico(nt*nt);
+            for(int i=0; i<nt; ++i){
+                for(int j=0; j<nt; ++j){
+                    int lo=std::min(i, j);
+                    int hi=std::max(i, j);
+                    ico[i*nt+j]=hi*(hi+1)/2+lo+1;
+                }
+            }
+            c.set(flag, format, ico);
+        }else if(flag=="LENNARD_JONES_ACOEF" || flag=="LENNARD_JONES_BCOEF"){
+            bool acoef=(flag=="LENNARD_JONES_ACOEF");
+            std::vector<int> aIco=a.ints("NONBONDED_PARM_INDEX");
+            std::vector<int> bIco=b.ints("NONBONDED_PARM_INDEX");
+            std::vector<double> aTable=a.reals(flag);
+            std::vector<double> bTable=b.reals(flag);
+            int ntb=nt-nta;
+
+            std::vector<double> table(nt*(nt+1)/2);
+            for(int j=0; j<nt; ++j){
+                for(int i=0; i<=j; ++i){
+                    double v;
+                    if(j<nta){
+                        v=aTable[aIco[i*nta+j]-1];
+                    }else if(i>=nta){
+                        v=bTable[bIco[(i-nta)*ntb+(j-nta)]-1];
+                    }else{
+                        double r=radius[i]+radius[j];
+                        double e=std::sqrt(eps[i]*eps[j]);
+                        double r6=r*r*r*r*r*r;
+                        v=acoef ? e*r6*r6 : 2.0*e*r6;
+                    }
+                    table[j*(j+1)/2+i]=v;
+                }
+            }
+            c.set(flag, format, table);
+        }
+    }
+
+    std::vector<int> pointers=a.ints("POINTERS");
+    for(Prmtop::Pointer p : {Prmtop::NATOM, Prmtop::NTYPES, Prmtop::NBONH, Prmtop::MBONA, Prmtop::NTHETH,
+                             Prmtop::MTHETA, Prmtop::NPHIH, Prmtop::MPHIA, Prmtop::NRES, Prmtop::NBONA,
+                             Prmtop::NTHETA, Prmtop::NPHIA, Prmtop::NUMBND, Prmtop::NUMANG, Prmtop::NPTRA,
+                             Prmtop::NATYP, Prmtop::NPHB}){
+        pointers[p]+=b.pointer(p);
+    }
+    pointers[Prmtop::NNB]=c.ints("EXCLUDED_ATOMS_LIST").size();
+    pointers[Prmtop::NMXRS]=std::max(a.pointer(Prmtop::NMXRS), b.pointer(Prmtop::NMXRS));
+    c.set("POINTERS", a.format("POINTERS"), pointers);
+    return c;
+}
+
+}//namespace LBIND
@@ -0,0 +1,27 @@
+//
+// Combined Amber topology of two molecules, the in-process counterpart of
+// "combine {A B}; saveamberparm" in tleap.
+//
+// The atoms of b follow those of a. Per-atom and per-residue sections are
+// concatenated, the bonded lists and parameter tables appended with their
+// indices shifted, and the atom types of b get new type indices. The
+// Lennard-Jones pairs between a and b types follow the Lorentz-Berthelot
+// rule tleap applies, so topologies whose own pairs do not (NBFIX-style
+// edits, 10-12 hydrogen-bond terms) are refused. So are periodic boxes,
+// perturbation, extra points and any section the merger does not know, such
+// as CMAP; the caller then falls back to tleap.
+//
+
+#ifndef CONVEYORLC_PRMTOPMERGE_H
+#define CONVEYORLC_PRMTOPMERGE_H
+
+#include "Parser/Prmtop.h"
+
+namespace LBIND {
+
+//! a followed by b. Throws LBindException for topologies it does not handle.
+Prmtop mergePrmtop(const Prmtop& a, const Prmtop& b);
+
+}//namespace LBIND
+
+#endif //CONVEYORLC_PRMTOPMERGE_H
@@ -9,6 +9,7 @@
 #include "Common/Tokenize.hpp"
 #include "Structure/Sstrm.hpp"
 
+#include <boost/algorithm/string.hpp>
 #include <boost/regex.hpp>
 
 namespace LBIND{
@@ -110,4 +111,112 @@ bool SanderOutput::getEnergy(std::string sanderOutFile, double& energy){
     return false;
 }
 
+bool SanderOutput::getTerms(std::string sanderOutFile, std::map<std::string, double>& terms){
+    std::ifstream inFile(sanderOutFile.c_str());
+    if(!inFile){
+        std::cout << "SanderOutput::getTerms >> Cannot open file " << sanderOutFile << std::endl;
+        return false;
+    }
+
+    static const boost::regex nstepRegex("NSTEP");
+    static const boost::regex termRegex("([0-9A-Z][-0-9A-Z ]*?)\\s*=\\s*(-?[0-9]+\\.[0-9]+)");
+
+    std::vector<std::string> lineVector;
+    std::string fileLine;
+    while(std::getline(inFile, fileLine)){
+        lineVector.push_back(fileLine);
+    }
+
+    int start=-1;
+    for(int i=lineVector.size()-1; i>=0; i--){
+        if(boost::regex_search(lineVector[i], nstepRegex)){
+            start=i;
+            break;
+        }
+    }
+    if(start<0) return false;
+
+    terms.clear();
+    bool inBlock=false;
+    for(unsigned i=start+2; i<lineVector.size(); ++i){
+        boost::sregex_iterator it(lineVector[i].begin(), lineVector[i].end(), termRegex);
+        boost::sregex_iterator end;
+        if(it==end){
+            if(inBlock) break;
+            continue;
+        }
+        inBlock=true;
+        for(; it!=end; ++it){
+            terms[(*it)[1].str()]=Sstrm<double, std::string>((*it)[2].str());
+        }
+    }
+    return !terms.empty();
+}
+
+bool SanderOutput::getInput(std::string sanderOutFile, std::map<std::string, std::string>& settings,
+                            std::map<std::string, std::string>& files){
+    std::ifstream inFile(sanderOutFile.c_str());
+    if(!inFile){
+        std::cout << "SanderOutput::getInput >> Cannot open file " << sanderOutFile << std::endl;
+        return false;
+    }
+
+    static const boost::regex fileRegex("^\\|\\s*([A-Z]+):\\s*(\\S+)");
+    static const boost::regex inputRegex("Here is the input file");
+    static const boost::regex settingRegex("(\\w+)\\s*=\\s*('[^']*'|\"[^\"]*\"|[^,\\s]+)");
+    static const boost::regex endRegex("^\\s*(/|&end)\\s*$");
+
+    settings.clear();
+    files.clear();
+    bool inInput=false;
+    boost::smatch what;
+    std::string fileLine;
+    while(std::getline(inFile, fileLine)){
+        if(!inInput){
+            if(boost::regex_search(fileLine, what, fileRegex)){
+                files[what[1].str()]=what[2].str();
+            }else if(boost::regex_search(fileLine, inputRegex)){
+                inInput=true;
+            }
+            continue;
+        }
+        if(boost::regex_search(fileLine, endRegex)) break;
+
+        boost::sregex_iterator end;
+        for(boost::sregex_iterator it(fileLine.begin(), fileLine.end(), settingRegex); it!=end; ++it){
+            std::string value=(*it)[2].str();
+            if(value.size()>=2 && (value[0]=='\'' || value[0]=='"')){
+                value=value.substr(1, value.size()-2);
+            }
+            settings[boost::algorithm::to_lower_copy((*it)[1].str())]=value;
+        }
+    }
+    return inInput;
+}
+
+bool SanderOutput::getTimes(std::string sanderOutFile, double& cpu, double& wall){
+    std::ifstream inFile(sanderOutFile.c_str());
+    if(!inFile){
+        std::cout << "SanderOutput::getTimes >> Cannot open file " << sanderOutFile << std::endl;
+        return false;
+    }
+
+    static const boost::regex cpuRegex("Total CPU time:\\s*([0-9.]+)");
+    static const boost::regex wallRegex("Total wall time:\\s*([0-9.]+)");
+
+    bool hasCpu=false, hasWall=false;
+    boost::smatch what;
+    std::string fileLine;
+    while(std::getline(inFile, fileLine)){
+        if(boost::regex_search(fileLine, what, cpuRegex)){
+            cpu=Sstrm<double, std::string>(what[1].str());
+            hasCpu=true;
+        }else if(boost::regex_search(fileLine, what, wallRegex)){
+            wall=Sstrm<double, std::string>(what[1].str());
+            hasWall=true;
+        }
+    }
+    return hasCpu && hasWall;
+}
+
 }//namespace LBIND
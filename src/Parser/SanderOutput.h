@@ -8,6 +8,7 @@
 #ifndef SANDEROUTPUT_H
 #define	SANDEROUTPUT_H
 
+#include <map>
 #include <string>
 
 namespace LBIND{
@@ -20,6 +21,15 @@ public:
     
     bool getEAmber(std::string sanderOutFile, double& energy);
     bool getEnergy(std::string sanderOutFile, double& energy);
+    //! Terms of the last energy block (BOND, ANGLE, DIHED, VDWAALS, EEL, EGB, 1-4 VDW, 1-4 EEL, RESTRAINT, ESURF).
+    bool getTerms(std::string sanderOutFile, std::map<std::string, double>& terms);
+    //! The &cntrl settings echoed from the mdin file (lower case names) and the file assignments
+    //! (PARM, INPCRD, RESTRT, ...).
+    bool getInput(std::string sanderOutFile, std::map<std::string, std::string>& settings,
+                  std::map<std::string, std::string>& files);
+    //! Total CPU and wall times in seconds from the timing summary at the end of the output; wall is
+    //! whole seconds in sander.
+    bool getTimes(std::string sanderOutFile, double& cpu, double& wall);
 
 private:
 
@@ -0,0 +1,169 @@
+//
+// Byte-offset index of the records in a multi-structure SDF file.
+//
+
+#include "SdfIndex.h"
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Common/LBindException.h"
+
+namespace LBIND {
+
+static const char idxMagic[8]={'S', 'D', 'F', 'I', 'D', 'X', '1', '\0'};
+
+SdfIndex::SdfIndex() {
+}
+
+SdfIndex::~SdfIndex() {
+}
+
+size_t SdfIndex::size() const {
+    return offsets.empty() ? 0 : offsets.size()-1;
+}
+
+int64_t SdfIndex::offset(size_t i) const {
+    return offsets[i];
+}
+
+int64_t SdfIndex::length(size_t i) const {
+    return offsets[i+1]-offsets[i];
+}
+
+void SdfIndex::build(const std::string& fileName, bool useCache){
+    struct stat st;
+    if(stat(fileName.c_str(), &st)!=0){
+        throw LBindException("SdfIndex: cannot stat "+fileName);
+    }
+    int64_t fileSize=st.st_size;
+    int64_t mtime=st.st_mtime;
+    std::string idxFile=fileName+".idx";
+
+    if(useCache && loadCache(idxFile, fileSize, mtime)){
+        std::cout << "SdfIndex: use cached index " << idxFile << std::endl;
+        return;
+    }
+
+    scan(fileName);
+
+    if(useCache){
+        saveCache(idxFile, fileSize, mtime);
+    }
+}
+
+void SdfIndex::scan(const std::string& fileName){
+    offsets.clear();
+    offsets.push_back(0);
+
+    int fd=open(fileName.c_str(), O_RDONLY);
+    if(fd<0){
+        throw LBindException("SdfIndex: cannot open "+fileName);
+    }
+
+    struct stat st;
+    fstat(fd, &st);
+    size_t fileSize=st.st_size;
+    if(fileSize==0){
+        close(fd);
+        return;
+    }
+
+    void* addr=mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(addr==MAP_FAILED){
+        throw LBindException("SdfIndex: cannot mmap "+fileName);
+    }
+    madvise(addr, fileSize, MADV_SEQUENTIAL);
+
+    const char* base=static_cast<const char*>(addr);
+    const char* end=base+fileSize;
+    const char* p=base;
+
+    //! '$' is rare in SDF files, so memchr skips most of the data.
+    while(p<end){
+        p=static_cast<const char*>(memchr(p, '$', end-p));
+        if(p==NULL) break;
+
+        bool lineStart=(p==base || p[-1]=='\n');
+        if(lineStart && end-p>=4 && memcmp(p, "$$$$", 4)==0){
+            const char* nl=static_cast<const char*>(memchr(p, '\n', end-p));
+            p=(nl==NULL) ? end : nl+1;
+            offsets.push_back(p-base);
+        }else{
+            ++p;
+        }
+    }
+
+    munmap(addr, fileSize);
+}
+
+bool SdfIndex::loadCache(const std::string& idxFile, int64_t fileSize, int64_t mtime){
+    std::ifstream inFile(idxFile.c_str(), std::ios::binary);
+    if(!inFile.good()) return false;
+
+    char magic[8];
+    int64_t header[3];
+    inFile.read(magic, sizeof(magic));
+    inFile.read(reinterpret_cast<char*>(header), sizeof(header));
+    if(!inFile || memcmp(magic, idxMagic, sizeof(magic))!=0) return false;
+    if(header[0]!=fileSize || header[1]!=mtime || header[2]<0) return false;
+
+    std::vector<int64_t> cached(header[2]+1);
+    inFile.read(reinterpret_cast<char*>(cached.data()), cached.size()*sizeof(int64_t));
+    if(!inFile || cached.back()>fileSize) return false;
+
+    offsets.swap(cached);
+    return true;
+}
+
+void SdfIndex::saveCache(const std::string& idxFile, int64_t fileSize, int64_t mtime){
+    //! Write to a temporary file and rename, readers never see a partial index.
+    std::string tmpFile=idxFile+".tmp";
+    std::ofstream outFile(tmpFile.c_str(), std::ios::binary);
+    if(!outFile.good()){
+        std::cout << "SdfIndex: cannot write index cache " << idxFile << std::endl;
+        return;
+    }
+
+    int64_t header[3]={fileSize, mtime, static_cast<int64_t>(size())};
+    outFile.write(idxMagic, sizeof(idxMagic));
+    outFile.write(reinterpret_cast<const char*>(header), sizeof(header));
+    outFile.write(reinterpret_cast<const char*>(offsets.data()), offsets.size()*sizeof(int64_t));
+    outFile.close();
+
+    if(!outFile || std::rename(tmpFile.c_str(), idxFile.c_str())!=0){
+        std::remove(tmpFile.c_str());
+        std::cout << "SdfIndex: cannot write index cache " << idxFile << std::endl;
+    }
+}
+
+std::string SdfIndex::read(const std::string& fileName, int64_t offset, int64_t length){
+    int fd=open(fileName.c_str(), O_RDONLY);
+    if(fd<0){
+        throw LBindException("SdfIndex: cannot open "+fileName);
+    }
+
+    std::string buffer(length, '\0');
+    int64_t done=0;
+    while(done<length){
+        ssize_t n=pread(fd, &buffer[done], length-done, offset+done);
+        if(n<=0){
+            close(fd);
+            throw LBindException("SdfIndex: cannot read record from "+fileName);
+        }
+        done+=n;
+    }
+    close(fd);
+
+    return buffer;
+}
+
+} //namespace LBIND
@@ -0,0 +1,48 @@
+//
+// Byte-offset index of the records in a multi-structure SDF file.
+//
+// Each record ends with a line starting with "$$$$". The index is built in
+// one pass over the memory-mapped file and cached next to the SDF file as
+// <sdf>.idx, keyed by the file size and modification time, so a restart
+// does not scan the library again.
+//
+
+#ifndef CONVEYORLC_SDFINDEX_H
+#define CONVEYORLC_SDFINDEX_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace LBIND {
+
+class SdfIndex {
+public:
+    SdfIndex();
+    virtual ~SdfIndex();
+
+    //! Build the index of fileName, or load it from the cache if it is still valid.
+    void build(const std::string& fileName, bool useCache=true);
+
+    //! Number of records.
+    size_t size() const;
+    //! Byte offset of record i (0-based).
+    int64_t offset(size_t i) const;
+    //! Byte length of record i, including the "$$$$" line.
+    int64_t length(size_t i) const;
+
+    //! Read one record with pread, without touching the rest of the file.
+    static std::string read(const std::string& fileName, int64_t offset, int64_t length);
+
+private:
+    void scan(const std::string& fileName);
+    bool loadCache(const std::string& idxFile, int64_t fileSize, int64_t mtime);
+    void saveCache(const std::string& idxFile, int64_t fileSize, int64_t mtime);
+
+    //! Start of each record, followed by the end of the last record.
+    std::vector<int64_t> offsets;
+};
+
+} //namespace LBIND
+
+#endif //CONVEYORLC_SDFINDEX_H
@@ -20,8 +20,12 @@
 
 */
 
+#include <boost/atomic.hpp>
+#include <boost/thread/tss.hpp>
+
 #include "parallel.h"
 #include "parallel_mc.h"
+#include "Common/Affinity.h"
 #include "coords.h"
 #include "parallel_progress.h"
 
@@ -43,9 +47,17 @@ struct parallel_mc_aux {
 	const vec* corner1;
 	const vec* corner2;
 	parallel_progress* pg;
-	parallel_mc_aux(const monte_carlo* mc_, const precalculate* p_, const igrid* ig_, const precalculate* p_widened_, const igrid* ig_widened_, const vec* corner1_, const vec* corner2_, parallel_progress* pg_)
-		: mc(mc_), p(p_), ig(ig_), p_widened(p_widened_), ig_widened(ig_widened_), corner1(corner1_), corner2(corner2_), pg(pg_) {}
+	const std::vector<int>* cpus;
+	mutable boost::atomic<sz> next_cpu;
+	mutable boost::thread_specific_ptr<bool> pinned;
+	parallel_mc_aux(const monte_carlo* mc_, const precalculate* p_, const igrid* ig_, const precalculate* p_widened_, const igrid* ig_widened_, const vec* corner1_, const vec* corner2_, parallel_progress* pg_, const std::vector<int>* cpus_)
+		: mc(mc_), p(p_), ig(ig_), p_widened(p_widened_), ig_widened(ig_widened_), corner1(corner1_), corner2(corner2_), pg(pg_), cpus(cpus_), next_cpu(0) {}
 	void operator()(parallel_mc_task& t) const {
+		if(!cpus->empty() && pinned.get() == NULL) { // each worker thread takes the next CPU once
+			sz i = next_cpu++;
+			LBIND::pinThread((*cpus)[i % cpus->size()]);
+			pinned.reset(new bool(true));
+		}
 		(*mc)(t.m, t.out, *p, *ig, *p_widened, *ig_widened, *corner1, *corner2, pg, t.generator);
 	}
 };
@@ -64,7 +76,7 @@ void merge_output_containers(const parallel_mc_task_container& many, output_cont
 
 void parallel_mc::operator()(const model& m, output_container& out, const precalculate& p, const igrid& ig, const precalculate& p_widened, const igrid& ig_widened, const vec& corner1, const vec& corner2, rng& generator) const {
 	parallel_progress pp;
-	parallel_mc_aux parallel_mc_aux_instance(&mc, &p, &ig, &p_widened, &ig_widened, &corner1, &corner2, (display_progress ? (&pp) : NULL));
+	parallel_mc_aux parallel_mc_aux_instance(&mc, &p, &ig, &p_widened, &ig_widened, &corner1, &corner2, (display_progress ? (&pp) : NULL), &cpus);
 	parallel_mc_task_container task_container;
 	VINA_FOR(i, num_tasks)
 		task_container.push_back(new parallel_mc_task(m, random_int(0, 1000000, generator)));
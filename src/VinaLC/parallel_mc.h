@@ -30,6 +30,7 @@ struct parallel_mc {
 	sz num_tasks;
 	sz num_threads;
 	bool display_progress;
+	std::vector<int> cpus; // pin the threads to these CPUs, empty for no pinning
 	parallel_mc() : num_tasks(8), num_threads(1), display_progress(true) {}
 	void operator()(const model& m, output_container& out, const precalculate& p, const igrid& ig, const precalculate& p_widened, const igrid& ig_widened, const vec& corner1, const vec& corner2, rng& generator) const;
 };